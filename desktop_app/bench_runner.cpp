@@ -0,0 +1,335 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "connection_manager.hpp"
+#include "profile_sweep.hpp"
+#include "runner.hpp"
+
+namespace desktop = teleop_led_benchmarks::desktop;
+using ConnectionType = desktop::ConnectionType;
+
+
+static std::atomic<bool> stopFlag{false};
+
+
+static void handleSignal(int)
+{
+    stopFlag.store(true, std::memory_order_relaxed);
+}
+
+
+static void printUsage()
+{
+    std::cout << "Expected usage \"BenchRunner --[connectionType] [options]\"" << '\n'
+              << "For example \"BenchRunner --customTcp --count 5000 --rate 100 --out results.json\"" << '\n'
+              << "Supported connection types are websocket, customTcp, udp and shm" << '\n'
+              << "\"BenchRunner --sweep [options]\" instead runs every pair of desktop and device socket" << '\n'
+              << "profiles on websocket, customTcp and udp against an emulated device in this process" << '\n'
+              << "Options:" << '\n'
+              << "  --count N     recorded round trips (default 1000)" << '\n'
+              << "  --warmup N    round trips sent before recording (default 0)" << '\n'
+              << "  --rate HZ     command rate, 0 sends back-to-back (default 0)" << '\n'
+              << "  --window N    max commands in flight, 1 is stop-and-wait (default 1)" << '\n'
+              << "  --stream HZ   stream setpoints open loop at HZ, e.g. 100 to 10000, regardless of acks" << '\n'
+              << "  --timeout-ms N  ack timeout per command (default 1000)" << '\n'
+              << "  --payload N   command payload bytes, up to 496 (default 0)" << '\n'
+              << "  --out PATH    export results as json" << '\n'
+              << "  --trace PATH  export per-stage command spans as chrome trace json" << '\n'
+              << "  --log PATH    stream every io event to a binary results log" << '\n'
+              << "  --devices N   accept a fleet of N devices instead of one, --count is then" << '\n'
+              << "                the number of rounds that each send a command to all of them" << '\n'
+              << "  --shards N    fleet acceptors sharing the port (default 1)" << '\n'
+              << "  --threads N   fleet io threads (default 1)" << '\n'
+              << "  --thread-sweep LIST  rerun the fleet with each comma separated io thread count, like 1,2,4,8," << '\n'
+              << "                   then print the throughput of each, the emulator reconnects in between" << '\n'
+              << "  --shm-wait MODE  busy or futex, how shm acks are waited for (default futex)" << '\n'
+              << "  --tcp-io MODE    epoll or io_uring, how customTcp reads and writes (default epoll)" << '\n'
+              << "  --busy-poll US   keep polling for US after the last completion before parking in epoll" << '\n'
+              << "  --cpu LIST       pin the io thread to a cpu, like 2 or 2-3,6 to spread fleet io threads," << '\n'
+              << "                   ideally ones isolated with isolcpus" << '\n'
+              << "  --fifo PRIO      run the io threads as SCHED_FIFO with priority 1 to 99" << '\n'
+              << "  --mlock KB       lock all memory with mlockall and prefault KB of io thread stack" << '\n'
+              << "  --jitter-test N  before connecting, time N wakeups of the tuned io thread, cyclictest style" << '\n'
+              << "  --jitter-interval US  between jitter test wakeups (default 1000)" << '\n'
+              << "  --compare-busy-poll US  run once parking right away and once with --busy-poll US," << '\n'
+              << "                   then print what spinning removed and the cpu it cost" << '\n'
+              << "  --profile NAME   desktop socket profile (default default), one of" << '\n'
+              << "                   default, nodelay, quickack, busypoll, lowat, smallbuf, dscp-ef, all" << '\n'
+              << "  --profiles LIST  comma separated profiles to sweep (default all of them)" << std::endl;
+}
+
+
+int main(int argc, const char** argv)
+{
+    std::ios::sync_with_stdio(false);
+    if (argc < 2)
+    {
+        printUsage();
+        return 0;
+    }
+
+    desktop::RunnerConfig config{};
+    desktop::FleetBenchConfig fleetConfig{};
+    fleetConfig.numDevices = 0;
+    desktop::ProfileSweepConfig sweepConfig{};
+    std::optional<std::chrono::microseconds> comparedSpinBudget;
+    std::vector<size_t> sweptThreadCounts;
+    const std::string connStr = argv[1];
+    bool isSweep = connStr == "--sweep";
+    if (connStr == "--websocket")
+    {
+        config.connType = ConnectionType::WEB_SOCKET;
+    }
+    else if (connStr == "--customTcp")
+    {
+        config.connType = ConnectionType::CUSTOM_TCP;
+    }
+    else if (connStr == "--udp")
+    {
+        config.connType = ConnectionType::UDP;
+    }
+    else if (connStr == "--shm")
+    {
+        config.connType = ConnectionType::SHARED_MEMORY;
+    }
+    else if (!isSweep)
+    {
+        std::cerr << "Unknown connection type: " << connStr << std::endl;
+        return 1;
+    }
+
+    for (int i = 2; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return 1;
+        }
+        const std::string value = argv[++i];
+        try
+        {
+            if (arg == "--count")
+            {
+                config.numCommands = std::stoul(value);
+            }
+            else if (arg == "--warmup")
+            {
+                config.numWarmup = std::stoul(value);
+            }
+            else if (arg == "--rate")
+            {
+                config.rateHz = std::stod(value);
+            }
+            else if (arg == "--stream")
+            {
+                config.rateHz = std::stod(value);
+                config.isStreaming = true;
+            }
+            else if (arg == "--window")
+            {
+                config.maxInFlight = std::stoul(value);
+            }
+            else if (arg == "--timeout-ms")
+            {
+                config.ackTimeoutMs = std::stoul(value);
+            }
+            else if (arg == "--payload")
+            {
+                config.payloadSize = std::stoul(value);
+            }
+            else if (arg == "--out")
+            {
+                config.outPath = value;
+            }
+            else if (arg == "--trace")
+            {
+                config.tracePath = value;
+            }
+            else if (arg == "--log")
+            {
+                config.logPath = value;
+            }
+            else if (arg == "--devices")
+            {
+                fleetConfig.numDevices = std::stoul(value);
+            }
+            else if (arg == "--shards")
+            {
+                fleetConfig.fleet.numShards = std::stoul(value);
+            }
+            else if (arg == "--threads")
+            {
+                fleetConfig.fleet.numThreads = std::stoul(value);
+            }
+            else if (arg == "--thread-sweep")
+            {
+                for (size_t begin = 0; begin <= value.size();)
+                {
+                    size_t end = std::min(value.find(',', begin), value.size());
+                    sweptThreadCounts.push_back(std::stoul(value.substr(begin, end - begin)));
+                    if (sweptThreadCounts.back() == 0)
+                    {
+                        throw std::invalid_argument{"no io threads"};
+                    }
+                    begin = end + 1;
+                }
+            }
+            else if (arg == "--shm-wait")
+            {
+                config.shmWaitMode = desktop::parseShmWaitMode(value).value();
+            }
+            else if (arg == "--tcp-io")
+            {
+                config.tcpIoBackend = desktop::parseTcpIoBackend(value).value();
+            }
+            else if (arg == "--busy-poll")
+            {
+                config.busyPoll.spinBudget = std::chrono::microseconds(std::stol(value));
+            }
+            else if (arg == "--cpu")
+            {
+                config.threadTuning.cpus = desktop::parseCpuList(value).value();
+            }
+            else if (arg == "--fifo")
+            {
+                config.threadTuning.fifoPriority = std::stoi(value);
+            }
+            else if (arg == "--mlock")
+            {
+                config.threadTuning.isMemoryLocked = true;
+                config.threadTuning.stackPrefaultBytes = std::stoul(value) * 1024;
+            }
+            else if (arg == "--jitter-test")
+            {
+                config.jitterTest.numWakeups = std::stoul(value);
+            }
+            else if (arg == "--jitter-interval")
+            {
+                config.jitterTest.interval = std::chrono::microseconds(std::stol(value));
+            }
+            else if (arg == "--compare-busy-poll")
+            {
+                comparedSpinBudget = std::chrono::microseconds(std::stol(value));
+            }
+            else if (arg == "--profile")
+            {
+                config.socketProfile = desktop::findSocketProfile(value).value();
+            }
+            else if (arg == "--profiles")
+            {
+                sweepConfig.profiles.clear();
+                for (size_t begin = 0; begin <= value.size();)
+                {
+                    size_t end = std::min(value.find(',', begin), value.size());
+                    sweepConfig.profiles.push_back(
+                        desktop::findSocketProfile(value.substr(begin, end - begin)).value());
+                    begin = end + 1;
+                }
+            }
+            else
+            {
+                std::cerr << "Unknown option: " << arg << std::endl;
+                return 1;
+            }
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Invalid value for " << arg << ": " << value << std::endl;
+            return 1;
+        }
+    }
+
+    if (config.isStreaming && config.rateHz <= 0.0)
+    {
+        std::cerr << "--stream needs a rate above 0" << std::endl;
+        return 1;
+    }
+
+    std::signal(SIGINT, handleSignal);
+    std::signal(SIGTERM, handleSignal);
+
+    if (!sweptThreadCounts.empty() && fleetConfig.numDevices == 0)
+    {
+        std::cerr << "--thread-sweep needs --devices" << std::endl;
+        return 1;
+    }
+
+    if (isSweep)
+    {
+        if (!config.outPath.empty() || !config.tracePath.empty() || !config.logPath.empty() ||
+            fleetConfig.numDevices > 0)
+        {
+            std::cerr << "--out, --trace, --log and --devices are not supported with --sweep" << std::endl;
+            return 1;
+        }
+        sweepConfig.runner = config;
+        sweepConfig.emulator.retryInterval = std::chrono::milliseconds(5);
+        desktop::ProfileSweepReport sweepReport{};
+        int exitCode = desktop::runProfileSweep(stopFlag, sweepConfig, sweepReport);
+        desktop::printProfileSweepReport(std::cout, sweepReport);
+        return exitCode;
+    }
+
+    if (fleetConfig.numDevices > 0)
+    {
+        if (!config.outPath.empty() || !config.tracePath.empty() || !config.logPath.empty() ||
+            config.jitterTest.numWakeups > 0)
+        {
+            std::cerr << "--out, --trace, --log and --jitter-test are not supported with --devices" << std::endl;
+            return 1;
+        }
+        fleetConfig.fleet.connType = config.connType;
+        fleetConfig.fleet.threadTuning = config.threadTuning;
+        fleetConfig.fleet.ackTimeout = std::chrono::milliseconds(config.ackTimeoutMs);
+        fleetConfig.numRounds = config.numCommands;
+        if (!sweptThreadCounts.empty())
+        {
+            std::vector<desktop::FleetReport> sweepReports;
+            int exitCode = desktop::runFleetThreadSweep(stopFlag, fleetConfig, sweptThreadCounts, sweepReports);
+            desktop::printFleetThreadSweep(std::cout, sweepReports);
+            return exitCode;
+        }
+        desktop::FleetReport fleetReport{};
+        int exitCode = desktop::runFleetBenchmark(stopFlag, fleetConfig, fleetReport);
+        desktop::printFleetReport(std::cout, fleetReport);
+        return exitCode;
+    }
+
+    if (comparedSpinBudget)
+    {
+        if (!config.outPath.empty() || !config.tracePath.empty() || !config.logPath.empty())
+        {
+            std::cerr << "--out, --trace and --log are not supported with --compare-busy-poll" << std::endl;
+            return 1;
+        }
+        // The device reconnects for the second run, as it does whenever the desktop restarts.
+        desktop::RunnerReport blockingReport{};
+        config.busyPoll.spinBudget = std::chrono::microseconds::zero();
+        int exitCode = desktop::runBenchmark(stopFlag, config, blockingReport);
+        desktop::printReport(std::cout, blockingReport);
+        desktop::RunnerReport busyReport{};
+        config.busyPoll.spinBudget = *comparedSpinBudget;
+        exitCode |= desktop::runBenchmark(stopFlag, config, busyReport);
+        std::cout << '\n';
+        desktop::printReport(std::cout, busyReport);
+        std::cout << '\n';
+        desktop::printBusyPollComparison(std::cout, blockingReport, busyReport);
+        return exitCode;
+    }
+
+    desktop::RunnerReport report{};
+    int exitCode = desktop::runBenchmark(stopFlag, config, report);
+    desktop::printReport(std::cout, report);
+    if (!config.outPath.empty() && !desktop::exportReportJson(config.outPath, report))
+    {
+        return 1;
+    }
+    return exitCode;
+}
@@ -0,0 +1,284 @@
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <atomic>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "device_emulator.hpp"
+#include "messages.hpp"
+#include "runner.hpp"
+
+namespace desktop = teleop_led_benchmarks::desktop;
+using ConnectionType = desktop::ConnectionType;
+
+
+constexpr size_t NUM_WARMUP = 200;
+constexpr size_t NUM_BACK_TO_BACK = 2000;
+constexpr size_t NUM_AT_RATE = 500;
+constexpr std::array<size_t, 3> PAYLOAD_SIZES = {0, 128, desktop::MAX_PAYLOAD_SIZE};
+constexpr std::array<double, 2> RATES_HZ = {0.0, 1000.0};  // 0 is back-to-back
+// Compared against the baseline, the tails are too noisy to gate on.
+constexpr std::array<std::string_view, 2> GATED_COUNTERS = {"p50_us", "mean_us"};
+
+
+/**
+ * One iteration is a whole runner session against a fresh emulated device,
+ * so the udp device says hello again and every run starts from a new
+ * connection. The iteration time is the mean round trip.
+ */
+static void roundTrips(benchmark::State& state, ConnectionType connType, desktop::TcpIoBackend tcpIoBackend,
+    size_t payloadSize, double rateHz)
+{
+    desktop::RunnerReport report{};
+    for (auto _ : state)
+    {
+        desktop::EmulatorConfig emulatorConfig{};
+        emulatorConfig.connType = connType;
+        emulatorConfig.retryInterval = std::chrono::milliseconds(5);
+        std::atomic<bool> stopFlag{false};
+        desktop::EmulatorReport emulatorReport{};
+        auto futEmulator = std::async(std::launch::async, [&]()
+            { return desktop::runDeviceEmulator(stopFlag, emulatorConfig, emulatorReport); });
+
+        desktop::RunnerConfig config{};
+        config.connType = connType;
+        config.tcpIoBackend = tcpIoBackend;
+        config.numWarmup = NUM_WARMUP;
+        config.numCommands = rateHz > 0.0 ? NUM_AT_RATE : NUM_BACK_TO_BACK;
+        config.rateHz = rateHz;
+        config.payloadSize = payloadSize;
+        int exitCode = desktop::runBenchmark(stopFlag, config, report);
+        stopFlag.store(true);
+        futEmulator.get();
+        if (exitCode != 0)
+        {
+            state.SkipWithError("not every round trip completed");
+            return;
+        }
+        state.SetIterationTime(report.summary.meanMs / 1e3);
+    }
+    state.counters["p50_us"] = report.summary.p50Ms * 1e3;
+    state.counters["p99_us"] = report.summary.p99Ms * 1e3;
+    state.counters["mean_us"] = report.summary.meanMs * 1e3;
+    state.counters["round_trips"] = static_cast<double>(report.summary.count);
+}
+
+
+static void registerBenchmarks()
+{
+    using TcpIoBackend = desktop::TcpIoBackend;
+    // The io_uring backend only changes how the desktop side of customTcp does its io.
+    for (auto [connType, tcpIoBackend] : {std::pair{ConnectionType::WEB_SOCKET, TcpIoBackend::REACTOR},
+             std::pair{ConnectionType::CUSTOM_TCP, TcpIoBackend::REACTOR},
+             std::pair{ConnectionType::CUSTOM_TCP, TcpIoBackend::IO_URING},
+             std::pair{ConnectionType::UDP, TcpIoBackend::REACTOR},
+             std::pair{ConnectionType::SHARED_MEMORY, TcpIoBackend::REACTOR}})
+    {
+        for (size_t payloadSize : PAYLOAD_SIZES)
+        {
+            for (double rateHz : RATES_HZ)
+            {
+                std::string name = "RoundTrip/" +
+                    std::string(desktop::CONNECTION_TYPE_STRINGS[static_cast<size_t>(connType)]) +
+                    (tcpIoBackend == TcpIoBackend::IO_URING ? "+io_uring" : "") +
+                    "/payload:" + std::to_string(payloadSize) +
+                    "/rate:" + std::to_string(static_cast<int>(rateHz));
+                benchmark::RegisterBenchmark(name.c_str(), roundTrips, connType, tcpIoBackend, payloadSize,
+                    rateHz)
+                    ->Iterations(1)
+                    ->UseManualTime()
+                    ->Unit(benchmark::kMicrosecond);
+            }
+        }
+    }
+}
+
+
+// Keeps the counters of every run for the baseline comparison.
+class CollectingReporter : public benchmark::ConsoleReporter
+{
+   public:
+    void ReportRuns(const std::vector<Run>& runs) override
+    {
+        ConsoleReporter::ReportRuns(runs);
+        for (const Run& run : runs)
+        {
+            if (run.run_type != Run::RT_Iteration)
+            {
+                continue;
+            }
+            auto& counters = results[run.benchmark_name()];
+            for (const auto& [key, counter] : run.counters)
+            {
+                counters[key] = counter.value;
+            }
+        }
+    }
+
+    std::map<std::string, std::map<std::string, double>> results;
+};
+
+
+struct Tolerance
+{
+    double relative = 0.5;  // of the baseline value
+    double absoluteUs = 25.0;
+};
+
+
+/**
+ * Reads a --benchmark_out json file and checks each gated counter of the
+ * benchmarks that ran against it. Returns the number of regressions, or -1
+ * if the baseline can't be read. A failed run counts as a regression,
+ * benchmarks missing from the baseline are listed but don't fail.
+ */
+static int compareWithBaseline(const std::string& path,
+    const std::map<std::string, std::map<std::string, double>>& results, const Tolerance& tolerance)
+{
+    std::ifstream in{path};
+    if (!in)
+    {
+        std::cerr << "Failed to open baseline " << path << std::endl;
+        return -1;
+    }
+    nlohmann::json j;
+    try
+    {
+        in >> j;
+    }
+    catch (const nlohmann::json::exception& e)
+    {
+        std::cerr << "Invalid baseline " << path << ": " << e.what() << std::endl;
+        return -1;
+    }
+    std::map<std::string, nlohmann::json> baseline;
+    for (const auto& b : j.value("benchmarks", nlohmann::json::array()))
+    {
+        baseline[b.value("name", "")] = b;
+    }
+
+    int numRegressions = 0;
+    std::cout << std::fixed << std::setprecision(1) << "\ncompared with " << path << " (limit "
+              << tolerance.relative * 100.0 << "% + " << tolerance.absoluteUs << " us)\n";
+    for (const auto& [name, counters] : results)
+    {
+        auto it = baseline.find(name);
+        if (it == baseline.end())
+        {
+            std::cout << name << ": not in baseline\n";
+            continue;
+        }
+        for (std::string_view key : GATED_COUNTERS)
+        {
+            if (!it->second.contains(std::string(key)))
+            {
+                continue;
+            }
+            double was = it->second.at(std::string(key)).get<double>();
+            auto counter = counters.find(std::string(key));
+            if (counter == counters.end())
+            {
+                // The run failed and reported no counters.
+                ++numRegressions;
+                std::cout << name << " " << key << ": " << was << " -> no result  REGRESSION\n";
+                continue;
+            }
+            double now = counter->second;
+            bool isRegression = now > was * (1.0 + tolerance.relative) + tolerance.absoluteUs;
+            numRegressions += isRegression;
+            std::cout << name << " " << key << ": " << was << " -> " << now << " us"
+                      << (isRegression ? "  REGRESSION" : "") << '\n';
+        }
+    }
+    std::cout << std::flush;
+    return numRegressions;
+}
+
+
+static void printUsage()
+{
+    std::cout << "Transport round trip benchmarks, every connection type against an emulated device" << '\n'
+              << "Takes the usual --benchmark_* flags, e.g. --benchmark_out=results.json to save a baseline" << '\n'
+              << "Options:" << '\n'
+              << "  --baseline=PATH      fail if p50 or mean round trips regressed against this" << '\n'
+              << "                       --benchmark_out json" << '\n'
+              << "  --tolerance=F        allowed regression as a fraction of the baseline (default 0.5)" << '\n'
+              << "  --tolerance-us=N     allowed regression on top of that (default 25)" << std::endl;
+}
+
+
+int main(int argc, char** argv)
+{
+    std::string baselinePath{};
+    Tolerance tolerance{};
+    // Our flags are taken out before google benchmark rejects them as unrecognized.
+    std::vector<char*> args;
+    for (int i = 0; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        auto valueOf = [&arg](std::string_view flag)
+        { return arg.substr(flag.size()); };
+        try
+        {
+            if (arg.rfind("--baseline=", 0) == 0)
+            {
+                baselinePath = valueOf("--baseline=");
+            }
+            else if (arg.rfind("--tolerance=", 0) == 0)
+            {
+                tolerance.relative = std::stod(valueOf("--tolerance="));
+            }
+            else if (arg.rfind("--tolerance-us=", 0) == 0)
+            {
+                tolerance.absoluteUs = std::stod(valueOf("--tolerance-us="));
+            }
+            else if (arg == "--help")
+            {
+                printUsage();
+                return 0;
+            }
+            else
+            {
+                args.push_back(argv[i]);
+            }
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Invalid value: " << arg << std::endl;
+            return 1;
+        }
+    }
+    int numArgs = static_cast<int>(args.size());
+    benchmark::Initialize(&numArgs, args.data());
+    if (benchmark::ReportUnrecognizedArguments(numArgs, args.data()))
+    {
+        return 1;
+    }
+
+    registerBenchmarks();
+    CollectingReporter reporter{};
+    benchmark::RunSpecifiedBenchmarks(&reporter);
+    benchmark::Shutdown();
+    if (baselinePath.empty())
+    {
+        return 0;
+    }
+    int numRegressions = compareWithBaseline(baselinePath, reporter.results, tolerance);
+    if (numRegressions != 0)
+    {
+        std::cerr << (numRegressions < 0 ? "baseline comparison failed"
+                                         : std::to_string(numRegressions) + " regressions against the baseline")
+                  << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,144 @@
+#include <atomic>
+#include <csignal>
+#include <iostream>
+#include <string>
+
+#include "device_emulator.hpp"
+
+namespace desktop = teleop_led_benchmarks::desktop;
+using ConnectionType = desktop::ConnectionType;
+
+
+static std::atomic<bool> stopFlag{false};
+
+
+static void handleSignal(int)
+{
+    stopFlag.store(true, std::memory_order_relaxed);
+}
+
+
+static void printUsage()
+{
+    std::cout << "Expected usage \"DeviceEmulator --[connectionType] [options]\"" << '\n'
+              << "For example \"DeviceEmulator --customTcp --devices 4 --delay-us 500 --jitter-us 200\"" << '\n'
+              << "Supported connection types are websocket, customTcp, udp and shm" << '\n'
+              << "Options:" << '\n'
+              << "  --host HOST         desktop address (default 127.0.0.1)" << '\n'
+              << "  --port N            desktop port (default 9002, 9003 or 9004 by type)" << '\n'
+              << "  --devices N         emulated devices (default 1)" << '\n'
+              << "  --threads N         io threads the devices are spread over (default 1)" << '\n'
+              << "  --delay-us N        processing delay per command (default 0)" << '\n'
+              << "  --jitter-us N       uniform extra processing delay up to N (default 0)" << '\n'
+              << "  --clock-offset-us N device clock minus desktop clock (default 0)" << '\n'
+              << "  --seed N            jitter seed (default 1)" << '\n'
+              << "  --shm-wait MODE     busy or futex, how shm commands are waited for (default futex)" << '\n'
+              << "  --profile NAME      socket profile (default nodelay, like the firmware), see BenchRunner" << std::endl;
+}
+
+
+int main(int argc, const char** argv)
+{
+    std::ios::sync_with_stdio(false);
+    if (argc < 2)
+    {
+        printUsage();
+        return 0;
+    }
+
+    desktop::EmulatorConfig config{};
+    const std::string connStr = argv[1];
+    if (connStr == "--websocket")
+    {
+        config.connType = ConnectionType::WEB_SOCKET;
+    }
+    else if (connStr == "--customTcp")
+    {
+        config.connType = ConnectionType::CUSTOM_TCP;
+    }
+    else if (connStr == "--udp")
+    {
+        config.connType = ConnectionType::UDP;
+    }
+    else if (connStr == "--shm")
+    {
+        config.connType = ConnectionType::SHARED_MEMORY;
+    }
+    else
+    {
+        std::cerr << "Unknown connection type: " << connStr << std::endl;
+        return 1;
+    }
+
+    for (int i = 2; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return 1;
+        }
+        const std::string value = argv[++i];
+        try
+        {
+            if (arg == "--host")
+            {
+                config.host = value;
+            }
+            else if (arg == "--port")
+            {
+                config.port = static_cast<unsigned short>(std::stoul(value));
+            }
+            else if (arg == "--devices")
+            {
+                config.numDevices = std::stoul(value);
+            }
+            else if (arg == "--threads")
+            {
+                config.numThreads = std::stoul(value);
+            }
+            else if (arg == "--delay-us")
+            {
+                config.processingDelay = std::chrono::microseconds(std::stoll(value));
+            }
+            else if (arg == "--jitter-us")
+            {
+                config.processingJitter = std::chrono::microseconds(std::stoll(value));
+            }
+            else if (arg == "--clock-offset-us")
+            {
+                config.clockOffsetUs = std::stoll(value);
+            }
+            else if (arg == "--seed")
+            {
+                config.seed = static_cast<uint32_t>(std::stoul(value));
+            }
+            else if (arg == "--shm-wait")
+            {
+                config.shmWaitMode = desktop::parseShmWaitMode(value).value();
+            }
+            else if (arg == "--profile")
+            {
+                config.socketProfile = desktop::findSocketProfile(value).value();
+            }
+            else
+            {
+                std::cerr << "Unknown option: " << arg << std::endl;
+                return 1;
+            }
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Invalid value for " << arg << ": " << value << std::endl;
+            return 1;
+        }
+    }
+
+    std::signal(SIGINT, handleSignal);
+    std::signal(SIGTERM, handleSignal);
+
+    desktop::EmulatorReport report{};
+    int exitCode = desktop::runDeviceEmulator(stopFlag, config, report);
+    desktop::printEmulatorReport(std::cout, report);
+    return exitCode;
+}
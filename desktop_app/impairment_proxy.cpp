@@ -0,0 +1,150 @@
+#include <atomic>
+#include <csignal>
+#include <iostream>
+#include <string>
+
+#include "impairment_proxy.hpp"
+
+namespace desktop = teleop_led_benchmarks::desktop;
+using ConnectionType = desktop::ConnectionType;
+
+
+static std::atomic<bool> stopFlag{false};
+
+
+static void handleSignal(int)
+{
+    stopFlag.store(true, std::memory_order_relaxed);
+}
+
+
+static void printUsage()
+{
+    std::cout << "Expected usage \"ImpairmentProxy --[connectionType] --listen PORT [options]\"" << '\n'
+              << "For example \"ImpairmentProxy --customTcp --listen 9103 --script wifi.json\"" << '\n'
+              << "Supported connection types are websocket, customTcp and udp" << '\n'
+              << "Options:" << '\n'
+              << "  --listen PORT     port the device connects to instead of the desktop's" << '\n'
+              << "  --target-host H   desktop address (default 127.0.0.1)" << '\n'
+              << "  --target-port N   desktop port (default 9002, 9003 or 9004 by type)" << '\n'
+              << "  --script PATH     json impairment phases, overrides the options below" << '\n'
+              << "  --seed N          random seed (default 1)" << '\n'
+              << "  --delay-us N      one-way delay, both directions (default 0)" << '\n'
+              << "  --jitter-us N     uniform extra one-way delay up to N (default 0)" << '\n'
+              << "  --loss P          independent loss probability, both directions (default 0)" << '\n'
+              << "  --rate-bps N      bandwidth cap, both directions (default unlimited)" << std::endl;
+}
+
+
+int main(int argc, const char** argv)
+{
+    std::ios::sync_with_stdio(false);
+    if (argc < 2)
+    {
+        printUsage();
+        return 0;
+    }
+
+    desktop::ProxyConfig config{};
+    const std::string connStr = argv[1];
+    if (connStr == "--websocket")
+    {
+        config.connType = ConnectionType::WEB_SOCKET;
+    }
+    else if (connStr == "--customTcp")
+    {
+        config.connType = ConnectionType::CUSTOM_TCP;
+    }
+    else if (connStr == "--udp")
+    {
+        config.connType = ConnectionType::UDP;
+    }
+    else
+    {
+        std::cerr << "Unknown connection type: " << connStr << std::endl;
+        return 1;
+    }
+
+    desktop::LinkImpairment impairment{};
+    std::string scriptPath{};
+    for (int i = 2; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return 1;
+        }
+        const std::string value = argv[++i];
+        try
+        {
+            if (arg == "--listen")
+            {
+                config.listenPort = static_cast<unsigned short>(std::stoul(value));
+            }
+            else if (arg == "--target-host")
+            {
+                config.targetHost = value;
+            }
+            else if (arg == "--target-port")
+            {
+                config.targetPort = static_cast<unsigned short>(std::stoul(value));
+            }
+            else if (arg == "--script")
+            {
+                scriptPath = value;
+            }
+            else if (arg == "--seed")
+            {
+                config.seed = static_cast<uint32_t>(std::stoul(value));
+            }
+            else if (arg == "--delay-us")
+            {
+                impairment.delay = std::chrono::microseconds(std::stoll(value));
+            }
+            else if (arg == "--jitter-us")
+            {
+                impairment.jitter = std::chrono::microseconds(std::stoll(value));
+            }
+            else if (arg == "--loss")
+            {
+                impairment.goodLossProb = std::stod(value);
+            }
+            else if (arg == "--rate-bps")
+            {
+                impairment.bandwidthBps = std::stod(value);
+            }
+            else
+            {
+                std::cerr << "Unknown option: " << arg << std::endl;
+                return 1;
+            }
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Invalid value for " << arg << ": " << value << std::endl;
+            return 1;
+        }
+    }
+    if (config.listenPort == 0)
+    {
+        std::cerr << "Missing --listen" << std::endl;
+        return 1;
+    }
+    if (scriptPath.empty())
+    {
+        config.phases.push_back(desktop::ImpairmentPhase{std::chrono::milliseconds{0}, impairment, impairment});
+    }
+    else if (!desktop::loadImpairmentScript(scriptPath, config))
+    {
+        return 1;
+    }
+
+    std::signal(SIGINT, handleSignal);
+    std::signal(SIGTERM, handleSignal);
+
+    desktop::ProxyReport report{};
+    int exitCode = desktop::runImpairmentProxy(stopFlag, config, report);
+    desktop::printProxyReport(std::cout, report);
+    return exitCode;
+}
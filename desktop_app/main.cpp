@@ -1,5 +1,7 @@
 #include <atomic>
+#include <chrono>
 #include <iostream>
+#include <string>
 
 #include "app.hpp"
 
@@ -9,11 +11,19 @@ using ConnectionType = desktop::ConnectionType;
 
 int main(int argc, const char** argv)
 {
-    if (argc != 2)
+    if (argc < 2)
     {
-        std::cout << "Expected usage \"TeleopLed --[connectionType]\"" << '\n'
-                  << "For example \"TeleopLed --websocket\"" << '\n'
-                  << "Supported connection types are websocket, customTcp, and ..." << std::endl;
+        std::cout << "Expected usage \"TeleopLed --[connectionType] [--trace PATH] [--log PATH] [--render MODE] [--busy-poll US] [--cpu LIST] [--fifo PRIO] [--mlock KB] [--jitter-test N]\"" << '\n'
+                  << "For example \"TeleopLed --websocket --trace trace.json\"" << '\n'
+                  << "Supported connection types are websocket, customTcp, udp and shm" << '\n'
+                  << "--trace writes per-stage command spans as chrome trace json on exit" << '\n'
+                  << "--log streams every io event to a binary results log" << '\n'
+                  << "--render continuous redraws every vsync (default), events only on input or io results" << '\n'
+                  << "--busy-poll US keeps the network thread polling for US after each completion" << '\n'
+                  << "--cpu LIST pins the network thread to the first cpu of a list like 2 or 2-3,6" << '\n'
+                  << "--fifo PRIO runs the network thread as SCHED_FIFO with priority 1 to 99" << '\n'
+                  << "--mlock KB locks all memory with mlockall and prefaults KB of network thread stack" << '\n'
+                  << "--jitter-test N times N 1 ms wakeups of the tuned network thread before it starts" << std::endl;
         return 0;
     }
     const std::string connStr = argv[1];
@@ -26,13 +36,100 @@ int main(int argc, const char** argv)
     {
         connType = ConnectionType::CUSTOM_TCP;
     }
+    else if (connStr == "--udp")
+    {
+        connType = ConnectionType::UDP;
+    }
+    else if (connStr == "--shm")
+    {
+        connType = ConnectionType::SHARED_MEMORY;
+    }
     else
     {
         std::cerr << "Unknown connection type: " << connStr << std::endl;
         return 1;
     }
 
+    std::string tracePath{};
+    std::string logPath{};
+    desktop::RenderMode renderMode = desktop::RenderMode::CONTINUOUS;
+    desktop::BusyPollConfig busyPoll{};
+    desktop::ThreadTuning netThreadTuning{};
+    desktop::JitterTestConfig jitterTest{};
+    for (int i = 2; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return 1;
+        }
+        if (arg == "--trace")
+        {
+            tracePath = argv[++i];
+        }
+        else if (arg == "--log")
+        {
+            logPath = argv[++i];
+        }
+        else if (arg == "--render")
+        {
+            const std::string mode = argv[++i];
+            if (mode == "continuous")
+            {
+                renderMode = desktop::RenderMode::CONTINUOUS;
+            }
+            else if (mode == "events")
+            {
+                renderMode = desktop::RenderMode::ON_EVENTS;
+            }
+            else
+            {
+                std::cerr << "Unknown render mode: " << mode << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--busy-poll" || arg == "--cpu" || arg == "--fifo" || arg == "--mlock" ||
+                 arg == "--jitter-test")
+        {
+            const std::string value = argv[++i];
+            try
+            {
+                if (arg == "--busy-poll")
+                {
+                    busyPoll.spinBudget = std::chrono::microseconds(std::stol(value));
+                }
+                else if (arg == "--cpu")
+                {
+                    netThreadTuning.cpus = desktop::parseCpuList(value).value();
+                }
+                else if (arg == "--fifo")
+                {
+                    netThreadTuning.fifoPriority = std::stoi(value);
+                }
+                else if (arg == "--mlock")
+                {
+                    netThreadTuning.isMemoryLocked = true;
+                    netThreadTuning.stackPrefaultBytes = std::stoul(value) * 1024;
+                }
+                else
+                {
+                    jitterTest.numWakeups = std::stoul(value);
+                }
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << "Invalid value for " << arg << ": " << value << std::endl;
+                return 1;
+            }
+        }
+        else
+        {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+
     std::atomic<bool> stopFlag{false};
-    desktop::runApp(stopFlag, connType);
-    return 0;
+    return desktop::runApp(stopFlag, connType, tracePath, logPath, renderMode, busyPoll, netThreadTuning, jitterTest);
 }
\ No newline at end of file
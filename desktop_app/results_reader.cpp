@@ -0,0 +1,27 @@
+#include <iostream>
+#include <string>
+
+#include "results_log.hpp"
+
+namespace desktop = teleop_led_benchmarks::desktop;
+
+
+int main(int argc, const char** argv)
+{
+    std::ios::sync_with_stdio(false);
+    if (argc != 2)
+    {
+        std::cout << "Expected usage \"ResultsReader PATH\"" << '\n'
+                  << "For example \"ResultsReader results.bin\"" << '\n'
+                  << "Summarizes a results log written by BenchRunner or TeleopLed with --log" << std::endl;
+        return 0;
+    }
+
+    desktop::ResultsLogReader reader{};
+    if (!reader.open(argv[1]))
+    {
+        return 1;
+    }
+    desktop::printResultsLogSummary(std::cout, desktop::summarizeResultsLog(reader));
+    return 0;
+}
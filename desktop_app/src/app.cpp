@@ -2,20 +2,24 @@
 
 #include <GLFW/glfw3.h>
 #include <stdio.h>
+#include <time.h>
 
-#include <boost/asio.hpp>
-#include <boost/asio/ip/tcp.hpp>
-#include <boost/beast/core.hpp>
-#include <boost/beast/websocket.hpp>
+#include <algorithm>
+#include <array>
+#include <cfloat>
 #include <future>
 #include <iostream>
 #include <optional>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
+#include "latency_plot.hpp"
+#include "net.hpp"
+#include "trace.hpp"
 
 namespace teleop_led_benchmarks
 {
@@ -23,18 +27,22 @@ namespace desktop
 {
 
 
-namespace beast = boost::beast;
-namespace http = beast::http;
-namespace websocket = beast::websocket;
-namespace asio = boost::asio;
-using chrono_time_point = std::chrono::steady_clock::time_point;
-using tcp = boost::asio::ip::tcp;
-
-
 constexpr float WINDOW_X_PADDING = 50.0f;
-
-
-const static std::string EXPECTED_MSG = "received";
+constexpr int MAX_IN_FLIGHT_LIMIT = 64;
+constexpr int MAX_COMMANDS_PER_CLICK = 64;
+constexpr size_t TRACE_CAPACITY = 1 << 20;  // records per thread, 16 MiB each
+constexpr size_t RECENT_PLOT_SAMPLES = 512;
+constexpr size_t RUN_PLOT_POINTS = 4096;
+constexpr size_t HISTOGRAM_PLOT_BINS = 64;
+constexpr float PLOT_HEIGHT = 80.0f;
+// In RenderMode::ON_EVENTS the stop flag and window close are checked at least this often.
+constexpr double IDLE_WAIT_TIMEOUT_S = 0.5;
+// ImGui settles hover and click states over a couple of frames after an input.
+constexpr int FRAMES_AFTER_WAKE = 3;
+constexpr std::chrono::seconds RENDER_STATS_PERIOD{1};
+// Input times of the latest commands by seq, far more than can be in flight.
+constexpr size_t INPUT_STAMP_CAPACITY = 1024;
+static_assert(INPUT_STAMP_CAPACITY >= MAX_IN_FLIGHT_LIMIT);
 
 
 enum class UIEventType
@@ -46,166 +54,84 @@ enum class UIEventType
 struct UIEvent
 {
     UIEventType type;
+    chrono_time_point inputPolledAt{};  // start of the frame whose input produced it
+    chrono_time_point inputAt{};        // glfw callback of the mouse event that produced it
+    chrono_time_point queuedAt{};
 };
 
 
-enum class IOResultType
-{
-    WS_CONNECTED,
-    WS_MSG_RECEIVED,
-    TCP_CONNECTED,
-    TCP_MESSAGE_RECEIVED,
-    CANCELLED
-};
-
-
-struct IOResult
+// Render thread cost, to compare render modes.
+struct RenderStats
 {
-    IOResultType type;
-    std::unique_ptr<websocket::stream<tcp::socket>> ws = nullptr;
-    std::unique_ptr<tcp::socket> tcpSock = nullptr;
+    size_t numFrames = 0;
+    chrono_time_point startedAt{};
+    double startThreadCpuS = 0.0;
+    double startProcessCpuS = 0.0;
+    // Over the last RENDER_STATS_PERIOD with frames.
+    chrono_time_point periodStartedAt{};
+    size_t periodStartFrames = 0;
+    double periodStartThreadCpuS = 0.0;
+    double periodStartProcessCpuS = 0.0;
+    double framesPerS = 0.0;
+    double threadCpuPercent = 0.0;
+    double processCpuPercent = 0.0;
 };
 
 
-constexpr std::array<std::string_view, 2> CONNECTION_TYPE_STRINGS = {"WebSocket", "CustomTcp"};
-
-
-void asyncWaitForTcpConnection(asio::io_context& ioc, std::vector<IOResult>& ioResults)
-{
-    auto const address = asio::ip::make_address("0.0.0.0");
-    auto const port = static_cast<unsigned short>(9003);
-    tcp::endpoint endpoint{address, port};
-    auto acceptor = std::make_unique<tcp::acceptor>(ioc, endpoint);
-    std::cout << "async tcp accepting" << std::endl;
-    acceptor->async_accept(
-        ioc,
-        [&ioResults, acceptor = std::move(acceptor)](boost::system::error_code ec,
-            tcp::socket socket)
-        {
-            std::cout << "tcp async accept handler" << std::endl;
-            if (ec)
-            {
-                std::cerr << "accept failed: " << ec.message() << "\n";
-                return;
-            }
-            std::cout << "tcp client connected!" << std::endl;
-            acceptor->close();
-            if (!socket.is_open())
-            {
-                std::cout << "Socket not open" << std::endl;
-                ioResults.emplace_back(IOResult{.type = IOResultType::CANCELLED});
-                return;
-            }
-            auto res = IOResult{.type = IOResultType::TCP_CONNECTED,
-                .tcpSock = std::make_unique<tcp::socket>(std::move(socket))};
-            ioResults.push_back(std::move(res));
-            return;
-        });
-    std::cout << "done async accepting" << std::endl;
-}
-
-
-void asyncWaitForWebsocketConnection(asio::io_context& ioc, std::vector<IOResult>& ioResults)
-{
-    auto const address = asio::ip::make_address("0.0.0.0");
-    auto const port = static_cast<unsigned short>(9002);
-    tcp::endpoint endpoint{address, port};
-    auto acceptor = std::make_unique<tcp::acceptor>(ioc, endpoint);
-    std::cout << "async websocket accepting" << std::endl;
-    acceptor->async_accept(
-        ioc,
-        [&ioResults, acceptor = std::move(acceptor)](boost::system::error_code ec,
-            tcp::socket socket)
-        {
-            std::cout << "Async accept handler" << std::endl;
-            if (ec)
-            {
-                std::cerr << "Accept failed: " << ec.message() << "\n";
-                return;
-            }
-            std::cout << "Client connected!" << std::endl;
-            acceptor->close();
-            if (!socket.is_open())
-            {
-                std::cout << "Socket not open" << std::endl;
-                ioResults.emplace_back(IOResult{.type = IOResultType::CANCELLED});
-                return;
-            }
-
-            // Construct the stream by moving in the socket
-            auto ws = std::make_unique<websocket::stream<tcp::socket>>(std::move(socket));
-
-            // Set a decorator to change the Server of the handshake
-            ws->set_option(websocket::stream_base::decorator(
-                [](websocket::response_type& res)
-                {
-                    res.set(http::field::server,
-                        std::string(BOOST_BEAST_VERSION_STRING) + " websocket-server-sync");
-                }));
-
-            // Accept the websocket handshake. This will block the io thread, but should be fast
-            try
-            {
-                ws->accept();
-            }
-            catch (beast::system_error const& se)
-            {
-                std::cerr << "Error opening acceptor: " << se.code().message() << std::endl;
-                std::abort();
-            }
-            catch (std::exception const& e)
-            {
-                std::cerr << "Error with acceptor: " << e.what() << std::endl;
-                std::abort();
-            }
-            auto res = IOResult{.type = IOResultType::WS_CONNECTED, .ws = std::move(ws)};
-            ioResults.push_back(std::move(res));
-            return;
-        });
-    std::cout << "done async accepting" << std::endl;
-}
-
-
 struct AppState
 {
-    asio::io_context ioc;
+    asio::io_context ioc;  // run by the network thread, never by the render loop
     std::vector<UIEvent> uiEventsToProcess;
-    std::vector<IOResult> ioResults;
-    ConnectionType connType;
-
-    std::unique_ptr<tcp::socket> tcpSock;
-    std::string tcpReadBuf;
-
-    std::unique_ptr<websocket::stream<tcp::socket>> ws;
-    beast::flat_buffer wsReadBuffer;
-
-    bool isSendingBlinkCommand;
-    chrono_time_point timeSendBlinkCommand;
-    std::chrono::duration<double, std::milli> blinkLatency;
-
-    AppState(ConnectionType initialConnType)
+    NetState net;
+    LinkState link;
+    int maxInFlight = 1;  // 1 is stop-and-wait
+    int commandsPerClick = 1;
+    chrono_time_point frameInputPolledAt{};
+
+    // Render thread stages. Commands get seqs in posting order, so the ui can
+    // tell a command's seq before the network thread assigns it.
+    std::unique_ptr<TraceBuffer> uiTrace;
+    uint32_t numCommandsPosted = 0;
+    std::vector<uint32_t> seqsToPresent;
+
+    // Plot data, bounded so drawing a frame costs the same however long the run.
+    RecentLatencies recentLatencies{RECENT_PLOT_SAMPLES};
+    DecimatedLatencies runLatencies{RUN_PLOT_POINTS};
+    std::vector<MinMaxPoint> runPlotColumns;
+    LatencyBins latencyBins;
+
+    RenderMode renderMode = RenderMode::CONTINUOUS;
+    int framesToDraw = FRAMES_AFTER_WAKE;
+    bool hasInput = false;  // set by the glfw callbacks during a poll
+    RenderStats renderStats;
+
+    // Operator side latency: the mouse event to the command's send, which is
+    // where the round trip starts, and to its ack.
+    chrono_time_point lastMouseButtonAt{};
+    std::array<chrono_time_point, INPUT_STAMP_CAPACITY> inputAtBySeq{};
+    LatencyHistogram inputToSendLatencies;
+    LatencyHistogram inputToAckLatencies;
+
+    // Sends from the mouse button callback on press instead of from the
+    // frame after ImGui reports the release. Hit tested against the
+    // button's rectangle from the last frame.
+    bool isImmediateDispatch = false;
+    bool isSendButtonShown = false;
+    ImVec2 sendButtonMin;
+    ImVec2 sendButtonMax;
+
+    AppState(ConnectionType initialConnType, bool isTracing)
         : ioc{1},
-          connType{initialConnType},
-          tcpReadBuf(EXPECTED_MSG.size(), '\0'),  // always expect "received" for now
-          isSendingBlinkCommand{false},
-          blinkLatency{0.0f}
-
+          net{ioc, initialConnType}
     {
         std::cout << "Creating app state" << std::endl;
-        switch (connType)
+        if (isTracing)
         {
-            case ConnectionType::WEB_SOCKET:
-            {
-                asyncWaitForWebsocketConnection(ioc, ioResults);
-                break;
-            }
-            case ConnectionType::CUSTOM_TCP:
-            {
-                asyncWaitForTcpConnection(ioc, ioResults);
-                break;
-            }
+            uiTrace = std::make_unique<TraceBuffer>(TRACE_CAPACITY);
+            net.trace = std::make_unique<TraceBuffer>(TRACE_CAPACITY);
+            seqsToPresent.reserve(IO_EVENT_QUEUE_CAPACITY);
         }
-
+        asyncWaitForConnection(net);
         std::cout << "Done creating app state" << std::endl;
     };
 
@@ -217,43 +143,45 @@ struct AppState
 };
 
 
-void handleSendButtonClick(AppState& s)
+size_t sendWindowRemaining(const AppState& s)
 {
-    s.isSendingBlinkCommand = true;
-    s.timeSendBlinkCommand = std::chrono::steady_clock::now();
-    switch (s.connType)
+    auto maxInFlight = static_cast<size_t>(s.maxInFlight);
+    return s.link.numInFlight < maxInFlight ? maxInFlight - s.link.numInFlight : 0;
+}
+
+
+void handleSendButtonClick(AppState& s, const UIEvent& e)
+{
+    size_t numToSend = std::min(static_cast<size_t>(s.commandsPerClick), sendWindowRemaining(s));
+    if (numToSend == 0)
     {
-        case ConnectionType::WEB_SOCKET:
-        {
-            s.ws->async_write(boost::asio::buffer("button clicked\n"),
-                [](boost::system::error_code ec, std::size_t bytesTransferred)
-                {
-                    (void) bytesTransferred;
-                    if (ec)
-                    {
-                        std::cout << "Error writing to websocket" << std::endl;
-                        return;
-                    }
-                });
-            break;
-        }
-        case ConnectionType::CUSTOM_TCP:
+        return;
+    }
+    if (s.uiTrace)
+    {
+        auto now = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < numToSend; ++i)
         {
-            std::cout << "sending tcp click" << std::endl;
-            asio::async_write(*s.tcpSock, asio::buffer("button clicked\n"),
-                [](boost::system::error_code ec, std::size_t bytesTransferred)
-                {
-                    (void) bytesTransferred;
-                    std::cout << "done writing to tcp" << std::endl;
-                    if (ec)
-                    {
-                        std::cout << "Error writing to tcp" << std::endl;
-                        return;
-                    }
-                });
-            break;
+            uint32_t seq = s.numCommandsPosted + static_cast<uint32_t>(i);
+            s.uiTrace->record(TraceStage::UI_INPUT_POLLED, seq, e.inputPolledAt);
+            s.uiTrace->record(TraceStage::UI_QUEUED, seq, e.queuedAt);
+            s.uiTrace->record(TraceStage::UI_DISPATCHED, seq, now);
         }
     }
+    for (size_t i = 0; i < numToSend; ++i)
+    {
+        uint32_t seq = s.numCommandsPosted + static_cast<uint32_t>(i);
+        s.inputAtBySeq[seq % INPUT_STAMP_CAPACITY] = e.inputAt;
+    }
+    s.numCommandsPosted += static_cast<uint32_t>(numToSend);
+    s.link.numInFlight += numToSend;
+    asio::post(s.ioc, [&net = s.net, numToSend]()
+        {
+            for (size_t i = 0; i < numToSend; ++i)
+            {
+                sendBlinkCommand(net);
+            }
+        });
 }
 
 
@@ -265,7 +193,7 @@ void processUiEvents(AppState& s)
         {
             case UIEventType::SEND_BUTTON_CLICK:
             {
-                handleSendButtonClick(s);
+                handleSendButtonClick(s, e);
                 break;
             }
         }
@@ -274,110 +202,112 @@ void processUiEvents(AppState& s)
 };
 
 
-void wsAsyncRead(AppState& s)
+/**
+ * Input to send ends where the round trip starts, when the network thread
+ * queues the command for writing, so input to send plus the round trip is
+ * input to ack.
+ */
+void recordInputLatencies(AppState& s, const IOEvent& e)
 {
-    s.ws->async_read(
-        s.wsReadBuffer,
-        [&s](boost::system::error_code ec, std::size_t numBytes) mutable
-        {
-            std::cout << "ws bytes received " << numBytes << "\n";
-            if (ec == websocket::error::closed)
-            {
-                std::cout << "Websocket closed" << std::endl;
-                return;
-            }
+    if (e.seq >= s.numCommandsPosted || s.numCommandsPosted - e.seq > INPUT_STAMP_CAPACITY)
+    {
+        return;
+    }
+    auto inputAt = s.inputAtBySeq[e.seq % INPUT_STAMP_CAPACITY];
+    if (inputAt == chrono_time_point{})
+    {
+        return;
+    }
+    auto sentAt = e.completedAt - std::chrono::duration_cast<std::chrono::steady_clock::duration>(e.latency);
+    s.inputToSendLatencies.record(
+        std::chrono::duration_cast<std::chrono::microseconds>(sentAt - inputAt));
+    s.inputToAckLatencies.record(
+        std::chrono::duration_cast<std::chrono::microseconds>(e.completedAt - inputAt));
+}
 
-            if (ec)
-            {
-                std::cout << "ec received " << ec << std::endl;
-                return;
-            }
-            if (numBytes == 0)
-            {
-                return;
-            }
-            IOResult res{};
-            res.type = IOResultType::WS_MSG_RECEIVED;
-            s.ioResults.push_back(std::move(res));
-            return;
-        });
-};
 
-void tcpAsyncRead(AppState& s)
+void processIOEvents(AppState& s)
 {
-    asio::async_read(
-        *s.tcpSock,
-        asio::buffer(s.tcpReadBuf),
-        [&s](const boost::system::error_code& ec, std::size_t bytesTransferred)
+    rearmConsumerWake(s.net);
+    ConnectionEvent connEvent{};
+    while (s.net.connEvents.tryPop(connEvent))
+    {
+        applyConnectionEvent(s.link, connEvent);
+    }
+    IOEvent e{};
+    while (s.net.ioEvents.tryPop(e))
+    {
+        applyIOEvent(s.link, e);
+        if (e.type == IOEventType::ACK_RECEIVED)
         {
-            std::cout << "tcp received bytes transferred " << bytesTransferred
-                      << std::endl;
-            (void) bytesTransferred;
-            if (ec)
-            {
-                std::cout << "tcp received failed" << std::endl;
-                return;
-            }
-
-            IOResult res{};
-            res.type = IOResultType::TCP_MESSAGE_RECEIVED;
-            s.ioResults.push_back(std::move(res));
-        });
-}
+            float latencyMs = static_cast<float>(e.latency.count()) / 1e3f;
+            s.recentLatencies.record(latencyMs);
+            s.runLatencies.record(latencyMs);
+            recordInputLatencies(s, e);
+        }
+        if (s.uiTrace && e.type == IOEventType::ACK_RECEIVED)
+        {
+            s.uiTrace->record(TraceStage::UI_APPLIED, e.seq, std::chrono::steady_clock::now());
+            s.seqsToPresent.push_back(e.seq);
+        }
+    }
+};
 
 
-void processIOResults(AppState& s)
+// One vertical min to max line per column, scaled from 0 ms at the bottom.
+void plotMinMax(const std::vector<MinMaxPoint>& columns, ImVec2 size)
 {
-    for (auto& res : s.ioResults)
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    ImVec2 bottomRight(origin.x + size.x, origin.y + size.y);
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    drawList->AddRectFilled(origin, bottomRight, ImGui::GetColorU32(ImGuiCol_FrameBg));
+    float maxMs = 0.0f;
+    for (const auto& column : columns)
+    {
+        maxMs = std::max(maxMs, column.maxMs);
+    }
+    if (maxMs > 0.0f)
     {
-        switch (res.type)
+        float scale = (size.y - 1.0f) / maxMs;
+        float columnWidth = size.x / static_cast<float>(columns.size());
+        ImU32 color = ImGui::GetColorU32(ImGuiCol_PlotLines);
+        for (size_t i = 0; i < columns.size(); ++i)
         {
-            case IOResultType::WS_CONNECTED:
-            {
-                std::cout << "WsConnected" << std::endl;
-                s.ws = std::move(res.ws);
-                wsAsyncRead(s);
-                break;
-            }
-
-            case IOResultType::WS_MSG_RECEIVED:
-            {
-                std::string_view msg{static_cast<const char*>(s.wsReadBuffer.data().data()),
-                    s.wsReadBuffer.size()};
-                std::cout << "WsMsgReceived " << msg << std::endl;
-                s.wsReadBuffer.consume(s.wsReadBuffer.size());
-                s.isSendingBlinkCommand = false;
-                s.blinkLatency = std::chrono::steady_clock::now() - s.timeSendBlinkCommand;
-                wsAsyncRead(s);
-                break;
-            }
-
-            case IOResultType::TCP_CONNECTED:
-            {
-                std::cout << "TcpConnected" << std::endl;
-                s.tcpSock = std::move(res.tcpSock);
-                tcpAsyncRead(s);
-                break;
-            }
-
-            case IOResultType::TCP_MESSAGE_RECEIVED:
-            {
-                std::cout << "TcpMessageReceived " << s.tcpReadBuf << std::endl;
-                s.isSendingBlinkCommand = false;
-                s.blinkLatency = std::chrono::steady_clock::now() - s.timeSendBlinkCommand;
-                tcpAsyncRead(s);
-                break;
-            }
-
-            case IOResultType::CANCELLED:
-            {
-                std::cout << "IO cancelled" << std::endl;
-                break;
-            }
+            float x = origin.x + (static_cast<float>(i) + 0.5f) * columnWidth;
+            // At least a pixel tall, so flat stretches still show.
+            drawList->AddLine(ImVec2(x, bottomRight.y - columns[i].minMs * scale),
+                ImVec2(x, bottomRight.y - columns[i].maxMs * scale - 1.0f), color);
         }
     }
-    s.ioResults.clear();
-};
+    ImGui::Dummy(size);
+}
+
+
+void renderLatencyPlots(AppState& s)
+{
+    float width = ImGui::GetContentRegionAvail().x;
+    char overlay[96];
+
+    snprintf(overlay, sizeof(overlay), "last %zu round trips, max %.3f ms", s.recentLatencies.size(),
+        static_cast<double>(s.recentLatencies.max()));
+    ImGui::PlotLines("##recent latencies", s.recentLatencies.data(),
+        static_cast<int>(s.recentLatencies.size()), static_cast<int>(s.recentLatencies.offset()),
+        overlay, 0.0f, FLT_MAX, ImVec2(width, PLOT_HEIGHT));
+
+    s.runLatencies.decimate(static_cast<size_t>(width), s.runPlotColumns);
+    auto numSamples = static_cast<size_t>(s.runLatencies.numSamples());
+    size_t numColumns = std::max<size_t>(s.runPlotColumns.size(), 1);
+    ImGui::Text("all %zu round trips, min to max of ~%zu per column", numSamples,
+        (numSamples + numColumns - 1) / numColumns);
+    plotMinMax(s.runPlotColumns, ImVec2(width, PLOT_HEIGHT));
+
+    binHistogram(s.link.blinkLatencies, HISTOGRAM_PLOT_BINS, s.latencyBins);
+    snprintf(overlay, sizeof(overlay), "%.3f to %.3f ms, log bins", s.latencyBins.lowMs,
+        s.latencyBins.highMs);
+    ImGui::PlotHistogram("##latency histogram", s.latencyBins.counts.data(),
+        static_cast<int>(s.latencyBins.counts.size()), 0, overlay, 0.0f, FLT_MAX,
+        ImVec2(width, PLOT_HEIGHT));
+}
 
 
 void render(AppState& s)
@@ -392,53 +322,229 @@ void render(AppState& s)
             ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoBringToFrontOnFocus |
             ImGuiWindowFlags_NoNavFocus);
 
+    s.isSendButtonShown = false;
     ImGui::Dummy(ImVec2(0.0f, 20.0f));
-    auto idxConnType = static_cast<size_t>(s.connType);
+    auto idxConnType = static_cast<size_t>(s.net.connType);
     ImGui::Text("Connection type: %s", CONNECTION_TYPE_STRINGS[idxConnType].data());
-    if (s.ws == nullptr && s.tcpSock == nullptr)
+    ImGui::Text("render %.0f frames/s  cpu %.1f%% render thread, %.1f%% process",
+        s.renderStats.framesPerS, s.renderStats.threadCpuPercent, s.renderStats.processCpuPercent);
+    if (!s.link.isConnected)
     {
         ImGui::Text("Waiting for esp32 to connect");
     }
     else
     {
         ImGui::Text("esp32 connected");
-        ImGui::BeginDisabled(s.isSendingBlinkCommand);
-        if (ImGui::Button("Send blink command"))
+        ImGui::SliderInt("Max in flight", &s.maxInFlight, 1, MAX_IN_FLIGHT_LIMIT);
+        ImGui::SliderInt("Commands per click", &s.commandsPerClick, 1, MAX_COMMANDS_PER_CLICK);
+        ImGui::Checkbox("Send on press, from the input callback", &s.isImmediateDispatch);
+        ImGui::BeginDisabled(sendWindowRemaining(s) == 0);
+        // On release, unless already sent on press.
+        if (ImGui::Button("Send blink command") && !s.isImmediateDispatch)
         {
-            s.uiEventsToProcess.push_back(UIEvent{.type = UIEventType::SEND_BUTTON_CLICK});
+            s.uiEventsToProcess.push_back(UIEvent{.type = UIEventType::SEND_BUTTON_CLICK,
+                .inputPolledAt = s.frameInputPolledAt,
+                .inputAt = s.lastMouseButtonAt,
+                .queuedAt = std::chrono::steady_clock::now()});
         };
+        s.isSendButtonShown = true;
+        s.sendButtonMin = ImGui::GetItemRectMin();
+        s.sendButtonMax = ImGui::GetItemRectMax();
         ImGui::EndDisabled();
         ImGui::SameLine();
-        ImGui::Text("last blink latency %.2f ms", s.blinkLatency.count());
+        ImGui::Text("last blink latency %.2f ms", s.link.lastBlinkLatency.count());
+        ImGui::Text("in flight %zu  timed out %zu  unmatched acks %zu", s.link.numInFlight,
+            s.link.numTimedOut, s.link.numUnmatchedAcks);
+        ImGui::Text("duplicate acks %zu  reordered acks %zu  malformed %zu",
+            s.link.ackSeqs.numDuplicates(), s.link.ackSeqs.numReordered(), s.link.numMalformedMsgs);
+
+        auto summary = summarizeHistogram(s.link.blinkLatencies);
+        ImGui::Text("round trips %zu", summary.count);
+        ImGui::Text("p50 %.3f ms  p90 %.3f ms  p99 %.3f ms", summary.p50Ms, summary.p90Ms,
+            summary.p99Ms);
+        ImGui::Text("p99.9 %.3f ms  max %.3f ms", summary.p999Ms, summary.maxMs);
+        if (s.link.clock)
+        {
+            auto uplink = summarizeHistogram(s.link.uplinkLatencies);
+            auto downlink = summarizeHistogram(s.link.downlinkLatencies);
+            ImGui::Text("uplink p50 %.3f ms  p99 %.3f ms", uplink.p50Ms, uplink.p99Ms);
+            ImGui::Text("downlink p50 %.3f ms  p99 %.3f ms", downlink.p50Ms, downlink.p99Ms);
+            ImGui::Text("clock +-%.0f us  drift %.1f ppm", s.link.clock->errorBoundUs,
+                s.link.clock->driftPpm);
+        }
+        auto inputToSend = summarizeHistogram(s.inputToSendLatencies);
+        auto inputToAck = summarizeHistogram(s.inputToAckLatencies);
+        ImGui::Text("click to send p50 %.3f ms  p99 %.3f ms", inputToSend.p50Ms, inputToSend.p99Ms);
+        ImGui::Text("click to ack p50 %.3f ms  p99 %.3f ms", inputToAck.p50Ms, inputToAck.p99Ms);
+        renderLatencyPlots(s);
+        if (ImGui::Button("Reset latency stats"))
+        {
+            s.link.blinkLatencies.reset();
+            s.link.uplinkLatencies.reset();
+            s.link.downlinkLatencies.reset();
+            s.inputToSendLatencies.reset();
+            s.inputToAckLatencies.reset();
+            s.recentLatencies.reset();
+            s.runLatencies.reset();
+        }
     }
     ImGui::End();
 };
 
 
-void runAppLoop(AppState& s, GLFWwindow* window, const std::atomic<bool>& stopFlag)
+double cpuSeconds(clockid_t clock)
 {
-    if (glfwWindowShouldClose(window))
+    timespec ts{};
+    clock_gettime(clock, &ts);
+    return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) / 1e9;
+}
+
+
+void startRenderStats(RenderStats& stats)
+{
+    stats.startedAt = std::chrono::steady_clock::now();
+    stats.startThreadCpuS = cpuSeconds(CLOCK_THREAD_CPUTIME_ID);
+    stats.startProcessCpuS = cpuSeconds(CLOCK_PROCESS_CPUTIME_ID);
+    stats.periodStartedAt = stats.startedAt;
+    stats.periodStartThreadCpuS = stats.startThreadCpuS;
+    stats.periodStartProcessCpuS = stats.startProcessCpuS;
+}
+
+
+void updateRenderStats(RenderStats& stats)
+{
+    ++stats.numFrames;
+    auto now = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed = now - stats.periodStartedAt;
+    if (elapsed < RENDER_STATS_PERIOD)
     {
-        std::cout << "stopping due to closed window" << std::endl;
-        s.ioc.stop();
         return;
     }
-    if (stopFlag.load(std::memory_order_relaxed))
+    double threadCpuS = cpuSeconds(CLOCK_THREAD_CPUTIME_ID);
+    double processCpuS = cpuSeconds(CLOCK_PROCESS_CPUTIME_ID);
+    stats.framesPerS = static_cast<double>(stats.numFrames - stats.periodStartFrames) / elapsed.count();
+    stats.threadCpuPercent = 100.0 * (threadCpuS - stats.periodStartThreadCpuS) / elapsed.count();
+    stats.processCpuPercent = 100.0 * (processCpuS - stats.periodStartProcessCpuS) / elapsed.count();
+    stats.periodStartedAt = now;
+    stats.periodStartFrames = stats.numFrames;
+    stats.periodStartThreadCpuS = threadCpuS;
+    stats.periodStartProcessCpuS = processCpuS;
+}
+
+
+void printRenderStats(const RenderStats& stats, RenderMode renderMode)
+{
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - stats.startedAt;
+    double threadCpuS = cpuSeconds(CLOCK_THREAD_CPUTIME_ID) - stats.startThreadCpuS;
+    double processCpuS = cpuSeconds(CLOCK_PROCESS_CPUTIME_ID) - stats.startProcessCpuS;
+    std::cout << "rendered " << stats.numFrames << " frames in " << elapsed.count() << " s ("
+              << (renderMode == RenderMode::ON_EVENTS ? "on events" : "continuous")
+              << "), render thread cpu " << 100.0 * threadCpuS / elapsed.count()
+              << "%, process cpu " << 100.0 * processCpuS / elapsed.count() << "%" << std::endl;
+}
+
+
+void markInput(GLFWwindow* window)
+{
+    static_cast<AppState*>(glfwGetWindowUserPointer(window))->hasInput = true;
+}
+
+
+/**
+ * Stamps every mouse button event, ImGui reports the click a frame later.
+ * With immediate dispatch, a left press on the send button sends right
+ * here instead, without waiting for the frame.
+ */
+void onMouseButton(GLFWwindow* window, int button, int action)
+{
+    auto& s = *static_cast<AppState*>(glfwGetWindowUserPointer(window));
+    auto now = std::chrono::steady_clock::now();
+    s.hasInput = true;
+    s.lastMouseButtonAt = now;
+    if (!s.isImmediateDispatch || !s.isSendButtonShown || button != GLFW_MOUSE_BUTTON_LEFT ||
+        action != GLFW_PRESS)
     {
-        std::cout << "stopping due to stop flag" << std::endl;
-        s.ioc.stop();
         return;
     }
+    double x = 0.0;
+    double y = 0.0;
+    glfwGetCursorPos(window, &x, &y);
+    if (x < s.sendButtonMin.x || x >= s.sendButtonMax.x || y < s.sendButtonMin.y ||
+        y >= s.sendButtonMax.y)
+    {
+        return;
+    }
+    // Whatever the network thread applied since the last frame can't be
+    // seen here, so the send window is as of that frame.
+    handleSendButtonClick(s, UIEvent{.type = UIEventType::SEND_BUTTON_CLICK,
+                                 .inputPolledAt = now,
+                                 .inputAt = now,
+                                 .queuedAt = now});
+}
+
+
+// Installed before ImGui's callbacks, which chain to these.
+void installInputCallbacks(AppState& s, GLFWwindow* window)
+{
+    glfwSetWindowUserPointer(window, &s);
+    glfwSetCursorPosCallback(window, [](GLFWwindow* w, double, double) { markInput(w); });
+    glfwSetMouseButtonCallback(window,
+        [](GLFWwindow* w, int button, int action, int) { onMouseButton(w, button, action); });
+    glfwSetScrollCallback(window, [](GLFWwindow* w, double, double) { markInput(w); });
+    glfwSetKeyCallback(window, [](GLFWwindow* w, int, int, int, int) { markInput(w); });
+    glfwSetCharCallback(window, [](GLFWwindow* w, unsigned int) { markInput(w); });
+    glfwSetWindowFocusCallback(window, [](GLFWwindow* w, int) { markInput(w); });
+    // Resized or uncovered, the old frame is gone.
+    glfwSetWindowRefreshCallback(window, [](GLFWwindow* w) { markInput(w); });
+}
+
+
+/**
+ * Processes pending input and returns whether to draw a frame. Continuous
+ * mode always draws. On events mode blocks until input, a wakeup from the
+ * network thread or the timeout, and then draws FRAMES_AFTER_WAKE frames;
+ * a timeout with nothing new draws nothing.
+ */
+bool pollEvents(AppState& s)
+{
+    s.hasInput = false;
+    if (s.renderMode == RenderMode::CONTINUOUS)
+    {
+        glfwPollEvents();
+        return true;
+    }
+    if (s.framesToDraw > 0)
+    {
+        glfwPollEvents();
+    }
+    else
+    {
+        glfwWaitEventsTimeout(IDLE_WAIT_TIMEOUT_S);
+    }
+    if (s.hasInput || s.net.isWakePending.load(std::memory_order_acquire))
+    {
+        s.framesToDraw = FRAMES_AFTER_WAKE;
+    }
+    if (s.framesToDraw == 0)
+    {
+        return false;
+    }
+    --s.framesToDraw;
+    return true;
+}
 
+
+void renderFrame(AppState& s, GLFWwindow* window)
+{
     // ImGUI new frame setup
-    glfwPollEvents();
+    s.frameInputPolledAt = std::chrono::steady_clock::now();
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
 
     // Core app logic
     processUiEvents(s);
-    processIOResults(s);
+    processIOEvents(s);
     render(s);
     // ImGui::ShowDemoWindow(); // if wanting to see ui examples
 
@@ -454,20 +560,61 @@ void runAppLoop(AppState& s, GLFWwindow* window, const std::atomic<bool>& stopFl
      * glfwSwapInterval(1) above enables vsync.
      * That means glfwSwapBuffers() blocks until the display's
      * next refresh (e.g., 1/60s on a 60Hz screen).
+     * IO runs on its own thread and stamps latency there,
+     * so this wait no longer delays or quantizes the measurement.
      */
     glfwSwapBuffers(window);
+    if (s.uiTrace)
+    {
+        auto presentedAt = std::chrono::steady_clock::now();
+        for (uint32_t seq : s.seqsToPresent)
+        {
+            s.uiTrace->record(TraceStage::UI_PRESENTED, seq, presentedAt);
+        }
+        s.seqsToPresent.clear();
+    }
+    updateRenderStats(s.renderStats);
+}
 
-    // Need to capture window pointer by value because arg value
-    // pops off the stack frame causing bugs.
-    asio::post(s.ioc, [&s, window, &stopFlag]()
-        { runAppLoop(s, window, stopFlag); });
+
+void runAppLoop(AppState& s, GLFWwindow* window, const std::atomic<bool>& stopFlag)
+{
+    while (true)
+    {
+        if (glfwWindowShouldClose(window))
+        {
+            std::cout << "stopping due to closed window" << std::endl;
+            return;
+        }
+        if (stopFlag.load(std::memory_order_relaxed))
+        {
+            std::cout << "stopping due to stop flag" << std::endl;
+            return;
+        }
+        if (pollEvents(s))
+        {
+            renderFrame(s, window);
+        }
+    }
 }
 
 
-int runApp(const std::atomic<bool>& stopFlag, const ConnectionType connType)
+int runApp(const std::atomic<bool>& stopFlag, const ConnectionType connType,
+    const std::string& tracePath, const std::string& logPath, RenderMode renderMode,
+    const BusyPollConfig& busyPoll, const ThreadTuning& netThreadTuning, const JitterTestConfig& jitterTest)
 {
-    AppState s{connType};
-    std::cout << "io results size " << s.ioResults.size() << std::endl;
+    AppState s{connType, !tracePath.empty()};
+    s.renderMode = renderMode;
+    if (!logPath.empty())
+    {
+        s.net.results = std::make_unique<ResultsRecorder>(logPath, connType);
+        // Before any window, rather than dropping the whole session's records and saying so at exit.
+        if (!s.net.results->isOpen())
+        {
+            return 1;
+        }
+    }
+    std::cout << "io events size " << s.net.ioEvents.size() << std::endl;
     glfwInit();
 
     // These hints MUST come before glfwCreateWindow
@@ -479,6 +626,13 @@ int runApp(const std::atomic<bool>& stopFlag, const ConnectionType connType)
     GLFWwindow* window = glfwCreateWindow(720, 720, "Teleop LED Benchmarking", NULL, NULL);
     glfwMakeContextCurrent(window);
     glfwSwapInterval(1);
+    installInputCallbacks(s, window);
+    if (renderMode == RenderMode::ON_EVENTS)
+    {
+        // Thread safe, and cheap enough since the network thread only calls it once per drain.
+        s.net.wakeConsumer = []()
+        { glfwPostEmptyEvent(); };
+    }
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
     ImGuiIO& io = ImGui::GetIO();
@@ -486,9 +640,55 @@ int runApp(const std::atomic<bool>& stopFlag, const ConnectionType connType)
     ImGui::StyleColorsDark();
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init("#version 150");
-    // auto work_guard = boost::asio::make_work_guard(s.ioc);
+
+    // The network thread owns ioc and everything it runs. The render loop only
+    // posts commands to it and drains results from the spsc queue.
+    auto workGuard = asio::make_work_guard(s.ioc);
+    bool isBusyPolling = busyPoll.spinBudget.count() > 0;
+    BusyPollStats netStats{};
+    std::thread netThread{[&s, &busyPoll, &netThreadTuning, &jitterTest, &netStats, isBusyPolling]()
+        {
+            applyThreadTuning(netThreadTuning);
+            if (jitterTest.numWakeups > 0)
+            {
+                // Before anything is connected, so it only measures the OS.
+                LatencyHistogram wakeupLatencies{};
+                runJitterTest(jitterTest, wakeupLatencies);
+                auto jitter = summarizeHistogram(wakeupLatencies);
+                std::cout << "network thread jitter: p50 " << jitter.p50Ms * 1e3 << " / p99 " << jitter.p99Ms * 1e3
+                          << " / max " << jitter.maxMs * 1e3 << " us over " << jitter.count << " wakeups"
+                          << std::endl;
+            }
+            if (isBusyPolling)
+            {
+                runBusyPolling(s.ioc, busyPoll, netStats);
+                return;
+            }
+            s.ioc.run();
+        }};
+    startRenderStats(s.renderStats);
     runAppLoop(s, window, stopFlag);
-    s.ioc.run();
+    printRenderStats(s.renderStats, renderMode);
+    workGuard.reset();
+    s.ioc.stop();
+    netThread.join();
+    if (isBusyPolling)
+    {
+        std::cout << "network thread: " << netStats.cpuS << " s cpu in " << netStats.elapsedS << " s, parked "
+                  << netStats.numParks << " times in " << netStats.numHandlers << " handlers" << std::endl;
+    }
+    // The network thread is gone, so abort and drain the remaining ops here.
+    s.ioc.restart();
+    closeConnection(s.net);
+    s.ioc.poll();
+    if (s.uiTrace)
+    {
+        exportChromeTrace(tracePath, {s.uiTrace.get(), s.net.trace.get()}, s.net.clock);
+    }
+    if (s.net.results && !s.net.results->close())
+    {
+        std::cerr << "Failed to write " << logPath << std::endl;
+    }
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
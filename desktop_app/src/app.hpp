@@ -1,5 +1,10 @@
 #pragma once
 #include <atomic>
+#include <string>
+
+#include "busy_poll.hpp"
+#include "connection_type.hpp"
+#include "thread_tuning.hpp"
 
 namespace teleop_led_benchmarks
 {
@@ -7,16 +12,27 @@ namespace desktop
 {
 
 
-enum class ConnectionType
+enum class RenderMode
 {
-    WEB_SOCKET,
-    CUSTOM_TCP
+    CONTINUOUS,  // polls input and redraws every vsync
+    ON_EVENTS,   // blocks until input or an io result, then redraws a few frames
 };
 
 
+// Writes per-stage command spans as chrome trace json to tracePath on exit, unless it's empty.
+// Streams every io event to a binary results log at logPath, unless it's empty, and returns 1 right away if
+// it can't be created.
+// The network thread busy polls as busyPoll says, and is tuned as netThreadTuning says before running
+// the jitter test, if any.
 int runApp(
     const std::atomic<bool>& stopSignal,
-    const ConnectionType connType);
+    const ConnectionType connType,
+    const std::string& tracePath = "",
+    const std::string& logPath = "",
+    RenderMode renderMode = RenderMode::CONTINUOUS,
+    const BusyPollConfig& busyPoll = {},
+    const ThreadTuning& netThreadTuning = {},
+    const JitterTestConfig& jitterTest = {});
 
 
 }  // namespace desktop
@@ -0,0 +1,53 @@
+#include "busy_poll.hpp"
+
+#include <time.h>
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+std::chrono::nanoseconds threadCpuTime()
+{
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+}
+
+
+size_t pollOrPark(boost::asio::io_context& ioc, const BusyPollConfig& config,
+    std::chrono::steady_clock::time_point& lastWorkAt, BusyPollStats& stats)
+{
+    // Also runs the reactor without blocking, so ready sockets count as work.
+    size_t numHandlers = ioc.poll();
+    if (numHandlers == 0 && std::chrono::steady_clock::now() - lastWorkAt >= config.spinBudget)
+    {
+        ++stats.numParks;
+        numHandlers = ioc.run_one_for(config.parkTimeout);
+    }
+    if (numHandlers > 0)
+    {
+        stats.numHandlers += numHandlers;
+        lastWorkAt = std::chrono::steady_clock::now();
+    }
+    return numHandlers;
+}
+
+
+void runBusyPolling(boost::asio::io_context& ioc, const BusyPollConfig& config, BusyPollStats& stats)
+{
+    auto startedAt = std::chrono::steady_clock::now();
+    auto cpuAtStart = threadCpuTime();
+    auto lastWorkAt = startedAt;
+    while (!ioc.stopped())
+    {
+        pollOrPark(ioc, config, lastWorkAt, stats);
+    }
+    stats.cpuS = std::chrono::duration<double>(threadCpuTime() - cpuAtStart).count();
+    stats.elapsedS = std::chrono::duration<double>(std::chrono::steady_clock::now() - startedAt).count();
+}
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
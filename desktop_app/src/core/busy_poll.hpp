@@ -0,0 +1,56 @@
+#pragma once
+#include <boost/asio/io_context.hpp>
+#include <chrono>
+#include <cstddef>
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+/**
+ * How the thread running an io_context waits for completions. With a spin
+ * budget it keeps polling for that long after the last handler ran before
+ * parking in epoll, so an ack that arrives within it is picked up without
+ * a wakeup, at the cost of a core kept busy.
+ */
+struct BusyPollConfig
+{
+    std::chrono::microseconds spinBudget{0};  // 0 parks as soon as there's nothing to run
+    // Longest single block once parked. Any handler or stop() wakes the thread earlier, so this only
+    // bounds how late a polling loop gets to its own work, like checking a stop signal.
+    std::chrono::milliseconds parkTimeout{100};
+};
+
+
+struct BusyPollStats
+{
+    size_t numHandlers = 0;
+    size_t numParks = 0;   // times the budget ran out and the thread blocked
+    double cpuS = 0.0;     // cpu time of the thread
+    double elapsedS = 0.0;
+};
+
+
+// Of the calling thread, from CLOCK_THREAD_CPUTIME_ID.
+std::chrono::nanoseconds threadCpuTime();
+
+/**
+ * Runs ioc on the calling thread until it is stopped or runs out of work,
+ * spinning and parking as config says, and fills stats on return.
+ */
+void runBusyPolling(boost::asio::io_context& ioc, const BusyPollConfig& config, BusyPollStats& stats);
+
+/**
+ * One step of runBusyPolling for a thread that also does other work in
+ * between, like the benchmark runner: polls ioc, and blocks for up to
+ * config.parkTimeout once the budget since lastWorkAt has run out. Returns
+ * the number of handlers run and updates lastWorkAt when there were any.
+ */
+size_t pollOrPark(boost::asio::io_context& ioc, const BusyPollConfig& config,
+    std::chrono::steady_clock::time_point& lastWorkAt, BusyPollStats& stats);
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
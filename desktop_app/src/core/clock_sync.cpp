@@ -0,0 +1,132 @@
+#include "clock_sync.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+double ClockSample::offsetUs() const
+{
+    return (static_cast<double>(t2 - t1) + static_cast<double>(t3 - t4)) / 2.0;
+}
+
+
+int64_t ClockSample::delayUs() const
+{
+    return (t4 - t1) - (t3 - t2);
+}
+
+
+static int64_t desktopMidpointUs(const ClockSample& s)
+{
+    return s.t1 + (s.t4 - s.t1) / 2;
+}
+
+
+double ClockEstimate::offsetAtUs(int64_t desktopUs) const
+{
+    return offsetUs + driftPpm * 1e-6 * static_cast<double>(desktopUs - refDesktopUs);
+}
+
+
+int64_t ClockEstimate::deviceToDesktopUs(int64_t deviceUs) const
+{
+    // The offset changes by well under a microsecond between the two clocks' readings.
+    auto approxDesktopUs = deviceUs - static_cast<int64_t>(std::llround(offsetUs));
+    return deviceUs - static_cast<int64_t>(std::llround(offsetAtUs(approxDesktopUs)));
+}
+
+
+ClockSync::ClockSync()
+    : samples_{},
+      numAdded_{0}
+{
+}
+
+
+bool ClockSync::addSample(const ClockSample& sample)
+{
+    if (sample.t4 < sample.t1 || sample.t3 < sample.t2 || sample.delayUs() < 0)
+    {
+        return false;
+    }
+    samples_[numAdded_ % WINDOW] = sample;
+    ++numAdded_;
+    return true;
+}
+
+
+std::optional<ClockEstimate> ClockSync::estimate() const
+{
+    const size_t n = numSamples();
+    if (n == 0)
+    {
+        return std::nullopt;
+    }
+    std::array<const ClockSample*, WINDOW> byDelay{};
+    int64_t refDesktopUs = desktopMidpointUs(samples_[0]);
+    for (size_t i = 0; i < n; ++i)
+    {
+        byDelay[i] = &samples_[i];
+        refDesktopUs = std::max(refDesktopUs, desktopMidpointUs(samples_[i]));
+    }
+    const size_t numSelected = std::max<size_t>(1, n / 4);
+    std::partial_sort(byDelay.begin(), byDelay.begin() + numSelected, byDelay.begin() + n,
+        [](const ClockSample* a, const ClockSample* b)
+        { return a->delayUs() < b->delayUs(); });
+
+    // Least squares offset = a + b * x over the selected samples, x relative to the newest one.
+    double meanX = 0.0;
+    double meanY = 0.0;
+    for (size_t i = 0; i < numSelected; ++i)
+    {
+        meanX += static_cast<double>(desktopMidpointUs(*byDelay[i]) - refDesktopUs);
+        meanY += byDelay[i]->offsetUs();
+    }
+    meanX /= static_cast<double>(numSelected);
+    meanY /= static_cast<double>(numSelected);
+    double sumXY = 0.0;
+    double sumXX = 0.0;
+    for (size_t i = 0; i < numSelected; ++i)
+    {
+        double dx = static_cast<double>(desktopMidpointUs(*byDelay[i]) - refDesktopUs) - meanX;
+        sumXY += dx * (byDelay[i]->offsetUs() - meanY);
+        sumXX += dx * dx;
+    }
+    const double slope = sumXX > 0.0 ? sumXY / sumXX : 0.0;
+
+    ClockEstimate est{};
+    est.refDesktopUs = refDesktopUs;
+    est.offsetUs = meanY - slope * meanX;
+    est.driftPpm = slope * 1e6;
+    est.numSamples = n;
+    // Each sample's true offset is within half its delay, the line adds its residual on top.
+    for (size_t i = 0; i < numSelected; ++i)
+    {
+        const auto& s = *byDelay[i];
+        double residual = s.offsetUs() - est.offsetAtUs(desktopMidpointUs(s));
+        est.errorBoundUs = std::max(est.errorBoundUs,
+            static_cast<double>(s.delayUs()) / 2.0 + std::abs(residual));
+    }
+    return est;
+}
+
+
+void ClockSync::reset()
+{
+    numAdded_ = 0;
+}
+
+
+size_t ClockSync::numSamples() const
+{
+    return std::min(numAdded_, WINDOW);
+}
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
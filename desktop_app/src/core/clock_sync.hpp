@@ -0,0 +1,77 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+/**
+ * One probe exchange, NTP style: the desktop sends at t1, the device
+ * receives at t2 and replies at t3, the desktop reads the reply at t4.
+ * t1 and t4 are desktop steady clock, t2 and t3 device esp_timer, all in us.
+ */
+struct ClockSample
+{
+    int64_t t1;
+    int64_t t2;
+    int64_t t3;
+    int64_t t4;
+
+    // Device clock minus desktop clock, exact if uplink and downlink took equally long.
+    double offsetUs() const;
+    // Round trip without the device's turnaround, the offset is within delayUs / 2.
+    int64_t delayUs() const;
+};
+
+
+/**
+ * Device clock as a linear function of desktop time. The true offset at
+ * refDesktopUs lies within errorBoundUs of offsetUs as long as the drift
+ * stays what it was over the sample window.
+ */
+struct ClockEstimate
+{
+    int64_t refDesktopUs = 0;
+    double offsetUs = 0.0;
+    double driftPpm = 0.0;
+    double errorBoundUs = 0.0;
+    size_t numSamples = 0;
+
+    double offsetAtUs(int64_t desktopUs) const;
+    int64_t deviceToDesktopUs(int64_t deviceUs) const;
+};
+
+
+/**
+ * Offset and drift estimator over the last WINDOW probe exchanges. Queueing
+ * only ever adds delay, so the samples with the smallest delay are the most
+ * trustworthy; the estimate is a least squares line through the fastest
+ * quarter of the window. Fixed storage, never allocates.
+ */
+class ClockSync
+{
+   public:
+    static constexpr size_t WINDOW = 64;
+
+    ClockSync();
+
+    // Samples with t4 < t1 or t3 < t2 can't come from a real exchange and are ignored.
+    bool addSample(const ClockSample& sample);
+    std::optional<ClockEstimate> estimate() const;
+    void reset();
+
+    size_t numSamples() const;
+
+   private:
+    std::array<ClockSample, WINDOW> samples_;
+    size_t numAdded_;
+};
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
@@ -0,0 +1,1058 @@
+#include "connection_manager.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <unordered_set>
+
+#include "inflight_table.hpp"
+#include "net.hpp"
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+namespace http = beast::http;
+using steady_clock = std::chrono::steady_clock;
+using Strand = asio::strand<asio::io_context::executor_type>;
+// Lets every shard bind the same port, the kernel then hashes new connections over their acceptors.
+using ReusePort = asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+
+
+// Accept errors are mostly running out of file descriptors, retrying right away would spin.
+constexpr std::chrono::milliseconds ACCEPT_RETRY_DELAY{100};
+// Acks are 24 bytes, so this holds a burst of them without growing the slot much.
+constexpr size_t FLEET_READ_BUF_SIZE = 256;
+constexpr std::chrono::microseconds FLEET_POLL_INTERVAL{100};
+
+
+struct PendingCommand
+{
+    chrono_time_point sentAt{};
+    uint32_t seq = 0;
+    uint16_t round = 0;
+    bool isPending = false;
+};
+
+
+/**
+ * One slot of a shard's table. Kept small since a shard holds thousands:
+ * no handler arena (8 KB each) and only FLEET_MAX_IN_FLIGHT send stamps.
+ * Everything but slot and strand is only touched on strand, which stays
+ * with the slot, so handlers can compare the generation they captured and
+ * ignore completions that belong to an earlier connection in the slot.
+ */
+struct FleetConnection
+{
+    Strand strand;
+    std::unique_ptr<TcpSocket> tcpSock;
+    std::unique_ptr<websocket::stream<TcpSocket>> ws;
+    beast::flat_buffer wsReadBuffer;
+    std::array<uint8_t, FLEET_READ_BUF_SIZE> readBuf{};
+    FrameParser frameParser;
+    std::array<PendingCommand, FLEET_MAX_IN_FLIGHT> inFlight{};  // indexed by seq
+    uint32_t nextSeq = 0;
+    uint32_t nextSeqToWrite = 0;  // seqs in [nextSeqToWrite, nextSeq) wait for the write in progress
+    std::array<uint8_t, FRAME_HEADER_SIZE> writeBuf{};
+    uint16_t slot = 0;
+    GroupId group = 0;
+    uint8_t generation = 0;
+    bool isOpen = false;  // connected, and for websockets past the handshake
+    bool isWriting = false;
+
+    FleetConnection(asio::io_context& ioc, uint16_t slot)
+        : strand{asio::make_strand(ioc)},
+          slot{slot}
+    {
+    }
+};
+
+
+/**
+ * One acceptor and the table of the connections it accepted. The acceptor,
+ * timers and table run on strand, other threads only post onto it and pop
+ * from events.
+ */
+struct FleetShard
+{
+    size_t idx;
+    const FleetConfig& config;
+    asio::io_context& ioc;
+    Strand strand;
+    tcp::acceptor acceptor;
+    asio::steady_timer acceptRetryTimer;
+    asio::steady_timer ackTimeoutTimer;
+    std::vector<std::unique_ptr<FleetConnection>> connections;  // indexed by slot, never shrinks
+    std::vector<uint16_t> freeSlots;
+    bool isClosed = false;  // set by closeShard, a sweep that already fired mustn't re-arm
+    // Every connection strand of the shard produces, so pushes are serialized by the mutex.
+    // The consumer side stays lock free.
+    std::mutex eventsMutex;
+    SpscQueue<FleetEvent, FLEET_EVENT_QUEUE_CAPACITY> events;
+    std::atomic<size_t> numDroppedEvents;
+    std::atomic<size_t> numRejectedConnections;
+
+    FleetShard(size_t idx, const FleetConfig& config, asio::io_context& ioc)
+        : idx{idx},
+          config{config},
+          ioc{ioc},
+          strand{asio::make_strand(ioc)},
+          acceptor{ioc},
+          acceptRetryTimer{ioc},
+          ackTimeoutTimer{ioc},
+          numDroppedEvents{0},
+          numRejectedConnections{0}
+    {
+    }
+
+    ~FleetShard() = default;
+    FleetShard(const FleetShard& other) = delete;
+    FleetShard& operator=(const FleetShard& other) = delete;
+    FleetShard(FleetShard&& other) = delete;
+    FleetShard& operator=(FleetShard&& other) = delete;
+};
+
+
+struct FleetIo
+{
+    asio::io_context ioc;
+    asio::executor_work_guard<asio::io_context::executor_type> workGuard;
+    std::vector<std::unique_ptr<FleetShard>> shards;
+
+    explicit FleetIo(size_t numThreads)
+        : ioc{static_cast<int>(numThreads)},
+          workGuard{asio::make_work_guard(ioc)}
+    {
+    }
+};
+
+
+static DeviceId deviceIdOf(const FleetShard& s, const FleetConnection& conn)
+{
+    return makeDeviceId(s.idx, conn.slot, conn.generation);
+}
+
+
+static void pushEvent(FleetShard& s, const FleetConnection& conn, FleetEventType type,
+    uint32_t seq, chrono_time_point completedAt, std::chrono::microseconds latency = {}, uint16_t round = 0)
+{
+    FleetEvent e{};
+    e.completedAt = completedAt;
+    e.latency = std::chrono::duration<uint32_t, std::micro>(static_cast<uint32_t>(latency.count()));
+    e.seq = seq;
+    e.device = deviceIdOf(s, conn);
+    e.round = round;
+    e.type = type;
+    std::lock_guard<std::mutex> lock{s.eventsMutex};
+    if (!s.events.tryPush(e))
+    {
+        s.numDroppedEvents.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+
+static void asyncRead(FleetShard& s, FleetConnection& conn);
+static void writeNextCommand(FleetShard& s, FleetConnection& conn);
+
+
+// Runs on conn.strand and hands the slot back to the shard. Commands still in
+// flight will never be acked and are reported as timed out.
+static void dropConnection(FleetShard& s, FleetConnection& conn)
+{
+    boost::system::error_code ec;
+    if (conn.tcpSock)
+    {
+        conn.tcpSock->close(ec);
+    }
+    if (conn.ws)
+    {
+        beast::get_lowest_layer(*conn.ws).close(ec);
+    }
+    if (conn.isOpen)
+    {
+        auto now = steady_clock::now();
+        for (auto& p : conn.inFlight)
+        {
+            if (p.isPending)
+            {
+                p.isPending = false;
+                pushEvent(s, conn, FleetEventType::COMMAND_TIMED_OUT, p.seq, now, {}, p.round);
+            }
+        }
+        pushEvent(s, conn, FleetEventType::DISCONNECTED, 0, now);
+    }
+    conn.isOpen = false;
+    ++conn.generation;
+    asio::post(s.strand, [&s, slot = conn.slot]() { s.freeSlots.push_back(slot); });
+}
+
+
+static void openConnection(FleetShard& s, FleetConnection& conn)
+{
+    conn.isOpen = true;
+    pushEvent(s, conn, FleetEventType::CONNECTED, 0, steady_clock::now());
+    asyncRead(s, conn);
+}
+
+
+// Runs on s.strand.
+static FleetConnection* allocateSlot(FleetShard& s)
+{
+    if (!s.freeSlots.empty())
+    {
+        auto slot = s.freeSlots.back();
+        s.freeSlots.pop_back();
+        return s.connections[slot].get();
+    }
+    if (s.connections.size() >= std::min(s.config.maxDevicesPerShard, MAX_DEVICES_PER_SHARD))
+    {
+        return nullptr;
+    }
+    auto slot = static_cast<uint16_t>(s.connections.size());
+    s.connections.push_back(std::make_unique<FleetConnection>(s.ioc, slot));
+    return s.connections.back().get();
+}
+
+
+// Runs on conn.strand, takes over a freshly accepted socket.
+static void startConnection(FleetShard& s, FleetConnection& conn, TcpSocket socket)
+{
+    boost::system::error_code ec;
+    socket.set_option(tcp::no_delay(true), ec);
+    conn.frameParser.reset();
+    conn.inFlight.fill(PendingCommand{});
+    conn.nextSeq = 0;
+    conn.nextSeqToWrite = 0;
+    conn.isWriting = false;
+    conn.group = 0;
+
+    if (s.config.connType == ConnectionType::CUSTOM_TCP)
+    {
+        // Assigned rather than replaced, aborted handlers of the slot's last socket may still be queued.
+        if (conn.tcpSock)
+        {
+            *conn.tcpSock = std::move(socket);
+        }
+        else
+        {
+            conn.tcpSock = std::make_unique<TcpSocket>(std::move(socket));
+        }
+        openConnection(s, conn);
+        return;
+    }
+
+    conn.ws = std::make_unique<websocket::stream<TcpSocket>>(std::move(socket));
+    conn.wsReadBuffer.clear();
+    conn.ws->set_option(websocket::stream_base::decorator(
+        [](websocket::response_type& res)
+        {
+            res.set(http::field::server,
+                std::string(BOOST_BEAST_VERSION_STRING) + " websocket-server-async");
+        }));
+    conn.ws->binary(true);
+    // Unlike the single device path the handshake is async, a slow device mustn't stall its thread.
+    conn.ws->async_accept(asio::bind_executor(conn.strand,
+        [&s, &conn, generation = conn.generation](boost::system::error_code ec)
+        {
+            if (conn.generation != generation)
+            {
+                return;
+            }
+            if (ec)
+            {
+                dropConnection(s, conn);
+                return;
+            }
+            openConnection(s, conn);
+        }));
+}
+
+
+static void asyncAccept(FleetShard& s)
+{
+    s.acceptor.async_accept(s.ioc, asio::bind_executor(s.strand,
+        [&s](boost::system::error_code ec, TcpSocket socket)
+        {
+            if (ec == asio::error::operation_aborted)
+            {
+                return;
+            }
+            if (ec)
+            {
+                std::cerr << "shard " << s.idx << " accept failed: " << ec.message() << std::endl;
+                s.acceptRetryTimer.expires_after(ACCEPT_RETRY_DELAY);
+                s.acceptRetryTimer.async_wait(asio::bind_executor(s.strand,
+                    [&s](boost::system::error_code ec)
+                    {
+                        if (!ec && !s.isClosed)
+                        {
+                            asyncAccept(s);
+                        }
+                    }));
+                return;
+            }
+            FleetConnection* conn = allocateSlot(s);
+            if (conn)
+            {
+                asio::post(conn->strand, [&s, conn, socket = std::move(socket)]() mutable
+                    { startConnection(s, *conn, std::move(socket)); });
+            }
+            else
+            {
+                s.numRejectedConnections.fetch_add(1, std::memory_order_relaxed);
+            }
+            asyncAccept(s);
+        }));
+}
+
+
+static bool openAcceptor(FleetShard& s, unsigned short port)
+{
+    tcp::endpoint endpoint{asio::ip::make_address("0.0.0.0"), port};
+    boost::system::error_code ec;
+    s.acceptor.open(endpoint.protocol(), ec);
+    if (!ec)
+    {
+        s.acceptor.set_option(tcp::acceptor::reuse_address(true), ec);
+    }
+    if (!ec)
+    {
+        s.acceptor.set_option(ReusePort(true), ec);
+    }
+    if (!ec)
+    {
+        s.acceptor.bind(endpoint, ec);
+    }
+    if (!ec)
+    {
+        s.acceptor.listen(asio::socket_base::max_listen_connections, ec);
+    }
+    if (ec)
+    {
+        std::cerr << "shard " << s.idx << " can't listen on port " << port << ": " << ec.message()
+                  << std::endl;
+        return false;
+    }
+    return true;
+}
+
+
+// Runs f(conn) on the strand of every slot that is in use when s.strand gets to it.
+template <typename F>
+static void postToEveryConnection(FleetShard& s, F f)
+{
+    asio::post(s.strand, [&s, f]()
+        {
+            for (auto& conn : s.connections)
+            {
+                asio::post(conn->strand, [&conn = *conn, f]() { f(conn); });
+            }
+        });
+}
+
+
+static void asyncSweepTimedOutCommands(FleetShard& s)
+{
+    s.ackTimeoutTimer.expires_after(s.config.ackTimeout / ACK_TIMEOUT_SWEEPS_PER_TIMEOUT);
+    s.ackTimeoutTimer.async_wait(asio::bind_executor(s.strand, [&s](boost::system::error_code ec)
+        {
+            if (ec || s.isClosed)
+            {
+                return;
+            }
+            postToEveryConnection(s, [&s](FleetConnection& conn)
+                {
+                    if (!conn.isOpen)
+                    {
+                        return;
+                    }
+                    auto now = steady_clock::now();
+                    auto deadline = now - s.config.ackTimeout;
+                    for (auto& p : conn.inFlight)
+                    {
+                        if (p.isPending && p.sentAt < deadline)
+                        {
+                            p.isPending = false;
+                            pushEvent(s, conn, FleetEventType::COMMAND_TIMED_OUT, p.seq, now, {}, p.round);
+                        }
+                    }
+                });
+            asyncSweepTimedOutCommands(s);
+        }));
+}
+
+
+static void handleFrame(FleetShard& s, FleetConnection& conn, const FrameHeader& header)
+{
+    auto now = steady_clock::now();
+    if (header.type != MsgType::ACK)
+    {
+        // The manager doesn't probe clocks, so there is nothing else a device should send.
+        pushEvent(s, conn, FleetEventType::MALFORMED_MSG, header.seq, now);
+        return;
+    }
+    auto& p = conn.inFlight[header.seq % FLEET_MAX_IN_FLIGHT];
+    if (!p.isPending || p.seq != header.seq)
+    {
+        pushEvent(s, conn, FleetEventType::UNMATCHED_ACK, header.seq, now);
+        return;
+    }
+    p.isPending = false;
+    pushEvent(s, conn, FleetEventType::ACK_RECEIVED, header.seq, now,
+        std::chrono::duration_cast<std::chrono::microseconds>(now - p.sentAt), p.round);
+}
+
+
+static void asyncRead(FleetShard& s, FleetConnection& conn)
+{
+    auto onFrame = [&s, &conn](const FrameHeader& header, const uint8_t*)
+        { handleFrame(s, conn, header); };
+    if (conn.ws)
+    {
+        conn.ws->async_read(conn.wsReadBuffer, asio::bind_executor(conn.strand,
+            [&s, &conn, onFrame, generation = conn.generation](boost::system::error_code ec, size_t)
+            {
+                if (conn.generation != generation)
+                {
+                    return;
+                }
+                if (ec)
+                {
+                    dropConnection(s, conn);
+                    return;
+                }
+                // Every message must hold whole frames, nothing may be left over.
+                bool isValid = conn.frameParser.feed(
+                    static_cast<const uint8_t*>(conn.wsReadBuffer.data().data()),
+                    conn.wsReadBuffer.size(), onFrame);
+                if (!isValid || conn.frameParser.hasPartialFrame())
+                {
+                    conn.frameParser.reset();
+                    pushEvent(s, conn, FleetEventType::MALFORMED_MSG, 0, steady_clock::now());
+                }
+                conn.wsReadBuffer.consume(conn.wsReadBuffer.size());
+                asyncRead(s, conn);
+            }));
+        return;
+    }
+
+    conn.tcpSock->async_read_some(asio::buffer(conn.readBuf), asio::bind_executor(conn.strand,
+        [&s, &conn, onFrame, generation = conn.generation](boost::system::error_code ec, size_t numBytes)
+        {
+            if (conn.generation != generation)
+            {
+                return;
+            }
+            if (ec)
+            {
+                dropConnection(s, conn);
+                return;
+            }
+            if (!conn.frameParser.feed(conn.readBuf.data(), numBytes, onFrame))
+            {
+                // The stream can't be resynchronized, so the device has to reconnect.
+                pushEvent(s, conn, FleetEventType::MALFORMED_MSG, 0, steady_clock::now());
+                dropConnection(s, conn);
+                return;
+            }
+            asyncRead(s, conn);
+        }));
+}
+
+
+// Writes the oldest queued command unless a write is already outstanding.
+static void writeNextCommand(FleetShard& s, FleetConnection& conn)
+{
+    if (conn.isWriting || conn.nextSeqToWrite == conn.nextSeq)
+    {
+        return;
+    }
+    uint32_t seq = conn.nextSeqToWrite++;
+    uint64_t nowUs = steadyClockNs(steady_clock::now()) / 1000;
+    size_t length = encodeFrame(MsgType::COMMAND, seq, nowUs, nullptr, 0, conn.writeBuf.data());
+    conn.isWriting = true;
+    auto onWritten = asio::bind_executor(conn.strand,
+        [&s, &conn, generation = conn.generation](boost::system::error_code ec, size_t)
+        {
+            if (conn.generation != generation)
+            {
+                return;
+            }
+            conn.isWriting = false;
+            if (ec)
+            {
+                dropConnection(s, conn);
+                return;
+            }
+            writeNextCommand(s, conn);
+        });
+    if (conn.ws)
+    {
+        conn.ws->async_write(asio::buffer(conn.writeBuf.data(), length), std::move(onWritten));
+    }
+    else
+    {
+        asio::async_write(*conn.tcpSock, asio::buffer(conn.writeBuf.data(), length), std::move(onWritten));
+    }
+}
+
+
+// Stamped when queued, like sendBlinkCommand, so waiting behind earlier writes counts as latency.
+static void sendCommand(FleetShard& s, FleetConnection& conn, uint16_t round = 0)
+{
+    uint32_t seq = conn.nextSeq++;
+    auto now = steady_clock::now();
+    auto& p = conn.inFlight[seq % FLEET_MAX_IN_FLIGHT];
+    if (p.isPending)
+    {
+        pushEvent(s, conn, FleetEventType::COMMAND_TIMED_OUT, p.seq, now, {}, p.round);
+    }
+    p = PendingCommand{now, seq, round, true};
+    writeNextCommand(s, conn);
+}
+
+
+// Runs f(conn) on the device's strand if it is still connected.
+template <typename F>
+static void postToDevice(FleetShard& s, DeviceId device, F f)
+{
+    asio::post(s.strand, [&s, device, f]()
+        {
+            size_t slot = deviceSlot(device);
+            if (slot >= s.connections.size())
+            {
+                return;
+            }
+            asio::post(s.connections[slot]->strand, [&conn = *s.connections[slot], device, f]()
+                {
+                    if (conn.isOpen && conn.generation == deviceGeneration(device))
+                    {
+                        f(conn);
+                    }
+                });
+        });
+}
+
+
+// Runs on s.strand, the connections close on their own strands.
+static void closeShard(FleetShard& s)
+{
+    boost::system::error_code ec;
+    s.isClosed = true;
+    s.acceptor.close(ec);
+    s.acceptRetryTimer.cancel();
+    s.ackTimeoutTimer.cancel();
+    for (auto& conn : s.connections)
+    {
+        asio::post(conn->strand, [&conn = *conn]()
+            {
+                boost::system::error_code ec;
+                if (conn.tcpSock)
+                {
+                    conn.tcpSock->close(ec);
+                }
+                if (conn.ws)
+                {
+                    beast::get_lowest_layer(*conn.ws).close(ec);
+                }
+                conn.isOpen = false;
+                ++conn.generation;
+            });
+    }
+}
+
+
+ConnectionManager::ConnectionManager(const FleetConfig& config)
+    : config_{config},
+      io_{},
+      threads_{},
+      nextShardToPoll_{0},
+      numRounds_{0}
+{
+}
+
+
+ConnectionManager::~ConnectionManager()
+{
+    stop();
+}
+
+
+bool ConnectionManager::start()
+{
+    if (config_.connType == ConnectionType::UDP || config_.connType == ConnectionType::SHARED_MEMORY)
+    {
+        std::cerr << "udp and shared memory have no connections to manage, use customTcp or websocket"
+                  << std::endl;
+        return false;
+    }
+    unsigned short port = config_.port != 0 ? config_.port : defaultPort(config_.connType);
+    size_t numShards = std::clamp<size_t>(config_.numShards, 1, MAX_FLEET_SHARDS);
+    size_t numThreads = std::max<size_t>(config_.numThreads, 1);
+    auto io = std::make_unique<FleetIo>(numThreads);
+    for (size_t i = 0; i < numShards; ++i)
+    {
+        io->shards.push_back(std::make_unique<FleetShard>(i, config_, io->ioc));
+        if (!openAcceptor(*io->shards.back(), port))
+        {
+            return false;
+        }
+    }
+    io_ = std::move(io);
+    for (auto& shard : io_->shards)
+    {
+        FleetShard& s = *shard;
+        asio::post(s.strand, [&s]()
+            {
+                asyncAccept(s);
+                asyncSweepTimedOutCommands(s);
+            });
+    }
+    for (size_t i = 0; i < numThreads; ++i)
+    {
+        threads_.emplace_back([&ioc = io_->ioc, &tuning = config_.threadTuning, i]()
+            {
+                applyThreadTuning(tuning, i);
+                ioc.run();
+            });
+    }
+    std::cout << "accepting devices on port " << port << " with " << numShards << " shard(s) on "
+              << numThreads << " thread(s)" << std::endl;
+    return true;
+}
+
+
+void ConnectionManager::stop()
+{
+    if (!io_ || threads_.empty())
+    {
+        return;
+    }
+    for (auto& shard : io_->shards)
+    {
+        FleetShard& s = *shard;
+        asio::post(s.strand, [&s]() { closeShard(s); });
+    }
+    // run() returns once the aborted handlers have completed.
+    io_->workGuard.reset();
+    for (auto& thread : threads_)
+    {
+        thread.join();
+    }
+    threads_.clear();
+}
+
+
+void ConnectionManager::sendToDevice(DeviceId device)
+{
+    if (!io_ || deviceShard(device) >= io_->shards.size())
+    {
+        return;
+    }
+    FleetShard& s = *io_->shards[deviceShard(device)];
+    postToDevice(s, device, [&s](FleetConnection& conn) { sendCommand(s, conn); });
+}
+
+
+void ConnectionManager::sendToGroup(GroupId group)
+{
+    if (!io_)
+    {
+        return;
+    }
+    for (auto& shard : io_->shards)
+    {
+        FleetShard& s = *shard;
+        postToEveryConnection(s, [&s, group](FleetConnection& conn)
+            {
+                if (conn.isOpen && conn.group == group)
+                {
+                    sendCommand(s, conn);
+                }
+            });
+    }
+}
+
+
+uint16_t ConnectionManager::sendToAll()
+{
+    // Wraps around skipping 0, which marks commands that aren't part of a round.
+    auto round = static_cast<uint16_t>(numRounds_.fetch_add(1, std::memory_order_relaxed) % UINT16_MAX + 1);
+    if (!io_)
+    {
+        return round;
+    }
+    for (auto& shard : io_->shards)
+    {
+        FleetShard& s = *shard;
+        postToEveryConnection(s, [&s, round](FleetConnection& conn)
+            {
+                if (conn.isOpen)
+                {
+                    sendCommand(s, conn, round);
+                }
+            });
+    }
+    return round;
+}
+
+
+void ConnectionManager::setDeviceGroup(DeviceId device, GroupId group)
+{
+    if (!io_ || deviceShard(device) >= io_->shards.size())
+    {
+        return;
+    }
+    FleetShard& s = *io_->shards[deviceShard(device)];
+    postToDevice(s, device, [group](FleetConnection& conn) { conn.group = group; });
+}
+
+
+bool ConnectionManager::tryPopEvent(FleetEvent& out)
+{
+    if (!io_)
+    {
+        return false;
+    }
+    auto& shards = io_->shards;
+    for (size_t i = 0; i < shards.size(); ++i)
+    {
+        FleetShard& s = *shards[nextShardToPoll_];
+        nextShardToPoll_ = (nextShardToPoll_ + 1) % shards.size();
+        if (s.events.tryPop(out))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+size_t ConnectionManager::numDroppedEvents() const
+{
+    if (!io_)
+    {
+        return 0;
+    }
+    size_t total = 0;
+    for (const auto& s : io_->shards)
+    {
+        total += s->numDroppedEvents.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+
+size_t ConnectionManager::numRejectedConnections() const
+{
+    if (!io_)
+    {
+        return 0;
+    }
+    size_t total = 0;
+    for (const auto& s : io_->shards)
+    {
+        total += s->numRejectedConnections.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+
+void applyFleetEvent(FleetView& view, const FleetEvent& e)
+{
+    if (e.type == FleetEventType::CONNECTED)
+    {
+        // A reused id is a new device, its predecessor's stats are dropped.
+        auto& device = view.devices[e.device];
+        device = DeviceLatency{};
+        device.isConnected = true;
+        ++view.numConnected;
+        return;
+    }
+    auto it = view.devices.find(e.device);
+    if (it == view.devices.end())
+    {
+        return;
+    }
+    DeviceLatency& device = it->second;
+    switch (e.type)
+    {
+        case FleetEventType::CONNECTED:
+        {
+            break;
+        }
+
+        case FleetEventType::DISCONNECTED:
+        {
+            if (device.isConnected)
+            {
+                device.isConnected = false;
+                --view.numConnected;
+            }
+            break;
+        }
+
+        case FleetEventType::ACK_RECEIVED:
+        {
+            device.latencies.record(uint64_t{e.latency.count()});
+            view.latencies.record(uint64_t{e.latency.count()});
+            break;
+        }
+
+        case FleetEventType::COMMAND_TIMED_OUT:
+        {
+            ++device.numTimedOut;
+            ++view.numTimedOut;
+            break;
+        }
+
+        case FleetEventType::UNMATCHED_ACK:
+        {
+            ++view.numUnmatchedAcks;
+            break;
+        }
+
+        case FleetEventType::MALFORMED_MSG:
+        {
+            ++device.numMalformedMsgs;
+            ++view.numMalformedMsgs;
+            break;
+        }
+    }
+}
+
+
+// Resolutions of the fan-out in progress, commands of every round share its seq.
+// Resolved per device, since devices that reconnected are at a different seq than the rest.
+struct FleetRound
+{
+    uint16_t id = 0;
+    std::unordered_set<DeviceId> unresolved;  // targets yet to ack, time out or disconnect
+    size_t numTargets = 0;
+    chrono_time_point sentAt{};
+    chrono_time_point lastResolvedAt{};
+};
+
+
+static bool drainFleetEvents(ConnectionManager& manager, FleetView& view, FleetRound& round)
+{
+    bool hasEvents = false;
+    FleetEvent e{};
+    while (manager.tryPopEvent(e))
+    {
+        hasEvents = true;
+        applyFleetEvent(view, e);
+        // Devices that connected after the fan-out was counted may get its command too, they're not waited for.
+        bool isRoundCommand = (e.type == FleetEventType::ACK_RECEIVED ||
+                               e.type == FleetEventType::COMMAND_TIMED_OUT) && e.round == round.id;
+        if ((isRoundCommand || e.type == FleetEventType::DISCONNECTED) && round.unresolved.erase(e.device) > 0)
+        {
+            round.lastResolvedAt = std::max(round.lastResolvedAt, e.completedAt);
+        }
+    }
+    return hasEvents;
+}
+
+
+int runFleetBenchmark(
+    const std::atomic<bool>& stopSignal,
+    const FleetBenchConfig& config,
+    FleetReport& report)
+{
+    report = FleetReport{};
+    report.config = config;
+    ConnectionManager manager{config.fleet};
+    if (!manager.start())
+    {
+        return 1;
+    }
+
+    FleetView view{};
+    FleetRound round{};
+    auto startedAt = steady_clock::now();
+    while (view.numConnected < config.numDevices && !stopSignal.load(std::memory_order_relaxed))
+    {
+        if (steady_clock::now() - startedAt > config.connectTimeout)
+        {
+            std::cerr << "only " << view.numConnected << " of " << config.numDevices
+                      << " devices connected" << std::endl;
+            break;
+        }
+        if (!drainFleetEvents(manager, view, round))
+        {
+            std::this_thread::sleep_for(FLEET_POLL_INTERVAL);
+        }
+    }
+    report.numConnected = view.numConnected;
+    report.connectS = std::chrono::duration<double>(steady_clock::now() - startedAt).count();
+    std::cout << view.numConnected << " devices connected in " << report.connectS << " s" << std::endl;
+
+    // Devices acked or timed out by then, so a round only hangs if its events were dropped.
+    auto roundLimit = 2 * config.fleet.ackTimeout;
+    size_t numRoundsDone = 0;
+    chrono_time_point firstSentAt{};
+    bool isComplete = view.numConnected >= config.numDevices;
+    while (isComplete && numRoundsDone < config.numRounds && !stopSignal.load(std::memory_order_relaxed))
+    {
+        // Disconnects that happened since the last round mustn't count as targets.
+        drainFleetEvents(manager, view, round);
+        round = FleetRound{};
+        for (const auto& [device, latency] : view.devices)
+        {
+            if (latency.isConnected)
+            {
+                round.unresolved.insert(device);
+            }
+        }
+        round.numTargets = round.unresolved.size();
+        round.sentAt = steady_clock::now();
+        if (numRoundsDone == 0)
+        {
+            firstSentAt = round.sentAt;
+        }
+        if (round.numTargets == 0)
+        {
+            std::cerr << "every device disconnected" << std::endl;
+            break;
+        }
+        round.id = manager.sendToAll();
+        while (!round.unresolved.empty() && !stopSignal.load(std::memory_order_relaxed))
+        {
+            if (steady_clock::now() - round.sentAt > roundLimit)
+            {
+                std::cerr << "round " << numRoundsDone << " resolved " << round.numTargets - round.unresolved.size()
+                          << " of " << round.numTargets << " commands" << std::endl;
+                break;
+            }
+            if (!drainFleetEvents(manager, view, round))
+            {
+                std::this_thread::sleep_for(FLEET_POLL_INTERVAL);
+            }
+        }
+        if (!round.unresolved.empty())
+        {
+            break;
+        }
+        report.roundLatencies.record(std::chrono::duration<double, std::milli>(
+            round.lastResolvedAt - round.sentAt));
+        report.elapsedS = std::chrono::duration<double>(round.lastResolvedAt - firstSentAt).count();
+        ++numRoundsDone;
+    }
+
+    manager.stop();
+    drainFleetEvents(manager, view, round);
+    report.roundSummary = summarizeHistogram(report.roundLatencies);
+    report.summary = summarizeHistogram(view.latencies);
+    report.numTimedOut = view.numTimedOut;
+    report.numUnmatchedAcks = view.numUnmatchedAcks;
+    report.numMalformedMsgs = view.numMalformedMsgs;
+    report.numDroppedEvents = manager.numDroppedEvents();
+    report.numRejectedConnections = manager.numRejectedConnections();
+    for (const auto& [device, latency] : view.devices)
+    {
+        report.devices.push_back(DeviceSummary{device, summarizeHistogram(latency.latencies),
+            latency.numTimedOut});
+    }
+    std::sort(report.devices.begin(), report.devices.end(),
+        [](const DeviceSummary& a, const DeviceSummary& b)
+        { return a.summary.p99Ms > b.summary.p99Ms; });
+
+    bool isEveryAcked = isComplete && numRoundsDone == config.numRounds && view.numTimedOut == 0;
+    return isEveryAcked ? 0 : 1;
+}
+
+
+static double roundTripsPerS(const FleetReport& report)
+{
+    return report.elapsedS > 0.0 ? static_cast<double>(report.summary.count) / report.elapsedS : 0.0;
+}
+
+
+void printFleetReport(std::ostream& os, const FleetReport& report)
+{
+    constexpr size_t NUM_SLOWEST_SHOWN = 5;
+    const auto& s = report.summary;
+    const auto& r = report.roundSummary;
+    auto idxConnType = static_cast<size_t>(report.config.fleet.connType);
+    os << std::fixed << std::setprecision(3)
+       << "connection type: " << CONNECTION_TYPE_STRINGS[idxConnType] << '\n'
+       << "shards:          " << report.config.fleet.numShards << '\n'
+       << "io threads:      " << report.config.fleet.numThreads << '\n'
+       << "devices:         " << report.numConnected << " of " << report.config.numDevices
+       << " in " << report.connectS << " s\n"
+       << "rejected:        " << report.numRejectedConnections << '\n'
+       << "rounds:          " << r.count << '\n'
+       << "round p50/p99:   " << r.p50Ms << " / " << r.p99Ms << " ms (max " << r.maxMs << " ms)\n"
+       << "round trips:     " << s.count << '\n'
+       << "throughput:      " << roundTripsPerS(report) << " round trips/s\n"
+       << "timed out:       " << report.numTimedOut << '\n'
+       << "unmatched acks:  " << report.numUnmatchedAcks << '\n'
+       << "malformed msgs:  " << report.numMalformedMsgs << '\n'
+       << "dropped events:  " << report.numDroppedEvents << '\n'
+       << "min:             " << s.minMs << " ms\n"
+       << "mean:            " << s.meanMs << " ms\n"
+       << "p50:             " << s.p50Ms << " ms\n"
+       << "p99:             " << s.p99Ms << " ms\n"
+       << "max:             " << s.maxMs << " ms\n"
+       << "slowest devices (shard/slot, p50 / p99 / max ms, timeouts):\n";
+    for (size_t i = 0; i < std::min(report.devices.size(), NUM_SLOWEST_SHOWN); ++i)
+    {
+        const auto& d = report.devices[i];
+        os << "  " << deviceShard(d.device) << '/' << deviceSlot(d.device) << ": "
+           << d.summary.p50Ms << " / " << d.summary.p99Ms << " / " << d.summary.maxMs << ", "
+           << d.numTimedOut << '\n';
+    }
+}
+
+
+int runFleetThreadSweep(
+    const std::atomic<bool>& stopSignal,
+    const FleetBenchConfig& config,
+    const std::vector<size_t>& threadCounts,
+    std::vector<FleetReport>& reports)
+{
+    int exitCode = 0;
+    for (size_t numThreads : threadCounts)
+    {
+        if (stopSignal.load(std::memory_order_relaxed))
+        {
+            return 1;
+        }
+        // The devices reconnect once the previous run's connections are closed.
+        FleetBenchConfig runConfig = config;
+        runConfig.fleet.numThreads = numThreads;
+        reports.emplace_back();
+        exitCode |= runFleetBenchmark(stopSignal, runConfig, reports.back());
+    }
+    return exitCode;
+}
+
+
+void printFleetThreadSweep(std::ostream& os, const std::vector<FleetReport>& reports)
+{
+    if (reports.empty())
+    {
+        return;
+    }
+    double baseline = roundTripsPerS(reports.front());
+    os << std::fixed << std::setprecision(2) << std::setw(8) << "threads" << std::setw(14) << "round trips/s"
+       << std::setw(9) << "scaling" << std::setw(12) << "round p50" << std::setw(12) << "round p99"
+       << std::setw(10) << "p99" << "  timed out\n";
+    for (const auto& r : reports)
+    {
+        double throughput = roundTripsPerS(r);
+        os << std::setw(8) << r.config.fleet.numThreads << std::setw(14) << std::setprecision(0) << throughput
+           << std::setw(8) << std::setprecision(2) << (baseline > 0.0 ? throughput / baseline : 0.0) << 'x'
+           << std::setw(12) << r.roundSummary.p50Ms << std::setw(12) << r.roundSummary.p99Ms << std::setw(10)
+           << r.summary.p99Ms << "  " << r.numTimedOut
+           << (r.roundSummary.count < r.config.numRounds ? "  incomplete" : "") << '\n';
+    }
+    os << "(latencies in ms)\n";
+}
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
@@ -0,0 +1,247 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "connection_type.hpp"
+#include "latency_histogram.hpp"
+#include "thread_tuning.hpp"
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+/**
+ * Names one device connection of a ConnectionManager: the shard that
+ * accepted it, its slot in the shard's table and the slot's generation.
+ * Slots are reused, the generation keeps a closed connection's id from
+ * addressing the device that took over its slot.
+ */
+using DeviceId = uint32_t;
+using GroupId = uint16_t;
+
+
+constexpr DeviceId makeDeviceId(size_t shard, size_t slot, uint8_t generation)
+{
+    return static_cast<DeviceId>((shard << 24) | (slot << 8) | generation);
+}
+
+
+constexpr size_t deviceShard(DeviceId device)
+{
+    return device >> 24;
+}
+
+
+constexpr size_t deviceSlot(DeviceId device)
+{
+    return (device >> 8) & 0xFFFF;
+}
+
+
+constexpr uint8_t deviceGeneration(DeviceId device)
+{
+    return static_cast<uint8_t>(device & 0xFF);
+}
+
+
+constexpr size_t MAX_FLEET_SHARDS = 256;
+constexpr size_t MAX_DEVICES_PER_SHARD = 1 << 16;
+// Commands awaiting an ack per device, sending one more times the oldest out.
+constexpr size_t FLEET_MAX_IN_FLIGHT = 8;
+constexpr size_t FLEET_EVENT_QUEUE_CAPACITY = 1 << 14;  // per shard
+
+
+enum class FleetEventType : uint8_t
+{
+    CONNECTED,
+    DISCONNECTED,       // commands still in flight are reported as timed out first
+    ACK_RECEIVED,
+    COMMAND_TIMED_OUT,  // no ack within FleetConfig::ackTimeout
+    UNMATCHED_ACK,
+    MALFORMED_MSG,
+};
+
+
+// Per-message notice from a shard thread, the fleet's counterpart of IOEvent.
+struct FleetEvent
+{
+    std::chrono::steady_clock::time_point completedAt{};
+    std::chrono::duration<uint32_t, std::micro> latency{0};  // acks only
+    uint32_t seq = 0;
+    DeviceId device = 0;
+    uint16_t round = 0;  // of the command's sendToAll, 0 for other sends and non-command events
+    FleetEventType type = FleetEventType::CONNECTED;
+};
+
+static_assert(std::is_trivially_copyable_v<FleetEvent> && sizeof(FleetEvent) <= 24,
+    "FleetEvent is copied through the ring for every message");
+
+
+struct FleetConfig
+{
+    ConnectionType connType = ConnectionType::CUSTOM_TCP;  // udp has no connections to manage
+    unsigned short port = 0;  // 0 uses the desktop's port for connType
+    size_t numShards = 1;     // acceptors sharing the port through SO_REUSEPORT, each with its own table
+    size_t numThreads = 1;    // io threads running every shard and connection
+    size_t maxDevicesPerShard = 4096;
+    std::chrono::milliseconds ackTimeout{1000};
+    ThreadTuning threadTuning;  // applied to each io thread, thread i pinned to cpus[i % size]
+};
+
+
+struct FleetIo;
+
+
+/**
+ * Keeps accepting device connections with numShards acceptors on the
+ * port, the kernel spreads new connections over them. Each shard owns the
+ * connections it accepted in a table of compact slots. A pool of
+ * numThreads io threads runs everything: a shard's acceptor and table are
+ * bound to one strand and every connection to its own, so connections
+ * progress in parallel while each one's state is only touched by one
+ * handler at a time. Results come back through one event ring per shard.
+ */
+class ConnectionManager
+{
+   public:
+    explicit ConnectionManager(const FleetConfig& config);
+
+    ~ConnectionManager();
+    ConnectionManager(const ConnectionManager& other) = delete;
+    ConnectionManager& operator=(const ConnectionManager& other) = delete;
+    ConnectionManager(ConnectionManager&& other) = delete;
+    ConnectionManager& operator=(ConnectionManager&& other) = delete;
+
+    // Binds every shard's acceptor and starts the io threads, false if a bind failed.
+    bool start();
+    // Closes every connection and joins the io threads.
+    void stop();
+
+    // Thread safe. Commands to closed connections are dropped.
+    void sendToDevice(DeviceId device);
+    void sendToGroup(GroupId group);
+    // Returns the round stamped on the events of the commands it sends, never 0. A device's
+    // seqs restart with every connection, so a round is what ties acks to one fan-out.
+    uint16_t sendToAll();
+    // Devices start in group 0.
+    void setDeviceGroup(DeviceId device, GroupId group);
+
+    // Only one thread may pop, the shards' rings are polled round robin.
+    bool tryPopEvent(FleetEvent& out);
+
+    size_t numDroppedEvents() const;
+    size_t numRejectedConnections() const;  // over maxDevicesPerShard
+
+   private:
+    FleetConfig config_;
+    std::unique_ptr<FleetIo> io_;  // io_context and shards, null until started
+    std::vector<std::thread> threads_;
+    size_t nextShardToPoll_;
+    std::atomic<uint32_t> numRounds_;
+};
+
+
+struct DeviceLatency
+{
+    bool isConnected = false;
+    CompactLatencyHistogram latencies;
+    size_t numTimedOut = 0;
+    size_t numMalformedMsgs = 0;
+};
+
+
+/**
+ * Consumer side view of the fleet, rebuilt from the events like LinkState.
+ * Closed connections stay in devices so their stats make it into reports.
+ */
+struct FleetView
+{
+    std::unordered_map<DeviceId, DeviceLatency> devices;
+    size_t numConnected = 0;
+    LatencyHistogram latencies;  // every device's acks
+    size_t numTimedOut = 0;
+    size_t numUnmatchedAcks = 0;
+    size_t numMalformedMsgs = 0;
+};
+
+
+void applyFleetEvent(FleetView& view, const FleetEvent& e);
+
+
+struct FleetBenchConfig
+{
+    FleetConfig fleet;
+    size_t numDevices = 100;  // rounds start once this many are connected
+    size_t numRounds = 100;   // each round sends one command to every device
+    std::chrono::milliseconds connectTimeout{30'000};
+};
+
+
+struct DeviceSummary
+{
+    DeviceId device = 0;
+    LatencySummary summary;
+    size_t numTimedOut = 0;
+};
+
+
+struct FleetReport
+{
+    FleetBenchConfig config;
+    size_t numConnected = 0;  // when the first round was sent
+    double connectS = 0.0;    // start to numDevices connected
+    double elapsedS = 0.0;    // first round sent to the last one completed
+    LatencyHistogram roundLatencies;  // fan-out sent to the last device's ack or timeout
+    LatencySummary roundSummary;
+    LatencySummary summary;  // per command, over every device
+    size_t numTimedOut = 0;
+    size_t numUnmatchedAcks = 0;
+    size_t numMalformedMsgs = 0;
+    size_t numDroppedEvents = 0;
+    size_t numRejectedConnections = 0;
+    std::vector<DeviceSummary> devices;  // slowest p99 first
+};
+
+
+/**
+ * Accepts config.numDevices devices and sends numRounds fan-outs to all of
+ * them, each after the previous one completed. Returns 0 when every
+ * command was acked.
+ */
+int runFleetBenchmark(
+    const std::atomic<bool>& stopSignal,
+    const FleetBenchConfig& config,
+    FleetReport& report);
+
+
+void printFleetReport(std::ostream& os, const FleetReport& report);
+
+
+/**
+ * Runs the fleet benchmark once per io thread count in threadCounts, each
+ * after the devices reconnected, and adds a report per run to reports.
+ * Returns 0 when every run had every command acked.
+ */
+int runFleetThreadSweep(
+    const std::atomic<bool>& stopSignal,
+    const FleetBenchConfig& config,
+    const std::vector<size_t>& threadCounts,
+    std::vector<FleetReport>& reports);
+
+
+// One row per run, with the throughput relative to the first run's.
+void printFleetThreadSweep(std::ostream& os, const std::vector<FleetReport>& reports);
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
@@ -0,0 +1,25 @@
+#pragma once
+#include <array>
+#include <string_view>
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+enum class ConnectionType
+{
+    WEB_SOCKET,
+    CUSTOM_TCP,
+    UDP,
+    SHARED_MEMORY,  // a local emulator over rings in shared memory, the floor without a network stack
+};
+
+
+constexpr std::array<std::string_view, 4> CONNECTION_TYPE_STRINGS = {"WebSocket", "CustomTcp", "Udp",
+    "SharedMemory"};
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
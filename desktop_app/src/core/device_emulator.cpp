@@ -0,0 +1,689 @@
+#include "device_emulator.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+
+#include "net.hpp"
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+/**
+ * One emulated esp32. Every connection attempt gets a new id, and handlers
+ * drop completions for an older one, so anything still queued from a lost
+ * connection can't touch its successor.
+ */
+class EmulatedDevice
+{
+   public:
+    EmulatedDevice(asio::io_context& ioc, const EmulatorConfig& config, size_t idx,
+        const asio::ip::address& server, unsigned short port, EmulatedDeviceStats& stats);
+
+    ~EmulatedDevice() = default;
+    EmulatedDevice(const EmulatedDevice& other) = delete;
+    EmulatedDevice& operator=(const EmulatedDevice& other) = delete;
+    EmulatedDevice(EmulatedDevice&& other) = delete;
+    EmulatedDevice& operator=(EmulatedDevice&& other) = delete;
+
+    void start();
+    void stop();
+
+   private:
+    // A received frame waiting for the device to get to it, replies go out in arrival order.
+    struct PendingReply
+    {
+        FrameHeader request;
+        uint64_t receivedUs;
+        chrono_time_point readyAt;
+    };
+
+    uint64_t deviceClockUs() const;
+    void connect();
+    void onConnected();
+    void retryLater();
+    void asyncSendHello();
+    void disconnect();
+    void asyncRead();
+    void handleFrame(const FrameHeader& header, uint64_t receivedUs);
+    void sendReadyReplies();
+    void writeNext();
+
+    asio::io_context& ioc_;
+    const EmulatorConfig& config_;
+    size_t idx_;
+    tcp::endpoint tcpServer_;
+    udp::endpoint udpServer_;
+    std::string wsHost_;
+    EmulatedDeviceStats& stats_;
+    std::mt19937 rng_;
+    std::uniform_int_distribution<int64_t> jitterUs_;
+
+    uint32_t connId_;
+    bool isStopped_;
+    bool isConnected_;
+    std::unique_ptr<TcpSocket> tcpSock_;
+    std::unique_ptr<websocket::stream<TcpSocket>> ws_;
+    std::unique_ptr<UdpSocket> udpSock_;
+    udp::endpoint udpSender_;
+    std::array<uint8_t, FRAME_HEADER_SIZE> hello_;
+    std::array<uint8_t, 2048> readBuf_;
+    beast::flat_buffer wsReadBuf_;
+    FrameParser parser_;
+
+    std::deque<PendingReply> pending_;
+    chrono_time_point busyUntil_;  // when the device finishes the last accepted frame
+    asio::steady_timer replyTimer_;
+    asio::steady_timer retryTimer_;
+    std::vector<uint8_t> outQueue_;  // encoded replies behind the write in progress
+    std::vector<uint8_t> writeBuf_;
+    bool isWriting_;
+};
+
+
+EmulatedDevice::EmulatedDevice(asio::io_context& ioc, const EmulatorConfig& config, size_t idx,
+    const asio::ip::address& server, unsigned short port, EmulatedDeviceStats& stats)
+    : ioc_{ioc},
+      config_{config},
+      idx_{idx},
+      tcpServer_{server, port},
+      udpServer_{server, port},
+      wsHost_{server.to_string() + ":" + std::to_string(port)},
+      stats_{stats},
+      rng_{config.seed + static_cast<uint32_t>(idx)},
+      jitterUs_{0, std::max<int64_t>(config.processingJitter.count(), 0)},
+      connId_{0},
+      isStopped_{false},
+      isConnected_{false},
+      udpSender_{},
+      hello_{},
+      readBuf_{},
+      wsReadBuf_{},
+      parser_{},
+      pending_{},
+      busyUntil_{},
+      replyTimer_{ioc},
+      retryTimer_{ioc},
+      outQueue_{},
+      writeBuf_{},
+      isWriting_{false}
+{
+    encodeFrame(MsgType::HELLO, 0, 0, nullptr, 0, hello_.data());
+}
+
+
+void EmulatedDevice::start()
+{
+    connect();
+}
+
+
+void EmulatedDevice::stop()
+{
+    isStopped_ = true;
+    retryTimer_.cancel();
+    disconnect();
+}
+
+
+// Same time base as the esp_timer stamps of the firmware, shifted by the configured offset.
+static uint64_t emulatedClockUs(const EmulatorConfig& config)
+{
+    return steadyClockNs(std::chrono::steady_clock::now()) / 1000 + static_cast<uint64_t>(config.clockOffsetUs);
+}
+
+
+uint64_t EmulatedDevice::deviceClockUs() const
+{
+    return emulatedClockUs(config_);
+}
+
+
+void EmulatedDevice::connect()
+{
+    uint32_t id = ++connId_;
+    if (config_.connType == ConnectionType::UDP)
+    {
+        boost::system::error_code ec;
+        udpSock_ = std::make_unique<UdpSocket>(ioc_);
+        udpSock_->open(udpServer_.protocol(), ec);
+        if (ec)
+        {
+            std::cerr << "device " << idx_ << " can't open udp socket: " << ec.message() << std::endl;
+            return;
+        }
+        applySocketProfile(udpSock_->native_handle(), config_.socketProfile);
+        // Like the firmware, the desktop learns our address from hellos repeated until it answers.
+        asyncRead();
+        asyncSendHello();
+        return;
+    }
+
+    tcpSock_ = std::make_unique<TcpSocket>(ioc_);
+    tcpSock_->async_connect(tcpServer_, [this, id](boost::system::error_code ec)
+        {
+            if (id != connId_)
+            {
+                return;
+            }
+            if (ec)
+            {
+                retryLater();
+                return;
+            }
+            applySocketProfile(tcpSock_->native_handle(), config_.socketProfile);
+            if (config_.connType == ConnectionType::CUSTOM_TCP)
+            {
+                onConnected();
+                return;
+            }
+            ws_ = std::make_unique<websocket::stream<TcpSocket>>(std::move(*tcpSock_));
+            tcpSock_.reset();
+            ws_->binary(true);
+            ws_->async_handshake(wsHost_, "/", [this, id](boost::system::error_code ec)
+                {
+                    if (id != connId_)
+                    {
+                        return;
+                    }
+                    if (ec)
+                    {
+                        disconnect();
+                        return;
+                    }
+                    onConnected();
+                });
+        });
+}
+
+
+void EmulatedDevice::onConnected()
+{
+    isConnected_ = true;
+    ++stats_.numConnects;
+    std::cout << "device " << idx_ << " connected" << std::endl;
+    asyncRead();
+}
+
+
+void EmulatedDevice::retryLater()
+{
+    if (isStopped_)
+    {
+        return;
+    }
+    retryTimer_.expires_after(config_.retryInterval);
+    retryTimer_.async_wait([this, id = connId_](boost::system::error_code ec)
+        {
+            if (!ec && id == connId_ && !isStopped_)
+            {
+                connect();
+            }
+        });
+}
+
+
+void EmulatedDevice::asyncSendHello()
+{
+    if (isConnected_)
+    {
+        return;
+    }
+    boost::system::error_code ec;
+    // Hellos are tiny and best effort, a full socket buffer just skips one.
+    udpSock_->send_to(asio::buffer(hello_), udpServer_, 0, ec);
+    retryTimer_.expires_after(config_.retryInterval);
+    retryTimer_.async_wait([this, id = connId_](boost::system::error_code ec)
+        {
+            if (!ec && id == connId_)
+            {
+                asyncSendHello();
+            }
+        });
+}
+
+
+void EmulatedDevice::disconnect()
+{
+    boost::system::error_code ec;
+    if (tcpSock_)
+    {
+        tcpSock_->close(ec);
+    }
+    if (ws_)
+    {
+        beast::get_lowest_layer(*ws_).close(ec);
+    }
+    if (udpSock_)
+    {
+        udpSock_->close(ec);
+    }
+    replyTimer_.cancel();
+    pending_.clear();
+    outQueue_.clear();
+    isWriting_ = false;
+    parser_.reset();
+    wsReadBuf_.clear();
+    if (isConnected_)
+    {
+        std::cout << "device " << idx_ << " disconnected" << std::endl;
+    }
+    isConnected_ = false;
+    ++connId_;
+    retryLater();
+}
+
+
+void EmulatedDevice::asyncRead()
+{
+    uint32_t id = connId_;
+    switch (config_.connType)
+    {
+        case ConnectionType::CUSTOM_TCP:
+        {
+            tcpSock_->async_read_some(asio::buffer(readBuf_),
+                [this, id](boost::system::error_code ec, size_t numBytes)
+                {
+                    if (id != connId_)
+                    {
+                        return;
+                    }
+                    if (ec)
+                    {
+                        disconnect();
+                        return;
+                    }
+                    uint64_t receivedUs = deviceClockUs();
+                    rearmQuickAck(tcpSock_->native_handle(), config_.socketProfile);
+                    bool isValid = parser_.feed(readBuf_.data(), numBytes,
+                        [this, receivedUs](const FrameHeader& header, const uint8_t*)
+                        { handleFrame(header, receivedUs); });
+                    if (!isValid)
+                    {
+                        // The stream can't be resynchronized, the firmware gives up the same way.
+                        ++stats_.numInvalidFrames;
+                        disconnect();
+                        return;
+                    }
+                    asyncRead();
+                });
+            break;
+        }
+
+        case ConnectionType::WEB_SOCKET:
+        {
+            ws_->async_read(wsReadBuf_, [this, id](boost::system::error_code ec, size_t numBytes)
+                {
+                    if (id != connId_)
+                    {
+                        return;
+                    }
+                    if (ec)
+                    {
+                        disconnect();
+                        return;
+                    }
+                    uint64_t receivedUs = deviceClockUs();
+                    rearmQuickAck(beast::get_lowest_layer(*ws_).native_handle(), config_.socketProfile);
+                    bool isValid = parser_.feed(static_cast<const uint8_t*>(wsReadBuf_.data().data()),
+                        numBytes, [this, receivedUs](const FrameHeader& header, const uint8_t*)
+                        { handleFrame(header, receivedUs); });
+                    if (!isValid || parser_.hasPartialFrame())
+                    {
+                        ++stats_.numInvalidFrames;
+                        parser_.reset();
+                    }
+                    wsReadBuf_.consume(wsReadBuf_.size());
+                    asyncRead();
+                });
+            break;
+        }
+
+        case ConnectionType::UDP:
+        {
+            udpSock_->async_receive_from(asio::buffer(readBuf_), udpSender_,
+                [this, id](boost::system::error_code ec, size_t numBytes)
+                {
+                    if (id != connId_)
+                    {
+                        return;
+                    }
+                    if (ec)
+                    {
+                        disconnect();
+                        return;
+                    }
+                    uint64_t receivedUs = deviceClockUs();
+                    if (!isConnected_)
+                    {
+                        isConnected_ = true;
+                        ++stats_.numConnects;
+                    }
+                    auto header = numBytes >= FRAME_HEADER_SIZE ? decodeHeader(readBuf_.data())
+                                                                : std::nullopt;
+                    if (header && header->length == numBytes)
+                    {
+                        handleFrame(*header, receivedUs);
+                    }
+                    else
+                    {
+                        ++stats_.numInvalidFrames;
+                    }
+                    asyncRead();
+                });
+            break;
+        }
+
+        case ConnectionType::SHARED_MEMORY:
+        {
+            break;  // served by runShmDevice, never an EmulatedDevice
+        }
+    }
+}
+
+
+void EmulatedDevice::handleFrame(const FrameHeader& header, uint64_t receivedUs)
+{
+    auto now = std::chrono::steady_clock::now();
+    // The firmware works through frames one at a time, so delays add up rather than overlap.
+    busyUntil_ = std::max(busyUntil_, now);
+    switch (header.type)
+    {
+        case MsgType::COMMAND:
+        {
+            busyUntil_ += config_.processingDelay + std::chrono::microseconds(jitterUs_(rng_));
+            break;
+        }
+        case MsgType::SYNC_REQUEST:
+        {
+            break;
+        }
+        default:
+        {
+            ++stats_.numInvalidFrames;
+            return;
+        }
+    }
+    bool wasIdle = pending_.empty();
+    pending_.push_back(PendingReply{header, receivedUs, busyUntil_});
+    if (wasIdle)
+    {
+        sendReadyReplies();
+    }
+}
+
+
+void EmulatedDevice::sendReadyReplies()
+{
+    auto now = std::chrono::steady_clock::now();
+    while (!pending_.empty() && pending_.front().readyAt <= now)
+    {
+        const auto& p = pending_.front();
+        size_t offset = outQueue_.size();
+        outQueue_.resize(offset + std::max(ACK_FRAME_SIZE, SYNC_REPLY_FRAME_SIZE));
+        size_t length = 0;
+        if (p.request.type == MsgType::COMMAND)
+        {
+            length = encodeAck(p.request.seq, p.receivedUs, deviceClockUs(), outQueue_.data() + offset);
+            ++stats_.numCommands;
+        }
+        else
+        {
+            length = encodeSyncReply(p.request.seq, p.request.sendTimeUs, p.receivedUs, deviceClockUs(),
+                outQueue_.data() + offset);
+            ++stats_.numProbes;
+        }
+        outQueue_.resize(offset + length);
+        pending_.pop_front();
+    }
+    writeNext();
+    if (pending_.empty())
+    {
+        return;
+    }
+    replyTimer_.expires_at(pending_.front().readyAt);
+    replyTimer_.async_wait([this, id = connId_](boost::system::error_code ec)
+        {
+            if (!ec && id == connId_)
+            {
+                sendReadyReplies();
+            }
+        });
+}
+
+
+// Tcp writes everything queued at once, ws and udp send one reply per message like the firmware.
+void EmulatedDevice::writeNext()
+{
+    if (isWriting_ || outQueue_.empty())
+    {
+        return;
+    }
+    uint32_t id = connId_;
+    auto onWritten = [this, id](boost::system::error_code ec, size_t)
+    {
+        if (id != connId_)
+        {
+            return;
+        }
+        isWriting_ = false;
+        // Udp send errors, e.g. the desktop not listening yet, don't end the session.
+        if (ec && config_.connType != ConnectionType::UDP)
+        {
+            disconnect();
+            return;
+        }
+        writeNext();
+    };
+    isWriting_ = true;
+    if (config_.connType == ConnectionType::CUSTOM_TCP)
+    {
+        std::swap(writeBuf_, outQueue_);
+        outQueue_.clear();
+        asio::async_write(*tcpSock_, asio::buffer(writeBuf_), onWritten);
+        return;
+    }
+    size_t length = decodeHeader(outQueue_.data())->length;
+    writeBuf_.assign(outQueue_.begin(), outQueue_.begin() + length);
+    outQueue_.erase(outQueue_.begin(), outQueue_.begin() + length);
+    if (config_.connType == ConnectionType::WEB_SOCKET)
+    {
+        ws_->async_write(asio::buffer(writeBuf_), onWritten);
+    }
+    else
+    {
+        udpSock_->async_send_to(asio::buffer(writeBuf_), udpServer_, onWritten);
+    }
+}
+
+
+/**
+ * Serves one attachment to the desktop's segment until it closes it or
+ * stopSignal is set. Frames are handled one at a time in arrival order,
+ * waiting out the processing delay in place, so delays add up like on the
+ * firmware.
+ */
+static void serveShmSegment(const std::atomic<bool>& stopSignal, const EmulatorConfig& config,
+    std::mt19937& rng, ShmSegmentLayout& layout, EmulatedDeviceStats& stats)
+{
+    std::uniform_int_distribution<int64_t> jitterUs{0, std::max<int64_t>(config.processingJitter.count(), 0)};
+    ShmRing& commands = layout.toDevice;
+    ShmRing& replies = layout.toDesktop;
+    // Commands for a previous device would be acked for the wrong one.
+    commands.tail.store(commands.head.load(std::memory_order_acquire), std::memory_order_release);
+    std::array<uint8_t, FRAME_HEADER_SIZE> hello{};
+    encodeFrame(MsgType::HELLO, 0, 0, nullptr, 0, hello.data());
+    replies.tryPush(hello.data(), hello.size());
+    ++stats.numConnects;
+    std::cout << "device 0 attached to " << config.shmName << std::endl;
+
+    std::array<uint8_t, MAX_FRAME_SIZE> frame{};
+    std::array<uint8_t, std::max(ACK_FRAME_SIZE, SYNC_REPLY_FRAME_SIZE)> reply{};
+    while (!stopSignal.load(std::memory_order_relaxed) && !layout.isClosed.load(std::memory_order_acquire))
+    {
+        size_t numBytes = commands.tryPop(frame.data());
+        if (numBytes == 0)
+        {
+            // Wakes for the desktop closing too, the stop signal is seen within retryInterval.
+            commands.waitForPush(commands.tail.load(std::memory_order_relaxed), config.shmWaitMode,
+                config.retryInterval, layout.isClosed);
+            continue;
+        }
+        uint64_t receivedUs = emulatedClockUs(config);
+        auto header = numBytes >= FRAME_HEADER_SIZE ? decodeHeader(frame.data()) : std::nullopt;
+        if (!header || header->length != numBytes)
+        {
+            ++stats.numInvalidFrames;
+            continue;
+        }
+        size_t length = 0;
+        if (header->type == MsgType::COMMAND)
+        {
+            auto delay = config.processingDelay + std::chrono::microseconds(jitterUs(rng));
+            if (delay > std::chrono::microseconds::zero())
+            {
+                std::this_thread::sleep_for(delay);
+            }
+            length = encodeAck(header->seq, receivedUs, emulatedClockUs(config), reply.data());
+            ++stats.numCommands;
+        }
+        else if (header->type == MsgType::SYNC_REQUEST)
+        {
+            length = encodeSyncReply(header->seq, header->sendTimeUs, receivedUs, emulatedClockUs(config),
+                reply.data());
+            ++stats.numProbes;
+        }
+        else
+        {
+            ++stats.numInvalidFrames;
+            continue;
+        }
+        // Full only if the desktop stopped draining, then the reply is lost like a udp one.
+        replies.tryPush(reply.data(), length);
+    }
+    std::cout << "device 0 detached" << std::endl;
+}
+
+
+static int runShmDevice(const std::atomic<bool>& stopSignal, const EmulatorConfig& config,
+    EmulatorReport& report)
+{
+    if (config.numDevices != 1)
+    {
+        std::cerr << "shared memory emulates a single device" << std::endl;
+        return 1;
+    }
+    EmulatedDeviceStats& stats = report.devices.front();
+    std::mt19937 rng{config.seed};
+    ShmSegment segment{};
+    while (!stopSignal.load(std::memory_order_relaxed))
+    {
+        if (!segment.open(config.shmName))
+        {
+            std::this_thread::sleep_for(config.retryInterval);
+            continue;
+        }
+        serveShmSegment(stopSignal, config, rng, segment.layout(), stats);
+        segment.close();
+    }
+    return 0;
+}
+
+
+int runDeviceEmulator(
+    const std::atomic<bool>& stopSignal,
+    const EmulatorConfig& config,
+    EmulatorReport& report)
+{
+    report.devices.assign(config.numDevices, EmulatedDeviceStats{});
+    if (config.connType == ConnectionType::SHARED_MEMORY)
+    {
+        return runShmDevice(stopSignal, config, report);
+    }
+
+    // One io_context per thread, each device stays on its own, so devices need no locking.
+    size_t numThreads = std::clamp<size_t>(config.numThreads, 1, std::max<size_t>(config.numDevices, 1));
+    std::vector<std::unique_ptr<asio::io_context>> iocs;
+    for (size_t i = 0; i < numThreads; ++i)
+    {
+        iocs.push_back(std::make_unique<asio::io_context>(1));
+    }
+    unsigned short port = config.port != 0 ? config.port : defaultPort(config.connType);
+    boost::system::error_code ec;
+    auto server = asio::ip::make_address(config.host, ec);
+    if (ec)
+    {
+        tcp::resolver resolver{*iocs[0]};
+        auto results = resolver.resolve(config.host, std::to_string(port), ec);
+        if (ec || results.empty())
+        {
+            std::cerr << "Can't resolve " << config.host << std::endl;
+            return 1;
+        }
+        server = results.begin()->endpoint().address();
+    }
+
+    std::vector<std::unique_ptr<EmulatedDevice>> devices;
+    devices.reserve(config.numDevices);
+    for (size_t i = 0; i < config.numDevices; ++i)
+    {
+        devices.push_back(std::make_unique<EmulatedDevice>(*iocs[i % numThreads], config, i, server,
+            port, report.devices[i]));
+        devices.back()->start();
+    }
+
+    auto runDevices = [&](size_t idxThread)
+    {
+        asio::io_context& ioc = *iocs[idxThread];
+        auto workGuard = asio::make_work_guard(ioc);
+        while (!stopSignal.load(std::memory_order_relaxed))
+        {
+            ioc.run_for(std::chrono::milliseconds(100));
+        }
+        for (size_t i = idxThread; i < devices.size(); i += numThreads)
+        {
+            devices[i]->stop();
+        }
+        ioc.restart();
+        ioc.poll();
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < numThreads; ++i)
+    {
+        threads.emplace_back(runDevices, i);
+    }
+    runDevices(0);
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    return 0;
+}
+
+
+void printEmulatorReport(std::ostream& os, const EmulatorReport& report)
+{
+    EmulatedDeviceStats total{};
+    for (size_t i = 0; i < report.devices.size(); ++i)
+    {
+        const auto& d = report.devices[i];
+        os << "device " << i << ": connects " << d.numConnects << "  commands " << d.numCommands
+           << "  probes " << d.numProbes << "  invalid frames " << d.numInvalidFrames << '\n';
+        total.numConnects += d.numConnects;
+        total.numCommands += d.numCommands;
+        total.numProbes += d.numProbes;
+        total.numInvalidFrames += d.numInvalidFrames;
+    }
+    os << "total:    connects " << total.numConnects << "  commands " << total.numCommands
+       << "  probes " << total.numProbes << "  invalid frames " << total.numInvalidFrames << '\n';
+}
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
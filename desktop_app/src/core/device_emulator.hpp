@@ -0,0 +1,72 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "connection_type.hpp"
+#include "shm_link.hpp"
+#include "socket_profile.hpp"
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+struct EmulatorConfig
+{
+    ConnectionType connType = ConnectionType::CUSTOM_TCP;
+    std::string host = "127.0.0.1";
+    unsigned short port = 0;  // 0 uses the desktop's port for connType
+    size_t numDevices = 1;
+    size_t numThreads = 1;  // devices are spread over this many io threads
+    std::chrono::microseconds processingDelay{0};   // per command, between receive and ack
+    std::chrono::microseconds processingJitter{0};  // uniform extra delay up to this much
+    int64_t clockOffsetUs = 0;  // device clock minus the desktop's steady clock
+    uint32_t seed = 1;
+    std::chrono::milliseconds retryInterval{100};  // between connect attempts and udp hellos
+    SocketProfile socketProfile = findSocketProfile("nodelay").value();  // like the firmware
+    // Shared memory only, which emulates a single device.
+    std::string shmName = DEFAULT_SHM_NAME;
+    ShmWaitMode shmWaitMode = ShmWaitMode::FUTEX;
+};
+
+
+struct EmulatedDeviceStats
+{
+    size_t numConnects = 0;
+    size_t numCommands = 0;  // acked commands
+    size_t numProbes = 0;    // answered clock probes
+    size_t numInvalidFrames = 0;
+};
+
+
+struct EmulatorReport
+{
+    std::vector<EmulatedDeviceStats> devices;
+};
+
+
+/**
+ * Runs config.numDevices emulated esp32s on numThreads threads until
+ * stopSignal is set. Each one behaves like esp32_cam/main: it connects to the desktop,
+ * handles commands one at a time, acks each after the processing delay
+ * and answers clock probes. Unlike the firmware it reconnects whenever the
+ * connection is lost, so the desktop side can be restarted in between.
+ * Over shared memory the one device runs on the calling thread, without asio.
+ */
+int runDeviceEmulator(
+    const std::atomic<bool>& stopSignal,
+    const EmulatorConfig& config,
+    EmulatorReport& report);
+
+
+void printEmulatorReport(std::ostream& os, const EmulatorReport& report);
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
@@ -0,0 +1,59 @@
+#include "handler_allocator.hpp"
+
+#include <new>
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+static_assert(HandlerArena::NUM_SLOTS <= 32, "inUseMask_ holds one bit per slot");
+
+
+HandlerArena::HandlerArena()
+    : inUseMask_{0},
+      numHeapFallbacks_{0}
+{
+}
+
+
+void* HandlerArena::allocate(size_t size)
+{
+    if (size <= SLOT_SIZE)
+    {
+        for (size_t i = 0; i < NUM_SLOTS; ++i)
+        {
+            uint32_t bit = 1u << i;
+            if ((inUseMask_ & bit) == 0)
+            {
+                inUseMask_ |= bit;
+                return slots_[i].storage;
+            }
+        }
+    }
+    ++numHeapFallbacks_;
+    return ::operator new(size);
+}
+
+
+void HandlerArena::deallocate(void* p)
+{
+    auto* slot = static_cast<Slot*>(p);
+    if (slot >= slots_.data() && slot < slots_.data() + NUM_SLOTS)
+    {
+        inUseMask_ &= ~(1u << (slot - slots_.data()));
+        return;
+    }
+    ::operator delete(p);
+}
+
+
+size_t HandlerArena::numHeapFallbacks() const
+{
+    return numHeapFallbacks_;
+}
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
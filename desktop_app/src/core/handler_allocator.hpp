@@ -0,0 +1,142 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+/**
+ * Fixed slots for the handlers of one connection's async operations, so
+ * steady-state round trips never reach the heap. A connection has only a
+ * few operations outstanding at once (read, write, timers, plus the state
+ * of beast's composed ops), and asio frees an op's memory before calling
+ * its handler, so a re-armed operation reuses the slot it just released.
+ * Requests that don't fit fall back to operator new and are counted.
+ * Not thread safe, only use it from the thread (or strand) running the ops.
+ */
+class HandlerArena
+{
+   public:
+    static constexpr size_t NUM_SLOTS = 8;
+    static constexpr size_t SLOT_SIZE = 1024;
+
+    HandlerArena();
+
+    ~HandlerArena() = default;
+    HandlerArena(const HandlerArena& other) = delete;
+    HandlerArena& operator=(const HandlerArena& other) = delete;
+    HandlerArena(HandlerArena&& other) = delete;
+    HandlerArena& operator=(HandlerArena&& other) = delete;
+
+    void* allocate(size_t size);
+    void deallocate(void* p);
+
+    size_t numHeapFallbacks() const;
+
+   private:
+    struct alignas(std::max_align_t) Slot
+    {
+        unsigned char storage[SLOT_SIZE];
+    };
+
+    std::array<Slot, NUM_SLOTS> slots_;
+    uint32_t inUseMask_;
+    size_t numHeapFallbacks_;
+};
+
+
+// Standard allocator over a HandlerArena, picked up by asio as a handler's associated allocator.
+template <typename T>
+class HandlerAllocator
+{
+   public:
+    using value_type = T;
+
+    explicit HandlerAllocator(HandlerArena& arena) noexcept
+        : arena_{&arena}
+    {
+    }
+
+    template <typename U>
+    HandlerAllocator(const HandlerAllocator<U>& other) noexcept
+        : arena_{other.arena()}
+    {
+    }
+
+    T* allocate(size_t n) const
+    {
+        return static_cast<T*>(arena_->allocate(sizeof(T) * n));
+    }
+
+    void deallocate(T* p, size_t) const
+    {
+        arena_->deallocate(p);
+    }
+
+    HandlerArena* arena() const noexcept
+    {
+        return arena_;
+    }
+
+    template <typename U>
+    bool operator==(const HandlerAllocator<U>& other) const noexcept
+    {
+        return arena_ == other.arena();
+    }
+
+    template <typename U>
+    bool operator!=(const HandlerAllocator<U>& other) const noexcept
+    {
+        return arena_ != other.arena();
+    }
+
+   private:
+    HandlerArena* arena_;
+};
+
+
+// Completion handler wrapper that makes asio allocate the operation from an arena.
+template <typename Handler>
+class ArenaHandler
+{
+   public:
+    using allocator_type = HandlerAllocator<Handler>;
+
+    ArenaHandler(HandlerArena& arena, Handler handler)
+        : arena_{arena},
+          handler_{std::move(handler)}
+    {
+    }
+
+    allocator_type get_allocator() const noexcept
+    {
+        return allocator_type{arena_};
+    }
+
+    template <typename... Args>
+    void operator()(Args&&... args)
+    {
+        handler_(std::forward<Args>(args)...);
+    }
+
+   private:
+    HandlerArena& arena_;
+    Handler handler_;
+};
+
+
+template <typename Handler>
+ArenaHandler<std::decay_t<Handler>> bindArena(HandlerArena& arena, Handler&& handler)
+{
+    return ArenaHandler<std::decay_t<Handler>>{arena, std::forward<Handler>(handler)};
+}
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
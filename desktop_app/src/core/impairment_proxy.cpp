@@ -0,0 +1,802 @@
+#include "impairment_proxy.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <nlohmann/json.hpp>
+
+#include "net.hpp"
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+ImpairedLink::ImpairedLink(const LinkImpairment& impairment, uint32_t seed, LinkStats& stats)
+    : impairment_{impairment},
+      stats_{stats},
+      rng_{seed},
+      isBad_{false},
+      linkFreeAt_{},
+      lastReleaseAt_{}
+{
+}
+
+
+bool ImpairedLink::chance(double prob)
+{
+    if (prob <= 0.0)
+    {
+        return false;
+    }
+    return std::uniform_real_distribution<double>{0.0, 1.0}(rng_) < prob;
+}
+
+
+std::chrono::microseconds ImpairedLink::sampleJitter()
+{
+    auto jitterUs = static_cast<double>(impairment_.jitter.count());
+    if (jitterUs <= 0.0)
+    {
+        return std::chrono::microseconds{0};
+    }
+    double sampleUs = 0.0;
+    switch (impairment_.jitterDistribution)
+    {
+        case DelayDistribution::UNIFORM:
+        {
+            sampleUs = std::uniform_real_distribution<double>{0.0, jitterUs}(rng_);
+            break;
+        }
+        case DelayDistribution::NORMAL:
+        {
+            sampleUs = std::abs(std::normal_distribution<double>{0.0, jitterUs}(rng_));
+            break;
+        }
+        case DelayDistribution::PARETO:
+        {
+            // Lomax with shape 2, whose mean is its scale. Capped so one sample can't stall a run.
+            double u = std::uniform_real_distribution<double>{0.0, 1.0}(rng_);
+            sampleUs = std::min(jitterUs * (1.0 / std::sqrt(1.0 - u) - 1.0), 100.0 * jitterUs);
+            break;
+        }
+    }
+    return std::chrono::microseconds(std::llround(sampleUs));
+}
+
+
+std::optional<ImpairedLink::time_point> ImpairedLink::schedule(time_point now, size_t numBytes, bool isStream)
+{
+    ++stats_.numChunks;
+    stats_.numBytes += numBytes;
+    isBad_ = isBad_ ? !chance(impairment_.badToGoodProb) : chance(impairment_.goodToBadProb);
+    bool isLost = chance(isBad_ ? impairment_.badLossProb : impairment_.goodLossProb);
+
+    // Lost chunks went over the air too, so they still take their share of the bandwidth.
+    auto sentAt = std::max(now, linkFreeAt_);
+    if (impairment_.bandwidthBps > 0.0)
+    {
+        std::chrono::duration<double> serialization{static_cast<double>(numBytes) * 8.0 / impairment_.bandwidthBps};
+        sentAt += std::chrono::duration_cast<std::chrono::steady_clock::duration>(serialization);
+        linkFreeAt_ = sentAt;
+    }
+    auto releaseAt = sentAt + impairment_.delay + sampleJitter();
+    if (isLost)
+    {
+        if (!isStream)
+        {
+            ++stats_.numLost;
+            return std::nullopt;
+        }
+        ++stats_.numRetransmitted;
+        releaseAt += impairment_.retransmitDelay;
+    }
+    if (isStream)
+    {
+        releaseAt = std::max(releaseAt, lastReleaseAt_);
+    }
+    else if (chance(impairment_.reorderProb))
+    {
+        ++stats_.numReordered;
+        releaseAt += impairment_.reorderDelay;
+    }
+    lastReleaseAt_ = std::max(lastReleaseAt_, releaseAt);
+    return releaseAt;
+}
+
+
+/**
+ * Holds chunks back until the ImpairedLink's release time, then hands them
+ * to release in release order. Pending waits keep the owner alive.
+ */
+class DelayLine
+{
+   public:
+    using Release = std::function<void(std::vector<uint8_t>&&)>;
+
+    DelayLine(asio::io_context& ioc, const LinkImpairment& impairment, uint32_t seed, LinkStats& stats,
+        bool isStream, Release release);
+
+    void setOwner(std::weak_ptr<void> owner);
+    void push(const uint8_t* data, size_t size);
+    void cancel();
+    size_t numQueuedBytes() const;
+
+   private:
+    struct Chunk
+    {
+        chrono_time_point releaseAt;
+        std::vector<uint8_t> data;
+    };
+
+    void asyncWaitForFront();
+    void releaseDue();
+
+    const LinkImpairment& impairment_;
+    LinkStats& stats_;
+    ImpairedLink link_;
+    bool isStream_;
+    Release release_;
+    std::deque<Chunk> chunks_;
+    size_t numQueuedBytes_;
+    asio::steady_timer timer_;
+    std::weak_ptr<void> owner_;
+    bool isCancelled_;
+};
+
+
+DelayLine::DelayLine(asio::io_context& ioc, const LinkImpairment& impairment, uint32_t seed, LinkStats& stats,
+    bool isStream, Release release)
+    : impairment_{impairment},
+      stats_{stats},
+      link_{impairment, seed, stats},
+      isStream_{isStream},
+      release_{std::move(release)},
+      chunks_{},
+      numQueuedBytes_{0},
+      timer_{ioc},
+      owner_{},
+      isCancelled_{false}
+{
+}
+
+
+void DelayLine::setOwner(std::weak_ptr<void> owner)
+{
+    owner_ = std::move(owner);
+}
+
+
+void DelayLine::push(const uint8_t* data, size_t size)
+{
+    // Streams are throttled by their reader instead, see TcpProxySession::hasRoom.
+    if (!isStream_ && numQueuedBytes_ + size > impairment_.queueLimitBytes)
+    {
+        ++stats_.numQueueDrops;
+        return;
+    }
+    auto releaseAt = link_.schedule(std::chrono::steady_clock::now(), size, isStream_);
+    if (!releaseAt)
+    {
+        return;
+    }
+    auto pos = std::upper_bound(chunks_.begin(), chunks_.end(), *releaseAt,
+        [](chrono_time_point t, const Chunk& c)
+        { return t < c.releaseAt; });
+    bool isNewFront = pos == chunks_.begin();
+    chunks_.insert(pos, Chunk{*releaseAt, std::vector<uint8_t>(data, data + size)});
+    numQueuedBytes_ += size;
+    if (isNewFront)
+    {
+        asyncWaitForFront();
+    }
+}
+
+
+void DelayLine::cancel()
+{
+    isCancelled_ = true;
+    timer_.cancel();
+    chunks_.clear();
+    numQueuedBytes_ = 0;
+}
+
+
+size_t DelayLine::numQueuedBytes() const
+{
+    return numQueuedBytes_;
+}
+
+
+void DelayLine::asyncWaitForFront()
+{
+    // Re-arming aborts the previous wait, whose handler then does nothing.
+    timer_.expires_at(chunks_.front().releaseAt);
+    timer_.async_wait([this, keepAlive = owner_.lock()](boost::system::error_code ec)
+        {
+            if (ec || isCancelled_)
+            {
+                return;
+            }
+            releaseDue();
+        });
+}
+
+
+void DelayLine::releaseDue()
+{
+    auto now = std::chrono::steady_clock::now();
+    while (!chunks_.empty() && chunks_.front().releaseAt <= now)
+    {
+        auto data = std::move(chunks_.front().data);
+        chunks_.pop_front();
+        numQueuedBytes_ -= data.size();
+        release_(std::move(data));
+        if (isCancelled_)
+        {
+            return;
+        }
+    }
+    if (!chunks_.empty())
+    {
+        asyncWaitForFront();
+    }
+}
+
+
+/**
+ * One device connection forwarded to the desktop. Each direction reads,
+ * holds the bytes in its delay line, then writes them in order. A direction
+ * stops reading once queueLimitBytes are held, so the sender sees a full
+ * window just like behind a slow bottleneck.
+ */
+class TcpProxySession : public std::enable_shared_from_this<TcpProxySession>
+{
+   public:
+    TcpProxySession(asio::io_context& ioc, TcpSocket device, const tcp::endpoint& target,
+        const LinkImpairment& uplink, const LinkImpairment& downlink, uint32_t seed, ProxyReport& report);
+
+    void start();
+    void close();
+
+   private:
+    struct Pump
+    {
+        Pump(asio::io_context& ioc, TcpSocket& from, TcpSocket& to, const LinkImpairment& impairment,
+            uint32_t seed, LinkStats& stats, DelayLine::Release release);
+
+        TcpSocket& from;
+        TcpSocket& to;
+        const LinkImpairment& impairment;
+        DelayLine delayLine;
+        std::deque<std::vector<uint8_t>> released;
+        size_t numReleasedBytes;
+        bool isReading;
+        bool isWriting;
+        std::array<uint8_t, 4096> readBuf;
+    };
+
+    bool hasRoom(const Pump& p) const;
+    void asyncRead(Pump& p);
+    void onReleased(Pump& p, std::vector<uint8_t>&& data);
+    void writeNext(Pump& p);
+
+    TcpSocket device_;
+    TcpSocket desktop_;
+    tcp::endpoint target_;
+    Pump uplink_;    // desktop to device
+    Pump downlink_;  // device to desktop
+    bool isClosed_;
+};
+
+
+TcpProxySession::Pump::Pump(asio::io_context& ioc, TcpSocket& from, TcpSocket& to,
+    const LinkImpairment& impairment, uint32_t seed, LinkStats& stats, DelayLine::Release release)
+    : from{from},
+      to{to},
+      impairment{impairment},
+      delayLine{ioc, impairment, seed, stats, true, std::move(release)},
+      released{},
+      numReleasedBytes{0},
+      isReading{false},
+      isWriting{false},
+      readBuf{}
+{
+}
+
+
+TcpProxySession::TcpProxySession(asio::io_context& ioc, TcpSocket device, const tcp::endpoint& target,
+    const LinkImpairment& uplink, const LinkImpairment& downlink, uint32_t seed, ProxyReport& report)
+    : device_{std::move(device)},
+      desktop_{ioc},
+      target_{target},
+      uplink_{ioc, desktop_, device_, uplink, seed, report.uplink,
+          [this](std::vector<uint8_t>&& data)
+          { onReleased(uplink_, std::move(data)); }},
+      downlink_{ioc, device_, desktop_, downlink, seed + 1, report.downlink,
+          [this](std::vector<uint8_t>&& data)
+          { onReleased(downlink_, std::move(data)); }},
+      isClosed_{false}
+{
+}
+
+
+void TcpProxySession::start()
+{
+    uplink_.delayLine.setOwner(weak_from_this());
+    downlink_.delayLine.setOwner(weak_from_this());
+    desktop_.async_connect(target_, [this, self = shared_from_this()](boost::system::error_code ec)
+        {
+            if (isClosed_)
+            {
+                return;
+            }
+            if (ec)
+            {
+                std::cerr << "proxy can't reach the desktop: " << ec.message() << std::endl;
+                close();
+                return;
+            }
+            // Nagle would add its own delay on top of the impairment.
+            device_.set_option(tcp::no_delay(true), ec);
+            desktop_.set_option(tcp::no_delay(true), ec);
+            asyncRead(uplink_);
+            asyncRead(downlink_);
+        });
+}
+
+
+void TcpProxySession::close()
+{
+    if (isClosed_)
+    {
+        return;
+    }
+    isClosed_ = true;
+    boost::system::error_code ec;
+    device_.close(ec);
+    desktop_.close(ec);
+    uplink_.delayLine.cancel();
+    downlink_.delayLine.cancel();
+}
+
+
+bool TcpProxySession::hasRoom(const Pump& p) const
+{
+    return p.delayLine.numQueuedBytes() + p.numReleasedBytes < p.impairment.queueLimitBytes;
+}
+
+
+void TcpProxySession::asyncRead(Pump& p)
+{
+    p.isReading = true;
+    p.from.async_read_some(asio::buffer(p.readBuf),
+        [this, self = shared_from_this(), &p](boost::system::error_code ec, size_t numBytes)
+        {
+            p.isReading = false;
+            if (isClosed_)
+            {
+                return;
+            }
+            if (ec)
+            {
+                close();
+                return;
+            }
+            p.delayLine.push(p.readBuf.data(), numBytes);
+            if (hasRoom(p))
+            {
+                asyncRead(p);
+            }
+        });
+}
+
+
+void TcpProxySession::onReleased(Pump& p, std::vector<uint8_t>&& data)
+{
+    p.numReleasedBytes += data.size();
+    p.released.push_back(std::move(data));
+    writeNext(p);
+}
+
+
+void TcpProxySession::writeNext(Pump& p)
+{
+    if (p.isWriting || p.released.empty())
+    {
+        return;
+    }
+    p.isWriting = true;
+    asio::async_write(p.to, asio::buffer(p.released.front()),
+        [this, self = shared_from_this(), &p](boost::system::error_code ec, size_t)
+        {
+            p.isWriting = false;
+            if (isClosed_)
+            {
+                return;
+            }
+            if (ec)
+            {
+                close();
+                return;
+            }
+            p.numReleasedBytes -= p.released.front().size();
+            p.released.pop_front();
+            if (!p.isReading && hasRoom(p))
+            {
+                asyncRead(p);
+            }
+            writeNext(p);
+        });
+}
+
+
+/**
+ * One udp peer forwarded to the desktop from a socket of its own, so the
+ * desktop sees one address per device just as without the proxy.
+ */
+class UdpProxySession : public std::enable_shared_from_this<UdpProxySession>
+{
+   public:
+    UdpProxySession(asio::io_context& ioc, UdpSocket& listenSock, const udp::endpoint& device,
+        const udp::endpoint& target, const LinkImpairment& uplink, const LinkImpairment& downlink,
+        uint32_t seed, ProxyReport& report);
+
+    void start();
+    void close();
+    void onDeviceDatagram(const uint8_t* data, size_t size);
+
+   private:
+    void asyncReadDesktop();
+
+    UdpSocket& listenSock_;
+    udp::endpoint device_;
+    udp::endpoint target_;
+    UdpSocket upstream_;
+    udp::endpoint upstreamSender_;
+    std::array<uint8_t, 2048> readBuf_;
+    DelayLine uplink_;
+    DelayLine downlink_;
+    bool isClosed_;
+};
+
+
+UdpProxySession::UdpProxySession(asio::io_context& ioc, UdpSocket& listenSock, const udp::endpoint& device,
+    const udp::endpoint& target, const LinkImpairment& uplink, const LinkImpairment& downlink,
+    uint32_t seed, ProxyReport& report)
+    : listenSock_{listenSock},
+      device_{device},
+      target_{target},
+      upstream_{ioc, udp::endpoint{target.protocol(), 0}},
+      upstreamSender_{},
+      readBuf_{},
+      uplink_{ioc, uplink, seed, report.uplink, false,
+          [this](std::vector<uint8_t>&& data)
+          {
+              boost::system::error_code ec;
+              listenSock_.send_to(asio::buffer(data), device_, 0, ec);
+          }},
+      downlink_{ioc, downlink, seed + 1, report.downlink, false,
+          [this](std::vector<uint8_t>&& data)
+          {
+              boost::system::error_code ec;
+              upstream_.send_to(asio::buffer(data), target_, 0, ec);
+          }},
+      isClosed_{false}
+{
+}
+
+
+void UdpProxySession::start()
+{
+    uplink_.setOwner(weak_from_this());
+    downlink_.setOwner(weak_from_this());
+    asyncReadDesktop();
+}
+
+
+void UdpProxySession::close()
+{
+    isClosed_ = true;
+    boost::system::error_code ec;
+    upstream_.close(ec);
+    uplink_.cancel();
+    downlink_.cancel();
+}
+
+
+void UdpProxySession::onDeviceDatagram(const uint8_t* data, size_t size)
+{
+    if (!isClosed_)
+    {
+        downlink_.push(data, size);
+    }
+}
+
+
+void UdpProxySession::asyncReadDesktop()
+{
+    upstream_.async_receive_from(asio::buffer(readBuf_), upstreamSender_,
+        [this, self = shared_from_this()](boost::system::error_code ec, size_t numBytes)
+        {
+            if (isClosed_ || ec)
+            {
+                return;
+            }
+            uplink_.push(readBuf_.data(), numBytes);
+            asyncReadDesktop();
+        });
+}
+
+
+struct ProxyState
+{
+    asio::io_context& ioc;
+    const ProxyConfig& config;
+    ProxyReport& report;
+    asio::ip::address targetAddress;
+    unsigned short targetPort;
+    LinkImpairment uplink;  // current phase, sessions reference these
+    LinkImpairment downlink;
+    chrono_time_point startedAt;
+    asio::steady_timer phaseTimer;
+    size_t nextPhase;
+
+    std::unique_ptr<tcp::acceptor> acceptor;
+    std::vector<std::weak_ptr<TcpProxySession>> tcpSessions;
+    std::unique_ptr<UdpSocket> udpSock;
+    udp::endpoint udpSender;
+    std::array<uint8_t, 2048> udpReadBuf;
+    std::map<udp::endpoint, std::shared_ptr<UdpProxySession>> udpSessions;
+};
+
+
+static uint32_t sessionSeed(const ProxyState& s)
+{
+    // Two streams per session, one per direction.
+    return s.config.seed + 2 * static_cast<uint32_t>(s.report.numSessions);
+}
+
+
+static void asyncApplyPhases(ProxyState& s)
+{
+    const auto& phases = s.config.phases;
+    auto now = std::chrono::steady_clock::now();
+    while (s.nextPhase < phases.size() && s.startedAt + phases[s.nextPhase].at <= now)
+    {
+        const auto& phase = phases[s.nextPhase];
+        s.uplink = phase.uplink;
+        s.downlink = phase.downlink;
+        std::cout << "impairment phase " << s.nextPhase << " at " << phase.at.count() << " ms" << std::endl;
+        ++s.nextPhase;
+    }
+    if (s.nextPhase == phases.size())
+    {
+        return;
+    }
+    s.phaseTimer.expires_at(s.startedAt + phases[s.nextPhase].at);
+    s.phaseTimer.async_wait([&s](boost::system::error_code ec)
+        {
+            if (!ec)
+            {
+                asyncApplyPhases(s);
+            }
+        });
+}
+
+
+static void asyncAcceptTcp(ProxyState& s)
+{
+    s.acceptor->async_accept(s.ioc, [&s](boost::system::error_code ec, TcpSocket socket)
+        {
+            if (ec)
+            {
+                return;
+            }
+            std::cout << "proxying device " << socket.remote_endpoint(ec) << std::endl;
+            auto session = std::make_shared<TcpProxySession>(s.ioc, std::move(socket),
+                tcp::endpoint{s.targetAddress, s.targetPort}, s.uplink, s.downlink, sessionSeed(s), s.report);
+            ++s.report.numSessions;
+            session->start();
+            s.tcpSessions.push_back(session);
+            asyncAcceptTcp(s);
+        });
+}
+
+
+static void asyncReceiveUdp(ProxyState& s)
+{
+    s.udpSock->async_receive_from(asio::buffer(s.udpReadBuf), s.udpSender,
+        [&s](boost::system::error_code ec, size_t numBytes)
+        {
+            if (ec == asio::error::operation_aborted)
+            {
+                return;
+            }
+            if (!ec)
+            {
+                auto& session = s.udpSessions[s.udpSender];
+                if (!session)
+                {
+                    std::cout << "proxying device " << s.udpSender << std::endl;
+                    session = std::make_shared<UdpProxySession>(s.ioc, *s.udpSock, s.udpSender,
+                        udp::endpoint{s.targetAddress, s.targetPort}, s.uplink, s.downlink, sessionSeed(s),
+                        s.report);
+                    ++s.report.numSessions;
+                    session->start();
+                }
+                session->onDeviceDatagram(s.udpReadBuf.data(), numBytes);
+            }
+            asyncReceiveUdp(s);
+        });
+}
+
+
+int runImpairmentProxy(
+    const std::atomic<bool>& stopSignal,
+    const ProxyConfig& config,
+    ProxyReport& report)
+{
+    report = ProxyReport{};
+    asio::io_context ioc{1};
+    boost::system::error_code ec;
+    auto targetAddress = asio::ip::make_address(config.targetHost, ec);
+    if (ec)
+    {
+        std::cerr << "Invalid target address " << config.targetHost << std::endl;
+        return 1;
+    }
+    ProxyState s{ioc, config, report, targetAddress,
+        config.targetPort != 0 ? config.targetPort : defaultPort(config.connType), LinkImpairment{},
+        LinkImpairment{}, std::chrono::steady_clock::now(), asio::steady_timer{ioc}, 0, nullptr, {},
+        nullptr, {}, {}, {}};
+    asyncApplyPhases(s);
+
+    try
+    {
+        if (config.connType == ConnectionType::UDP)
+        {
+            s.udpSock = std::make_unique<UdpSocket>(ioc, udp::endpoint{udp::v4(), config.listenPort});
+            asyncReceiveUdp(s);
+        }
+        else
+        {
+            s.acceptor = std::make_unique<tcp::acceptor>(ioc, tcp::endpoint{tcp::v4(), config.listenPort});
+            asyncAcceptTcp(s);
+        }
+    }
+    catch (const boost::system::system_error& e)
+    {
+        std::cerr << "Can't listen on port " << config.listenPort << ": " << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << "proxying port " << config.listenPort << " to " << targetAddress << ":" << s.targetPort
+              << std::endl;
+
+    auto workGuard = asio::make_work_guard(ioc);
+    while (!stopSignal.load(std::memory_order_relaxed))
+    {
+        ioc.run_for(std::chrono::milliseconds(100));
+    }
+
+    s.phaseTimer.cancel();
+    if (s.acceptor)
+    {
+        s.acceptor->close(ec);
+    }
+    for (auto& weakSession : s.tcpSessions)
+    {
+        if (auto session = weakSession.lock())
+        {
+            session->close();
+        }
+    }
+    for (auto& [endpoint, session] : s.udpSessions)
+    {
+        session->close();
+    }
+    if (s.udpSock)
+    {
+        s.udpSock->close(ec);
+    }
+    ioc.restart();
+    ioc.poll();
+    return 0;
+}
+
+
+static DelayDistribution parseDistribution(const std::string& name)
+{
+    if (name == "normal")
+    {
+        return DelayDistribution::NORMAL;
+    }
+    if (name == "pareto")
+    {
+        return DelayDistribution::PARETO;
+    }
+    if (name != "uniform")
+    {
+        throw std::invalid_argument("unknown jitter distribution " + name);
+    }
+    return DelayDistribution::UNIFORM;
+}
+
+
+static LinkImpairment parseImpairment(const nlohmann::json& j)
+{
+    LinkImpairment imp{};
+    imp.delay = std::chrono::microseconds(j.value("delayUs", imp.delay.count()));
+    imp.jitter = std::chrono::microseconds(j.value("jitterUs", imp.jitter.count()));
+    imp.jitterDistribution = parseDistribution(j.value("jitterDistribution", std::string{"uniform"}));
+    imp.goodToBadProb = j.value("goodToBadProb", imp.goodToBadProb);
+    imp.badToGoodProb = j.value("badToGoodProb", imp.badToGoodProb);
+    imp.goodLossProb = j.value("goodLossProb", imp.goodLossProb);
+    imp.badLossProb = j.value("badLossProb", imp.badLossProb);
+    imp.bandwidthBps = j.value("bandwidthBps", imp.bandwidthBps);
+    imp.reorderProb = j.value("reorderProb", imp.reorderProb);
+    imp.reorderDelay = std::chrono::microseconds(j.value("reorderDelayUs", imp.reorderDelay.count()));
+    imp.retransmitDelay = std::chrono::microseconds(j.value("retransmitDelayUs", imp.retransmitDelay.count()));
+    imp.queueLimitBytes = j.value("queueLimitBytes", imp.queueLimitBytes);
+    return imp;
+}
+
+
+bool loadImpairmentScript(const std::string& path, ProxyConfig& config)
+{
+    std::ifstream in{path};
+    if (!in)
+    {
+        std::cerr << "Failed to open " << path << std::endl;
+        return false;
+    }
+    try
+    {
+        auto j = nlohmann::json::parse(in);
+        config.seed = j.value("seed", config.seed);
+        config.phases.clear();
+        for (const auto& p : j.at("phases"))
+        {
+            ImpairmentPhase phase{};
+            phase.at = std::chrono::milliseconds(p.value("atMs", int64_t{0}));
+            // "both" sets the two directions alike, "uplink" and "downlink" override it.
+            auto both = p.value("both", nlohmann::json::object());
+            phase.uplink = parseImpairment(p.contains("uplink") ? p.at("uplink") : both);
+            phase.downlink = parseImpairment(p.contains("downlink") ? p.at("downlink") : both);
+            config.phases.push_back(phase);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Invalid impairment script " << path << ": " << e.what() << std::endl;
+        return false;
+    }
+    std::stable_sort(config.phases.begin(), config.phases.end(), [](const ImpairmentPhase& a, const ImpairmentPhase& b)
+        { return a.at < b.at; });
+    return true;
+}
+
+
+static void printLinkStats(std::ostream& os, const char* name, const LinkStats& l)
+{
+    os << name << l.numChunks << " chunks  " << l.numBytes << " B  lost " << l.numLost << "  retransmitted "
+       << l.numRetransmitted << "  reordered " << l.numReordered << "  queue drops " << l.numQueueDrops << '\n';
+}
+
+
+void printProxyReport(std::ostream& os, const ProxyReport& report)
+{
+    os << "sessions: " << report.numSessions << '\n';
+    printLinkStats(os, "uplink:   ", report.uplink);
+    printLinkStats(os, "downlink: ", report.downlink);
+}
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
@@ -0,0 +1,141 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "connection_type.hpp"
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+enum class DelayDistribution
+{
+    UNIFORM,  // [0, jitter]
+    NORMAL,   // |N(0, jitter)|
+    PARETO,   // heavy tailed with mean jitter, like retries and rate drops on Wi-Fi
+};
+
+
+/**
+ * What one direction of the proxy does to the traffic passing through it.
+ * Loss follows a Gilbert-Elliott model: each chunk first moves the link
+ * between a good and a bad state, then is lost at that state's rate, which
+ * produces the bursty loss of a fading Wi-Fi link. Tcp can't lose bytes, a
+ * lost chunk is held back by retransmitDelay instead and everything behind
+ * it waits, like a real retransmission would make it.
+ */
+struct LinkImpairment
+{
+    std::chrono::microseconds delay{0};
+    std::chrono::microseconds jitter{0};
+    DelayDistribution jitterDistribution = DelayDistribution::UNIFORM;
+    double goodToBadProb = 0.0;
+    double badToGoodProb = 1.0;
+    double goodLossProb = 0.0;
+    double badLossProb = 0.0;
+    double bandwidthBps = 0.0;  // 0 is unlimited
+    double reorderProb = 0.0;   // udp only, the datagram is held back by reorderDelay
+    std::chrono::microseconds reorderDelay{2'000};
+    std::chrono::microseconds retransmitDelay{200'000};
+    size_t queueLimitBytes = 1 << 20;  // tcp stops reading, udp drops the datagram
+};
+
+
+struct LinkStats
+{
+    size_t numChunks = 0;  // tcp reads or udp datagrams
+    size_t numBytes = 0;
+    size_t numLost = 0;
+    size_t numRetransmitted = 0;
+    size_t numReordered = 0;
+    size_t numQueueDrops = 0;
+};
+
+
+/**
+ * Decides when a chunk entering one direction of the proxy leaves it, or
+ * that it is lost. Pure bookkeeping, the proxy does the actual holding back.
+ * The impairment is referenced so a script can change it mid run.
+ */
+class ImpairedLink
+{
+   public:
+    using time_point = std::chrono::steady_clock::time_point;
+
+    ImpairedLink(const LinkImpairment& impairment, uint32_t seed, LinkStats& stats);
+
+    // Streams keep their byte order, so their release times never decrease.
+    std::optional<time_point> schedule(time_point now, size_t numBytes, bool isStream);
+
+   private:
+    bool chance(double prob);
+    std::chrono::microseconds sampleJitter();
+
+    const LinkImpairment& impairment_;
+    LinkStats& stats_;
+    std::mt19937 rng_;
+    bool isBad_;
+    time_point linkFreeAt_;    // when the bandwidth cap lets the next chunk start
+    time_point lastReleaseAt_;
+};
+
+
+// Impairments that take effect at an offset from the proxy's start.
+struct ImpairmentPhase
+{
+    std::chrono::milliseconds at{0};
+    LinkImpairment uplink;    // desktop to device
+    LinkImpairment downlink;  // device to desktop
+};
+
+
+struct ProxyConfig
+{
+    ConnectionType connType = ConnectionType::CUSTOM_TCP;
+    unsigned short listenPort = 0;  // where devices connect instead of the desktop
+    std::string targetHost = "127.0.0.1";
+    unsigned short targetPort = 0;  // 0 uses the desktop's port for connType
+    uint32_t seed = 1;
+    std::vector<ImpairmentPhase> phases;  // sorted by at, no impairment before the first
+};
+
+
+struct ProxyReport
+{
+    size_t numSessions = 0;
+    LinkStats uplink;
+    LinkStats downlink;
+};
+
+
+/**
+ * Reads phases and seed from a json script, see the README for the format.
+ * Keys that are left out keep their LinkImpairment defaults.
+ */
+bool loadImpairmentScript(const std::string& path, ProxyConfig& config);
+
+/**
+ * Forwards every device connection (or udp peer) on listenPort to the
+ * desktop, impairing both directions, until stopSignal is set. Each
+ * session gets its own seeded random streams, so runs are reproducible.
+ */
+int runImpairmentProxy(
+    const std::atomic<bool>& stopSignal,
+    const ProxyConfig& config,
+    ProxyReport& report);
+
+
+void printProxyReport(std::ostream& os, const ProxyReport& report);
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
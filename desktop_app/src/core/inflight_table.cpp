@@ -0,0 +1,68 @@
+#include "inflight_table.hpp"
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+static_assert((InFlightTable::CAPACITY & (InFlightTable::CAPACITY - 1)) == 0,
+    "CAPACITY must be a power of two");
+
+
+InFlightTable::InFlightTable()
+    : size_{0}
+{
+}
+
+
+std::optional<uint32_t> InFlightTable::insert(uint32_t seq, time_point sentAt)
+{
+    auto& slot = slots_[seq & (CAPACITY - 1)];
+    std::optional<uint32_t> evicted;
+    if (slot.isPending)
+    {
+        evicted = slot.seq;
+    }
+    else
+    {
+        ++size_;
+    }
+    slot.seq = seq;
+    slot.isPending = true;
+    slot.sentAt = sentAt;
+    return evicted;
+}
+
+
+std::optional<InFlightTable::time_point> InFlightTable::complete(uint32_t seq)
+{
+    auto& slot = slots_[seq & (CAPACITY - 1)];
+    if (!slot.isPending || slot.seq != seq)
+    {
+        return std::nullopt;
+    }
+    slot.isPending = false;
+    --size_;
+    return slot.sentAt;
+}
+
+
+void InFlightTable::clear()
+{
+    for (auto& slot : slots_)
+    {
+        slot.isPending = false;
+    }
+    size_ = 0;
+}
+
+
+size_t InFlightTable::size() const
+{
+    return size_;
+}
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
@@ -0,0 +1,78 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+// How often pending commands are checked against the ack timeout, as a fraction of it. Shared by
+// the single device link and the fleet, so both report a timeout equally late.
+constexpr int ACK_TIMEOUT_SWEEPS_PER_TIMEOUT = 4;
+
+
+/**
+ * Send timestamps of commands awaiting an ack, keyed by sequence number.
+ * Slots are indexed by seq modulo CAPACITY so insert and complete are O(1)
+ * and never allocate. Acks may complete in any order; acks for unknown,
+ * expired or already completed sequence numbers are rejected.
+ */
+class InFlightTable
+{
+   public:
+    using time_point = std::chrono::steady_clock::time_point;
+    static constexpr size_t CAPACITY = 1024;
+
+    InFlightTable();
+
+    /**
+     * Returns the sequence number of a still pending command that had to be
+     * evicted because it shared the slot, which the caller should treat as
+     * timed out. Only happens when more than CAPACITY commands are pending.
+     */
+    std::optional<uint32_t> insert(uint32_t seq, time_point sentAt);
+
+    // Removes seq and returns its send time, nullopt if it isn't pending.
+    std::optional<time_point> complete(uint32_t seq);
+
+    // Removes every command sent before deadline, calling onExpired(seq) for each.
+    template <typename F>
+    size_t expireSentBefore(time_point deadline, F&& onExpired)
+    {
+        size_t numExpired = 0;
+        for (auto& slot : slots_)
+        {
+            if (slot.isPending && slot.sentAt < deadline)
+            {
+                slot.isPending = false;
+                --size_;
+                ++numExpired;
+                onExpired(slot.seq);
+            }
+        }
+        return numExpired;
+    }
+
+    void clear();
+    size_t size() const;
+
+   private:
+    struct Slot
+    {
+        uint32_t seq = 0;
+        bool isPending = false;
+        time_point sentAt{};
+    };
+
+    std::array<Slot, CAPACITY> slots_;
+    size_t size_;
+};
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
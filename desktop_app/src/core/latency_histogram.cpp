@@ -0,0 +1,304 @@
+#include "latency_histogram.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+static unsigned mostSignificantBit(uint64_t v)
+{
+    return 63u - static_cast<unsigned>(__builtin_clzll(v));
+}
+
+
+LatencyHistogram::LatencyHistogram()
+    : counts_(NUM_BUCKETS, 0),
+      totalCount_{0},
+      min_{std::numeric_limits<uint64_t>::max()},
+      max_{0},
+      sum_{0.0}
+{
+}
+
+
+// Log-linear bucket math shared by both histograms, see LatencyHistogram.
+static size_t logLinearIndex(uint64_t valueUs, unsigned subBucketBits)
+{
+    const uint64_t subBucketCount = uint64_t{1} << subBucketBits;
+    const uint64_t subBucketHalf = subBucketCount / 2;
+    if (valueUs < subBucketCount)
+    {
+        return static_cast<size_t>(valueUs);
+    }
+    // Shift so the value keeps subBucketBits significant bits, top bit set.
+    const unsigned shift = mostSignificantBit(valueUs) - (subBucketBits - 1);
+    const uint64_t subBucket = valueUs >> shift;  // in [subBucketHalf, subBucketCount)
+    return static_cast<size_t>(
+        subBucketCount + (shift - 1) * subBucketHalf + (subBucket - subBucketHalf));
+}
+
+
+static uint64_t logLinearLowerBound(size_t index, unsigned subBucketBits)
+{
+    const uint64_t subBucketCount = uint64_t{1} << subBucketBits;
+    const uint64_t subBucketHalf = subBucketCount / 2;
+    if (index < subBucketCount)
+    {
+        return index;
+    }
+    const uint64_t rel = index - subBucketCount;
+    const uint64_t shift = rel / subBucketHalf + 1;
+    const uint64_t subBucket = rel % subBucketHalf + subBucketHalf;
+    return subBucket << shift;
+}
+
+
+static uint64_t logLinearUpperBound(size_t index, unsigned subBucketBits)
+{
+    const uint64_t subBucketCount = uint64_t{1} << subBucketBits;
+    if (index < subBucketCount)
+    {
+        return index;
+    }
+    const uint64_t shift = (index - subBucketCount) / (subBucketCount / 2) + 1;
+    return logLinearLowerBound(index, subBucketBits) + (uint64_t{1} << shift) - 1;
+}
+
+
+// Nearest rank, reported as the highest value equivalent to the rank's bucket.
+template <typename Counts>
+static uint64_t logLinearPercentile(const Counts& counts, unsigned subBucketBits,
+    uint64_t totalCount, uint64_t min, uint64_t max, double percentile)
+{
+    if (totalCount == 0)
+    {
+        return 0;
+    }
+    percentile = std::clamp(percentile, 0.0, 100.0);
+    auto rank = static_cast<uint64_t>(std::ceil(percentile / 100.0 * static_cast<double>(totalCount)));
+    rank = std::clamp(rank, uint64_t{1}, totalCount);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); ++i)
+    {
+        seen += counts[i];
+        if (seen >= rank)
+        {
+            return std::clamp(logLinearUpperBound(i, subBucketBits), min, max);
+        }
+    }
+    return max;
+}
+
+
+size_t LatencyHistogram::bucketIndex(uint64_t valueUs)
+{
+    return logLinearIndex(std::min(valueUs, MAX_TRACKABLE_US), SUB_BUCKET_BITS);
+}
+
+
+uint64_t LatencyHistogram::bucketLowerBound(size_t index)
+{
+    return logLinearLowerBound(index, SUB_BUCKET_BITS);
+}
+
+
+uint64_t LatencyHistogram::bucketUpperBound(size_t index)
+{
+    return logLinearUpperBound(index, SUB_BUCKET_BITS);
+}
+
+
+void LatencyHistogram::record(uint64_t valueUs)
+{
+    recordCount(valueUs, 1);
+}
+
+
+void LatencyHistogram::record(std::chrono::duration<double, std::milli> latency)
+{
+    const double us = std::max(0.0, latency.count() * 1000.0);
+    record(static_cast<uint64_t>(std::llround(std::min(us, static_cast<double>(MAX_TRACKABLE_US)))));
+}
+
+
+void LatencyHistogram::recordCount(uint64_t valueUs, uint64_t count)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    valueUs = std::min(valueUs, MAX_TRACKABLE_US);
+    counts_[bucketIndex(valueUs)] += count;
+    totalCount_ += count;
+    min_ = std::min(min_, valueUs);
+    max_ = std::max(max_, valueUs);
+    sum_ += static_cast<double>(valueUs) * static_cast<double>(count);
+}
+
+
+void LatencyHistogram::merge(const LatencyHistogram& other)
+{
+    if (other.totalCount_ == 0)
+    {
+        return;
+    }
+    for (size_t i = 0; i < NUM_BUCKETS; ++i)
+    {
+        counts_[i] += other.counts_[i];
+    }
+    totalCount_ += other.totalCount_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+    sum_ += other.sum_;
+}
+
+
+void LatencyHistogram::reset()
+{
+    std::fill(counts_.begin(), counts_.end(), 0);
+    totalCount_ = 0;
+    min_ = std::numeric_limits<uint64_t>::max();
+    max_ = 0;
+    sum_ = 0.0;
+}
+
+
+uint64_t LatencyHistogram::count() const
+{
+    return totalCount_;
+}
+
+
+uint64_t LatencyHistogram::min() const
+{
+    return totalCount_ == 0 ? 0 : min_;
+}
+
+
+uint64_t LatencyHistogram::max() const
+{
+    return max_;
+}
+
+
+double LatencyHistogram::mean() const
+{
+    return totalCount_ == 0 ? 0.0 : sum_ / static_cast<double>(totalCount_);
+}
+
+
+uint64_t LatencyHistogram::valueAtPercentile(double percentile) const
+{
+    return logLinearPercentile(counts_, SUB_BUCKET_BITS, totalCount_, min(), max_, percentile);
+}
+
+
+uint64_t LatencyHistogram::countAtIndex(size_t index) const
+{
+    return counts_[index];
+}
+
+
+CompactLatencyHistogram::CompactLatencyHistogram()
+    : counts_{},
+      totalCount_{0},
+      min_{std::numeric_limits<uint32_t>::max()},
+      max_{0},
+      sum_{0}
+{
+}
+
+
+void CompactLatencyHistogram::record(uint64_t valueUs)
+{
+    auto value = static_cast<uint32_t>(std::min(valueUs, MAX_TRACKABLE_US));
+    ++counts_[bucketIndex(value)];
+    ++totalCount_;
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+    sum_ += value;
+}
+
+
+uint64_t CompactLatencyHistogram::count() const
+{
+    return totalCount_;
+}
+
+
+uint64_t CompactLatencyHistogram::min() const
+{
+    return totalCount_ == 0 ? 0 : min_;
+}
+
+
+uint64_t CompactLatencyHistogram::max() const
+{
+    return max_;
+}
+
+
+double CompactLatencyHistogram::mean() const
+{
+    return totalCount_ == 0 ? 0.0 : static_cast<double>(sum_) / static_cast<double>(totalCount_);
+}
+
+
+uint64_t CompactLatencyHistogram::valueAtPercentile(double percentile) const
+{
+    return logLinearPercentile(counts_, SUB_BUCKET_BITS, totalCount_, min(), max_, percentile);
+}
+
+
+size_t CompactLatencyHistogram::bucketIndex(uint64_t valueUs)
+{
+    return logLinearIndex(std::min(valueUs, MAX_TRACKABLE_US), SUB_BUCKET_BITS);
+}
+
+
+uint64_t CompactLatencyHistogram::bucketUpperBound(size_t index)
+{
+    return logLinearUpperBound(index, SUB_BUCKET_BITS);
+}
+
+
+template <typename Histogram>
+static LatencySummary summarize(const Histogram& hist)
+{
+    constexpr double US_PER_MS = 1000.0;
+    LatencySummary summary{};
+    summary.count = hist.count();
+    if (summary.count == 0)
+    {
+        return summary;
+    }
+    summary.minMs = static_cast<double>(hist.min()) / US_PER_MS;
+    summary.meanMs = hist.mean() / US_PER_MS;
+    summary.p50Ms = static_cast<double>(hist.valueAtPercentile(50.0)) / US_PER_MS;
+    summary.p90Ms = static_cast<double>(hist.valueAtPercentile(90.0)) / US_PER_MS;
+    summary.p99Ms = static_cast<double>(hist.valueAtPercentile(99.0)) / US_PER_MS;
+    summary.p999Ms = static_cast<double>(hist.valueAtPercentile(99.9)) / US_PER_MS;
+    summary.maxMs = static_cast<double>(hist.max()) / US_PER_MS;
+    return summary;
+}
+
+
+LatencySummary summarizeHistogram(const LatencyHistogram& hist)
+{
+    return summarize(hist);
+}
+
+
+LatencySummary summarizeHistogram(const CompactLatencyHistogram& hist)
+{
+    return summarize(hist);
+}
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
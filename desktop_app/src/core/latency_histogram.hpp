@@ -0,0 +1,122 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+/**
+ * Fixed-memory log-linear latency histogram in the spirit of HdrHistogram.
+ * Values are microseconds. Values below 2^SUB_BUCKET_BITS are counted
+ * exactly, larger ones land in one of SUB_BUCKET_HALF linear sub-buckets per
+ * power of two, so any reported value is within 1/SUB_BUCKET_HALF of the
+ * recorded one. Counters are allocated once in the constructor; record() is
+ * O(1) and never allocates.
+ */
+class LatencyHistogram
+{
+   public:
+    static constexpr unsigned SUB_BUCKET_BITS = 8;
+    static constexpr uint64_t SUB_BUCKET_COUNT = uint64_t{1} << SUB_BUCKET_BITS;
+    static constexpr uint64_t SUB_BUCKET_HALF = SUB_BUCKET_COUNT / 2;
+    static constexpr unsigned MAX_VALUE_BITS = 36;  // ~19 hours in us
+    static constexpr uint64_t MAX_TRACKABLE_US = (uint64_t{1} << MAX_VALUE_BITS) - 1;
+    static constexpr size_t NUM_BUCKETS =
+        SUB_BUCKET_COUNT + (MAX_VALUE_BITS - SUB_BUCKET_BITS) * SUB_BUCKET_HALF;
+
+    LatencyHistogram();
+
+    // Values above MAX_TRACKABLE_US are clamped.
+    void record(uint64_t valueUs);
+    void record(std::chrono::duration<double, std::milli> latency);
+    void recordCount(uint64_t valueUs, uint64_t count);
+
+    void merge(const LatencyHistogram& other);
+    void reset();
+
+    uint64_t count() const;
+    uint64_t min() const;
+    uint64_t max() const;
+    double mean() const;
+
+    // Highest value equivalent to the bucket holding the p-th percentile (0-100].
+    uint64_t valueAtPercentile(double percentile) const;
+
+    static size_t bucketIndex(uint64_t valueUs);
+    static uint64_t bucketLowerBound(size_t index);
+    static uint64_t bucketUpperBound(size_t index);
+    uint64_t countAtIndex(size_t index) const;
+
+   private:
+    std::vector<uint64_t> counts_;
+    uint64_t totalCount_;
+    uint64_t min_;
+    uint64_t max_;
+    double sum_;
+};
+
+
+/**
+ * Coarser LatencyHistogram for per-device stats of large fleets: 8 linear
+ * sub-buckets per power of two (reported values within 1/8 of the recorded
+ * ones), 32 bit counters and values up to ~71 minutes, in ~1 KB inline.
+ */
+class CompactLatencyHistogram
+{
+   public:
+    static constexpr unsigned SUB_BUCKET_BITS = 4;
+    static constexpr uint64_t SUB_BUCKET_COUNT = uint64_t{1} << SUB_BUCKET_BITS;
+    static constexpr uint64_t SUB_BUCKET_HALF = SUB_BUCKET_COUNT / 2;
+    static constexpr unsigned MAX_VALUE_BITS = 32;
+    static constexpr uint64_t MAX_TRACKABLE_US = (uint64_t{1} << MAX_VALUE_BITS) - 1;
+    static constexpr size_t NUM_BUCKETS =
+        SUB_BUCKET_COUNT + (MAX_VALUE_BITS - SUB_BUCKET_BITS) * SUB_BUCKET_HALF;
+
+    CompactLatencyHistogram();
+
+    // Values above MAX_TRACKABLE_US are clamped.
+    void record(uint64_t valueUs);
+
+    uint64_t count() const;
+    uint64_t min() const;
+    uint64_t max() const;
+    double mean() const;
+    uint64_t valueAtPercentile(double percentile) const;
+
+    static size_t bucketIndex(uint64_t valueUs);
+    static uint64_t bucketUpperBound(size_t index);
+
+   private:
+    std::array<uint32_t, NUM_BUCKETS> counts_;
+    uint32_t totalCount_;
+    uint32_t min_;
+    uint32_t max_;
+    uint64_t sum_;
+};
+
+
+struct LatencySummary
+{
+    size_t count = 0;
+    double minMs = 0.0;
+    double meanMs = 0.0;
+    double p50Ms = 0.0;
+    double p90Ms = 0.0;
+    double p99Ms = 0.0;
+    double p999Ms = 0.0;
+    double maxMs = 0.0;
+};
+
+
+LatencySummary summarizeHistogram(const LatencyHistogram& hist);
+LatencySummary summarizeHistogram(const CompactLatencyHistogram& hist);
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
@@ -0,0 +1,198 @@
+#include "latency_plot.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+RecentLatencies::RecentLatencies(size_t capacity)
+    : capacity_{std::max<size_t>(capacity, 1)},
+      next_{0}
+{
+    samples_.reserve(capacity_);
+}
+
+
+void RecentLatencies::record(float valueMs)
+{
+    if (samples_.size() < capacity_)
+    {
+        samples_.push_back(valueMs);
+        return;
+    }
+    samples_[next_] = valueMs;
+    next_ = (next_ + 1) % capacity_;
+}
+
+
+void RecentLatencies::reset()
+{
+    samples_.clear();
+    next_ = 0;
+}
+
+
+const float* RecentLatencies::data() const
+{
+    return samples_.data();
+}
+
+
+size_t RecentLatencies::size() const
+{
+    return samples_.size();
+}
+
+
+size_t RecentLatencies::offset() const
+{
+    return next_;
+}
+
+
+float RecentLatencies::max() const
+{
+    return samples_.empty() ? 0.0f : *std::max_element(samples_.begin(), samples_.end());
+}
+
+
+DecimatedLatencies::DecimatedLatencies(size_t capacity)
+    : capacity_{std::max<size_t>(capacity + capacity % 2, 2)},
+      samplesPerPoint_{1},
+      numInLastPoint_{0},
+      numSamples_{0}
+{
+    points_.reserve(capacity_);
+}
+
+
+void DecimatedLatencies::record(float valueMs)
+{
+    ++numSamples_;
+    if (!points_.empty() && numInLastPoint_ < samplesPerPoint_)
+    {
+        auto& last = points_.back();
+        last.minMs = std::min(last.minMs, valueMs);
+        last.maxMs = std::max(last.maxMs, valueMs);
+        ++numInLastPoint_;
+        return;
+    }
+    if (points_.size() == capacity_)
+    {
+        mergePairs();
+    }
+    points_.push_back(MinMaxPoint{valueMs, valueMs});
+    numInLastPoint_ = 1;
+}
+
+
+// Only called with every point full, so the merged ones are full again.
+void DecimatedLatencies::mergePairs()
+{
+    for (size_t i = 0; i < points_.size() / 2; ++i)
+    {
+        const auto& a = points_[2 * i];
+        const auto& b = points_[2 * i + 1];
+        points_[i] = MinMaxPoint{std::min(a.minMs, b.minMs), std::max(a.maxMs, b.maxMs)};
+    }
+    points_.resize(points_.size() / 2);
+    samplesPerPoint_ *= 2;
+    numInLastPoint_ = samplesPerPoint_;
+}
+
+
+void DecimatedLatencies::reset()
+{
+    points_.clear();
+    samplesPerPoint_ = 1;
+    numInLastPoint_ = 0;
+    numSamples_ = 0;
+}
+
+
+size_t DecimatedLatencies::size() const
+{
+    return points_.size();
+}
+
+
+size_t DecimatedLatencies::samplesPerPoint() const
+{
+    return samplesPerPoint_;
+}
+
+
+uint64_t DecimatedLatencies::numSamples() const
+{
+    return numSamples_;
+}
+
+
+const MinMaxPoint& DecimatedLatencies::operator[](size_t i) const
+{
+    return points_[i];
+}
+
+
+void DecimatedLatencies::decimate(size_t numColumns, std::vector<MinMaxPoint>& out) const
+{
+    out.clear();
+    if (numColumns == 0 || points_.size() <= numColumns)
+    {
+        out.assign(points_.begin(), points_.end());
+        return;
+    }
+    for (size_t column = 0; column < numColumns; ++column)
+    {
+        size_t begin = column * points_.size() / numColumns;
+        size_t end = (column + 1) * points_.size() / numColumns;
+        MinMaxPoint merged = points_[begin];
+        for (size_t i = begin + 1; i < end; ++i)
+        {
+            merged.minMs = std::min(merged.minMs, points_[i].minMs);
+            merged.maxMs = std::max(merged.maxMs, points_[i].maxMs);
+        }
+        out.push_back(merged);
+    }
+}
+
+
+void binHistogram(const LatencyHistogram& hist, size_t numBins, LatencyBins& out)
+{
+    out.counts.assign(numBins, 0.0f);
+    out.lowMs = 0.0;
+    out.highMs = 0.0;
+    if (hist.count() == 0 || numBins == 0)
+    {
+        return;
+    }
+    // Bin edges in us, log-spaced, so a long tail doesn't squash the body into one bin.
+    double low = static_cast<double>(std::max<uint64_t>(hist.min(), 1));
+    double high = std::max(static_cast<double>(hist.max()) + 1.0, low + 1.0);
+    double logSpan = std::log(high / low);
+    out.lowMs = low / 1e3;
+    out.highMs = high / 1e3;
+
+    size_t lastIndex = LatencyHistogram::bucketIndex(hist.max());
+    for (size_t i = LatencyHistogram::bucketIndex(hist.min()); i <= lastIndex; ++i)
+    {
+        uint64_t count = hist.countAtIndex(i);
+        if (count == 0)
+        {
+            continue;
+        }
+        double mid = 0.5 * static_cast<double>(LatencyHistogram::bucketLowerBound(i) +
+                                               LatencyHistogram::bucketUpperBound(i));
+        mid = std::clamp(mid, low, high);
+        auto bin = static_cast<size_t>(std::log(mid / low) / logSpan * static_cast<double>(numBins));
+        out.counts[std::min(bin, numBins - 1)] += static_cast<float>(count);
+    }
+}
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
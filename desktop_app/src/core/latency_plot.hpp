@@ -0,0 +1,96 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "latency_histogram.hpp"
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+/**
+ * The most recent round trips in ms, overwriting the oldest once full.
+ * Laid out for ImGui::PlotLines: pass data(), size() and offset().
+ */
+class RecentLatencies
+{
+   public:
+    explicit RecentLatencies(size_t capacity);
+
+    void record(float valueMs);
+    void reset();
+
+    const float* data() const;
+    size_t size() const;
+    size_t offset() const;  // index of the oldest sample
+    float max() const;      // over the retained samples, O(size)
+
+   private:
+    std::vector<float> samples_;
+    size_t capacity_;
+    size_t next_;
+};
+
+
+struct MinMaxPoint
+{
+    float minMs = 0.0f;
+    float maxMs = 0.0f;
+};
+
+
+/**
+ * Every round trip of a run as at most capacity min/max points. Each point
+ * covers samplesPerPoint() consecutive samples; when the points run out,
+ * neighbours are merged pairwise and samplesPerPoint doubles. Memory and
+ * the cost of drawing stay fixed however long the run is, while spikes
+ * survive every merge. record() is O(1) amortized.
+ */
+class DecimatedLatencies
+{
+   public:
+    explicit DecimatedLatencies(size_t capacity);  // rounded up to even
+
+    void record(float valueMs);
+    void reset();
+
+    size_t size() const;
+    size_t samplesPerPoint() const;
+    uint64_t numSamples() const;
+    const MinMaxPoint& operator[](size_t i) const;
+
+    // Reduces the points to at most numColumns, e.g. one per pixel, in O(size).
+    void decimate(size_t numColumns, std::vector<MinMaxPoint>& out) const;
+
+   private:
+    void mergePairs();
+
+    std::vector<MinMaxPoint> points_;
+    size_t capacity_;
+    size_t samplesPerPoint_;
+    size_t numInLastPoint_;
+    uint64_t numSamples_;
+};
+
+
+struct LatencyBins
+{
+    std::vector<float> counts;
+    double lowMs = 0.0;   // lower edge of the first bin
+    double highMs = 0.0;  // upper edge of the last bin
+};
+
+
+/**
+ * Regroups the histogram into numBins log-spaced bins from its min to its
+ * max, for ImGui::PlotHistogram. The cost is bounded by the histogram's
+ * bucket count, not by how many values it holds.
+ */
+void binHistogram(const LatencyHistogram& hist, size_t numBins, LatencyBins& out);
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
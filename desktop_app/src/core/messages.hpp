@@ -0,0 +1,176 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+/**
+ * Binary frames shared with the esp32 firmware, all fields little-endian.
+ *
+ *   offset  size  field
+ *   0       2     length of the whole frame, header included
+ *   2       1     MsgType
+ *   3       1     FRAME_VERSION
+ *   4       4     sequence number, acks echo the command's
+ *   8       8     sender's clock at send in microseconds
+ *   16      ...   payload, length - 16 bytes
+ *
+ * The same bytes go over tcp as a stream and as one udp datagram per frame.
+ * A binary websocket message holds one or more whole frames back to back,
+ * the desktop gathers up to MAX_FRAMES_PER_WRITE queued ones into one, so
+ * a receiver must split messages with a FrameParser. The device replies
+ * with one message per frame.
+ */
+enum class MsgType : uint8_t
+{
+    COMMAND = 1,
+    ACK = 2,
+    HELLO = 3,  // udp only, announces the device's address
+    SYNC_REQUEST = 4,  // clock probe, sendTimeUs is the desktop's send time
+    SYNC_REPLY = 5,
+};
+
+
+constexpr uint8_t FRAME_VERSION = 1;
+constexpr size_t FRAME_HEADER_SIZE = 16;
+constexpr size_t MAX_FRAME_SIZE = 512;
+constexpr size_t MAX_PAYLOAD_SIZE = MAX_FRAME_SIZE - FRAME_HEADER_SIZE;
+
+
+struct FrameHeader
+{
+    uint16_t length = 0;
+    MsgType type = MsgType::COMMAND;
+    uint32_t seq = 0;
+    uint64_t sendTimeUs = 0;
+};
+
+
+/**
+ * Writes header and payload to out, which must hold FRAME_HEADER_SIZE +
+ * payloadSize bytes. Returns the frame length, 0 if the payload is too big.
+ */
+size_t encodeFrame(MsgType type, uint32_t seq, uint64_t sendTimeUs, const uint8_t* payload,
+    size_t payloadSize, uint8_t* out);
+
+// Reads FRAME_HEADER_SIZE bytes, nullopt when the version, type or length is invalid.
+std::optional<FrameHeader> decodeHeader(const uint8_t* data);
+
+/**
+ * Acks echo the command's seq, stamp sendTimeUs with the device's clock when
+ * the ack is sent, and carry the device's clock when the command arrived as
+ * an 8 byte payload. Older devices send acks without the payload.
+ */
+constexpr size_t ACK_PAYLOAD_SIZE = 8;
+constexpr size_t ACK_FRAME_SIZE = FRAME_HEADER_SIZE + ACK_PAYLOAD_SIZE;
+
+size_t encodeAck(uint32_t seq, uint64_t deviceReceivedUs, uint64_t deviceSentUs, uint8_t* out);
+std::optional<uint64_t> decodeAckReceivedUs(const FrameHeader& header, const uint8_t* payload);
+
+
+/**
+ * Sync replies echo the request's seq and sendTimeUs, and add the device's
+ * clock when the request arrived. Their own sendTimeUs is the device's clock
+ * at reply send.
+ */
+constexpr size_t SYNC_REPLY_PAYLOAD_SIZE = 16;
+constexpr size_t SYNC_REPLY_FRAME_SIZE = FRAME_HEADER_SIZE + SYNC_REPLY_PAYLOAD_SIZE;
+
+
+struct SyncReplyTimes
+{
+    uint64_t desktopSentUs;
+    uint64_t deviceReceivedUs;
+};
+
+
+size_t encodeSyncReply(uint32_t seq, uint64_t desktopSentUs, uint64_t deviceReceivedUs,
+    uint64_t deviceSentUs, uint8_t* out);
+std::optional<SyncReplyTimes> decodeSyncReply(const FrameHeader& header, const uint8_t* payload);
+
+
+/**
+ * Splits a byte stream into frames. Frames that arrive whole are handed out
+ * straight from the caller's buffer; only a frame split across reads is
+ * copied, into a buffer of MAX_FRAME_SIZE.
+ */
+class FrameParser
+{
+   public:
+    FrameParser();
+
+    /**
+     * Calls onFrame(const FrameHeader&, const uint8_t* payload) for every
+     * complete frame in data. Returns false on an invalid header, after
+     * which the stream can't be resynchronized and the parser is reset.
+     */
+    template <typename F>
+    bool feed(const uint8_t* data, size_t size, F&& onFrame)
+    {
+        while (size > 0)
+        {
+            if (pendingSize_ == 0 && size >= FRAME_HEADER_SIZE)
+            {
+                auto header = decodeHeader(data);
+                if (!header)
+                {
+                    reset();
+                    return false;
+                }
+                if (size >= header->length)
+                {
+                    onFrame(*header, data + FRAME_HEADER_SIZE);
+                    data += header->length;
+                    size -= header->length;
+                    continue;
+                }
+            }
+
+            // Split frame, gather the header first and then the rest of it.
+            bool hasHeader = pendingSize_ >= FRAME_HEADER_SIZE;
+            size_t wanted = hasHeader ? pendingHeader_.length : FRAME_HEADER_SIZE;
+            size_t numCopied = std::min(wanted - pendingSize_, size);
+            std::memcpy(pending_.data() + pendingSize_, data, numCopied);
+            pendingSize_ += numCopied;
+            data += numCopied;
+            size -= numCopied;
+            if (!hasHeader && pendingSize_ == FRAME_HEADER_SIZE)
+            {
+                auto header = decodeHeader(pending_.data());
+                if (!header)
+                {
+                    reset();
+                    return false;
+                }
+                pendingHeader_ = *header;
+            }
+            if (pendingSize_ >= FRAME_HEADER_SIZE && pendingSize_ == pendingHeader_.length)
+            {
+                onFrame(pendingHeader_, pending_.data() + FRAME_HEADER_SIZE);
+                pendingSize_ = 0;
+            }
+        }
+        return true;
+    }
+
+    // True while part of a frame is buffered, for udp that means a truncated datagram.
+    bool hasPartialFrame() const;
+    void reset();
+
+   private:
+    std::array<uint8_t, MAX_FRAME_SIZE> pending_;
+    size_t pendingSize_;
+    FrameHeader pendingHeader_;
+};
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
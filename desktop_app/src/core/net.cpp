@@ -0,0 +1,991 @@
+#include "net.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <string_view>
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+namespace http = beast::http;
+
+
+// Often enough for the fastest quarter of the window to hold uncongested exchanges.
+constexpr std::chrono::milliseconds CLOCK_PROBE_INTERVAL{200};
+
+
+NetState::NetState(asio::io_context& ioc, ConnectionType connType, bool verbose)
+    : ioc{ioc},
+      isWakePending{false},
+      connType{connType},
+      verbose{verbose},
+      connId{0},
+      tcpReadBuf{},
+      tcpIoBackend{TcpIoBackend::REACTOR},
+      udpReadBuf{},
+      shmName{DEFAULT_SHM_NAME},
+      shmWaitMode{ShmWaitMode::FUTEX},
+      shmReadBuf{},
+      nextSeq{0},
+      nextSeqToWrite{0},
+      isWriting{false},
+      writeBuf{},
+      ackTimeoutTimer{ioc},
+      ackTimeout{std::chrono::seconds(1)},
+      clockProbeTimer{ioc},
+      clockProbeInterval{CLOCK_PROBE_INTERVAL},
+      nextProbeSeq{0},
+      isProbePending{false},
+      numWrites{0},
+      numFramesWritten{0},
+      numBytesWritten{0},
+      numDroppedIOEvents{0},
+      numTimedOut{0},
+      numUnmatchedAcks{0},
+      numMalformedMsgs{0}
+{
+}
+
+
+static IOEvent makeIOEvent(IOEventType type, uint32_t seq, chrono_time_point completedAt,
+    uint32_t numBytes = 0)
+{
+    IOEvent e{};
+    e.completedAt = completedAt;
+    e.seq = seq;
+    e.numBytes = numBytes;
+    e.type = type;
+    return e;
+}
+
+
+static ResultRecord makeResultRecord(const IOEvent& e)
+{
+    ResultRecord r{};
+    r.ackReadNs = steadyClockNs(e.completedAt);
+    r.latencyUs = e.latency.count();
+    r.uplinkUs = e.uplink.count();
+    r.deviceTurnaroundUs = e.deviceTurnaround.count();
+    r.seq = e.seq;
+    r.numBytes = e.numBytes;
+    r.connId = e.connId;
+    r.type = static_cast<uint8_t>(e.type);
+    r.flags = e.hasOneWay ? RESULT_HAS_ONE_WAY : 0;
+    return r;
+}
+
+
+// Coalesced, so a burst of events costs the consumer one wakeup.
+static void notifyConsumer(NetState& s)
+{
+    if (s.wakeConsumer && !s.isWakePending.exchange(true, std::memory_order_acq_rel))
+    {
+        s.wakeConsumer();
+    }
+}
+
+
+static void pushIOEvent(NetState& s, IOEvent e)
+{
+    e.connId = s.connId;
+    // Logged before the ring, so the log has every event even when the consumer falls behind.
+    if (s.results)
+    {
+        s.results->record(makeResultRecord(e));
+    }
+    // Only counted, logging here would slow the network thread down just as the consumer falls behind.
+    if (!s.ioEvents.tryPush(e))
+    {
+        ++s.numDroppedIOEvents;
+    }
+    notifyConsumer(s);
+}
+
+
+static void pushConnectionEvent(NetState& s, ConnectionEventType type, std::string peer = {})
+{
+    ConnectionEvent e{};
+    e.type = type;
+    e.connType = s.connType;
+    e.connId = s.connId;
+    e.at = std::chrono::steady_clock::now();
+    e.peer = std::move(peer);
+    if (s.clock)
+    {
+        e.clock = *s.clock;
+    }
+    // A dropped clock update is superseded by the next probe's.
+    if (!s.connEvents.tryPush(std::move(e)) && type != ConnectionEventType::CLOCK_UPDATED)
+    {
+        std::cerr << "connection event queue full" << std::endl;
+    }
+    notifyConsumer(s);
+}
+
+
+// A read failed or the peer closed, nothing more will arrive on this connection.
+static void pushDisconnected(NetState& s, const boost::system::error_code& ec)
+{
+    if (ec == asio::error::operation_aborted)
+    {
+        return;  // closed by us, the owner is tearing down
+    }
+    // Probing a device that's gone would only produce write errors.
+    s.clockProbeTimer.cancel();
+    pushConnectionEvent(s, ConnectionEventType::DISCONNECTED);
+}
+
+
+static std::string endpointString(const TcpSocket& sock)
+{
+    boost::system::error_code ec;
+    auto endpoint = sock.remote_endpoint(ec);
+    if (ec)
+    {
+        return "unknown";
+    }
+    return endpoint.address().to_string() + ":" + std::to_string(endpoint.port());
+}
+
+
+static void wsAsyncRead(NetState& s);
+static void tcpAsyncRead(NetState& s);
+static void udpAsyncRead(NetState& s);
+
+
+static void pushTimedOut(NetState& s, uint32_t seq)
+{
+    ++s.numTimedOut;
+    pushIOEvent(s, makeIOEvent(IOEventType::COMMAND_TIMED_OUT, seq, std::chrono::steady_clock::now()));
+}
+
+
+static void writeNextCommand(NetState& s);
+static void handleWritten(NetState& s, uint32_t firstSeq, uint32_t numCommands, uint32_t numFrames,
+    size_t numBytes, const boost::system::error_code& ec);
+
+
+// Sends a probe now and then every clockProbeInterval until the connection is closed.
+static void asyncProbeClock(NetState& s)
+{
+    s.isProbePending = true;
+    writeNextCommand(s);
+    s.clockProbeTimer.expires_after(s.clockProbeInterval);
+    s.clockProbeTimer.async_wait(
+        bindArena(s.handlerArena, [&s](boost::system::error_code ec)
+        {
+            if (!ec)
+            {
+                asyncProbeClock(s);
+            }
+        }));
+}
+
+
+// Each connection may be a different device, so its clock is estimated from scratch.
+static void startClockSync(NetState& s)
+{
+    s.clockSync.reset();
+    s.clock.reset();
+    asyncProbeClock(s);
+}
+
+
+static void asyncSweepTimedOutCommands(NetState& s)
+{
+    s.ackTimeoutTimer.expires_after(s.ackTimeout / ACK_TIMEOUT_SWEEPS_PER_TIMEOUT);
+    s.ackTimeoutTimer.async_wait(
+        bindArena(s.handlerArena, [&s](boost::system::error_code ec)
+        {
+            if (ec)
+            {
+                return;
+            }
+            auto deadline = std::chrono::steady_clock::now() - s.ackTimeout;
+            s.inFlight.expireSentBefore(deadline, [&s](uint32_t seq)
+                { pushTimedOut(s, seq); });
+            asyncSweepTimedOutCommands(s);
+        }));
+}
+
+
+void asyncWaitForTcpConnection(NetState& s)
+{
+    auto const address = asio::ip::make_address("0.0.0.0");
+    tcp::endpoint endpoint{address, CUSTOM_TCP_PORT};
+    s.acceptor = std::make_unique<tcp::acceptor>(s.ioc, endpoint);
+    std::cout << "async tcp accepting" << std::endl;
+    s.acceptor->async_accept(
+        s.ioc,
+        bindArena(s.handlerArena, [&s](boost::system::error_code ec, TcpSocket socket)
+        {
+            std::cout << "tcp async accept handler" << std::endl;
+            if (ec)
+            {
+                std::cerr << "accept failed: " << ec.message() << "\n";
+                return;
+            }
+            std::cout << "tcp client connected!" << std::endl;
+            s.acceptor->close();
+            if (!socket.is_open())
+            {
+                std::cout << "Socket not open" << std::endl;
+                pushConnectionEvent(s, ConnectionEventType::CANCELLED);
+                return;
+            }
+            applySocketProfile(socket.native_handle(), s.socketProfile);
+            s.tcpSock = std::make_unique<TcpSocket>(std::move(socket));
+            ++s.connId;
+            if (s.tcpIoBackend == TcpIoBackend::IO_URING)
+            {
+                s.uring = std::make_unique<UringLink>();
+                if (!s.uring->open(s.tcpSock->native_handle(), s.writeBuf.data(), s.writeBuf.size(),
+                        s.tcpReadBuf.data(), s.tcpReadBuf.size()))
+                {
+                    std::cerr << "falling back to epoll for tcp" << std::endl;
+                    s.uring.reset();
+                }
+            }
+            if (s.uring)
+            {
+                s.uring->queueRead();
+            }
+            else
+            {
+                tcpAsyncRead(s);
+            }
+            asyncSweepTimedOutCommands(s);
+            startClockSync(s);
+            pushConnectionEvent(s, ConnectionEventType::CONNECTED, endpointString(*s.tcpSock));
+            return;
+        }));
+    std::cout << "done async accepting" << std::endl;
+}
+
+
+void asyncWaitForWebsocketConnection(NetState& s)
+{
+    auto const address = asio::ip::make_address("0.0.0.0");
+    tcp::endpoint endpoint{address, WEB_SOCKET_PORT};
+    s.acceptor = std::make_unique<tcp::acceptor>(s.ioc, endpoint);
+    std::cout << "async websocket accepting" << std::endl;
+    s.acceptor->async_accept(
+        s.ioc,
+        bindArena(s.handlerArena, [&s](boost::system::error_code ec, TcpSocket socket)
+        {
+            std::cout << "Async accept handler" << std::endl;
+            if (ec)
+            {
+                std::cerr << "Accept failed: " << ec.message() << "\n";
+                return;
+            }
+            std::cout << "Client connected!" << std::endl;
+            s.acceptor->close();
+            if (!socket.is_open())
+            {
+                std::cout << "Socket not open" << std::endl;
+                pushConnectionEvent(s, ConnectionEventType::CANCELLED);
+                return;
+            }
+
+            applySocketProfile(socket.native_handle(), s.socketProfile);
+
+            // Construct the stream by moving in the socket
+            auto ws = std::make_unique<websocket::stream<TcpSocket>>(std::move(socket));
+
+            // Set a decorator to change the Server of the handshake
+            ws->set_option(websocket::stream_base::decorator(
+                [](websocket::response_type& res)
+                {
+                    res.set(http::field::server,
+                        std::string(BOOST_BEAST_VERSION_STRING) + " websocket-server-sync");
+                }));
+
+            // Accept the websocket handshake. This blocks the network thread, but should be fast
+            try
+            {
+                ws->accept();
+            }
+            catch (beast::system_error const& se)
+            {
+                std::cerr << "Error opening acceptor: " << se.code().message() << std::endl;
+                std::abort();
+            }
+            catch (std::exception const& e)
+            {
+                std::cerr << "Error with acceptor: " << e.what() << std::endl;
+                std::abort();
+            }
+            ws->binary(true);
+            s.ws = std::move(ws);
+            ++s.connId;
+            wsAsyncRead(s);
+            asyncSweepTimedOutCommands(s);
+            startClockSync(s);
+            pushConnectionEvent(s, ConnectionEventType::CONNECTED,
+                endpointString(beast::get_lowest_layer(*s.ws)));
+            return;
+        }));
+    std::cout << "done async accepting" << std::endl;
+}
+
+
+void asyncWaitForUdpConnection(NetState& s)
+{
+    auto const address = asio::ip::make_address("0.0.0.0");
+    s.udpSock = std::make_unique<UdpSocket>(s.ioc, udp::endpoint{address, UDP_PORT});
+    applySocketProfile(s.udpSock->native_handle(), s.socketProfile);
+    std::cout << "udp waiting for hello" << std::endl;
+    udpAsyncRead(s);
+}
+
+
+void asyncWaitForShmConnection(NetState& s)
+{
+    s.shmSegment = std::make_unique<ShmSegment>();
+    if (!s.shmSegment->create(s.shmName))
+    {
+        return;
+    }
+    // Posted from the watcher thread, the drain runs on ioc like any completion handler.
+    // Busy polling skips that hop, the thread running ioc polls the ring itself.
+    if (s.shmWaitMode == ShmWaitMode::FUTEX)
+    {
+        s.shmWatcher = std::make_unique<ShmRingWatcher>(s.shmSegment->layout().toDesktop, s.shmWaitMode,
+            [&s]() { asio::post(s.ioc, [&s]() { pollShm(s); }); });
+    }
+    std::cout << "shared memory " << s.shmName << " waiting for hello" << std::endl;
+}
+
+
+void asyncWaitForConnection(NetState& s)
+{
+    switch (s.connType)
+    {
+        case ConnectionType::WEB_SOCKET:
+        {
+            asyncWaitForWebsocketConnection(s);
+            break;
+        }
+        case ConnectionType::CUSTOM_TCP:
+        {
+            asyncWaitForTcpConnection(s);
+            break;
+        }
+        case ConnectionType::UDP:
+        {
+            asyncWaitForUdpConnection(s);
+            break;
+        }
+        case ConnectionType::SHARED_MEMORY:
+        {
+            asyncWaitForShmConnection(s);
+            break;
+        }
+    }
+}
+
+
+static uint64_t steadyClockUs(chrono_time_point t)
+{
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(t.time_since_epoch()).count());
+}
+
+
+// Writes a pending clock probe and the oldest queued commands, unless a write is already outstanding.
+static void writeNextCommand(NetState& s)
+{
+    if (s.isWriting || (!s.isProbePending && s.nextSeqToWrite == s.nextSeq))
+    {
+        return;
+    }
+    // Stamped right before the write, t1 of a probe's exchange.
+    uint64_t nowUs = steadyClockUs(std::chrono::steady_clock::now());
+    bool isStream = s.connType == ConnectionType::CUSTOM_TCP || s.connType == ConnectionType::WEB_SOCKET;
+    size_t maxFrames = isStream ? MAX_FRAMES_PER_WRITE : 1;
+    uint32_t numFrames = 0;
+    size_t length = 0;
+    if (s.isProbePending)
+    {
+        s.isProbePending = false;
+        length += encodeFrame(MsgType::SYNC_REQUEST, s.nextProbeSeq++, nowUs, nullptr, 0, s.writeBuf.data());
+        ++numFrames;
+    }
+    // Back to back in writeBuf, so the gathered frames go out in one contiguous write.
+    uint32_t firstSeq = s.nextSeqToWrite;
+    while (numFrames < maxFrames && s.nextSeqToWrite != s.nextSeq)
+    {
+        length += encodeFrame(MsgType::COMMAND, s.nextSeqToWrite++, nowUs, s.commandPayload.data(),
+            s.commandPayload.size(), s.writeBuf.data() + length);
+        ++numFrames;
+    }
+    uint32_t numCommands = s.nextSeqToWrite - firstSeq;
+    auto frames = asio::buffer(s.writeBuf.data(), length);
+    s.isWriting = true;
+
+    auto onWritten = bindArena(s.handlerArena,
+        [&s, firstSeq, numCommands, numFrames](boost::system::error_code ec, std::size_t bytesTransferred)
+        {
+            handleWritten(s, firstSeq, numCommands, numFrames, bytesTransferred, ec);
+        });
+
+    switch (s.connType)
+    {
+        case ConnectionType::WEB_SOCKET:
+        {
+            // One binary message, the device's parser splits it back into frames.
+            s.ws->async_write(frames, std::move(onWritten));
+            break;
+        }
+        case ConnectionType::CUSTOM_TCP:
+        {
+            if (s.uring)
+            {
+                // Submitted by the next pollUring, which completes it.
+                s.uring->queueWrite(length, (uint64_t{numFrames} << 48) | (uint64_t{numCommands} << 32) | firstSeq);
+                break;
+            }
+            asio::async_write(*s.tcpSock, frames, std::move(onWritten));
+            break;
+        }
+        case ConnectionType::UDP:
+        {
+            s.udpSock->async_send_to(frames, s.udpPeer, std::move(onWritten));
+            break;
+        }
+        case ConnectionType::SHARED_MEMORY:
+        {
+            // Done once it's on the ring, completed through ioc like the socket writes.
+            boost::system::error_code ec{};
+            if (!s.shmSegment->layout().toDevice.tryPush(s.writeBuf.data(), length))
+            {
+                ec = asio::error::no_buffer_space;
+            }
+            asio::post(s.ioc, beast::bind_front_handler(std::move(onWritten), ec, length));
+            break;
+        }
+    }
+}
+
+
+static void handleWritten(NetState& s, uint32_t firstSeq, uint32_t numCommands, uint32_t numFrames,
+    size_t numBytes, const boost::system::error_code& ec)
+{
+    s.isWriting = false;
+    if (ec)
+    {
+        std::cout << "Error writing command: " << ec.message() << std::endl;
+        return;
+    }
+    ++s.numWrites;
+    s.numFramesWritten += numFrames;
+    s.numBytesWritten += numBytes;
+    if (s.trace)
+    {
+        auto now = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < numCommands; ++i)
+        {
+            s.trace->record(TraceStage::NET_WRITTEN, firstSeq + i, now);
+        }
+    }
+    writeNextCommand(s);
+}
+
+
+void sendBlinkCommand(NetState& s)
+{
+    uint32_t seq = s.nextSeq++;
+    if (s.verbose)
+    {
+        std::cout << "sending blink command " << seq << std::endl;
+    }
+    // Stamped when queued, so time spent waiting behind earlier writes counts as latency.
+    auto now = std::chrono::steady_clock::now();
+    if (s.trace)
+    {
+        s.trace->record(TraceStage::NET_QUEUED, seq, now);
+    }
+    auto evicted = s.inFlight.insert(seq, now);
+    if (evicted)
+    {
+        pushTimedOut(s, *evicted);
+    }
+    writeNextCommand(s);
+}
+
+
+static void pushMalformed(NetState& s)
+{
+    ++s.numMalformedMsgs;
+    pushIOEvent(s, makeIOEvent(IOEventType::MALFORMED_MSG, 0, std::chrono::steady_clock::now()));
+}
+
+
+static void handleSyncReply(NetState& s, const FrameHeader& header, const uint8_t* payload)
+{
+    auto t4 = static_cast<int64_t>(steadyClockUs(std::chrono::steady_clock::now()));
+    auto times = decodeSyncReply(header, payload);
+    if (!times)
+    {
+        pushMalformed(s);
+        return;
+    }
+    ClockSample sample{static_cast<int64_t>(times->desktopSentUs),
+        static_cast<int64_t>(times->deviceReceivedUs), static_cast<int64_t>(header.sendTimeUs), t4};
+    if (s.clockSync.addSample(sample))
+    {
+        s.clock = s.clockSync.estimate();
+        pushConnectionEvent(s, ConnectionEventType::CLOCK_UPDATED);
+    }
+}
+
+
+static void handleAck(NetState& s, const FrameHeader& header, const uint8_t* payload)
+{
+    auto now = std::chrono::steady_clock::now();
+    if (s.verbose)
+    {
+        std::cout << "AckReceived " << header.seq << std::endl;
+    }
+    auto sentAt = s.inFlight.complete(header.seq);
+    if (!sentAt)
+    {
+        ++s.numUnmatchedAcks;
+        pushIOEvent(s, makeIOEvent(IOEventType::UNMATCHED_ACK, header.seq, now, header.length));
+        return;
+    }
+    auto receivedUs = decodeAckReceivedUs(header, payload);
+    if (s.trace)
+    {
+        s.trace->record(TraceStage::NET_ACK_READ, header.seq, now);
+        if (receivedUs)
+        {
+            s.trace->record(TraceStage::DEVICE_RECEIVED, header.seq, *receivedUs * 1000);
+            s.trace->record(TraceStage::DEVICE_ACK_SENT, header.seq, header.sendTimeUs * 1000);
+        }
+    }
+    auto e = makeIOEvent(IOEventType::ACK_RECEIVED, header.seq, now, header.length);
+    auto latency = std::chrono::duration_cast<std::chrono::microseconds>(now - *sentAt);
+    e.latency = std::chrono::duration<uint32_t, std::micro>(static_cast<uint32_t>(latency.count()));
+    if (s.clock && receivedUs && header.sendTimeUs >= *receivedUs)
+    {
+        auto sentAtUs = static_cast<int64_t>(steadyClockUs(*sentAt));
+        auto deviceReceivedAtUs = s.clock->deviceToDesktopUs(static_cast<int64_t>(*receivedUs));
+        e.uplink = std::chrono::duration<int32_t, std::micro>(
+            static_cast<int32_t>(deviceReceivedAtUs - sentAtUs));
+        e.deviceTurnaround = std::chrono::duration<uint32_t, std::micro>(
+            static_cast<uint32_t>(header.sendTimeUs - *receivedUs));
+        e.hasOneWay = true;
+    }
+    pushIOEvent(s, e);
+}
+
+
+static void handleFrame(NetState& s, const FrameHeader& header, const uint8_t* payload)
+{
+    switch (header.type)
+    {
+        case MsgType::ACK:
+        {
+            handleAck(s, header, payload);
+            break;
+        }
+        case MsgType::SYNC_REPLY:
+        {
+            handleSyncReply(s, header, payload);
+            break;
+        }
+        default:
+        {
+            pushMalformed(s);
+            break;
+        }
+    }
+}
+
+
+// Websocket messages and udp datagrams must hold whole frames, nothing may be left over.
+static void feedMessage(NetState& s, const uint8_t* data, size_t size)
+{
+    bool isValid = s.frameParser.feed(data, size, [&s](const FrameHeader& header, const uint8_t* payload)
+        { handleFrame(s, header, payload); });
+    if (!isValid || s.frameParser.hasPartialFrame())
+    {
+        s.frameParser.reset();
+        pushMalformed(s);
+    }
+}
+
+
+static void wsAsyncRead(NetState& s)
+{
+    s.ws->async_read(
+        s.wsReadBuffer,
+        bindArena(s.handlerArena, [&s](boost::system::error_code ec, std::size_t numBytes) mutable
+        {
+            if (ec == websocket::error::closed)
+            {
+                std::cout << "Websocket closed" << std::endl;
+                pushDisconnected(s, ec);
+                return;
+            }
+
+            if (ec)
+            {
+                std::cout << "ec received " << ec << std::endl;
+                pushDisconnected(s, ec);
+                return;
+            }
+            if (numBytes == 0)
+            {
+                return;
+            }
+            rearmQuickAck(beast::get_lowest_layer(*s.ws).native_handle(), s.socketProfile);
+            feedMessage(s, static_cast<const uint8_t*>(s.wsReadBuffer.data().data()),
+                s.wsReadBuffer.size());
+            s.wsReadBuffer.consume(s.wsReadBuffer.size());
+            wsAsyncRead(s);
+            return;
+        }));
+};
+
+
+static void closeTcpStream(NetState& s, const boost::system::error_code& reason)
+{
+    // The ring's reads and writes go first, they use the socket. Its write never completes now.
+    if (s.uring)
+    {
+        s.uring.reset();
+        s.isWriting = false;
+    }
+    boost::system::error_code ec;
+    s.tcpSock->close(ec);
+    pushDisconnected(s, reason);
+}
+
+
+// The stream can't be resynchronized after a bad header, so the device has to reconnect.
+static void dropCorruptTcpStream(NetState& s)
+{
+    std::cerr << "invalid frame header, can't resync the tcp stream" << std::endl;
+    pushMalformed(s);
+    closeTcpStream(s, boost::system::errc::make_error_code(boost::system::errc::protocol_error));
+}
+
+
+static void tcpAsyncRead(NetState& s)
+{
+    // Read whatever has arrived, the parser reassembles frames split across reads.
+    s.tcpSock->async_read_some(
+        asio::buffer(s.tcpReadBuf),
+        bindArena(s.handlerArena, [&s](const boost::system::error_code& ec, std::size_t bytesTransferred)
+        {
+            if (ec)
+            {
+                std::cout << "tcp received failed" << std::endl;
+                pushDisconnected(s, ec);
+                return;
+            }
+            rearmQuickAck(s.tcpSock->native_handle(), s.socketProfile);
+
+            bool isValid = s.frameParser.feed(s.tcpReadBuf.data(), bytesTransferred,
+                [&s](const FrameHeader& header, const uint8_t* payload)
+                { handleFrame(s, header, payload); });
+            if (!isValid)
+            {
+                dropCorruptTcpStream(s);
+                return;
+            }
+            tcpAsyncRead(s);
+        }));
+}
+
+
+// A rebooted or re-bound device says hello from a new port, its predecessor's commands will never be acked.
+static void detachUdpPeer(NetState& s)
+{
+    std::cout << "udp peer " << s.udpPeer << " replaced" << std::endl;
+    s.inFlight.expireSentBefore(chrono_time_point::max(), [&s](uint32_t seq)
+        { pushTimedOut(s, seq); });
+    // Those not written yet just timed out too, so they aren't sent to the new peer.
+    s.nextSeqToWrite = s.nextSeq;
+    pushConnectionEvent(s, ConnectionEventType::DISCONNECTED);
+}
+
+
+static void udpAsyncRead(NetState& s)
+{
+    s.udpSock->async_receive_from(
+        asio::buffer(s.udpReadBuf),
+        s.udpSender,
+        bindArena(s.handlerArena, [&s](const boost::system::error_code& ec, std::size_t numBytes)
+        {
+            if (ec)
+            {
+                std::cout << "udp receive failed: " << ec.message() << std::endl;
+                pushDisconnected(s, ec);
+                return;
+            }
+
+            bool isPeerKnown = s.udpPeer.port() != 0;
+            auto header = numBytes >= FRAME_HEADER_SIZE ? decodeHeader(s.udpReadBuf.data())
+                                                        : std::nullopt;
+            if (header && header->type == MsgType::HELLO)
+            {
+                // The device repeats its hello until the first command arrives, only a hello from
+                // another endpoint is a device (re)attaching.
+                if (s.udpSender != s.udpPeer)
+                {
+                    if (isPeerKnown)
+                    {
+                        detachUdpPeer(s);
+                    }
+                    std::cout << "udp peer " << s.udpSender << " said hello" << std::endl;
+                    s.udpPeer = s.udpSender;
+                    ++s.connId;
+                    asyncSweepTimedOutCommands(s);
+                    startClockSync(s);
+                    pushConnectionEvent(s, ConnectionEventType::CONNECTED,
+                        s.udpPeer.address().to_string() + ":" + std::to_string(s.udpPeer.port()));
+                }
+            }
+            else if (isPeerKnown && s.udpSender == s.udpPeer)
+            {
+                feedMessage(s, s.udpReadBuf.data(), numBytes);
+            }
+            udpAsyncRead(s);
+        }));
+}
+
+
+// A hello is a device (re)attaching, anything else goes through the frame handling.
+bool pollShm(NetState& s)
+{
+    if (!s.shmSegment || !s.shmSegment->isOpen())
+    {
+        return false;  // closed while the drain was queued
+    }
+    // Before popping, so a push from here on posts another drain.
+    if (s.shmWatcher)
+    {
+        s.shmWatcher->rearm();
+    }
+    auto& ring = s.shmSegment->layout().toDesktop;
+    bool hasFrames = false;
+    while (size_t numBytes = ring.tryPop(s.shmReadBuf.data()))
+    {
+        hasFrames = true;
+        auto header = numBytes >= FRAME_HEADER_SIZE ? decodeHeader(s.shmReadBuf.data()) : std::nullopt;
+        if (header && header->type == MsgType::HELLO)
+        {
+            std::cout << "shared memory device said hello" << std::endl;
+            // Restarting the timers cancels those of a previous device.
+            ++s.connId;
+            asyncSweepTimedOutCommands(s);
+            startClockSync(s);
+            pushConnectionEvent(s, ConnectionEventType::CONNECTED, s.shmName);
+            continue;
+        }
+        feedMessage(s, s.shmReadBuf.data(), numBytes);
+    }
+    return hasFrames;
+}
+
+
+bool pollUring(NetState& s, std::chrono::microseconds timeout)
+{
+    if (!s.uring)
+    {
+        return false;
+    }
+    // Nothing to do between a write and its ack unless another write is waiting behind it.
+    bool hasQueuedWrites = s.isProbePending || s.nextSeqToWrite != s.nextSeq;
+    UringCompletions completions{};
+    size_t numCompleted = s.uring->wait(timeout, !hasQueuedWrites, completions);
+    // Acted on once the whole batch is handled, so the writes completed alongside a failed read
+    // still reach handleWritten.
+    std::optional<boost::system::error_code> readError;
+    bool isCorrupt = false;
+    for (size_t i = 0; i < numCompleted; ++i)
+    {
+        const auto& c = completions[i];
+        boost::system::error_code ec{};
+        if (c.result < 0)
+        {
+            ec.assign(-c.result, boost::system::system_category());
+        }
+        if (c.op == UringOp::WRITE)
+        {
+            handleWritten(s, static_cast<uint32_t>(c.tag), static_cast<uint16_t>(c.tag >> 32),
+                static_cast<uint8_t>(c.tag >> 48), static_cast<size_t>(std::max(c.result, 0)), ec);
+            continue;
+        }
+        if (c.result <= 0)
+        {
+            std::cout << "tcp received failed" << std::endl;
+            readError = c.result == 0 ? asio::error::eof : ec;
+            continue;
+        }
+        rearmQuickAck(s.tcpSock->native_handle(), s.socketProfile);
+        isCorrupt = !s.frameParser.feed(s.tcpReadBuf.data(), static_cast<size_t>(c.result),
+            [&s](const FrameHeader& header, const uint8_t* payload)
+            { handleFrame(s, header, payload); });
+        if (!isCorrupt)
+        {
+            // Linked behind the next write if there is one by the time it's submitted.
+            s.uring->queueRead();
+        }
+    }
+    if (isCorrupt)
+    {
+        dropCorruptTcpStream(s);
+    }
+    else if (readError)
+    {
+        closeTcpStream(s, *readError);
+    }
+    return numCompleted > 0;
+}
+
+
+void closeConnection(NetState& s)
+{
+    boost::system::error_code ec;
+    s.ackTimeoutTimer.cancel();
+    s.clockProbeTimer.cancel();
+    if (s.acceptor)
+    {
+        s.acceptor->close(ec);
+    }
+    // Cancels the ring's reads and writes, which use the state's buffers.
+    s.uring.reset();
+    if (s.tcpSock)
+    {
+        s.tcpSock->close(ec);
+    }
+    if (s.ws)
+    {
+        beast::get_lowest_layer(*s.ws).close(ec);
+    }
+    if (s.udpSock)
+    {
+        s.udpSock->close(ec);
+    }
+    // Watcher first, it runs on the segment.
+    s.shmWatcher.reset();
+    if (s.shmSegment)
+    {
+        s.shmSegment->close();
+    }
+    if (s.numDroppedIOEvents > 0)
+    {
+        std::cerr << "io event queue was full, dropped " << s.numDroppedIOEvents << " events" << std::endl;
+    }
+}
+
+
+void rearmConsumerWake(NetState& s)
+{
+    s.isWakePending.store(false, std::memory_order_release);
+}
+
+
+void applyConnectionEvent(LinkState& link, const ConnectionEvent& e)
+{
+    auto idxConnType = static_cast<size_t>(e.connType);
+    switch (e.type)
+    {
+        case ConnectionEventType::CONNECTED:
+        {
+            std::cout << CONNECTION_TYPE_STRINGS[idxConnType] << " connection " << e.connId
+                      << " from " << e.peer << std::endl;
+            link.isConnected = true;
+            link.connId = e.connId;
+            break;
+        }
+
+        case ConnectionEventType::DISCONNECTED:
+        {
+            std::cout << CONNECTION_TYPE_STRINGS[idxConnType] << " connection " << e.connId
+                      << " closed" << std::endl;
+            if (e.connId == link.connId)
+            {
+                link.isConnected = false;
+            }
+            break;
+        }
+
+        case ConnectionEventType::CANCELLED:
+        {
+            std::cout << "IO cancelled" << std::endl;
+            break;
+        }
+
+        case ConnectionEventType::CLOCK_UPDATED:
+        {
+            link.clock = e.clock;
+            break;
+        }
+    }
+}
+
+
+void applyIOEvent(LinkState& link, const IOEvent& e)
+{
+    switch (e.type)
+    {
+        case IOEventType::ACK_RECEIVED:
+        {
+            link.ackSeqs.record(e.seq);
+            if (link.numInFlight > 0)
+            {
+                --link.numInFlight;
+            }
+            link.lastBlinkLatency = e.latency;
+            link.blinkLatencies.record(uint64_t{e.latency.count()});
+            if (e.hasOneWay)
+            {
+                // Estimation error can push either leg slightly below zero.
+                int64_t uplinkUs = e.uplink.count();
+                int64_t downlinkUs = int64_t{e.latency.count()} - uplinkUs - int64_t{e.deviceTurnaround.count()};
+                link.uplinkLatencies.record(static_cast<uint64_t>(std::max<int64_t>(uplinkUs, 0)));
+                link.downlinkLatencies.record(static_cast<uint64_t>(std::max<int64_t>(downlinkUs, 0)));
+            }
+            break;
+        }
+
+        case IOEventType::COMMAND_TIMED_OUT:
+        {
+            std::cout << "Command " << e.seq << " timed out" << std::endl;
+            if (link.numInFlight > 0)
+            {
+                --link.numInFlight;
+            }
+            ++link.numTimedOut;
+            break;
+        }
+
+        case IOEventType::UNMATCHED_ACK:
+        {
+            std::cout << "Unmatched ack " << e.seq << std::endl;
+            link.ackSeqs.record(e.seq);
+            ++link.numUnmatchedAcks;
+            break;
+        }
+
+        case IOEventType::MALFORMED_MSG:
+        {
+            std::cout << "Malformed message" << std::endl;
+            ++link.numMalformedMsgs;
+            break;
+        }
+    }
+}
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
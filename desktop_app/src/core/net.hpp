@@ -0,0 +1,303 @@
+#pragma once
+#include <boost/asio.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/ip/udp.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "clock_sync.hpp"
+#include "connection_type.hpp"
+#include "handler_allocator.hpp"
+#include "inflight_table.hpp"
+#include "latency_histogram.hpp"
+#include "messages.hpp"
+#include "results_log.hpp"
+#include "sequence_tracker.hpp"
+#include "shm_link.hpp"
+#include "socket_profile.hpp"
+#include "spsc_queue.hpp"
+#include "trace.hpp"
+#include "uring_link.hpp"
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+namespace beast = boost::beast;
+namespace websocket = beast::websocket;
+namespace asio = boost::asio;
+using chrono_time_point = std::chrono::steady_clock::time_point;
+using tcp = boost::asio::ip::tcp;
+using udp = boost::asio::ip::udp;
+
+// Sockets bound to the io_context's concrete executor. With the default
+// type-erased executor every completion is wrapped in a heap allocated
+// function once beast's composed handlers outgrow asio's recycling cache.
+using TcpSocket = tcp::socket::rebind_executor<asio::io_context::executor_type>::other;
+using UdpSocket = udp::socket::rebind_executor<asio::io_context::executor_type>::other;
+
+
+constexpr unsigned short WEB_SOCKET_PORT = 9002;
+constexpr unsigned short CUSTOM_TCP_PORT = 9003;
+constexpr unsigned short UDP_PORT = 9004;
+
+
+constexpr unsigned short defaultPort(ConnectionType connType)
+{
+    switch (connType)
+    {
+        case ConnectionType::WEB_SOCKET:
+        {
+            return WEB_SOCKET_PORT;
+        }
+        case ConnectionType::CUSTOM_TCP:
+        {
+            return CUSTOM_TCP_PORT;
+        }
+        case ConnectionType::UDP:
+        {
+            return UDP_PORT;
+        }
+        case ConnectionType::SHARED_MEMORY:
+        {
+            return 0;  // no port, see DEFAULT_SHM_NAME
+        }
+    }
+    return 0;
+}
+
+
+enum class IOEventType : uint8_t
+{
+    ACK_RECEIVED,
+    COMMAND_TIMED_OUT,  // no ack within NetState::ackTimeout
+    UNMATCHED_ACK,      // ack for a command that is not in flight (late or duplicate)
+    MALFORMED_MSG,      // invalid frame, or a frame that isn't an ack
+};
+
+
+/**
+ * Per-message notice handed from the network thread to the consumer. Plain
+ * data and fixed size, so the ring it travels through is allocated once and
+ * draining it touches a few cache lines per hundred events.
+ */
+struct IOEvent
+{
+    chrono_time_point completedAt{};  // stamped in the completion handler
+    std::chrono::duration<uint32_t, std::micro> latency{0};  // completedAt - send time, acks only
+    uint32_t seq = 0;
+    uint32_t numBytes = 0;  // frame length, 0 for timeouts
+    // Split of latency once the clocks are synchronized, downlink is the rest.
+    std::chrono::duration<int32_t, std::micro> uplink{0};  // send time to device receive
+    std::chrono::duration<uint32_t, std::micro> deviceTurnaround{0};  // device receive to ack send
+    uint16_t connId = 0;
+    IOEventType type = IOEventType::ACK_RECEIVED;
+    bool hasOneWay = false;
+};
+
+static_assert(std::is_trivially_copyable_v<IOEvent> && sizeof(IOEvent) <= 32,
+    "IOEvent is copied through the ring for every message, two per cache line");
+
+
+enum class ConnectionEventType
+{
+    CONNECTED,
+    DISCONNECTED,
+    CANCELLED,
+    CLOCK_UPDATED,  // a clock probe completed, see clock
+};
+
+
+/**
+ * Connection lifecycle notice. Rare, so it travels through its own small
+ * queue and may carry strings. Streams stay owned by the network thread.
+ */
+struct ConnectionEvent
+{
+    ConnectionEventType type = ConnectionEventType::CONNECTED;
+    ConnectionType connType = ConnectionType::WEB_SOCKET;
+    uint16_t connId = 0;
+    chrono_time_point at{};
+    std::string peer;
+    ClockEstimate clock{};
+};
+
+
+constexpr size_t IO_EVENT_QUEUE_CAPACITY = 1024;
+constexpr size_t CONNECTION_EVENT_QUEUE_CAPACITY = 16;
+constexpr size_t TCP_READ_BUF_SIZE = 4096;
+// Larger than any frame, so oversized datagrams show up as malformed instead of truncated.
+constexpr size_t UDP_READ_BUF_SIZE = MAX_FRAME_SIZE + 1;
+// Queued frames gathered into one stream write. Udp and shared memory keep one per datagram or message.
+constexpr size_t MAX_FRAMES_PER_WRITE = 16;
+
+
+/**
+ * Networking state owned by the thread that runs ioc. Only the completion
+ * handlers touch the streams; other threads must asio::post onto ioc and
+ * read results from ioEvents and connEvents.
+ */
+struct NetState
+{
+    asio::io_context& ioc;
+    SpscQueue<IOEvent, IO_EVENT_QUEUE_CAPACITY> ioEvents;
+    SpscQueue<ConnectionEvent, CONNECTION_EVENT_QUEUE_CAPACITY> connEvents;
+    // Called on the network thread when an event is pushed while none is pending,
+    // so a consumer that blocks between events can be woken, e.g. glfwPostEmptyEvent.
+    std::function<void()> wakeConsumer;
+    std::atomic<bool> isWakePending;
+    ConnectionType connType;
+    bool verbose;
+    uint16_t connId;  // incremented for every accepted connection, 0 before the first
+
+    // Backs every async op started on this state, so must outlive them, see closeConnection.
+    HandlerArena handlerArena;
+
+    SocketProfile socketProfile;  // applied to the accepted socket, or the udp one
+    std::unique_ptr<tcp::acceptor> acceptor;
+    std::unique_ptr<TcpSocket> tcpSock;
+    std::array<uint8_t, TCP_READ_BUF_SIZE> tcpReadBuf;
+    // With IO_URING the accepted socket's reads and writes go through uring
+    // instead, driven by pollUring. Null before that or if setting it up failed.
+    TcpIoBackend tcpIoBackend;
+    std::unique_ptr<UringLink> uring;
+
+    std::unique_ptr<websocket::stream<TcpSocket>> ws;
+    beast::flat_buffer wsReadBuffer;
+
+    // Udp has no accept, a hello datagram picks the peer. A hello from another endpoint replaces it.
+    std::unique_ptr<UdpSocket> udpSock;
+    udp::endpoint udpPeer;
+    udp::endpoint udpSender;
+    std::array<uint8_t, UDP_READ_BUF_SIZE> udpReadBuf;
+
+    // Shared memory has no socket either. The device's hello on toDesktop
+    // connects it, and its frames are drained by pollShm.
+    std::string shmName;
+    ShmWaitMode shmWaitMode;
+    std::unique_ptr<ShmSegment> shmSegment;
+    std::unique_ptr<ShmRingWatcher> shmWatcher;  // after the segment it watches, null when busy polling
+    std::array<uint8_t, MAX_FRAME_SIZE> shmReadBuf;
+
+    // Shared by all transports, only one is in use per NetState.
+    FrameParser frameParser;
+
+    // Commands are numbered in send order. Streams allow one outstanding write,
+    // so seqs in [nextSeqToWrite, nextSeq) are queued behind the current write,
+    // and the next one takes up to MAX_FRAMES_PER_WRITE of them at once.
+    InFlightTable inFlight;
+    uint32_t nextSeq;
+    uint32_t nextSeqToWrite;
+    bool isWriting;
+    std::array<uint8_t, MAX_FRAMES_PER_WRITE * MAX_FRAME_SIZE> writeBuf;
+    std::vector<uint8_t> commandPayload;  // sent with every command, up to MAX_PAYLOAD_SIZE
+
+    asio::steady_timer ackTimeoutTimer;
+    std::chrono::milliseconds ackTimeout;
+
+    std::unique_ptr<TraceBuffer> trace;  // network thread stages, null when not tracing
+    std::unique_ptr<ResultsRecorder> results;  // every io event, null when not logging
+
+    // Probes are written ahead of queued commands so they don't wait behind a window of them.
+    ClockSync clockSync;
+    std::optional<ClockEstimate> clock;
+    asio::steady_timer clockProbeTimer;
+    std::chrono::milliseconds clockProbeInterval;
+    uint32_t nextProbeSeq;
+    bool isProbePending;
+
+    size_t numWrites;  // completed, numFramesWritten / numWrites is the gather factor
+    size_t numFramesWritten;
+    size_t numBytesWritten;
+    size_t numDroppedIOEvents;  // reported once by closeConnection
+    size_t numTimedOut;
+    size_t numUnmatchedAcks;
+    size_t numMalformedMsgs;
+
+    NetState(asio::io_context& ioc, ConnectionType connType, bool verbose = true);
+
+    ~NetState() = default;
+    NetState(const NetState& other) = delete;
+    NetState& operator=(const NetState& other) = delete;
+    NetState(NetState&& other) = delete;
+    NetState& operator=(NetState&& other) = delete;
+};
+
+
+/**
+ * Consumer side view of the link, rebuilt from the events by the gui or the
+ * benchmark runner.
+ */
+struct LinkState
+{
+    bool isConnected = false;
+    uint16_t connId = 0;
+    size_t numInFlight = 0;  // incremented by the consumer for every command it posts
+    std::chrono::duration<double, std::milli> lastBlinkLatency{0.0};
+    LatencyHistogram blinkLatencies;
+    size_t numTimedOut = 0;
+    size_t numUnmatchedAcks = 0;
+    size_t numMalformedMsgs = 0;
+    SequenceTracker ackSeqs;  // loss, duplicates and reordering of acks
+    std::optional<ClockEstimate> clock;
+    LatencyHistogram uplinkLatencies;  // acks that arrived once the clock was synchronized
+    LatencyHistogram downlinkLatencies;
+};
+
+
+void asyncWaitForTcpConnection(NetState& s);
+void asyncWaitForWebsocketConnection(NetState& s);
+void asyncWaitForUdpConnection(NetState& s);
+void asyncWaitForShmConnection(NetState& s);
+
+// Starts the acceptor (or udp socket, or shared memory segment) matching s.connType.
+void asyncWaitForConnection(NetState& s);
+
+/**
+ * Must run on the ioc thread. Assigns the next sequence number, stamps its
+ * send time in the in-flight table and queues the write. Any number of
+ * commands may be in flight; the consumer bounds the window.
+ */
+void sendBlinkCommand(NetState& s);
+
+/**
+ * Aborts every pending operation. The owner must then run ioc until the
+ * aborted handlers have completed, e.g. ioc.restart() and ioc.poll(), before
+ * destroying s, since their memory comes from s.handlerArena.
+ */
+void closeConnection(NetState& s);
+
+/**
+ * Handles the frames the device pushed since the last call, on the ioc
+ * thread, and returns whether there were any. Posted by the watcher with
+ * ShmWaitMode::FUTEX. With BUSY_POLL the thread running ioc must call it
+ * in between polls of ioc.
+ */
+bool pollShm(NetState& s);
+
+/**
+ * Submits the reads and writes queued on s.uring and waits up to timeout
+ * for them, handling what completed on the calling thread, which must be
+ * the one running ioc. Returns whether anything completed.
+ */
+bool pollUring(NetState& s, std::chrono::microseconds timeout);
+
+// Consumer side, before draining: events pushed from then on call wakeConsumer again.
+void rearmConsumerWake(NetState& s);
+
+void applyConnectionEvent(LinkState& link, const ConnectionEvent& e);
+void applyIOEvent(LinkState& link, const IOEvent& e);
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
@@ -0,0 +1,161 @@
+#include "profile_sweep.hpp"
+
+#include <algorithm>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <utility>
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+static bool isPairSwept(const std::vector<std::pair<SocketProfile, SocketProfile>>& swept,
+    const SocketProfile& desktop, const SocketProfile& device)
+{
+    return std::any_of(swept.begin(), swept.end(), [&](const auto& pair)
+        { return pair.first.hasSameOptions(desktop) && pair.second.hasSameOptions(device); });
+}
+
+
+// Lower tail first: p99, then p99.9.
+static bool hasLowerTail(const ProfileSweepResult& a, const ProfileSweepResult& b)
+{
+    return std::make_pair(a.summary.p99Ms, a.summary.p999Ms) < std::make_pair(b.summary.p99Ms, b.summary.p999Ms);
+}
+
+
+static ProfileSweepResult runProfilePair(const std::atomic<bool>& stopSignal, const ProfileSweepConfig& config,
+    ConnectionType connType, const SocketProfile& desktop, const SocketProfile& device)
+{
+    EmulatorConfig emulatorConfig = config.emulator;
+    emulatorConfig.connType = connType;
+    emulatorConfig.socketProfile = device;
+    std::atomic<bool> stopEmulator{false};
+    EmulatorReport emulatorReport{};
+    auto futEmulator = std::async(std::launch::async, [&]()
+        { return runDeviceEmulator(stopEmulator, emulatorConfig, emulatorReport); });
+
+    RunnerConfig runnerConfig = config.runner;
+    runnerConfig.connType = connType;
+    runnerConfig.socketProfile = desktop;
+    RunnerReport runnerReport{};
+    int exitCode = runBenchmark(stopSignal, runnerConfig, runnerReport);
+    stopEmulator.store(true);
+    futEmulator.get();
+
+    ProfileSweepResult result{};
+    result.connType = connType;
+    result.desktopProfile = desktop.name;
+    result.deviceProfile = device.name;
+    result.summary = runnerReport.summary;
+    result.numTimedOut = runnerReport.numTimedOut;
+    result.isComplete = exitCode == 0;
+    return result;
+}
+
+
+int runProfileSweep(
+    const std::atomic<bool>& stopSignal,
+    const ProfileSweepConfig& config,
+    ProfileSweepReport& report)
+{
+    report.results.clear();
+    int exitCode = 0;
+    for (auto connType : config.connTypes)
+    {
+        bool isTcp = connType != ConnectionType::UDP;
+        std::vector<std::pair<SocketProfile, SocketProfile>> swept;
+        for (const auto& desktop : config.profiles)
+        {
+            for (const auto& device : config.profiles)
+            {
+                if (stopSignal.load(std::memory_order_relaxed))
+                {
+                    return 1;
+                }
+                auto effectiveDesktop = desktop.effective(isTcp);
+                auto effectiveDevice = device.effective(isTcp);
+                if (isPairSwept(swept, effectiveDesktop, effectiveDevice))
+                {
+                    continue;
+                }
+                swept.emplace_back(effectiveDesktop, effectiveDevice);
+                report.results.push_back(runProfilePair(stopSignal, config, connType, desktop, device));
+                exitCode |= report.results.back().isComplete ? 0 : 1;
+            }
+        }
+    }
+    return exitCode;
+}
+
+
+const ProfileSweepResult* bestProfilePair(const ProfileSweepReport& report, ConnectionType connType)
+{
+    const ProfileSweepResult* best = nullptr;
+    for (const auto& result : report.results)
+    {
+        if (result.connType != connType || !result.isComplete)
+        {
+            continue;
+        }
+        if (!best || hasLowerTail(result, *best))
+        {
+            best = &result;
+        }
+    }
+    return best;
+}
+
+
+void printProfileSweepReport(std::ostream& os, const ProfileSweepReport& report)
+{
+    std::vector<ConnectionType> connTypes;
+    for (const auto& result : report.results)
+    {
+        if (std::find(connTypes.begin(), connTypes.end(), result.connType) == connTypes.end())
+        {
+            connTypes.push_back(result.connType);
+        }
+    }
+
+    os << std::fixed << std::setprecision(3);
+    for (auto connType : connTypes)
+    {
+        std::vector<const ProfileSweepResult*> results;
+        for (const auto& result : report.results)
+        {
+            if (result.connType == connType)
+            {
+                results.push_back(&result);
+            }
+        }
+        std::stable_sort(results.begin(), results.end(), [](const auto* a, const auto* b)
+            { return hasLowerTail(*a, *b); });
+
+        os << CONNECTION_TYPE_STRINGS[static_cast<size_t>(connType)] << " (ms)\n"
+           << std::left << std::setw(10) << "desktop" << std::setw(10) << "device" << std::right
+           << std::setw(8) << "p50" << std::setw(8) << "p99" << std::setw(8) << "p99.9" << std::setw(9)
+           << "max" << "  timed out\n";
+        for (const auto* r : results)
+        {
+            os << std::left << std::setw(10) << r->desktopProfile << std::setw(10) << r->deviceProfile
+               << std::right << std::setw(8) << r->summary.p50Ms << std::setw(8) << r->summary.p99Ms
+               << std::setw(8) << r->summary.p999Ms << std::setw(9) << r->summary.maxMs << "  "
+               << r->numTimedOut << (r->isComplete ? "" : "  incomplete") << '\n';
+        }
+        const auto* best = bestProfilePair(report, connType);
+        if (best)
+        {
+            os << "lowest tail: desktop " << best->desktopProfile << ", device " << best->deviceProfile
+               << " (p99 " << best->summary.p99Ms << " ms, p99.9 " << best->summary.p999Ms << " ms)\n";
+        }
+        os << '\n';
+    }
+}
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
@@ -0,0 +1,62 @@
+#pragma once
+#include <atomic>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "device_emulator.hpp"
+#include "runner.hpp"
+#include "socket_profile.hpp"
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+struct ProfileSweepConfig
+{
+    std::vector<ConnectionType> connTypes = {
+        ConnectionType::WEB_SOCKET, ConnectionType::CUSTOM_TCP, ConnectionType::UDP};
+    std::vector<SocketProfile> profiles = socketProfiles();  // tried on both sides
+    RunnerConfig runner;      // connType and socketProfile are set per run
+    EmulatorConfig emulator;  // likewise
+};
+
+
+struct ProfileSweepResult
+{
+    ConnectionType connType = ConnectionType::CUSTOM_TCP;
+    std::string desktopProfile;
+    std::string deviceProfile;
+    LatencySummary summary;
+    size_t numTimedOut = 0;
+    bool isComplete = false;  // every round trip acked
+};
+
+
+struct ProfileSweepReport
+{
+    std::vector<ProfileSweepResult> results;
+};
+
+
+/**
+ * Runs the benchmark once per transport and pair of desktop and device
+ * profiles, against an emulated device in this process. Pairs that set
+ * the same options on the transport's sockets as an earlier pair, e.g.
+ * nodelay on udp, are skipped. Returns 0 when every run completed.
+ */
+int runProfileSweep(
+    const std::atomic<bool>& stopSignal,
+    const ProfileSweepConfig& config,
+    ProfileSweepReport& report);
+
+// The complete run of connType with the lowest p99, then p99.9, or nullptr.
+const ProfileSweepResult* bestProfilePair(const ProfileSweepReport& report, ConnectionType connType);
+
+void printProfileSweepReport(std::ostream& os, const ProfileSweepReport& report);
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
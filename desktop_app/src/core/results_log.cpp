@@ -0,0 +1,320 @@
+#include "results_log.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+#include "net.hpp"
+#include "trace.hpp"
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+// Records appended per write call.
+constexpr size_t RESULTS_WRITE_BATCH = 4096;
+
+
+ResultsRecorder::ResultsRecorder(const std::string& path, ConnectionType connType)
+    : out_{path, std::ios::binary | std::ios::trunc},
+      numDropped_{0},
+      isClosing_{false},
+      numWritten_{0}
+{
+    if (!out_)
+    {
+        std::cerr << "Failed to open " << path << std::endl;
+        return;
+    }
+    ResultsLogHeader header{};
+    header.recordSize = sizeof(ResultRecord);
+    header.steadyOriginNs = steadyClockNs(std::chrono::steady_clock::now());
+    header.unixOriginUs = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    header.connType = static_cast<uint8_t>(connType);
+    out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    writer_ = std::thread{[this]()
+        { writeLoop(); }};
+}
+
+
+ResultsRecorder::~ResultsRecorder()
+{
+    close();
+}
+
+
+bool ResultsRecorder::isOpen() const
+{
+    return writer_.joinable();
+}
+
+
+bool ResultsRecorder::close()
+{
+    if (!writer_.joinable())
+    {
+        return static_cast<bool>(out_);
+    }
+    isClosing_.store(true, std::memory_order_release);
+    writer_.join();
+    out_.flush();
+    if (numDropped() > 0)
+    {
+        std::cerr << "results queue full, dropped " << numDropped() << " records" << std::endl;
+    }
+    return static_cast<bool>(out_);
+}
+
+
+size_t ResultsRecorder::numWritten() const
+{
+    return numWritten_;
+}
+
+
+size_t ResultsRecorder::numDropped() const
+{
+    return numDropped_.load(std::memory_order_relaxed);
+}
+
+
+void ResultsRecorder::writeLoop()
+{
+    while (!isClosing_.load(std::memory_order_acquire))
+    {
+        writeQueued();
+        std::this_thread::sleep_for(RESULTS_FLUSH_INTERVAL);
+    }
+    // Whatever was recorded before close() was called.
+    writeQueued();
+}
+
+
+void ResultsRecorder::writeQueued()
+{
+    std::array<ResultRecord, RESULTS_WRITE_BATCH> batch;
+    size_t numBatched = 0;
+    do
+    {
+        numBatched = 0;
+        while (numBatched < batch.size() && queue_.tryPop(batch[numBatched]))
+        {
+            ++numBatched;
+        }
+        out_.write(reinterpret_cast<const char*>(batch.data()),
+            static_cast<std::streamsize>(numBatched * sizeof(ResultRecord)));
+        numWritten_ += numBatched;
+    } while (numBatched == batch.size());
+    out_.flush();
+}
+
+
+ResultsLogReader::~ResultsLogReader()
+{
+    unmap();
+}
+
+
+void ResultsLogReader::unmap()
+{
+    if (mapped_ != nullptr)
+    {
+        munmap(mapped_, mappedSize_);
+    }
+    mapped_ = nullptr;
+    mappedSize_ = 0;
+    numRecords_ = 0;
+}
+
+
+bool ResultsLogReader::open(const std::string& path)
+{
+    unmap();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        std::cerr << "Failed to open " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(ResultsLogHeader))
+    {
+        std::cerr << path << " is too short for a results log" << std::endl;
+        ::close(fd);
+        return false;
+    }
+    mappedSize_ = static_cast<size_t>(st.st_size);
+    mapped_ = mmap(nullptr, mappedSize_, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps the file referenced on its own.
+    ::close(fd);
+    if (mapped_ == MAP_FAILED)
+    {
+        std::cerr << "Failed to map " << path << ": " << std::strerror(errno) << std::endl;
+        mapped_ = nullptr;
+        mappedSize_ = 0;
+        return false;
+    }
+    // Analyses stream through the records once.
+    madvise(mapped_, mappedSize_, MADV_SEQUENTIAL);
+
+    std::memcpy(&header_, mapped_, sizeof(header_));
+    if (header_.magic != RESULTS_LOG_MAGIC || header_.version != RESULTS_LOG_VERSION ||
+        header_.recordSize != sizeof(ResultRecord))
+    {
+        std::cerr << path << " is not a version " << RESULTS_LOG_VERSION << " results log"
+                  << std::endl;
+        unmap();
+        return false;
+    }
+    // Indexes CONNECTION_TYPE_STRINGS, so a corrupt or foreign value mustn't get past here.
+    if (header_.connType >= CONNECTION_TYPE_STRINGS.size())
+    {
+        std::cerr << path << " has an unknown connection type " << unsigned{header_.connType} << std::endl;
+        unmap();
+        return false;
+    }
+    numRecords_ = (mappedSize_ - sizeof(ResultsLogHeader)) / sizeof(ResultRecord);
+    return true;
+}
+
+
+const ResultsLogHeader& ResultsLogReader::header() const
+{
+    return header_;
+}
+
+
+ConnectionType ResultsLogReader::connType() const
+{
+    return static_cast<ConnectionType>(header_.connType);
+}
+
+
+size_t ResultsLogReader::size() const
+{
+    return numRecords_;
+}
+
+
+const ResultRecord* ResultsLogReader::begin() const
+{
+    if (mapped_ == nullptr)
+    {
+        return nullptr;
+    }
+    // The header is 64 bytes and the mapping page aligned, so records are aligned.
+    return reinterpret_cast<const ResultRecord*>(
+        static_cast<const uint8_t*>(mapped_) + sizeof(ResultsLogHeader));
+}
+
+
+const ResultRecord* ResultsLogReader::end() const
+{
+    return mapped_ == nullptr ? nullptr : begin() + numRecords_;
+}
+
+
+const ResultRecord& ResultsLogReader::operator[](size_t i) const
+{
+    return begin()[i];
+}
+
+
+ResultsLogSummary summarizeResultsLog(const ResultsLogReader& reader)
+{
+    ResultsLogSummary out{};
+    out.connType = reader.connType();
+    out.numRecords = reader.size();
+    LatencyHistogram latencies;
+    LatencyHistogram uplinkLatencies;
+    LatencyHistogram downlinkLatencies;
+    for (const ResultRecord& r : reader)
+    {
+        switch (static_cast<IOEventType>(r.type))
+        {
+            case IOEventType::ACK_RECEIVED:
+            {
+                latencies.record(uint64_t{r.latencyUs});
+                if (r.flags & RESULT_HAS_ONE_WAY)
+                {
+                    // Same clamping as applyIOEvent, estimation error can push a leg below zero.
+                    int64_t uplinkUs = r.uplinkUs;
+                    int64_t downlinkUs = int64_t{r.latencyUs} - uplinkUs - int64_t{r.deviceTurnaroundUs};
+                    uplinkLatencies.record(static_cast<uint64_t>(std::max<int64_t>(uplinkUs, 0)));
+                    downlinkLatencies.record(static_cast<uint64_t>(std::max<int64_t>(downlinkUs, 0)));
+                }
+                break;
+            }
+
+            case IOEventType::COMMAND_TIMED_OUT:
+            {
+                ++out.numTimedOut;
+                break;
+            }
+
+            case IOEventType::UNMATCHED_ACK:
+            {
+                ++out.numUnmatchedAcks;
+                break;
+            }
+
+            case IOEventType::MALFORMED_MSG:
+            {
+                ++out.numMalformedMsgs;
+                break;
+            }
+        }
+    }
+    if (reader.size() > 1)
+    {
+        uint64_t spanNs = reader[reader.size() - 1].ackReadNs - reader[0].ackReadNs;
+        out.elapsedS = static_cast<double>(spanNs) / 1e9;
+    }
+    out.summary = summarizeHistogram(latencies);
+    out.uplinkSummary = summarizeHistogram(uplinkLatencies);
+    out.downlinkSummary = summarizeHistogram(downlinkLatencies);
+    return out;
+}
+
+
+void printResultsLogSummary(std::ostream& os, const ResultsLogSummary& summary)
+{
+    const auto& s = summary.summary;
+    auto idxConnType = static_cast<size_t>(summary.connType);
+    os << std::fixed << std::setprecision(3)
+       << "connection type: " << CONNECTION_TYPE_STRINGS[idxConnType] << '\n'
+       << "records:         " << summary.numRecords << '\n'
+       << "round trips:     " << s.count << '\n'
+       << "timed out:       " << summary.numTimedOut << '\n'
+       << "unmatched acks:  " << summary.numUnmatchedAcks << '\n'
+       << "malformed msgs:  " << summary.numMalformedMsgs << '\n'
+       << "elapsed:         " << summary.elapsedS << " s\n"
+       << "min:             " << s.minMs << " ms\n"
+       << "mean:            " << s.meanMs << " ms\n"
+       << "p50:             " << s.p50Ms << " ms\n"
+       << "p90:             " << s.p90Ms << " ms\n"
+       << "p99:             " << s.p99Ms << " ms\n"
+       << "p99.9:           " << s.p999Ms << " ms\n"
+       << "max:             " << s.maxMs << " ms\n";
+    if (summary.uplinkSummary.count > 0)
+    {
+        const auto& up = summary.uplinkSummary;
+        const auto& down = summary.downlinkSummary;
+        os << "uplink p50/p99:   " << up.p50Ms << " / " << up.p99Ms << " ms\n"
+           << "downlink p50/p99: " << down.p50Ms << " / " << down.p99Ms << " ms\n";
+    }
+}
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
@@ -0,0 +1,192 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+#include "connection_type.hpp"
+#include "latency_histogram.hpp"
+#include "spsc_queue.hpp"
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+/**
+ * Results log layout: one ResultsLogHeader followed by ResultRecords until
+ * the end of the file. Both are written in host byte order, so a log is
+ * read on a machine of the same endianness. A run that is killed mid-write
+ * leaves a partial last record, which readers ignore.
+ */
+constexpr std::array<char, 8> RESULTS_LOG_MAGIC = {'T', 'L', 'B', 'R', 'L', 'O', 'G', '1'};
+constexpr uint32_t RESULTS_LOG_VERSION = 1;
+
+
+struct ResultsLogHeader
+{
+    std::array<char, 8> magic = RESULTS_LOG_MAGIC;
+    uint32_t version = RESULTS_LOG_VERSION;
+    uint32_t recordSize = 0;
+    uint64_t steadyOriginNs = 0;  // steady clock when the log was created
+    int64_t unixOriginUs = 0;     // system clock at the same moment
+    uint8_t connType = 0;
+    std::array<uint8_t, 31> reserved{};
+};
+
+static_assert(std::is_trivially_copyable_v<ResultsLogHeader> && sizeof(ResultsLogHeader) == 64,
+    "ResultsLogHeader is the file's first 64 bytes");
+
+
+enum ResultRecordFlags : uint8_t
+{
+    RESULT_HAS_ONE_WAY = 1 << 0,  // uplinkUs and deviceTurnaroundUs are valid
+};
+
+
+/**
+ * One IOEvent as stored on disk. Times are steady clock, so they line up
+ * with traces of the same run: the command was sent at
+ * ackReadNs - latencyUs, reached the device uplinkUs later and was acked
+ * deviceTurnaroundUs after that; the rest of latencyUs is the downlink.
+ */
+struct ResultRecord
+{
+    uint64_t ackReadNs = 0;  // completion time of any event type
+    uint32_t latencyUs = 0;  // acks only
+    int32_t uplinkUs = 0;
+    uint32_t deviceTurnaroundUs = 0;
+    uint32_t seq = 0;
+    uint32_t numBytes = 0;
+    uint16_t connId = 0;
+    uint8_t type = 0;  // IOEventType
+    uint8_t flags = 0;
+};
+
+static_assert(std::is_trivially_copyable_v<ResultRecord> && sizeof(ResultRecord) == 32,
+    "ResultRecord is mapped straight from the file");
+
+
+// About 2 MB of records, enough for a second of round trips with the disk stalled.
+constexpr size_t RESULTS_QUEUE_CAPACITY = 1 << 16;
+constexpr std::chrono::milliseconds RESULTS_FLUSH_INTERVAL{20};
+
+
+/**
+ * Streams records to an append-only results log. record() is a push onto
+ * a lock-free ring, so the network thread never waits on the disk; a
+ * background thread drains the ring every RESULTS_FLUSH_INTERVAL and
+ * appends the batch to the file. Records that find the ring full are
+ * counted and dropped.
+ */
+class ResultsRecorder
+{
+   public:
+    ResultsRecorder(const std::string& path, ConnectionType connType);
+
+    ~ResultsRecorder();
+    ResultsRecorder(const ResultsRecorder& other) = delete;
+    ResultsRecorder& operator=(const ResultsRecorder& other) = delete;
+    ResultsRecorder(ResultsRecorder&& other) = delete;
+    ResultsRecorder& operator=(ResultsRecorder&& other) = delete;
+
+    // False when the file couldn't be created, records are then dropped.
+    bool isOpen() const;
+
+    // Only one thread may record.
+    void record(const ResultRecord& r)
+    {
+        if (!queue_.tryPush(r))
+        {
+            numDropped_.store(numDropped_.load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+        }
+    }
+
+    // Writes out what was recorded so far and joins the writer thread.
+    // The recording thread must be done. Returns false on a write error.
+    bool close();
+
+    size_t numWritten() const;  // after close
+    size_t numDropped() const;
+
+   private:
+    void writeLoop();
+    void writeQueued();
+
+    std::ofstream out_;
+    SpscQueue<ResultRecord, RESULTS_QUEUE_CAPACITY> queue_;
+    std::atomic<size_t> numDropped_;
+    std::atomic<bool> isClosing_;
+    size_t numWritten_;
+    std::thread writer_;
+};
+
+
+/**
+ * Read-only view of a results log through mmap, so analysing hundreds of
+ * millions of records neither copies nor parses them. Records stay valid
+ * while the reader is alive.
+ */
+class ResultsLogReader
+{
+   public:
+    ResultsLogReader() = default;
+
+    ~ResultsLogReader();
+    ResultsLogReader(const ResultsLogReader& other) = delete;
+    ResultsLogReader& operator=(const ResultsLogReader& other) = delete;
+    ResultsLogReader(ResultsLogReader&& other) = delete;
+    ResultsLogReader& operator=(ResultsLogReader&& other) = delete;
+
+    // False if the file can't be mapped or isn't a results log of this version.
+    bool open(const std::string& path);
+
+    const ResultsLogHeader& header() const;
+    ConnectionType connType() const;
+
+    size_t size() const;
+    const ResultRecord* begin() const;
+    const ResultRecord* end() const;
+    const ResultRecord& operator[](size_t i) const;
+
+   private:
+    void unmap();
+
+    ResultsLogHeader header_{};
+    void* mapped_ = nullptr;
+    size_t mappedSize_ = 0;
+    size_t numRecords_ = 0;
+};
+
+
+struct ResultsLogSummary
+{
+    ConnectionType connType = ConnectionType::CUSTOM_TCP;
+    size_t numRecords = 0;
+    double elapsedS = 0.0;  // first to last record
+    LatencySummary summary;
+    LatencySummary uplinkSummary;  // acks with RESULT_HAS_ONE_WAY
+    LatencySummary downlinkSummary;
+    size_t numTimedOut = 0;
+    size_t numUnmatchedAcks = 0;
+    size_t numMalformedMsgs = 0;
+};
+
+
+// One sequential pass over the mapped records.
+ResultsLogSummary summarizeResultsLog(const ResultsLogReader& reader);
+
+
+void printResultsLogSummary(std::ostream& os, const ResultsLogSummary& summary);
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
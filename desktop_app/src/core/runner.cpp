@@ -0,0 +1,493 @@
+#include "runner.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <nlohmann/json.hpp>
+
+#include "inflight_table.hpp"
+#include "net.hpp"
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+using steady_clock = std::chrono::steady_clock;
+
+
+// With io_uring, how late ioc's timers, the ack timeout sweep and clock probes, may run.
+constexpr std::chrono::microseconds URING_IOC_POLL_INTERVAL{1000};
+
+
+struct RunnerState
+{
+    NetState& net;
+    LinkState link;
+    const RunnerConfig& config;
+    RunnerReport& report;
+    asio::steady_timer pacer;
+    steady_clock::duration sendPeriod;
+    chrono_time_point nextSendTime;
+    chrono_time_point firstRecordedSendTime;
+    size_t numSent = 0;
+    size_t numAcked = 0;
+    size_t numTimedOut = 0;
+    bool isWaitingForPacer = false;
+
+    RunnerState(NetState& net, const RunnerConfig& config, RunnerReport& report)
+        : net{net},
+          config{config},
+          report{report},
+          pacer{net.ioc},
+          sendPeriod{0}
+    {
+        if (config.rateHz > 0.0)
+        {
+            sendPeriod = std::chrono::duration_cast<steady_clock::duration>(
+                std::chrono::duration<double>(1.0 / config.rateHz));
+        }
+    }
+};
+
+
+static size_t totalCommands(const RunnerState& r)
+{
+    return r.config.numWarmup + r.config.numCommands;
+}
+
+
+static size_t numResolved(const RunnerState& r)
+{
+    return r.numAcked + r.numTimedOut;
+}
+
+
+static void trySendNext(RunnerState& r)
+{
+    size_t maxInFlight = r.config.isStreaming ? InFlightTable::CAPACITY : std::max<size_t>(r.config.maxInFlight, 1);
+    while (r.numSent < totalCommands(r) && r.link.numInFlight < maxInFlight &&
+           !r.isWaitingForPacer)
+    {
+        auto now = steady_clock::now();
+        if (now < r.nextSendTime)
+        {
+            r.isWaitingForPacer = true;
+            r.pacer.expires_at(r.nextSendTime);
+            r.pacer.async_wait(bindArena(r.net.handlerArena, [&r](boost::system::error_code ec)
+                {
+                    r.isWaitingForPacer = false;
+                    if (!ec)
+                    {
+                        trySendNext(r);
+                    }
+                }));
+            return;
+        }
+
+        // A late send does not try to catch up, so a stalled window never turns into a burst.
+        // A stream does, its burst is gathered into as few writes as the window allows.
+        r.nextSendTime = r.config.isStreaming ? r.nextSendTime + r.sendPeriod
+                                              : std::max(r.nextSendTime + r.sendPeriod, now);
+        if (r.numSent == r.config.numWarmup)
+        {
+            r.firstRecordedSendTime = now;
+        }
+        ++r.link.numInFlight;
+        sendBlinkCommand(r.net);
+        ++r.numSent;
+    }
+}
+
+
+static void recordAck(RunnerState& r, const IOEvent& e)
+{
+    ++r.numAcked;
+    // Sequence numbers start at 0 per connection and follow send order.
+    if (e.seq >= r.config.numWarmup)
+    {
+        r.report.histogram.record(uint64_t{e.latency.count()});
+        if (e.hasOneWay)
+        {
+            int64_t uplinkUs = e.uplink.count();
+            int64_t downlinkUs = int64_t{e.latency.count()} - uplinkUs - int64_t{e.deviceTurnaround.count()};
+            r.report.uplinkHistogram.record(static_cast<uint64_t>(std::max<int64_t>(uplinkUs, 0)));
+            r.report.downlinkHistogram.record(static_cast<uint64_t>(std::max<int64_t>(downlinkUs, 0)));
+        }
+    }
+}
+
+
+int runBenchmark(
+    const std::atomic<bool>& stopSignal,
+    const RunnerConfig& config,
+    RunnerReport& report)
+{
+    report.config = config;
+    report.histogram.reset();
+    report.uplinkHistogram.reset();
+    report.downlinkHistogram.reset();
+    report.osJitter.reset();
+    report.elapsedS = 0.0;
+    report.msgsPerS = 0.0;
+    report.bytesPerS = 0.0;
+
+    applyThreadTuning(config.threadTuning);
+    if (config.jitterTest.numWakeups > 0)
+    {
+        std::cout << "running jitter test, " << config.jitterTest.numWakeups << " wakeups" << std::endl;
+        runJitterTest(config.jitterTest, report.osJitter);
+    }
+
+    // The runner has no frame loop to share a thread with, so ioc runs here and
+    // results are drained right after each completion handler.
+    asio::io_context ioc{1};
+    // Results are drained outside of the handlers, so ioc can briefly have no work.
+    auto workGuard = asio::make_work_guard(ioc);
+    NetState net{ioc, config.connType, false};
+    net.ackTimeout = std::chrono::milliseconds(config.ackTimeoutMs);
+    net.shmWaitMode = config.shmWaitMode;
+    net.socketProfile = config.socketProfile;
+    net.tcpIoBackend = config.tcpIoBackend;
+    net.commandPayload.resize(std::min(config.payloadSize, MAX_PAYLOAD_SIZE));
+    for (size_t i = 0; i < net.commandPayload.size(); ++i)
+    {
+        net.commandPayload[i] = static_cast<uint8_t>(i);
+    }
+    if (!config.tracePath.empty())
+    {
+        // Queued, written, ack read and the two device stages of every command.
+        net.trace = std::make_unique<TraceBuffer>(5 * (config.numWarmup + config.numCommands));
+    }
+    if (!config.logPath.empty())
+    {
+        net.results = std::make_unique<ResultsRecorder>(config.logPath, config.connType);
+        if (!net.results->isOpen())
+        {
+            return 1;
+        }
+    }
+    RunnerState r{net, config, report};
+    asyncWaitForConnection(net);
+    // Spins on the io_context and the shared memory ring instead of sleeping in either.
+    bool isBusyPolling = config.connType == ConnectionType::SHARED_MEMORY &&
+                         config.shmWaitMode == ShmWaitMode::BUSY_POLL;
+    chrono_time_point nextIocPoll{};
+    bool isSpinning = config.busyPoll.spinBudget.count() > 0;
+    report.ioThread = BusyPollStats{};
+    auto startedAt = steady_clock::now();
+    auto cpuAtStart = threadCpuTime();
+    auto lastWorkAt = startedAt;
+
+    while (numResolved(r) < totalCommands(r))
+    {
+        if (stopSignal.load(std::memory_order_relaxed))
+        {
+            std::cout << "stopping due to stop flag" << std::endl;
+            break;
+        }
+        if (isBusyPolling)
+        {
+            ioc.poll();
+            pollShm(net);
+        }
+        else if (net.uring)
+        {
+            // Sleeps in io_uring_enter rather than epoll, which is left with only the timers.
+            // The pacer's are the only ones that can't be a little late.
+            auto timeout = URING_IOC_POLL_INTERVAL;
+            if (r.isWaitingForPacer)
+            {
+                timeout = std::clamp(std::chrono::duration_cast<std::chrono::microseconds>(
+                    r.nextSendTime - steady_clock::now()), std::chrono::microseconds::zero(), timeout);
+            }
+            bool hasCompleted = pollUring(net, timeout);
+            auto now = steady_clock::now();
+            if (!hasCompleted || now >= nextIocPoll)
+            {
+                ioc.poll();
+                nextIocPoll = now + URING_IOC_POLL_INTERVAL;
+            }
+        }
+        else if (isSpinning)
+        {
+            pollOrPark(ioc, config.busyPoll, lastWorkAt, report.ioThread);
+        }
+        else
+        {
+            // Parked, the loop still drains results and checks the stop signal this often.
+            ioc.run_one_for(config.busyPoll.parkTimeout);
+        }
+
+        ConnectionEvent connEvent{};
+        while (net.connEvents.tryPop(connEvent))
+        {
+            applyConnectionEvent(r.link, connEvent);
+            if (connEvent.type == ConnectionEventType::CONNECTED)
+            {
+                if (r.numSent == 0)
+                {
+                    // Waiting for the device doesn't count towards the io thread's cpu.
+                    startedAt = steady_clock::now();
+                    cpuAtStart = threadCpuTime();
+                }
+                r.nextSendTime = steady_clock::now();
+                trySendNext(r);
+            }
+        }
+        if (r.numSent > 0 && !r.link.isConnected)
+        {
+            std::cout << "stopping, device disconnected" << std::endl;
+            break;
+        }
+
+        IOEvent e{};
+        while (net.ioEvents.tryPop(e))
+        {
+            applyIOEvent(r.link, e);
+            switch (e.type)
+            {
+                case IOEventType::ACK_RECEIVED:
+                {
+                    recordAck(r, e);
+                    trySendNext(r);
+                    break;
+                }
+
+                case IOEventType::COMMAND_TIMED_OUT:
+                {
+                    ++r.numTimedOut;
+                    trySendNext(r);
+                    break;
+                }
+
+                case IOEventType::UNMATCHED_ACK:
+                case IOEventType::MALFORMED_MSG:
+                {
+                    break;
+                }
+            }
+        }
+    }
+
+    report.ioThread.cpuS = std::chrono::duration<double>(threadCpuTime() - cpuAtStart).count();
+    report.ioThread.elapsedS = std::chrono::duration<double>(steady_clock::now() - startedAt).count();
+    if (report.histogram.count() > 0)
+    {
+        std::chrono::duration<double> elapsed =
+            steady_clock::now() - r.firstRecordedSendTime;
+        report.elapsedS = elapsed.count();
+        size_t numRecordedSent = r.numSent - std::min(r.numSent, config.numWarmup);
+        report.msgsPerS = static_cast<double>(numRecordedSent) / std::max(report.elapsedS, 1e-9);
+        report.bytesPerS = report.msgsPerS * static_cast<double>(FRAME_HEADER_SIZE + net.commandPayload.size());
+    }
+    report.framesPerWrite = static_cast<double>(net.numFramesWritten) /
+                            static_cast<double>(std::max<size_t>(net.numWrites, 1));
+    // Complete the aborted ops while the arena their memory came from is still alive.
+    r.pacer.cancel();
+    closeConnection(net);
+    ioc.restart();
+    ioc.poll();
+
+    if (net.trace)
+    {
+        exportChromeTrace(config.tracePath, {net.trace.get()}, net.clock);
+    }
+    if (net.results && !net.results->close())
+    {
+        std::cerr << "Failed to write " << config.logPath << std::endl;
+    }
+    report.summary = summarizeHistogram(report.histogram);
+    report.uplinkSummary = summarizeHistogram(report.uplinkHistogram);
+    report.downlinkSummary = summarizeHistogram(report.downlinkHistogram);
+    report.osJitterSummary = summarizeHistogram(report.osJitter);
+    report.clock = net.clock;
+    report.numTimedOut = r.link.numTimedOut;
+    report.numUnmatchedAcks = r.link.numUnmatchedAcks;
+    report.numDuplicateAcks = r.link.ackSeqs.numDuplicates();
+    report.numReorderedAcks = r.link.ackSeqs.numReordered();
+    report.numMalformedMsgs = r.link.numMalformedMsgs;
+    report.numDroppedIOEvents = net.numDroppedIOEvents;
+    return r.numAcked == totalCommands(r) ? 0 : 1;
+}
+
+
+void printReport(std::ostream& os, const RunnerReport& report)
+{
+    const auto& s = report.summary;
+    auto idxConnType = static_cast<size_t>(report.config.connType);
+    os << std::fixed << std::setprecision(3)
+       << "connection type: " << CONNECTION_TYPE_STRINGS[idxConnType] << '\n'
+       << "round trips:     " << s.count << '\n'
+       << "max in flight:   " << (report.config.isStreaming ? InFlightTable::CAPACITY : report.config.maxInFlight)
+       << '\n'
+       << "payload size:    " << report.config.payloadSize << " B\n"
+       << "timed out:       " << report.numTimedOut << '\n'
+       << "unmatched acks:  " << report.numUnmatchedAcks << '\n'
+       << "duplicate acks:  " << report.numDuplicateAcks << '\n'
+       << "reordered acks:  " << report.numReorderedAcks << '\n'
+       << "malformed msgs:  " << report.numMalformedMsgs << '\n'
+       << "dropped events:  " << report.numDroppedIOEvents << '\n'
+       << "elapsed:         " << report.elapsedS << " s\n"
+       << std::setprecision(0) << "throughput:      " << report.msgsPerS << " msgs/s, " << report.bytesPerS
+       << " B/s, " << std::setprecision(2) << report.framesPerWrite << " frames per write\n"
+       << std::setprecision(3)
+       << "min:             " << s.minMs << " ms\n"
+       << "mean:            " << s.meanMs << " ms\n"
+       << "p50:             " << s.p50Ms << " ms\n"
+       << "p90:             " << s.p90Ms << " ms\n"
+       << "p99:             " << s.p99Ms << " ms\n"
+       << "p99.9:           " << s.p999Ms << " ms\n"
+       << "max:             " << s.maxMs << " ms\n";
+    if (report.config.isStreaming)
+    {
+        os << std::setprecision(0) << "stream target:   " << report.config.rateHz << " msgs/s\n"
+           << std::setprecision(3);
+    }
+    if (report.clock)
+    {
+        const auto& up = report.uplinkSummary;
+        const auto& down = report.downlinkSummary;
+        os << "clock offset:    " << report.clock->offsetUs << " us +- " << report.clock->errorBoundUs << " us\n"
+           << "clock drift:     " << report.clock->driftPpm << " ppm\n"
+           << "uplink p50/p99:   " << up.p50Ms << " / " << up.p99Ms << " ms\n"
+           << "downlink p50/p99: " << down.p50Ms << " / " << down.p99Ms << " ms\n";
+    }
+    const auto& io = report.ioThread;
+    os << "io thread cpu:   " << io.cpuS << " s, " << std::setprecision(0)
+       << 100.0 * io.cpuS / std::max(io.elapsedS, 1e-9) << "% of " << std::setprecision(3) << io.elapsedS << " s\n";
+    if (report.config.busyPoll.spinBudget.count() > 0)
+    {
+        os << "spin budget:     " << report.config.busyPoll.spinBudget.count() << " us, parked " << io.numParks
+           << " times in " << io.numHandlers << " handlers\n";
+    }
+    if (report.osJitterSummary.count > 0)
+    {
+        const auto& jitter = report.osJitterSummary;
+        os << std::setprecision(0) << "os jitter:       p50 " << jitter.p50Ms * 1e3 << " / p99 " << jitter.p99Ms * 1e3
+           << " / max " << jitter.maxMs * 1e3 << " us over " << jitter.count << " wakeups\n";
+    }
+}
+
+
+void printBusyPollComparison(std::ostream& os, const RunnerReport& blocking, const RunnerReport& busy)
+{
+    const auto& a = blocking.summary;
+    const auto& b = busy.summary;
+    auto printRow = [&os](const char* label, double wasMs, double nowMs)
+    {
+        os << label << wasMs * 1e3 << " -> " << nowMs * 1e3 << " us (" << std::showpos
+           << (nowMs - wasMs) * 1e3 << std::noshowpos << " us)\n";
+    };
+    auto cpuShare = [](const BusyPollStats& io) { return 100.0 * io.cpuS / std::max(io.elapsedS, 1e-9); };
+    // Warmup round trips burn cpu too.
+    auto cpuPerRoundTripUs = [](const RunnerReport& report)
+    {
+        size_t numRoundTrips = report.config.numWarmup + report.summary.count;
+        return report.ioThread.cpuS * 1e6 / static_cast<double>(std::max<size_t>(numRoundTrips, 1));
+    };
+    os << std::fixed << std::setprecision(1) << "busy polling for " << busy.config.busyPoll.spinBudget.count()
+       << " us against parking in epoll\n";
+    printRow("p50:           ", a.p50Ms, b.p50Ms);
+    printRow("p99:           ", a.p99Ms, b.p99Ms);
+    printRow("p99 - p50:     ", a.p99Ms - a.p50Ms, b.p99Ms - b.p50Ms);
+    printRow("p99.9 - p50:   ", a.p999Ms - a.p50Ms, b.p999Ms - b.p50Ms);
+    os << "io thread cpu: " << cpuShare(blocking.ioThread) << "% -> " << cpuShare(busy.ioThread)
+       << "% of wall time, " << cpuPerRoundTripUs(blocking) << " -> " << cpuPerRoundTripUs(busy)
+       << " us per round trip\n";
+}
+
+
+bool exportReportJson(const std::string& path, const RunnerReport& report)
+{
+    const auto& s = report.summary;
+    auto idxConnType = static_cast<size_t>(report.config.connType);
+    nlohmann::json j;
+    j["connectionType"] = std::string(CONNECTION_TYPE_STRINGS[idxConnType]);
+    j["numCommands"] = report.config.numCommands;
+    j["numWarmup"] = report.config.numWarmup;
+    j["rateHz"] = report.config.rateHz;
+    j["maxInFlight"] = report.config.maxInFlight;
+    j["ackTimeoutMs"] = report.config.ackTimeoutMs;
+    j["payloadSize"] = report.config.payloadSize;
+    j["elapsedS"] = report.elapsedS;
+    j["isStreaming"] = report.config.isStreaming;
+    j["msgsPerS"] = report.msgsPerS;
+    j["bytesPerS"] = report.bytesPerS;
+    j["framesPerWrite"] = report.framesPerWrite;
+    j["ioThreadCpuS"] = report.ioThread.cpuS;
+    j["spinBudgetUs"] = report.config.busyPoll.spinBudget.count();
+    j["numTimedOut"] = report.numTimedOut;
+    j["numUnmatchedAcks"] = report.numUnmatchedAcks;
+    j["numDuplicateAcks"] = report.numDuplicateAcks;
+    j["numReorderedAcks"] = report.numReorderedAcks;
+    j["numMalformedMsgs"] = report.numMalformedMsgs;
+    j["numDroppedIOEvents"] = report.numDroppedIOEvents;
+    j["summary"] = {
+        {"count", s.count},
+        {"minMs", s.minMs},
+        {"meanMs", s.meanMs},
+        {"p50Ms", s.p50Ms},
+        {"p90Ms", s.p90Ms},
+        {"p99Ms", s.p99Ms},
+        {"p999Ms", s.p999Ms},
+        {"maxMs", s.maxMs},
+    };
+    if (report.osJitterSummary.count > 0)
+    {
+        j["osJitter"] = {
+            {"count", report.osJitterSummary.count},
+            {"p50Ms", report.osJitterSummary.p50Ms},
+            {"p99Ms", report.osJitterSummary.p99Ms},
+            {"maxMs", report.osJitterSummary.maxMs},
+        };
+    }
+    if (report.clock)
+    {
+        j["clock"] = {
+            {"offsetUs", report.clock->offsetUs},
+            {"driftPpm", report.clock->driftPpm},
+            {"errorBoundUs", report.clock->errorBoundUs},
+            {"numSamples", report.clock->numSamples},
+        };
+        j["uplink"] = {
+            {"count", report.uplinkSummary.count},
+            {"p50Ms", report.uplinkSummary.p50Ms},
+            {"p99Ms", report.uplinkSummary.p99Ms},
+        };
+        j["downlink"] = {
+            {"count", report.downlinkSummary.count},
+            {"p50Ms", report.downlinkSummary.p50Ms},
+            {"p99Ms", report.downlinkSummary.p99Ms},
+        };
+    }
+
+    // Non-empty buckets as [lowerUs, upperUs, count] so runs can be merged offline.
+    auto buckets = nlohmann::json::array();
+    for (size_t i = 0; i < LatencyHistogram::NUM_BUCKETS; ++i)
+    {
+        auto count = report.histogram.countAtIndex(i);
+        if (count > 0)
+        {
+            buckets.push_back({LatencyHistogram::bucketLowerBound(i),
+                LatencyHistogram::bucketUpperBound(i), count});
+        }
+    }
+    j["histogramUs"] = std::move(buckets);
+
+    std::ofstream out{path};
+    if (!out)
+    {
+        std::cerr << "Failed to open " << path << std::endl;
+        return false;
+    }
+    out << j.dump(2) << '\n';
+    return static_cast<bool>(out);
+}
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
@@ -0,0 +1,93 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <ostream>
+#include <string>
+
+#include "busy_poll.hpp"
+#include "clock_sync.hpp"
+#include "connection_type.hpp"
+#include "latency_histogram.hpp"
+#include "shm_link.hpp"
+#include "socket_profile.hpp"
+#include "thread_tuning.hpp"
+#include "uring_link.hpp"
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+struct RunnerConfig
+{
+    ConnectionType connType = ConnectionType::CUSTOM_TCP;
+    size_t numCommands = 1000;
+    size_t numWarmup = 0;     // round trips sent before recording starts
+    double rateHz = 0.0;      // 0 sends the next command as soon as the window allows
+    // Streams setpoints open loop at rateHz: the window is the whole in-flight table and a
+    // late pacer catches up, so the sustained rate holds and queued frames share writes.
+    bool isStreaming = false;
+    size_t maxInFlight = 1;   // commands awaiting an ack, 1 is stop-and-wait
+    size_t ackTimeoutMs = 1000;
+    size_t payloadSize = 0;   // command payload bytes, up to MAX_PAYLOAD_SIZE
+    std::string outPath{};    // json export path, empty to skip
+    std::string tracePath{};  // chrome trace export path, empty to skip tracing
+    std::string logPath{};    // binary results log of every io event, empty to skip
+    ShmWaitMode shmWaitMode = ShmWaitMode::FUTEX;  // how the io thread waits for shared memory acks
+    SocketProfile socketProfile = findSocketProfile("default").value();  // desktop side options
+    TcpIoBackend tcpIoBackend = TcpIoBackend::REACTOR;  // customTcp only
+    BusyPollConfig busyPoll;  // spins instead of parking in epoll
+    ThreadTuning threadTuning;  // applied to the calling thread for good
+    JitterTestConfig jitterTest;  // run on the calling thread, once tuned, before accepting the device
+};
+
+
+struct RunnerReport
+{
+    RunnerConfig config;
+    LatencyHistogram histogram;  // recorded round trips, merge reports by merging these
+    LatencySummary summary;
+    // One-way split of the round trips acked after the first clock estimate.
+    LatencyHistogram uplinkHistogram;
+    LatencyHistogram downlinkHistogram;
+    LatencySummary uplinkSummary;
+    LatencySummary downlinkSummary;
+    std::optional<ClockEstimate> clock;  // last estimate before the run ended
+    double elapsedS = 0.0;  // first recorded send to last ack
+    double msgsPerS = 0.0;   // recorded commands sent over elapsedS
+    double bytesPerS = 0.0;  // their frames, without transport framing
+    double framesPerWrite = 0.0;  // commands and probes per write, of the whole run
+    size_t numTimedOut = 0;  // lost commands or acks
+    size_t numUnmatchedAcks = 0;
+    size_t numDuplicateAcks = 0;
+    size_t numReorderedAcks = 0;
+    size_t numMalformedMsgs = 0;
+    size_t numDroppedIOEvents = 0;  // the runner never saw them, so round trips may be missing
+    BusyPollStats ioThread;  // of the thread running the benchmark, from connecting to the last ack
+    LatencyHistogram osJitter;  // wakeup latencies of the jitter test
+    LatencySummary osJitterSummary;
+};
+
+
+/**
+ * Accepts one device on the port (or shared memory segment) for config.connType and drives
+ * numWarmup + numCommands round trips without any gui, keeping up to
+ * maxInFlight commands outstanding. Returns 0 when every round trip completed.
+ */
+int runBenchmark(
+    const std::atomic<bool>& stopSignal,
+    const RunnerConfig& config,
+    RunnerReport& report);
+
+
+void printReport(std::ostream& os, const RunnerReport& report);
+
+// What busy polling removed from the round trips, against the cpu it burned.
+void printBusyPollComparison(std::ostream& os, const RunnerReport& blocking, const RunnerReport& busy);
+bool exportReportJson(const std::string& path, const RunnerReport& report);
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
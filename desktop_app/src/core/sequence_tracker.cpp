@@ -0,0 +1,102 @@
+#include "sequence_tracker.hpp"
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+static_assert((SequenceTracker::WINDOW & (SequenceTracker::WINDOW - 1)) == 0,
+    "WINDOW must be a power of two");
+
+
+SequenceTracker::SequenceTracker()
+{
+    reset();
+}
+
+
+SeqArrival SequenceTracker::record(uint32_t seq)
+{
+    if (!hasSeq_ || seq > highestSeq_)
+    {
+        // Forget the seqs that slide out of the window, bounded by its size.
+        uint32_t first = hasSeq_ ? highestSeq_ + 1 : 0;
+        if (seq - first >= WINDOW)
+        {
+            seen_.reset();
+        }
+        else
+        {
+            for (uint32_t s = first; s != seq; ++s)
+            {
+                seen_.reset(s & (WINDOW - 1));
+            }
+        }
+        seen_.set(seq & (WINDOW - 1));
+        highestSeq_ = seq;
+        hasSeq_ = true;
+        ++numReceived_;
+        return SeqArrival::IN_ORDER;
+    }
+
+    if (highestSeq_ - seq >= WINDOW)
+    {
+        ++numReceived_;
+        ++numReordered_;
+        return SeqArrival::TOO_OLD;
+    }
+    if (seen_.test(seq & (WINDOW - 1)))
+    {
+        ++numDuplicates_;
+        return SeqArrival::DUPLICATE;
+    }
+    seen_.set(seq & (WINDOW - 1));
+    ++numReceived_;
+    ++numReordered_;
+    return SeqArrival::REORDERED;
+}
+
+
+void SequenceTracker::reset()
+{
+    seen_.reset();
+    highestSeq_ = 0;
+    hasSeq_ = false;
+    numReceived_ = 0;
+    numDuplicates_ = 0;
+    numReordered_ = 0;
+}
+
+
+size_t SequenceTracker::numReceived() const
+{
+    return numReceived_;
+}
+
+
+size_t SequenceTracker::numDuplicates() const
+{
+    return numDuplicates_;
+}
+
+
+size_t SequenceTracker::numReordered() const
+{
+    return numReordered_;
+}
+
+
+size_t SequenceTracker::numMissing() const
+{
+    if (!hasSeq_)
+    {
+        return 0;
+    }
+    size_t expected = static_cast<size_t>(highestSeq_) + 1;
+    return expected > numReceived_ ? expected - numReceived_ : 0;
+}
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
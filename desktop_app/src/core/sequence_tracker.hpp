@@ -0,0 +1,54 @@
+#pragma once
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+enum class SeqArrival
+{
+    IN_ORDER,   // newer than anything seen so far, possibly after a gap
+    REORDERED,  // fills a gap behind the newest seq
+    DUPLICATE,  // already seen within the window
+    TOO_OLD,    // behind the window, can't tell reordered from duplicate
+};
+
+
+/**
+ * Classifies arriving sequence numbers, which start at 0 and increase by one
+ * per message. Keeps a bitmap of the last WINDOW seqs so duplicates and late
+ * arrivals can be told apart without storing every seq. Sequence numbers
+ * are assumed not to wrap within a run.
+ */
+class SequenceTracker
+{
+   public:
+    static constexpr size_t WINDOW = 1024;
+
+    SequenceTracker();
+
+    SeqArrival record(uint32_t seq);
+    void reset();
+
+    size_t numReceived() const;  // unique seqs, duplicates excluded
+    size_t numDuplicates() const;
+    size_t numReordered() const;  // includes TOO_OLD arrivals
+    // Seqs up to the newest one that have not arrived (yet).
+    size_t numMissing() const;
+
+   private:
+    std::bitset<WINDOW> seen_;
+    uint32_t highestSeq_;
+    bool hasSeq_;
+    size_t numReceived_;
+    size_t numDuplicates_;
+    size_t numReordered_;
+};
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
@@ -0,0 +1,282 @@
+#include "shm_link.hpp"
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+// How long the watcher sleeps between checks of its stop flag.
+constexpr std::chrono::milliseconds WATCHER_WAIT_TIMEOUT{100};
+
+
+// Not FUTEX_PRIVATE, the waiter and the waker may be different processes.
+static void futexWait(std::atomic<uint32_t>& word, uint32_t expected, std::chrono::nanoseconds timeout)
+{
+    timespec ts{};
+    ts.tv_sec = static_cast<time_t>(timeout.count() / 1'000'000'000);
+    ts.tv_nsec = static_cast<long>(timeout.count() % 1'000'000'000);
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected, &ts, nullptr, 0);
+}
+
+
+static void futexWakeAll(std::atomic<uint32_t>& word)
+{
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+}
+
+
+std::optional<ShmWaitMode> parseShmWaitMode(std::string_view str)
+{
+    if (str == "busy")
+    {
+        return ShmWaitMode::BUSY_POLL;
+    }
+    if (str == "futex")
+    {
+        return ShmWaitMode::FUTEX;
+    }
+    return std::nullopt;
+}
+
+
+bool ShmRing::tryPush(const uint8_t* frame, size_t length)
+{
+    uint32_t h = head.load(std::memory_order_relaxed);
+    if (length > MAX_FRAME_SIZE || h - tail.load(std::memory_order_acquire) == SHM_RING_CAPACITY)
+    {
+        return false;
+    }
+    auto& slot = slots[h % SHM_RING_CAPACITY];
+    slot.length = static_cast<uint32_t>(length);
+    std::memcpy(slot.data.data(), frame, length);
+    // Sequentially consistent with the consumer's flag, so either it sees the
+    // new head before sleeping or we see it waiting and wake it.
+    head.store(h + 1, std::memory_order_seq_cst);
+    if (isConsumerWaiting.load(std::memory_order_seq_cst) != 0)
+    {
+        futexWakeAll(head);
+    }
+    return true;
+}
+
+
+size_t ShmRing::tryPop(uint8_t* out)
+{
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if (head.load(std::memory_order_acquire) == t)
+    {
+        return 0;
+    }
+    const auto& slot = slots[t % SHM_RING_CAPACITY];
+    size_t length = std::min<size_t>(slot.length, MAX_FRAME_SIZE);
+    std::memcpy(out, slot.data.data(), length);
+    tail.store(t + 1, std::memory_order_release);
+    return length;
+}
+
+
+bool ShmRing::waitForPush(uint32_t seenHead, ShmWaitMode mode, std::chrono::microseconds timeout,
+    const std::atomic<bool>& stopSignal)
+{
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    if (mode == ShmWaitMode::BUSY_POLL)
+    {
+        while (head.load(std::memory_order_acquire) == seenHead)
+        {
+            if (stopSignal.load(std::memory_order_relaxed) || std::chrono::steady_clock::now() >= deadline)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    isConsumerWaiting.store(1, std::memory_order_seq_cst);
+    bool hasPush = true;
+    while (head.load(std::memory_order_seq_cst) == seenHead)
+    {
+        auto remaining = deadline - std::chrono::steady_clock::now();
+        if (stopSignal.load(std::memory_order_relaxed) || remaining <= std::chrono::nanoseconds::zero())
+        {
+            hasPush = false;
+            break;
+        }
+        // Returns at once if head already moved, so a push between the check and the wait isn't missed.
+        futexWait(head, seenHead, remaining);
+    }
+    isConsumerWaiting.store(0, std::memory_order_relaxed);
+    return hasPush;
+}
+
+
+void ShmRing::wakeConsumer()
+{
+    futexWakeAll(head);
+}
+
+
+ShmSegment::ShmSegment()
+    : layout_{nullptr},
+      isOwner_{false}
+{
+}
+
+
+ShmSegment::~ShmSegment()
+{
+    close();
+}
+
+
+bool ShmSegment::create(const std::string& name)
+{
+    close();
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+    {
+        std::cerr << "Failed to create shared memory " << name << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    void* addr = MAP_FAILED;
+    if (ftruncate(fd, sizeof(ShmSegmentLayout)) == 0)
+    {
+        addr = mmap(nullptr, sizeof(ShmSegmentLayout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (addr == MAP_FAILED)
+    {
+        std::cerr << "Failed to map shared memory " << name << ": " << std::strerror(errno) << std::endl;
+        shm_unlink(name.c_str());
+        return false;
+    }
+    // Zero filled by ftruncate, which is a valid state for every member.
+    layout_ = static_cast<ShmSegmentLayout*>(addr);
+    layout_->version.store(SHM_LAYOUT_VERSION, std::memory_order_release);
+    name_ = name;
+    isOwner_ = true;
+    return true;
+}
+
+
+bool ShmSegment::open(const std::string& name)
+{
+    close();
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat st{};
+    void* addr = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) == sizeof(ShmSegmentLayout))
+    {
+        addr = mmap(nullptr, sizeof(ShmSegmentLayout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (addr == MAP_FAILED)
+    {
+        return false;
+    }
+    auto* layout = static_cast<ShmSegmentLayout*>(addr);
+    if (layout->version.load(std::memory_order_acquire) != SHM_LAYOUT_VERSION ||
+        layout->isClosed.load(std::memory_order_acquire))
+    {
+        munmap(addr, sizeof(ShmSegmentLayout));
+        return false;
+    }
+    layout_ = layout;
+    name_ = name;
+    isOwner_ = false;
+    return true;
+}
+
+
+void ShmSegment::close()
+{
+    if (!layout_)
+    {
+        return;
+    }
+    if (isOwner_)
+    {
+        layout_->isClosed.store(true, std::memory_order_release);
+        layout_->toDevice.wakeConsumer();
+        shm_unlink(name_.c_str());
+    }
+    munmap(layout_, sizeof(ShmSegmentLayout));
+    layout_ = nullptr;
+    isOwner_ = false;
+}
+
+
+bool ShmSegment::isOpen() const
+{
+    return layout_ != nullptr;
+}
+
+
+ShmSegmentLayout& ShmSegment::layout()
+{
+    return *layout_;
+}
+
+
+ShmRingWatcher::ShmRingWatcher(ShmRing& ring, ShmWaitMode mode, std::function<void()> onPush)
+    : ring_{ring},
+      mode_{mode},
+      onPush_{std::move(onPush)},
+      isStopping_{false},
+      isNotified_{false},
+      thread_{[this]() { run(); }}
+{
+}
+
+
+ShmRingWatcher::~ShmRingWatcher()
+{
+    isStopping_.store(true, std::memory_order_relaxed);
+    ring_.wakeConsumer();
+    thread_.join();
+}
+
+
+void ShmRingWatcher::rearm()
+{
+    isNotified_.store(false, std::memory_order_release);
+}
+
+
+void ShmRingWatcher::run()
+{
+    uint32_t seenHead = ring_.tail.load(std::memory_order_acquire);
+    while (!isStopping_.load(std::memory_order_relaxed))
+    {
+        if (!ring_.waitForPush(seenHead, mode_, WATCHER_WAIT_TIMEOUT, isStopping_))
+        {
+            continue;
+        }
+        seenHead = ring_.head.load(std::memory_order_acquire);
+        if (!isNotified_.exchange(true, std::memory_order_acq_rel))
+        {
+            onPush_();
+        }
+    }
+}
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
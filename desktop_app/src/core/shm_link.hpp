@@ -0,0 +1,155 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "messages.hpp"
+#include "spsc_queue.hpp"
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+constexpr char DEFAULT_SHM_NAME[] = "/teleop_led_benchmarks";
+constexpr size_t SHM_RING_CAPACITY = 256;  // frames per direction
+constexpr uint32_t SHM_LAYOUT_VERSION = 1;
+
+
+// How a ring's consumer waits for the producer.
+enum class ShmWaitMode
+{
+    BUSY_POLL,  // spins on the ring, no syscalls on either side but burns a core
+    FUTEX,      // sleeps in the kernel, the producer wakes it only while it sleeps
+};
+
+
+// "busy" or "futex", as taken by --shm-wait.
+std::optional<ShmWaitMode> parseShmWaitMode(std::string_view str);
+
+
+struct ShmFrameSlot
+{
+    uint32_t length;
+    std::array<uint8_t, MAX_FRAME_SIZE> data;
+};
+
+
+/**
+ * Single producer single consumer ring of whole frames, living in shared
+ * memory so the two sides can be different processes. The indices only
+ * grow and head doubles as the futex word a sleeping consumer waits on.
+ */
+struct ShmRing
+{
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> head;  // written by the producer
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> tail;  // written by the consumer
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> isConsumerWaiting;
+    alignas(CACHE_LINE_SIZE) std::array<ShmFrameSlot, SHM_RING_CAPACITY> slots;
+
+    // Producer only. Returns false when full, and wakes the consumer if it sleeps.
+    bool tryPush(const uint8_t* frame, size_t length);
+    // Consumer only. Copies the oldest frame into out, of MAX_FRAME_SIZE, and returns its length or 0.
+    size_t tryPop(uint8_t* out);
+
+    /**
+     * Consumer only. Waits until head moves past seenHead, the timeout passes
+     * or stopSignal is set, and returns whether head moved. A consumer that
+     * has drained the ring passes its tail.
+     */
+    bool waitForPush(uint32_t seenHead, ShmWaitMode mode, std::chrono::microseconds timeout,
+        const std::atomic<bool>& stopSignal);
+
+    // Wakes a sleeping consumer regardless of the ring, to see a stop signal.
+    void wakeConsumer();
+};
+
+
+/**
+ * The desktop creates the segment and sets version last. The device opens
+ * it, discards stale commands and says hello through toDesktop. isClosed
+ * tells a device to let go and wait for the desktop's next segment.
+ */
+struct ShmSegmentLayout
+{
+    std::atomic<uint32_t> version;  // SHM_LAYOUT_VERSION once initialized
+    std::atomic<bool> isClosed;
+    ShmRing toDevice;
+    ShmRing toDesktop;
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<bool>::is_always_lock_free,
+    "atomics shared between processes must not hide a lock");
+
+
+/**
+ * A mapping of the POSIX shared memory segment name. The creator owns the
+ * name and unlinks it on close, the other side only unmaps.
+ */
+class ShmSegment
+{
+   public:
+    ShmSegment();
+    ~ShmSegment();
+    ShmSegment(const ShmSegment& other) = delete;
+    ShmSegment& operator=(const ShmSegment& other) = delete;
+    ShmSegment(ShmSegment&& other) = delete;
+    ShmSegment& operator=(ShmSegment&& other) = delete;
+
+    // Replaces any segment left behind under name, e.g. by a crashed run.
+    bool create(const std::string& name);
+    // Fails until the creator has initialized the segment.
+    bool open(const std::string& name);
+    // Marks the segment closed and wakes the peer first when owned.
+    void close();
+
+    bool isOpen() const;
+    ShmSegmentLayout& layout();
+
+   private:
+    std::string name_;
+    ShmSegmentLayout* layout_;
+    bool isOwner_;
+};
+
+
+/**
+ * Waits on a ring's consumer side on its own thread and calls onPush from
+ * there when the producer pushed. Calls are coalesced until rearm(), so
+ * onPush can post a drain to the thread that owns the ring's consumer side,
+ * which calls rearm() before it starts popping.
+ */
+class ShmRingWatcher
+{
+   public:
+    ShmRingWatcher(ShmRing& ring, ShmWaitMode mode, std::function<void()> onPush);
+    ~ShmRingWatcher();  // stops and joins the thread
+    ShmRingWatcher(const ShmRingWatcher& other) = delete;
+    ShmRingWatcher& operator=(const ShmRingWatcher& other) = delete;
+    ShmRingWatcher(ShmRingWatcher&& other) = delete;
+    ShmRingWatcher& operator=(ShmRingWatcher&& other) = delete;
+
+    void rearm();
+
+   private:
+    void run();
+
+    ShmRing& ring_;
+    ShmWaitMode mode_;
+    std::function<void()> onPush_;
+    std::atomic<bool> isStopping_;
+    std::atomic<bool> isNotified_;
+    std::thread thread_;
+};
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
@@ -0,0 +1,178 @@
+#include "socket_profile.hpp"
+
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include "messages.hpp"
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+// Well below the defaults, so a burst queues in the application rather than the kernel.
+constexpr int SMALL_SOCKET_BUF_BYTES = 8 * 1024;
+constexpr int BUSY_POLL_US = 50;
+
+
+static std::vector<SocketProfile> makeSocketProfiles()
+{
+    SocketProfile none{};
+    none.name = "default";
+
+    SocketProfile noDelay{};
+    noDelay.name = "nodelay";
+    noDelay.noDelay = true;
+
+    SocketProfile quickAck = noDelay;
+    quickAck.name = "quickack";
+    quickAck.quickAck = true;
+
+    SocketProfile busyPoll = noDelay;
+    busyPoll.name = "busypoll";
+    busyPoll.busyPollUs = BUSY_POLL_US;
+
+    // Every frame has a header, so a read never wakes up for less than one.
+    SocketProfile lowat = noDelay;
+    lowat.name = "lowat";
+    lowat.rcvLowatBytes = static_cast<int>(FRAME_HEADER_SIZE);
+
+    SocketProfile smallBuf = noDelay;
+    smallBuf.name = "smallbuf";
+    smallBuf.sndBufBytes = SMALL_SOCKET_BUF_BYTES;
+    smallBuf.rcvBufBytes = SMALL_SOCKET_BUF_BYTES;
+
+    SocketProfile dscp = noDelay;
+    dscp.name = "dscp-ef";
+    dscp.tos = TOS_DSCP_EF;
+
+    SocketProfile all = noDelay;
+    all.name = "all";
+    all.quickAck = true;
+    all.busyPollUs = BUSY_POLL_US;
+    all.rcvLowatBytes = static_cast<int>(FRAME_HEADER_SIZE);
+    all.sndBufBytes = SMALL_SOCKET_BUF_BYTES;
+    all.rcvBufBytes = SMALL_SOCKET_BUF_BYTES;
+    all.tos = TOS_DSCP_EF;
+
+    return {none, noDelay, quickAck, busyPoll, lowat, smallBuf, dscp, all};
+}
+
+
+SocketProfile SocketProfile::effective(bool isTcp) const
+{
+    SocketProfile p = *this;
+    p.name.clear();
+    if (!isTcp)
+    {
+        p.noDelay = false;
+        p.quickAck = false;
+        p.rcvLowatBytes = 0;
+    }
+    return p;
+}
+
+
+bool SocketProfile::hasSameOptions(const SocketProfile& other) const
+{
+    return noDelay == other.noDelay && quickAck == other.quickAck && busyPollUs == other.busyPollUs &&
+           rcvLowatBytes == other.rcvLowatBytes && sndBufBytes == other.sndBufBytes &&
+           rcvBufBytes == other.rcvBufBytes && tos == other.tos;
+}
+
+
+const std::vector<SocketProfile>& socketProfiles()
+{
+    static const std::vector<SocketProfile> profiles = makeSocketProfiles();
+    return profiles;
+}
+
+
+std::optional<SocketProfile> findSocketProfile(std::string_view name)
+{
+    for (const auto& profile : socketProfiles())
+    {
+        if (profile.name == name)
+        {
+            return profile;
+        }
+    }
+    return std::nullopt;
+}
+
+
+static bool setIntOption(int fd, int level, int option, int value, const char* optionName)
+{
+    if (setsockopt(fd, level, option, &value, sizeof(value)) == 0)
+    {
+        return true;
+    }
+    std::cerr << "Failed to set " << optionName << " to " << value << ": " << std::strerror(errno) << std::endl;
+    return false;
+}
+
+
+bool applySocketProfile(int fd, const SocketProfile& profile)
+{
+    int type = 0;
+    socklen_t typeSize = sizeof(type);
+    getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &typeSize);
+    sockaddr_storage addr{};
+    socklen_t addrSize = sizeof(addr);
+    getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &addrSize);
+    bool isTcp = type == SOCK_STREAM;
+
+    bool isApplied = true;
+    if (isTcp && profile.noDelay)
+    {
+        isApplied &= setIntOption(fd, IPPROTO_TCP, TCP_NODELAY, 1, "TCP_NODELAY");
+    }
+    if (isTcp && profile.quickAck)
+    {
+        isApplied &= setIntOption(fd, IPPROTO_TCP, TCP_QUICKACK, 1, "TCP_QUICKACK");
+    }
+    if (isTcp && profile.rcvLowatBytes > 0)
+    {
+        isApplied &= setIntOption(fd, SOL_SOCKET, SO_RCVLOWAT, profile.rcvLowatBytes, "SO_RCVLOWAT");
+    }
+    if (profile.busyPollUs > 0)
+    {
+        isApplied &= setIntOption(fd, SOL_SOCKET, SO_BUSY_POLL, profile.busyPollUs, "SO_BUSY_POLL");
+    }
+    if (profile.sndBufBytes > 0)
+    {
+        isApplied &= setIntOption(fd, SOL_SOCKET, SO_SNDBUF, profile.sndBufBytes, "SO_SNDBUF");
+    }
+    if (profile.rcvBufBytes > 0)
+    {
+        isApplied &= setIntOption(fd, SOL_SOCKET, SO_RCVBUF, profile.rcvBufBytes, "SO_RCVBUF");
+    }
+    if (profile.tos > 0)
+    {
+        isApplied &= addr.ss_family == AF_INET6
+            ? setIntOption(fd, IPPROTO_IPV6, IPV6_TCLASS, profile.tos, "IPV6_TCLASS")
+            : setIntOption(fd, IPPROTO_IP, IP_TOS, profile.tos, "IP_TOS");
+    }
+    return isApplied;
+}
+
+
+void rearmQuickAck(int fd, const SocketProfile& profile)
+{
+    if (profile.quickAck)
+    {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_QUICKACK, &one, sizeof(one));
+    }
+}
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
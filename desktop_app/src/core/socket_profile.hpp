@@ -0,0 +1,55 @@
+#pragma once
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+/**
+ * Socket options applied to every socket of one side of the link. Zero or
+ * false leaves the kernel's default. Tcp only options are skipped on udp
+ * sockets.
+ */
+struct SocketProfile
+{
+    std::string name;
+    bool noDelay = false;   // TCP_NODELAY, what the esp32 sets
+    bool quickAck = false;  // TCP_QUICKACK, cleared by the kernel so re-armed after every read
+    int busyPollUs = 0;     // SO_BUSY_POLL, spin on the device queue before sleeping in a read
+    int rcvLowatBytes = 0;  // SO_RCVLOWAT, tcp reads wait for at least this much
+    int sndBufBytes = 0;    // SO_SNDBUF, the kernel doubles it
+    int rcvBufBytes = 0;    // SO_RCVBUF
+    int tos = 0;            // IP_TOS or IPV6_TCLASS, the DSCP is the upper 6 bits
+
+    // Without the name and the options that don't apply to the socket type.
+    SocketProfile effective(bool isTcp) const;
+    bool hasSameOptions(const SocketProfile& other) const;
+};
+
+
+// DSCP 46, expedited forwarding, shifted into the tos byte.
+constexpr int TOS_DSCP_EF = 46 << 2;
+
+
+// default, nodelay, quickack, busypoll, lowat, smallbuf, dscp-ef and all.
+const std::vector<SocketProfile>& socketProfiles();
+std::optional<SocketProfile> findSocketProfile(std::string_view name);
+
+/**
+ * Applies every option set in profile to the socket fd, on either side of
+ * the link. Logs and skips options the kernel refuses, e.g. SO_BUSY_POLL
+ * without CAP_NET_ADMIN, and returns false if there were any.
+ */
+bool applySocketProfile(int fd, const SocketProfile& profile);
+
+// After a read on a tcp socket, when profile.quickAck is set.
+void rearmQuickAck(int fd, const SocketProfile& profile);
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
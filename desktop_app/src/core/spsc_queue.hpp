@@ -0,0 +1,108 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+
+/**
+ * Bounded lock-free single producer single consumer queue.
+ * Slots are allocated once at construction. tryPush may only be called from
+ * one thread and tryPop from one (possibly different) thread.
+ */
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+        "Capacity must be a power of two");
+
+   public:
+    SpscQueue()
+        : slots_(std::make_unique<T[]>(Capacity))
+    {
+    }
+
+    SpscQueue(const SpscQueue& other) = delete;
+    SpscQueue& operator=(const SpscQueue& other) = delete;
+    SpscQueue(SpscQueue&& other) = delete;
+    SpscQueue& operator=(SpscQueue&& other) = delete;
+
+    // Producer only. Returns false without moving from value when full.
+    bool tryPush(T&& value)
+    {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cachedHead_ == Capacity)
+        {
+            cachedHead_ = head_.load(std::memory_order_acquire);
+            if (tail - cachedHead_ == Capacity)
+            {
+                return false;
+            }
+        }
+        slots_[tail & MASK] = std::move(value);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPush(const T& value)
+    {
+        T copy = value;
+        return tryPush(std::move(copy));
+    }
+
+    // Consumer only. Returns false when empty.
+    bool tryPop(T& out)
+    {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head == cachedTail_)
+        {
+            cachedTail_ = tail_.load(std::memory_order_acquire);
+            if (head == cachedTail_)
+            {
+                return false;
+            }
+        }
+        out = std::move(slots_[head & MASK]);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Approximate when called concurrently with the other side.
+    size_t size() const
+    {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    static constexpr size_t capacity()
+    {
+        return Capacity;
+    }
+
+   private:
+    static constexpr size_t MASK = Capacity - 1;
+
+    // Producer and consumer indices live on separate cache lines, each next to
+    // the side's cached copy of the other index, to avoid false sharing.
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail_{0};
+    size_t cachedHead_ = 0;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> head_{0};
+    size_t cachedTail_ = 0;
+    alignas(CACHE_LINE_SIZE) std::unique_ptr<T[]> slots_;
+};
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
@@ -0,0 +1,159 @@
+#include "thread_tuning.hpp"
+
+#include <alloca.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+// Calls f with each cpu of a list like "2-3,6", the format of the kernel's cpu lists.
+template <typename F>
+static bool forEachCpuInList(const std::string& list, F&& f)
+{
+    std::istringstream ranges{list};
+    std::string range;
+    while (std::getline(ranges, range, ','))
+    {
+        try
+        {
+            size_t dash = range.find('-');
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last; ++cpu)
+            {
+                f(cpu);
+            }
+        }
+        catch (const std::exception&)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+static bool isCpuIsolated(int cpu)
+{
+    std::ifstream in{"/sys/devices/system/cpu/isolated"};
+    std::string list;
+    std::getline(in, list);
+    bool isIsolated = false;
+    forEachCpuInList(list, [&](int isolated) { isIsolated |= isolated == cpu; });
+    return isIsolated;
+}
+
+
+std::optional<std::vector<int>> parseCpuList(std::string_view str)
+{
+    std::vector<int> cpus;
+    bool isValid = forEachCpuInList(std::string(str), [&](int cpu) { cpus.push_back(cpu); });
+    if (!isValid || cpus.empty() ||
+        std::any_of(cpus.begin(), cpus.end(), [](int cpu) { return cpu < 0 || cpu >= CPU_SETSIZE; }))
+    {
+        return std::nullopt;
+    }
+    return cpus;
+}
+
+
+static bool pinThreadToCpu(int cpu)
+{
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    if (err != 0)
+    {
+        std::cerr << "Failed to pin thread to cpu " << cpu << ": " << std::strerror(err) << std::endl;
+        return false;
+    }
+    if (!isCpuIsolated(cpu))
+    {
+        std::cerr << "cpu " << cpu << " isn't isolated, other tasks can still run on it" << std::endl;
+    }
+    return true;
+}
+
+
+// Touches the pages below the caller's frame, locked in place by mlockall's MCL_FUTURE.
+static void prefaultStack(size_t numBytes)
+{
+    auto* stack = static_cast<volatile uint8_t*>(alloca(numBytes));
+    for (size_t i = 0; i < numBytes; i += 4096)
+    {
+        stack[i] = 0;
+    }
+}
+
+
+bool applyThreadTuning(const ThreadTuning& tuning, size_t threadIndex)
+{
+    bool isApplied = true;
+    if (!tuning.cpus.empty())
+    {
+        isApplied &= pinThreadToCpu(tuning.cpus[threadIndex % tuning.cpus.size()]);
+    }
+    if (tuning.isMemoryLocked && mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    {
+        std::cerr << "Failed to lock memory: " << std::strerror(errno) << std::endl;
+        isApplied = false;
+    }
+    if (tuning.stackPrefaultBytes > 0)
+    {
+        prefaultStack(std::min(tuning.stackPrefaultBytes, MAX_STACK_PREFAULT_BYTES));
+    }
+    // Last, so a refused lock doesn't leave a real time thread faulting in pages.
+    if (tuning.fifoPriority > 0)
+    {
+        sched_param param{};
+        param.sched_priority = tuning.fifoPriority;
+        int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (err != 0)
+        {
+            std::cerr << "Failed to set SCHED_FIFO priority " << tuning.fifoPriority << ": " << std::strerror(err)
+                      << std::endl;
+            isApplied = false;
+        }
+    }
+    return isApplied;
+}
+
+
+void runJitterTest(const JitterTestConfig& config, LatencyHistogram& wakeupLatencies)
+{
+    auto toNs = [](const timespec& ts) { return int64_t{ts.tv_sec} * 1'000'000'000 + ts.tv_nsec; };
+    int64_t intervalNs = std::chrono::duration_cast<std::chrono::nanoseconds>(config.interval).count();
+    timespec deadline{};
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    for (size_t i = 0; i < config.numWakeups; ++i)
+    {
+        int64_t deadlineNs = toNs(deadline) + intervalNs;
+        deadline.tv_sec = static_cast<time_t>(deadlineNs / 1'000'000'000);
+        deadline.tv_nsec = static_cast<long>(deadlineNs % 1'000'000'000);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR)
+        {
+        }
+        timespec now{};
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        wakeupLatencies.record(static_cast<uint64_t>(std::max<int64_t>(toNs(now) - deadlineNs, 0) / 1000));
+    }
+}
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
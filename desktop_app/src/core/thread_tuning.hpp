@@ -0,0 +1,60 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "latency_histogram.hpp"
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+// Largest stack prefault, well within the 8 MiB default thread stack.
+constexpr size_t MAX_STACK_PREFAULT_BYTES = 4 * 1024 * 1024;
+
+
+/**
+ * Keeps the scheduler and the pager away from an io thread. Everything is
+ * opt-in, and what the system doesn't permit is logged and skipped.
+ */
+struct ThreadTuning
+{
+    std::vector<int> cpus;      // thread i of a pool is pinned to cpus[i % size], empty leaves it unpinned
+    int fifoPriority = 0;       // SCHED_FIFO priority, 1 to 99, 0 keeps the default policy
+    bool isMemoryLocked = false;  // mlockall, current and future pages, for the whole process
+    size_t stackPrefaultBytes = 0;  // stack touched up front so it doesn't fault mid run
+};
+
+
+// "2" or "2-3,6", as taken by --cpu.
+std::optional<std::vector<int>> parseCpuList(std::string_view str);
+
+/**
+ * Applies tuning to the calling thread, the threadIndex-th of its pool.
+ * Returns false if any part of it was refused, e.g. SCHED_FIFO without
+ * CAP_SYS_NICE or mlockall over RLIMIT_MEMLOCK, after applying the rest.
+ */
+bool applyThreadTuning(const ThreadTuning& tuning, size_t threadIndex = 0);
+
+
+struct JitterTestConfig
+{
+    size_t numWakeups = 0;  // 0 skips the test
+    std::chrono::microseconds interval{1000};
+};
+
+
+/**
+ * cyclictest style: sleeps until absolute deadlines interval apart on the
+ * calling thread and records how late each wakeup was, in us. Run on a
+ * tuned io thread it shows the noise the OS alone adds to a round trip.
+ */
+void runJitterTest(const JitterTestConfig& config, LatencyHistogram& wakeupLatencies);
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
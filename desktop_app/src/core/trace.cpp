@@ -0,0 +1,202 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <nlohmann/json.hpp>
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+static size_t roundUpToPowerOfTwo(size_t n)
+{
+    size_t p = 1;
+    while (p < n)
+    {
+        p <<= 1;
+    }
+    return p;
+}
+
+
+TraceBuffer::TraceBuffer(size_t capacity)
+    : records_{std::make_unique<TraceRecord[]>(roundUpToPowerOfTwo(std::max<size_t>(capacity, 1)))},
+      mask_{roundUpToPowerOfTwo(std::max<size_t>(capacity, 1)) - 1},
+      numRecorded_{0}
+{
+}
+
+
+size_t TraceBuffer::capacity() const
+{
+    return mask_ + 1;
+}
+
+
+size_t TraceBuffer::size() const
+{
+    return std::min(numRecorded_, capacity());
+}
+
+
+size_t TraceBuffer::numOverwritten() const
+{
+    return numRecorded_ - size();
+}
+
+
+struct StageTimes
+{
+    std::array<uint64_t, NUM_TRACE_STAGES> timeNs{};
+    std::array<bool, NUM_TRACE_STAGES> isRecorded{};
+
+    bool has(TraceStage stage) const
+    {
+        return isRecorded[static_cast<size_t>(stage)];
+    }
+
+    uint64_t& at(TraceStage stage)
+    {
+        return timeNs[static_cast<size_t>(stage)];
+    }
+};
+
+
+// Moves the device stages onto the desktop clock, or drops them if they can't fit.
+static void placeDeviceStages(StageTimes& t, const std::optional<ClockEstimate>& clock)
+{
+    const bool hasDevice = t.has(TraceStage::DEVICE_RECEIVED) && t.has(TraceStage::DEVICE_ACK_SENT);
+    const bool hasWire = t.has(TraceStage::NET_WRITTEN) && t.has(TraceStage::NET_ACK_READ);
+    if (hasDevice && hasWire)
+    {
+        uint64_t written = t.at(TraceStage::NET_WRITTEN);
+        uint64_t ackRead = t.at(TraceStage::NET_ACK_READ);
+        uint64_t received = t.at(TraceStage::DEVICE_RECEIVED);
+        uint64_t ackSent = t.at(TraceStage::DEVICE_ACK_SENT);
+        if (ackSent >= received && ackRead >= written && ackSent - received <= ackRead - written)
+        {
+            uint64_t deviceNs = ackSent - received;
+            uint64_t placedNs = written + (ackRead - written - deviceNs) / 2;
+            if (clock)
+            {
+                // Keep it within the round trip even if the estimate is off by its error bound.
+                auto mappedUs = clock->deviceToDesktopUs(static_cast<int64_t>(received / 1000));
+                placedNs = std::clamp(static_cast<uint64_t>(std::max<int64_t>(mappedUs, 0)) * 1000,
+                    written, ackRead - deviceNs);
+            }
+            t.at(TraceStage::DEVICE_RECEIVED) = placedNs;
+            t.at(TraceStage::DEVICE_ACK_SENT) = t.at(TraceStage::DEVICE_RECEIVED) + deviceNs;
+            return;
+        }
+    }
+    t.isRecorded[static_cast<size_t>(TraceStage::DEVICE_RECEIVED)] = false;
+    t.isRecorded[static_cast<size_t>(TraceStage::DEVICE_ACK_SENT)] = false;
+}
+
+
+std::vector<TraceSpan> buildTraceSpans(const std::vector<const TraceBuffer*>& buffers,
+    const std::optional<ClockEstimate>& clock)
+{
+    // Later records of the same stage win, e.g. after the ring wrapped around.
+    std::map<uint32_t, StageTimes> commands;
+    for (const TraceBuffer* buffer : buffers)
+    {
+        if (buffer == nullptr)
+        {
+            continue;
+        }
+        buffer->forEach([&commands](const TraceRecord& rec)
+            {
+                auto& t = commands[rec.seq];
+                t.at(rec.stage) = rec.timeNs;
+                t.isRecorded[static_cast<size_t>(rec.stage)] = true;
+            });
+    }
+
+    std::vector<TraceSpan> spans;
+    for (auto& [seq, t] : commands)
+    {
+        placeDeviceStages(t, clock);
+        bool hasPrev = false;
+        TraceStage prev = TraceStage::UI_INPUT_POLLED;
+        for (size_t i = 0; i < NUM_TRACE_STAGES; ++i)
+        {
+            auto stage = static_cast<TraceStage>(i);
+            if (!t.has(stage))
+            {
+                continue;
+            }
+            if (hasPrev)
+            {
+                spans.push_back(TraceSpan{seq, prev, stage, t.at(prev), std::max(t.at(prev), t.at(stage))});
+            }
+            prev = stage;
+            hasPrev = true;
+        }
+    }
+    std::stable_sort(spans.begin(), spans.end(), [](const TraceSpan& a, const TraceSpan& b)
+        { return a.startNs < b.startNs; });
+    return spans;
+}
+
+
+void writeChromeTrace(std::ostream& os, const std::vector<TraceSpan>& spans)
+{
+    uint64_t originNs = spans.empty() ? 0 : spans.front().startNs;
+    auto events = nlohmann::json::array();
+    for (const auto& span : spans)
+    {
+        // Async begin/end pairs sharing the seq as id stack each command's stages on one row.
+        nlohmann::json begin = {
+            {"name", std::string(TRACE_STAGE_STRINGS[static_cast<size_t>(span.to)])},
+            {"cat", "command"},
+            {"ph", "b"},
+            {"id", span.seq},
+            {"pid", 1},
+            {"tid", 1},
+            {"ts", static_cast<double>(span.startNs - originNs) / 1000.0},
+            {"args", {{"seq", span.seq},
+                         {"from", std::string(TRACE_STAGE_STRINGS[static_cast<size_t>(span.from)])}}},
+        };
+        nlohmann::json end = begin;
+        end["ph"] = "e";
+        end["ts"] = static_cast<double>(span.endNs - originNs) / 1000.0;
+        end.erase("args");
+        events.push_back(std::move(begin));
+        events.push_back(std::move(end));
+    }
+    nlohmann::json j;
+    j["traceEvents"] = std::move(events);
+    j["displayTimeUnit"] = "ms";
+    os << j.dump() << '\n';
+}
+
+
+bool exportChromeTrace(const std::string& path, const std::vector<const TraceBuffer*>& buffers,
+    const std::optional<ClockEstimate>& clock)
+{
+    for (const TraceBuffer* buffer : buffers)
+    {
+        if (buffer != nullptr && buffer->numOverwritten() > 0)
+        {
+            std::cerr << "trace buffer wrapped, oldest " << buffer->numOverwritten()
+                      << " records are lost" << std::endl;
+        }
+    }
+    std::ofstream out{path};
+    if (!out)
+    {
+        std::cerr << "Failed to open " << path << std::endl;
+        return false;
+    }
+    writeChromeTrace(out, buildTraceSpans(buffers, clock));
+    return static_cast<bool>(out);
+}
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
@@ -0,0 +1,140 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "clock_sync.hpp"
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+/**
+ * Points in a command's life, in the order they happen. Device stages are
+ * stamped with the device's clock, everything else with the desktop's
+ * steady clock.
+ */
+enum class TraceStage : uint8_t
+{
+    UI_INPUT_POLLED,  // glfwPollEvents of the frame that saw the click
+    UI_QUEUED,        // pushed to uiEventsToProcess
+    UI_DISPATCHED,    // handleSendButtonClick posted it to the network thread
+    NET_QUEUED,       // sendBlinkCommand assigned its seq
+    NET_WRITTEN,      // write completion
+    DEVICE_RECEIVED,
+    DEVICE_ACK_SENT,
+    NET_ACK_READ,  // read completion that matched the ack
+    UI_APPLIED,    // drained from ioEvents by the render loop
+    UI_PRESENTED,  // swap of the frame that showed the result
+};
+
+
+constexpr size_t NUM_TRACE_STAGES = 10;
+constexpr std::array<std::string_view, NUM_TRACE_STAGES> TRACE_STAGE_STRINGS = {"input polled",
+    "queued", "dispatched", "net queued", "written", "device received", "device ack sent",
+    "ack read", "applied", "presented"};
+
+
+struct TraceRecord
+{
+    uint64_t timeNs;
+    uint32_t seq;
+    TraceStage stage;
+};
+
+
+inline uint64_t steadyClockNs(std::chrono::steady_clock::time_point t)
+{
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count());
+}
+
+
+/**
+ * Fixed-size ring of trace records for one writer thread. Recording is a
+ * store and an increment; once full the oldest records are overwritten.
+ * Read it only after the writer has stopped.
+ */
+class TraceBuffer
+{
+   public:
+    // Capacity is rounded up to a power of two.
+    explicit TraceBuffer(size_t capacity);
+
+    ~TraceBuffer() = default;
+    TraceBuffer(const TraceBuffer& other) = delete;
+    TraceBuffer& operator=(const TraceBuffer& other) = delete;
+    TraceBuffer(TraceBuffer&& other) = delete;
+    TraceBuffer& operator=(TraceBuffer&& other) = delete;
+
+    void record(TraceStage stage, uint32_t seq, uint64_t timeNs)
+    {
+        records_[numRecorded_ & mask_] = TraceRecord{timeNs, seq, stage};
+        ++numRecorded_;
+    }
+
+    void record(TraceStage stage, uint32_t seq, std::chrono::steady_clock::time_point t)
+    {
+        record(stage, seq, steadyClockNs(t));
+    }
+
+    size_t capacity() const;
+    size_t size() const;
+    size_t numOverwritten() const;
+
+    // Calls f(const TraceRecord&) for the retained records, oldest first.
+    template <typename F>
+    void forEach(F&& f) const
+    {
+        for (size_t i = numRecorded_ - size(); i < numRecorded_; ++i)
+        {
+            f(records_[i & mask_]);
+        }
+    }
+
+   private:
+    std::unique_ptr<TraceRecord[]> records_;
+    size_t mask_;
+    size_t numRecorded_;
+};
+
+
+// Time between two consecutive recorded stages of one command, in desktop clock.
+struct TraceSpan
+{
+    uint32_t seq;
+    TraceStage from;
+    TraceStage to;
+    uint64_t startNs;
+    uint64_t endNs;
+};
+
+
+/**
+ * Joins the records of all buffers by seq and turns each command's stages
+ * into consecutive spans. Device stages are mapped onto the desktop clock
+ * with clock when given. Without it they are placed by assuming equal uplink
+ * and downlink time, centering the device's own processing time between
+ * write and ack read. Either way they are dropped when the device claims
+ * more time than the round trip allows.
+ */
+std::vector<TraceSpan> buildTraceSpans(const std::vector<const TraceBuffer*>& buffers,
+    const std::optional<ClockEstimate>& clock = std::nullopt);
+
+// Chrome trace event format, one async track per command, viewable in chrome://tracing or Perfetto.
+void writeChromeTrace(std::ostream& os, const std::vector<TraceSpan>& spans);
+bool exportChromeTrace(const std::string& path, const std::vector<const TraceBuffer*>& buffers,
+    const std::optional<ClockEstimate>& clock = std::nullopt);
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
@@ -0,0 +1,322 @@
+#include "uring_link.hpp"
+
+#include <linux/io_uring.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+// A write, the read linked behind it and the write's remainder after a short write.
+constexpr unsigned URING_ENTRIES = 4;
+constexpr unsigned WRITE_BUF_INDEX = 0;
+constexpr unsigned READ_BUF_INDEX = 1;
+
+
+// The ring indices are shared with the kernel, which reads and writes them without our atomics.
+static uint32_t loadAcquire(const uint8_t* ring, uint32_t offset)
+{
+    return __atomic_load_n(reinterpret_cast<const uint32_t*>(ring + offset), __ATOMIC_ACQUIRE);
+}
+
+
+static void storeRelease(uint8_t* ring, uint32_t offset, uint32_t value)
+{
+    __atomic_store_n(reinterpret_cast<uint32_t*>(ring + offset), value, __ATOMIC_RELEASE);
+}
+
+
+// The op in the top byte, the caller's tag below it.
+static uint64_t makeUserData(UringOp op, uint64_t tag)
+{
+    return (uint64_t{static_cast<uint8_t>(op)} << 56) | tag;
+}
+
+
+std::optional<TcpIoBackend> parseTcpIoBackend(std::string_view str)
+{
+    if (str == "epoll")
+    {
+        return TcpIoBackend::REACTOR;
+    }
+    if (str == "io_uring")
+    {
+        return TcpIoBackend::IO_URING;
+    }
+    return std::nullopt;
+}
+
+
+UringLink::UringLink()
+    : ringFd_{-1},
+      sockFd_{-1},
+      rings_{nullptr},
+      ringsSize_{0},
+      sqes_{nullptr},
+      sqesSize_{0},
+      sqTailOffset_{0},
+      sqMask_{0},
+      cqHeadOffset_{0},
+      cqTailOffset_{0},
+      cqesOffset_{0},
+      cqMask_{0},
+      writeBuf_{nullptr},
+      readBuf_{nullptr},
+      readBufSize_{0},
+      writeLength_{0},
+      writeOffset_{0},
+      writeTag_{0},
+      isWriteQueued_{false},
+      isWriteInFlight_{false},
+      isReadQueued_{false},
+      isReadInFlight_{false},
+      numEnters_{0}
+{
+}
+
+
+UringLink::~UringLink()
+{
+    close();
+}
+
+
+bool UringLink::open(int fd, uint8_t* writeBuf, size_t writeBufSize, uint8_t* readBuf, size_t readBufSize)
+{
+    close();
+    io_uring_params params{};
+    int ringFd = static_cast<int>(syscall(__NR_io_uring_setup, URING_ENTRIES, &params));
+    if (ringFd < 0)
+    {
+        std::cerr << "Failed to set up io_uring: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    // Waiting with a timeout needs IORING_ENTER_EXT_ARG, linux 5.11.
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_EXT_ARG))
+    {
+        std::cerr << "io_uring lacks single mmap or ext arg, linux 5.11 or later is needed" << std::endl;
+        ::close(ringFd);
+        return false;
+    }
+    ringFd_ = ringFd;
+
+    ringsSize_ = std::max<size_t>(params.sq_off.array + params.sq_entries * sizeof(uint32_t),
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+    void* rings = mmap(nullptr, ringsSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_,
+        IORING_OFF_SQ_RING);
+    if (rings == MAP_FAILED)
+    {
+        std::cerr << "Failed to map io_uring: " << std::strerror(errno) << std::endl;
+        ::close(ringFd_);
+        ringFd_ = -1;
+        return false;
+    }
+    rings_ = static_cast<uint8_t*>(rings);
+    sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES);
+    if (sqes_ == MAP_FAILED)
+    {
+        std::cerr << "Failed to map io_uring entries: " << std::strerror(errno) << std::endl;
+        sqes_ = nullptr;
+        close();
+        return false;
+    }
+    sqTailOffset_ = params.sq_off.tail;
+    sqMask_ = *reinterpret_cast<const uint32_t*>(rings_ + params.sq_off.ring_mask);
+    cqHeadOffset_ = params.cq_off.head;
+    cqTailOffset_ = params.cq_off.tail;
+    cqesOffset_ = params.cq_off.cqes;
+    cqMask_ = *reinterpret_cast<const uint32_t*>(rings_ + params.cq_off.ring_mask);
+    // Submission slot i always holds entry i.
+    auto* sqArray = reinterpret_cast<uint32_t*>(rings_ + params.sq_off.array);
+    for (uint32_t i = 0; i < params.sq_entries; ++i)
+    {
+        sqArray[i] = i;
+    }
+
+    // Pinned once here instead of on every op.
+    std::array<iovec, 2> buffers{};
+    buffers[WRITE_BUF_INDEX] = {writeBuf, writeBufSize};
+    buffers[READ_BUF_INDEX] = {readBuf, readBufSize};
+    if (syscall(__NR_io_uring_register, ringFd_, IORING_REGISTER_BUFFERS, buffers.data(), buffers.size()) < 0)
+    {
+        std::cerr << "Failed to register io_uring buffers: " << std::strerror(errno) << std::endl;
+        close();
+        return false;
+    }
+    sockFd_ = fd;
+    writeBuf_ = writeBuf;
+    readBuf_ = readBuf;
+    readBufSize_ = readBufSize;
+    return true;
+}
+
+
+void UringLink::close()
+{
+    if (ringFd_ < 0)
+    {
+        return;
+    }
+    // Closing the ring cancels whatever is still in flight.
+    if (sqes_)
+    {
+        munmap(sqes_, sqesSize_);
+    }
+    munmap(rings_, ringsSize_);
+    ::close(ringFd_);
+    ringFd_ = -1;
+    sockFd_ = -1;
+    rings_ = nullptr;
+    sqes_ = nullptr;
+    isWriteQueued_ = false;
+    isWriteInFlight_ = false;
+    isReadQueued_ = false;
+    isReadInFlight_ = false;
+    numEnters_ = 0;
+}
+
+
+bool UringLink::isOpen() const
+{
+    return ringFd_ >= 0;
+}
+
+
+void UringLink::queueWrite(size_t length, uint64_t tag)
+{
+    writeLength_ = length;
+    writeOffset_ = 0;
+    writeTag_ = tag;
+    isWriteQueued_ = true;
+}
+
+
+void UringLink::queueRead()
+{
+    if (!isReadInFlight_)
+    {
+        isReadQueued_ = true;
+    }
+}
+
+
+unsigned UringLink::prepareQueued()
+{
+    auto* sqes = static_cast<io_uring_sqe*>(sqes_);
+    uint32_t tail = loadAcquire(rings_, sqTailOffset_);
+    unsigned numPrepared = 0;
+    if (isWriteQueued_)
+    {
+        auto& sqe = sqes[(tail + numPrepared++) & sqMask_];
+        sqe = io_uring_sqe{};
+        sqe.opcode = IORING_OP_WRITE_FIXED;
+        sqe.fd = sockFd_;
+        sqe.addr = reinterpret_cast<uint64_t>(writeBuf_ + writeOffset_);
+        sqe.len = static_cast<uint32_t>(writeLength_ - writeOffset_);
+        sqe.buf_index = WRITE_BUF_INDEX;
+        sqe.user_data = makeUserData(UringOp::WRITE, writeTag_);
+        // The read only starts once the write is done, a short write cancels it.
+        sqe.flags = isReadQueued_ ? IOSQE_IO_LINK : 0;
+        isWriteQueued_ = false;
+        isWriteInFlight_ = true;
+    }
+    if (isReadQueued_)
+    {
+        auto& sqe = sqes[(tail + numPrepared++) & sqMask_];
+        sqe = io_uring_sqe{};
+        sqe.opcode = IORING_OP_READ_FIXED;
+        sqe.fd = sockFd_;
+        sqe.addr = reinterpret_cast<uint64_t>(readBuf_);
+        sqe.len = static_cast<uint32_t>(readBufSize_);
+        sqe.buf_index = READ_BUF_INDEX;
+        sqe.user_data = makeUserData(UringOp::READ, 0);
+        isReadQueued_ = false;
+        isReadInFlight_ = true;
+    }
+    storeRelease(rings_, sqTailOffset_, tail + numPrepared);
+    return numPrepared;
+}
+
+
+size_t UringLink::reap(UringCompletions& out)
+{
+    uint32_t head = loadAcquire(rings_, cqHeadOffset_);
+    uint32_t tail = loadAcquire(rings_, cqTailOffset_);
+    size_t numOut = 0;
+    for (; head != tail; ++head)
+    {
+        const auto& cqe = reinterpret_cast<const io_uring_cqe*>(rings_ + cqesOffset_)[head & cqMask_];
+        auto op = static_cast<UringOp>(cqe.user_data >> 56);
+        if (op == UringOp::WRITE)
+        {
+            isWriteInFlight_ = false;
+            if (cqe.res > 0 && writeOffset_ + static_cast<size_t>(cqe.res) < writeLength_)
+            {
+                writeOffset_ += static_cast<size_t>(cqe.res);
+                isWriteQueued_ = true;
+                continue;
+            }
+            // A write that makes no progress would otherwise look like a completed one.
+            int result = cqe.res == 0 ? -EPIPE : cqe.res;
+            out[numOut++] = {op, result < 0 ? result : static_cast<int>(writeLength_), writeTag_};
+            continue;
+        }
+        isReadInFlight_ = false;
+        if (cqe.res == -ECANCELED)
+        {
+            // Cut from a short or failed write, not by the peer.
+            isReadQueued_ = true;
+            continue;
+        }
+        out[numOut++] = {op, cqe.res, 0};
+    }
+    storeRelease(rings_, cqHeadOffset_, head);
+    return numOut;
+}
+
+
+size_t UringLink::wait(std::chrono::microseconds timeout, bool isWaitingForAll, UringCompletions& out)
+{
+    unsigned numPrepared = prepareQueued();
+    unsigned numInFlight = unsigned{isWriteInFlight_} + unsigned{isReadInFlight_};
+    unsigned numCompleted = loadAcquire(rings_, cqTailOffset_) - loadAcquire(rings_, cqHeadOffset_);
+    unsigned minCompleted = isWaitingForAll ? numInFlight : std::min(numInFlight, 1u);
+    bool isWaiting = timeout.count() > 0 && numCompleted < minCompleted;
+    if (numPrepared > 0 || isWaiting)
+    {
+        __kernel_timespec ts{};
+        ts.tv_sec = timeout.count() / 1'000'000;
+        ts.tv_nsec = (timeout.count() % 1'000'000) * 1'000;
+        io_uring_getevents_arg arg{};
+        arg.sigmask_sz = _NSIG / 8;
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+        unsigned flags = isWaiting ? IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG : 0;
+        // Times out with ETIME, which like EINTR just means fewer completed.
+        syscall(__NR_io_uring_enter, ringFd_, numPrepared, isWaiting ? minCompleted : 0, flags,
+            isWaiting ? &arg : nullptr, isWaiting ? sizeof(arg) : 0);
+        ++numEnters_;
+    }
+    return reap(out);
+}
+
+
+size_t UringLink::numEnters() const
+{
+    return numEnters_;
+}
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
@@ -0,0 +1,120 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+namespace teleop_led_benchmarks
+{
+namespace desktop
+{
+
+
+// How the desktop side of a customTcp connection does its reads and writes.
+enum class TcpIoBackend
+{
+    REACTOR,   // asio's epoll reactor, a readiness wait then a syscall per read and write
+    IO_URING,  // reads and writes submitted to an io_uring, driven by the runner's io thread
+};
+
+
+// "epoll" or "io_uring", as taken by --tcp-io.
+std::optional<TcpIoBackend> parseTcpIoBackend(std::string_view str);
+
+
+enum class UringOp : uint8_t
+{
+    WRITE,
+    READ,
+};
+
+
+struct UringCompletion
+{
+    UringOp op = UringOp::WRITE;
+    int result = 0;    // bytes, 0 for a read at end of stream, or -errno
+    uint64_t tag = 0;  // as passed to queueWrite
+};
+
+
+// One write and one read in flight at most, see UringLink.
+constexpr size_t URING_MAX_COMPLETIONS = 2;
+using UringCompletions = std::array<UringCompletion, URING_MAX_COMPLETIONS>;
+
+
+/**
+ * A small io_uring for one connected stream socket, with the caller's write
+ * and read buffers registered so the kernel doesn't map them per op. Ops are
+ * queued and only submitted by wait(), a queued write with the read linked
+ * behind it, so a round trip can cost a single io_uring_enter.
+ */
+class UringLink
+{
+   public:
+    UringLink();
+    ~UringLink();
+    UringLink(const UringLink& other) = delete;
+    UringLink& operator=(const UringLink& other) = delete;
+    UringLink(UringLink&& other) = delete;
+    UringLink& operator=(UringLink&& other) = delete;
+
+    // The buffers must outlive the link. Fails, e.g. when io_uring is disabled, without side effects.
+    bool open(int fd, uint8_t* writeBuf, size_t writeBufSize, uint8_t* readBuf, size_t readBufSize);
+    // Leaves the socket open, closing it first cancels whatever is in flight.
+    void close();
+    bool isOpen() const;
+
+    // Writes writeBuf[0, length), all of it before completing. One write at a time.
+    // tag must fit in 56 bits.
+    void queueWrite(size_t length, uint64_t tag);
+    // Reads whatever arrives into readBuf. A no-op while a read is queued or in flight.
+    void queueRead();
+
+    /**
+     * Submits the queued ops and waits up to timeout for at least one to
+     * complete, or every one in flight with isWaitingForAll, e.g. a write
+     * and the read of its reply. A zero timeout only reaps. Copies the
+     * completions into out and returns how many there were.
+     */
+    size_t wait(std::chrono::microseconds timeout, bool isWaitingForAll, UringCompletions& out);
+
+    size_t numEnters() const;  // io_uring_enter calls since open
+
+   private:
+    // Fills submission entries for the queued ops and returns how many.
+    unsigned prepareQueued();
+    size_t reap(UringCompletions& out);
+
+    int ringFd_;
+    int sockFd_;
+    // Both rings share one mapping, the entries have their own. Offsets are into rings_.
+    uint8_t* rings_;
+    size_t ringsSize_;
+    void* sqes_;
+    size_t sqesSize_;
+    uint32_t sqTailOffset_;
+    uint32_t sqMask_;
+    uint32_t cqHeadOffset_;
+    uint32_t cqTailOffset_;
+    uint32_t cqesOffset_;
+    uint32_t cqMask_;
+    uint8_t* writeBuf_;
+    uint8_t* readBuf_;
+    size_t readBufSize_;
+
+    // Of the write in progress, resubmitted from writeOffset_ after a short write.
+    size_t writeLength_;
+    size_t writeOffset_;
+    uint64_t writeTag_;
+    bool isWriteQueued_;
+    bool isWriteInFlight_;
+    bool isReadQueued_;
+    bool isReadInFlight_;
+    size_t numEnters_;
+};
+
+
+}  // namespace desktop
+}  // namespace teleop_led_benchmarks
@@ -0,0 +1,68 @@
+#include "busy_poll.hpp"
+
+#include <gtest/gtest.h>
+
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+namespace teleop_led_benchmarks
+{
+namespace tests
+{
+
+
+namespace desktop = teleop_led_benchmarks::desktop;
+namespace asio = boost::asio;
+
+
+TEST(BusyPollTest, ParksOnlyOnceTheBudgetRunsOut)
+{
+    asio::io_context ioc{1};
+    auto workGuard = asio::make_work_guard(ioc);
+    desktop::BusyPollConfig config{};
+    config.spinBudget = std::chrono::seconds(10);
+    config.parkTimeout = std::chrono::milliseconds(1);
+    desktop::BusyPollStats stats{};
+    auto lastWorkAt = std::chrono::steady_clock::now();
+
+    bool hasRun = false;
+    asio::post(ioc, [&hasRun]() { hasRun = true; });
+    EXPECT_EQ(desktop::pollOrPark(ioc, config, lastWorkAt, stats), 1u);
+    EXPECT_TRUE(hasRun);
+    // Nothing to run but still within the budget, so it returns right away.
+    EXPECT_EQ(desktop::pollOrPark(ioc, config, lastWorkAt, stats), 0u);
+    EXPECT_EQ(stats.numParks, 0u);
+
+    config.spinBudget = std::chrono::microseconds::zero();
+    config.parkTimeout = std::chrono::milliseconds(5);
+    auto parkedAt = std::chrono::steady_clock::now();
+    EXPECT_EQ(desktop::pollOrPark(ioc, config, lastWorkAt, stats), 0u);
+    EXPECT_GE(std::chrono::steady_clock::now() - parkedAt, std::chrono::milliseconds(5));
+    EXPECT_EQ(stats.numParks, 1u);
+    EXPECT_EQ(stats.numHandlers, 1u);
+}
+
+
+TEST(BusyPollTest, RunsUntilStopped)
+{
+    asio::io_context ioc{1};
+    auto workGuard = asio::make_work_guard(ioc);
+    asio::steady_timer timer{ioc, std::chrono::milliseconds(20)};
+    timer.async_wait([&ioc](boost::system::error_code) { ioc.stop(); });
+    desktop::BusyPollConfig config{};
+    config.spinBudget = std::chrono::milliseconds(5);
+    desktop::BusyPollStats stats{};
+
+    desktop::runBusyPolling(ioc, config, stats);
+    EXPECT_EQ(stats.numHandlers, 1u);
+    EXPECT_GE(stats.numParks, 1u);
+    EXPECT_GE(stats.elapsedS, 0.02 - 1e-3);
+    // The budget is wall time, how much of it was this thread's cpu depends on the host.
+    EXPECT_GT(stats.cpuS, 0.0);
+    EXPECT_LE(stats.cpuS, stats.elapsedS + 1e-3);
+}
+
+
+}  // namespace tests
+}  // namespace teleop_led_benchmarks
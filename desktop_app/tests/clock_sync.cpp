@@ -0,0 +1,107 @@
+#include "clock_sync.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+namespace teleop_led_benchmarks
+{
+namespace tests
+{
+
+
+namespace desktop = teleop_led_benchmarks::desktop;
+using ClockSample = desktop::ClockSample;
+
+
+// Device clock that starts an hour ahead and runs 20 ppm fast.
+constexpr double TRUE_OFFSET_US = 3'600'000'000.0;
+constexpr double TRUE_DRIFT_PPM = 20.0;
+
+
+static double trueOffsetAtUs(double desktopUs)
+{
+    return TRUE_OFFSET_US + TRUE_DRIFT_PPM * 1e-6 * desktopUs;
+}
+
+
+static ClockSample makeSample(int64_t t1, int64_t uplinkUs, int64_t downlinkUs)
+{
+    auto receivedAt = static_cast<double>(t1 + uplinkUs);
+    auto t2 = static_cast<int64_t>(std::llround(receivedAt + trueOffsetAtUs(receivedAt)));
+    auto t3 = t2 + 50;
+    auto repliedAt = receivedAt + 50.0;
+    auto t4 = static_cast<int64_t>(std::llround(repliedAt)) + downlinkUs;
+    return ClockSample{t1, t2, t3, t4};
+}
+
+
+TEST(ClockSyncTest, SampleOffsetAndDelay)
+{
+    ClockSample sample{1'000, 11'500, 11'550, 2'050};
+    EXPECT_DOUBLE_EQ(sample.offsetUs(), 10'000.0);
+    EXPECT_EQ(sample.delayUs(), 1'000);
+}
+
+
+TEST(ClockSyncTest, RejectsImpossibleSamples)
+{
+    desktop::ClockSync sync{};
+    EXPECT_FALSE(sync.estimate().has_value());
+    EXPECT_FALSE(sync.addSample(ClockSample{1'000, 5'000, 5'100, 900}));
+    EXPECT_FALSE(sync.addSample(ClockSample{1'000, 5'100, 5'000, 2'000}));
+    // The device claims to have spent longer than the whole round trip.
+    EXPECT_FALSE(sync.addSample(ClockSample{1'000, 5'000, 7'000, 2'000}));
+    EXPECT_EQ(sync.numSamples(), 0u);
+
+    EXPECT_TRUE(sync.addSample(ClockSample{1'000, 5'000, 5'100, 2'100}));
+    auto est = sync.estimate();
+    ASSERT_TRUE(est.has_value());
+    EXPECT_DOUBLE_EQ(est->driftPpm, 0.0);
+    EXPECT_DOUBLE_EQ(est->errorBoundUs, 500.0);
+
+    sync.reset();
+    EXPECT_FALSE(sync.estimate().has_value());
+}
+
+
+TEST(ClockSyncTest, FitsOffsetAndDriftThroughFastestSamples)
+{
+    desktop::ClockSync sync{};
+    // Three in four probes queue behind traffic on the uplink only, which skews their offsets.
+    for (int64_t i = 0; i < 200; ++i)
+    {
+        int64_t t1 = 1'000'000 + i * 200'000;
+        int64_t jitterUs = (i * 7) % 13;
+        int64_t queuedUs = i % 4 == 0 ? 0 : 5'000 + (i * 31) % 2'000;
+        ASSERT_TRUE(sync.addSample(makeSample(t1, 400 + jitterUs + queuedUs, 400 + jitterUs)));
+    }
+    EXPECT_EQ(sync.numSamples(), desktop::ClockSync::WINDOW);
+
+    auto est = sync.estimate();
+    ASSERT_TRUE(est.has_value());
+    EXPECT_EQ(est->numSamples, desktop::ClockSync::WINDOW);
+    EXPECT_NEAR(est->driftPpm, TRUE_DRIFT_PPM, 0.5);
+    double errorUs = est->offsetUs - trueOffsetAtUs(static_cast<double>(est->refDesktopUs));
+    EXPECT_LE(std::abs(errorUs), est->errorBoundUs);
+    EXPECT_LT(est->errorBoundUs, 450.0);
+    EXPECT_LT(std::abs(errorUs), 5.0);
+}
+
+
+TEST(ClockSyncTest, MapsDeviceTimeOntoDesktopClock)
+{
+    desktop::ClockEstimate est{};
+    est.refDesktopUs = 10'000'000;
+    est.offsetUs = TRUE_OFFSET_US;
+    est.driftPpm = 100.0;
+    for (int64_t desktopUs : {0LL, 10'000'000LL, 60'000'000LL})
+    {
+        auto deviceUs = desktopUs + static_cast<int64_t>(std::llround(est.offsetAtUs(desktopUs)));
+        EXPECT_NEAR(static_cast<double>(est.deviceToDesktopUs(deviceUs)), static_cast<double>(desktopUs), 1.0);
+    }
+}
+
+
+}  // namespace tests
+}  // namespace teleop_led_benchmarks
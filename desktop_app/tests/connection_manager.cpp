@@ -0,0 +1,280 @@
+#include "connection_manager.hpp"
+
+#include <gtest/gtest.h>
+
+#include <future>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "device_emulator.hpp"
+
+namespace teleop_led_benchmarks
+{
+namespace tests
+{
+
+
+namespace desktop = teleop_led_benchmarks::desktop;
+using ConnectionType = desktop::ConnectionType;
+using steady_clock = std::chrono::steady_clock;
+
+
+// Pops events into view until pred holds, false if it didn't within a few seconds.
+template <typename Pred>
+static bool pollUntil(desktop::ConnectionManager& manager, desktop::FleetView& view, Pred&& pred,
+    std::vector<desktop::FleetEvent>* acks = nullptr)
+{
+    auto deadline = steady_clock::now() + std::chrono::seconds(10);
+    while (!pred())
+    {
+        if (steady_clock::now() > deadline)
+        {
+            return false;
+        }
+        desktop::FleetEvent e{};
+        if (!manager.tryPopEvent(e))
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        desktop::applyFleetEvent(view, e);
+        if (acks && e.type == desktop::FleetEventType::ACK_RECEIVED)
+        {
+            acks->push_back(e);
+        }
+    }
+    return true;
+}
+
+
+TEST(ConnectionManagerTest, DeviceIdsRoundTrip)
+{
+    constexpr auto device = desktop::makeDeviceId(3, 40'000, 7);
+    static_assert(desktop::deviceShard(device) == 3);
+    static_assert(desktop::deviceSlot(device) == 40'000);
+    static_assert(desktop::deviceGeneration(device) == 7);
+    EXPECT_NE(desktop::makeDeviceId(0, 1, 0), desktop::makeDeviceId(0, 1, 1));
+}
+
+
+TEST(ConnectionManagerTest, FansOutToDevicesAndGroups)
+{
+    desktop::FleetConfig config{};
+    config.port = 9105;
+    config.numShards = 2;
+    config.numThreads = 3;
+    desktop::EmulatorConfig emulatorConfig{};
+    emulatorConfig.port = 9105;
+    emulatorConfig.numDevices = 6;
+    std::atomic<bool> stopFlag{false};
+    desktop::EmulatorReport emulatorReport{};
+    auto futEmulator = std::async(std::launch::async, [&]()
+        { return desktop::runDeviceEmulator(stopFlag, emulatorConfig, emulatorReport); });
+
+    desktop::ConnectionManager manager{config};
+    ASSERT_TRUE(manager.start());
+    desktop::FleetView view{};
+    ASSERT_TRUE(pollUntil(manager, view, [&]() { return view.numConnected == 6; }));
+
+    std::vector<desktop::DeviceId> devices;
+    for (const auto& [device, latency] : view.devices)
+    {
+        devices.push_back(device);
+    }
+    manager.setDeviceGroup(devices[0], 1);
+    manager.setDeviceGroup(devices[1], 1);
+    manager.sendToGroup(1);
+    std::vector<desktop::FleetEvent> acks;
+    ASSERT_TRUE(pollUntil(manager, view, [&]() { return acks.size() == 2; }, &acks));
+    std::set<desktop::DeviceId> acked{acks[0].device, acks[1].device};
+    EXPECT_EQ(acked, (std::set<desktop::DeviceId>{devices[0], devices[1]}));
+
+    manager.sendToDevice(devices[2]);
+    ASSERT_TRUE(pollUntil(manager, view, [&]() { return acks.size() == 3; }, &acks));
+    EXPECT_EQ(acks[2].device, devices[2]);
+    EXPECT_EQ(acks[2].seq, 0u);
+
+    manager.sendToAll();
+    ASSERT_TRUE(pollUntil(manager, view, [&]() { return acks.size() == 9; }, &acks));
+    manager.stop();
+    stopFlag.store(true);
+    ASSERT_EQ(futEmulator.get(), 0);
+
+    EXPECT_EQ(view.latencies.count(), 9u);
+    EXPECT_EQ(view.devices.at(devices[0]).latencies.count(), 2u);
+    EXPECT_EQ(view.devices.at(devices[5]).latencies.count(), 1u);
+    EXPECT_EQ(view.numTimedOut, 0u);
+    EXPECT_EQ(manager.numDroppedEvents(), 0u);
+}
+
+
+TEST(ConnectionManagerTest, ReconnectedDeviceGetsNewId)
+{
+    desktop::FleetConfig config{};
+    config.port = 9105;
+    std::atomic<bool> stopFlag{false};
+    desktop::ConnectionManager manager{config};
+    ASSERT_TRUE(manager.start());
+    desktop::FleetView view{};
+
+    desktop::EmulatorConfig emulatorConfig{};
+    emulatorConfig.port = 9105;
+    desktop::EmulatorReport emulatorReport{};
+    auto futEmulator = std::async(std::launch::async, [&]()
+        { return desktop::runDeviceEmulator(stopFlag, emulatorConfig, emulatorReport); });
+    ASSERT_TRUE(pollUntil(manager, view, [&]() { return view.numConnected == 1; }));
+    auto firstId = view.devices.begin()->first;
+    stopFlag.store(true);
+    ASSERT_EQ(futEmulator.get(), 0);
+    ASSERT_TRUE(pollUntil(manager, view, [&]() { return view.numConnected == 0; }));
+
+    // The old id must not reach the device that reuses the slot.
+    stopFlag.store(false);
+    futEmulator = std::async(std::launch::async, [&]()
+        { return desktop::runDeviceEmulator(stopFlag, emulatorConfig, emulatorReport); });
+    ASSERT_TRUE(pollUntil(manager, view, [&]() { return view.numConnected == 1; }));
+    manager.sendToDevice(firstId);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    manager.stop();
+    stopFlag.store(true);
+    ASSERT_EQ(futEmulator.get(), 0);
+
+    ASSERT_EQ(view.devices.size(), 2u);
+    auto secondId = view.devices.begin()->first == firstId ? std::next(view.devices.begin())->first
+                                                           : view.devices.begin()->first;
+    EXPECT_EQ(desktop::deviceSlot(secondId), desktop::deviceSlot(firstId));
+    EXPECT_NE(desktop::deviceGeneration(secondId), desktop::deviceGeneration(firstId));
+    EXPECT_EQ(emulatorReport.devices[0].numCommands, 0u);
+}
+
+
+TEST(ConnectionManagerTest, FleetBenchmarkWithHundredsOfDevices)
+{
+    for (auto connType : {ConnectionType::CUSTOM_TCP, ConnectionType::WEB_SOCKET})
+    {
+        desktop::FleetBenchConfig config{};
+        config.fleet.connType = connType;
+        config.fleet.port = 9105;
+        config.fleet.numShards = 2;
+        config.fleet.numThreads = 4;
+        config.numDevices = connType == ConnectionType::CUSTOM_TCP ? 200 : 50;
+        config.numRounds = 20;
+        desktop::EmulatorConfig emulatorConfig{};
+        emulatorConfig.connType = connType;
+        emulatorConfig.port = 9105;
+        emulatorConfig.numDevices = config.numDevices;
+        emulatorConfig.numThreads = 2;
+        std::atomic<bool> stopFlag{false};
+        desktop::EmulatorReport emulatorReport{};
+        auto futEmulator = std::async(std::launch::async, [&]()
+            { return desktop::runDeviceEmulator(stopFlag, emulatorConfig, emulatorReport); });
+        desktop::FleetReport report{};
+        int exitCode = desktop::runFleetBenchmark(stopFlag, config, report);
+        stopFlag.store(true);
+        ASSERT_EQ(futEmulator.get(), 0);
+
+        ASSERT_EQ(exitCode, 0);
+        EXPECT_EQ(report.numConnected, config.numDevices);
+        EXPECT_EQ(report.roundSummary.count, 20u);
+        EXPECT_EQ(report.summary.count, config.numDevices * 20);
+        EXPECT_GE(report.roundSummary.minMs, report.summary.minMs);
+        ASSERT_EQ(report.devices.size(), config.numDevices);
+        EXPECT_GE(report.devices.front().summary.p99Ms, report.devices.back().summary.p99Ms);
+        EXPECT_EQ(report.devices.back().summary.count, 20u);
+    }
+}
+
+
+// Its seqs restart at 0 on the new connection, which must not stall the rounds.
+TEST(ConnectionManagerTest, FleetBenchmarkKeepsGoingWhenADeviceReconnects)
+{
+    desktop::FleetBenchConfig config{};
+    config.fleet.port = 9105;
+    config.fleet.ackTimeout = std::chrono::milliseconds(200);
+    config.numDevices = 2;
+    config.numRounds = 400;
+    desktop::EmulatorConfig emulatorConfig{};
+    emulatorConfig.port = 9105;
+    emulatorConfig.processingDelay = std::chrono::microseconds(500);
+    emulatorConfig.retryInterval = std::chrono::milliseconds(5);
+    std::atomic<bool> stopFlag{false};
+    std::atomic<bool> reconnectingStopFlag{false};
+    desktop::EmulatorReport emulatorReport{};
+    desktop::EmulatorReport reconnectingReport{};
+    auto futSteady = std::async(std::launch::async, [&]()
+        { return desktop::runDeviceEmulator(stopFlag, emulatorConfig, emulatorReport); });
+    auto futReconnecting = std::async(std::launch::async, [&]()
+        { return desktop::runDeviceEmulator(reconnectingStopFlag, emulatorConfig, reconnectingReport); });
+    desktop::FleetReport report{};
+    auto futExitCode = std::async(std::launch::async, [&]()
+        { return desktop::runFleetBenchmark(stopFlag, config, report); });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    reconnectingStopFlag.store(true);
+    ASSERT_EQ(futReconnecting.get(), 0);
+    reconnectingStopFlag.store(false);
+    futReconnecting = std::async(std::launch::async, [&]()
+        { return desktop::runDeviceEmulator(reconnectingStopFlag, emulatorConfig, reconnectingReport); });
+    futExitCode.get();
+    stopFlag.store(true);
+    reconnectingStopFlag.store(true);
+    ASSERT_EQ(futSteady.get(), 0);
+    ASSERT_EQ(futReconnecting.get(), 0);
+
+    EXPECT_EQ(report.roundSummary.count, 400u);
+    // The steady device, the reconnecting one's first connection and its second.
+    ASSERT_EQ(report.devices.size(), 3u);
+    EXPECT_GT(reconnectingReport.devices[0].numCommands, 0u);
+    EXPECT_LE(report.numTimedOut, 1u);  // at most the command in flight when it disconnected
+}
+
+
+TEST(ConnectionManagerTest, ThreadSweepRunsTheFleetPerThreadCount)
+{
+    desktop::FleetBenchConfig config{};
+    config.fleet.port = 9105;
+    config.numDevices = 20;
+    config.numRounds = 10;
+    desktop::EmulatorConfig emulatorConfig{};
+    emulatorConfig.port = 9105;
+    emulatorConfig.numDevices = config.numDevices;
+    emulatorConfig.retryInterval = std::chrono::milliseconds(5);
+    std::atomic<bool> stopFlag{false};
+    desktop::EmulatorReport emulatorReport{};
+    auto futEmulator = std::async(std::launch::async, [&]()
+        { return desktop::runDeviceEmulator(stopFlag, emulatorConfig, emulatorReport); });
+    std::vector<desktop::FleetReport> reports;
+    int exitCode = desktop::runFleetThreadSweep(stopFlag, config, {1, 2}, reports);
+    stopFlag.store(true);
+    ASSERT_EQ(futEmulator.get(), 0);
+
+    ASSERT_EQ(exitCode, 0);
+    ASSERT_EQ(reports.size(), 2u);
+    EXPECT_EQ(reports[0].config.fleet.numThreads, 1u);
+    EXPECT_EQ(reports[1].config.fleet.numThreads, 2u);
+    for (const auto& report : reports)
+    {
+        EXPECT_EQ(report.summary.count, 200u);
+    }
+    // Both runs' devices went through the reconnect.
+    EXPECT_EQ(emulatorReport.devices[0].numConnects, 2u);
+
+    std::ostringstream os;
+    desktop::printFleetThreadSweep(os, reports);
+    EXPECT_NE(os.str().find("1.00x"), std::string::npos);
+}
+
+
+TEST(ConnectionManagerTest, RejectsUdp)
+{
+    desktop::FleetConfig config{};
+    config.connType = ConnectionType::UDP;
+    desktop::ConnectionManager manager{config};
+    EXPECT_FALSE(manager.start());
+}
+
+
+}  // namespace tests
+}  // namespace teleop_led_benchmarks
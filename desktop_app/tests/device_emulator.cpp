@@ -0,0 +1,142 @@
+#include "device_emulator.hpp"
+
+#include <gtest/gtest.h>
+
+#include <future>
+
+#include "runner.hpp"
+
+namespace teleop_led_benchmarks
+{
+namespace tests
+{
+
+
+namespace desktop = teleop_led_benchmarks::desktop;
+using ConnectionType = desktop::ConnectionType;
+
+
+static size_t totalCommands(const desktop::EmulatorReport& report)
+{
+    size_t total = 0;
+    for (const auto& d : report.devices)
+    {
+        total += d.numCommands;
+    }
+    return total;
+}
+
+
+static desktop::RunnerReport runBenchmark(ConnectionType connType, size_t numCommands)
+{
+    std::atomic<bool> stopFlag{false};
+    desktop::RunnerConfig config{};
+    config.connType = connType;
+    config.numCommands = numCommands;
+    desktop::RunnerReport report{};
+    EXPECT_EQ(desktop::runBenchmark(stopFlag, config, report), 0);
+    return report;
+}
+
+
+TEST(DeviceEmulatorTest, CustomTcpDevicesServeConsecutiveRuns)
+{
+    desktop::EmulatorConfig config{};
+    config.connType = ConnectionType::CUSTOM_TCP;
+    config.numDevices = 3;
+    config.processingDelay = std::chrono::microseconds(1'000);
+    config.processingJitter = std::chrono::microseconds(500);
+    config.clockOffsetUs = 1'000'000'000;
+    std::atomic<bool> stopFlag{false};
+    desktop::EmulatorReport emulatorReport{};
+    auto futExitCode = std::async(std::launch::async, [&]()
+        { return desktop::runDeviceEmulator(stopFlag, config, emulatorReport); });
+
+    // The runner serves one device and closes its listener, the others keep retrying.
+    auto first = runBenchmark(ConnectionType::CUSTOM_TCP, 100);
+    auto second = runBenchmark(ConnectionType::CUSTOM_TCP, 100);
+    stopFlag.store(true);
+    ASSERT_EQ(futExitCode.get(), 0);
+
+    for (const auto& report : {first, second})
+    {
+        EXPECT_EQ(report.summary.count, 100u);
+        EXPECT_GE(report.summary.minMs, 1.0);
+        ASSERT_TRUE(report.clock.has_value());
+        EXPECT_NEAR(report.clock->offsetUs, static_cast<double>(config.clockOffsetUs),
+            report.clock->errorBoundUs + 1.0);
+    }
+    ASSERT_EQ(emulatorReport.devices.size(), 3u);
+    EXPECT_EQ(totalCommands(emulatorReport), 200u);
+}
+
+
+TEST(DeviceEmulatorTest, WebsocketRoundTrips)
+{
+    desktop::EmulatorConfig config{};
+    config.connType = ConnectionType::WEB_SOCKET;
+    std::atomic<bool> stopFlag{false};
+    desktop::EmulatorReport emulatorReport{};
+    auto futExitCode = std::async(std::launch::async, [&]()
+        { return desktop::runDeviceEmulator(stopFlag, config, emulatorReport); });
+    auto report = runBenchmark(ConnectionType::WEB_SOCKET, 100);
+    stopFlag.store(true);
+    ASSERT_EQ(futExitCode.get(), 0);
+
+    EXPECT_EQ(report.summary.count, 100u);
+    EXPECT_EQ(emulatorReport.devices[0].numConnects, 1u);
+    EXPECT_EQ(emulatorReport.devices[0].numCommands, 100u);
+    EXPECT_GE(emulatorReport.devices[0].numProbes, 1u);
+    EXPECT_EQ(emulatorReport.devices[0].numInvalidFrames, 0u);
+}
+
+
+TEST(DeviceEmulatorTest, UdpRoundTrips)
+{
+    desktop::EmulatorConfig config{};
+    config.connType = ConnectionType::UDP;
+    config.processingDelay = std::chrono::microseconds(200);
+    std::atomic<bool> stopFlag{false};
+    desktop::EmulatorReport emulatorReport{};
+    auto futExitCode = std::async(std::launch::async, [&]()
+        { return desktop::runDeviceEmulator(stopFlag, config, emulatorReport); });
+    auto report = runBenchmark(ConnectionType::UDP, 100);
+    stopFlag.store(true);
+    ASSERT_EQ(futExitCode.get(), 0);
+
+    EXPECT_EQ(report.summary.count, 100u);
+    EXPECT_EQ(report.numTimedOut, 0u);
+    EXPECT_EQ(emulatorReport.devices[0].numCommands, 100u);
+}
+
+
+TEST(DeviceEmulatorTest, SharedMemoryRoundTrips)
+{
+    desktop::EmulatorConfig config{};
+    config.connType = ConnectionType::SHARED_MEMORY;
+    config.retryInterval = std::chrono::milliseconds(10);
+    std::atomic<bool> stopFlag{false};
+    desktop::EmulatorReport emulatorReport{};
+    auto futExitCode = std::async(std::launch::async, [&]()
+        { return desktop::runDeviceEmulator(stopFlag, config, emulatorReport); });
+    // The device lets go of the first run's segment and attaches to the second's.
+    auto first = runBenchmark(ConnectionType::SHARED_MEMORY, 100);
+    auto second = runBenchmark(ConnectionType::SHARED_MEMORY, 100);
+    stopFlag.store(true);
+    ASSERT_EQ(futExitCode.get(), 0);
+
+    for (const auto& report : {first, second})
+    {
+        EXPECT_EQ(report.summary.count, 100u);
+        EXPECT_EQ(report.numTimedOut, 0u);
+        EXPECT_EQ(report.numMalformedMsgs, 0u);
+        EXPECT_TRUE(report.clock.has_value());
+    }
+    EXPECT_EQ(emulatorReport.devices[0].numConnects, 2u);
+    EXPECT_EQ(emulatorReport.devices[0].numCommands, 200u);
+    EXPECT_EQ(emulatorReport.devices[0].numInvalidFrames, 0u);
+}
+
+
+}  // namespace tests
+}  // namespace teleop_led_benchmarks
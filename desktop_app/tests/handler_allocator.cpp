@@ -0,0 +1,279 @@
+#include "handler_allocator.hpp"
+
+#include <gtest/gtest.h>
+
+#include <boost/asio/connect.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "messages.hpp"
+#include "net.hpp"
+
+// gcc can't tell that the replacement new and delete below pair up.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+
+// Counts heap allocations made by threads that opted in, see AllocationCounter.
+static thread_local bool isCountingAllocations = false;
+static thread_local size_t numCountedAllocations = 0;
+
+
+void* operator new(size_t size)
+{
+    if (isCountingAllocations)
+    {
+        ++numCountedAllocations;
+    }
+    if (void* p = std::malloc(size == 0 ? 1 : size))
+    {
+        return p;
+    }
+    throw std::bad_alloc{};
+}
+
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+
+void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+
+namespace teleop_led_benchmarks
+{
+namespace tests
+{
+
+
+namespace desktop = teleop_led_benchmarks::desktop;
+namespace asio = boost::asio;
+namespace beast = boost::beast;
+namespace websocket = beast::websocket;
+using tcp = boost::asio::ip::tcp;
+using ConnectionType = desktop::ConnectionType;
+
+
+struct AllocationCounter
+{
+    AllocationCounter()
+    {
+        numCountedAllocations = 0;
+        isCountingAllocations = true;
+    }
+
+    ~AllocationCounter()
+    {
+        isCountingAllocations = false;
+    }
+
+    size_t count() const
+    {
+        return numCountedAllocations;
+    }
+};
+
+
+TEST(HandlerArenaTest, ReusesSlotsAndCountsFallbacks)
+{
+    desktop::HandlerArena arena{};
+    std::vector<void*> ptrs;
+    for (size_t i = 0; i < desktop::HandlerArena::NUM_SLOTS; ++i)
+    {
+        ptrs.push_back(arena.allocate(64));
+    }
+    EXPECT_EQ(arena.numHeapFallbacks(), 0u);
+
+    void* overflow = arena.allocate(64);
+    void* oversized = arena.allocate(desktop::HandlerArena::SLOT_SIZE + 1);
+    EXPECT_EQ(arena.numHeapFallbacks(), 2u);
+    arena.deallocate(overflow);
+    arena.deallocate(oversized);
+
+    arena.deallocate(ptrs[3]);
+    EXPECT_EQ(arena.allocate(desktop::HandlerArena::SLOT_SIZE), ptrs[3]);
+    EXPECT_EQ(arena.numHeapFallbacks(), 2u);
+    for (void* p : ptrs)
+    {
+        arena.deallocate(p);
+    }
+}
+
+
+static boost::system::error_code connectWithRetry(tcp::socket& sock, const std::string& port)
+{
+    tcp::resolver resolver{sock.get_executor()};
+    auto const results = resolver.resolve("127.0.0.1", port);
+    boost::system::error_code ec;
+    for (int attempt = 0; attempt < 50; ++attempt)
+    {
+        asio::connect(sock, results, ec);
+        if (!ec)
+        {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    return ec;
+}
+
+
+// Sync replies echo the probe's send time, the device clock is ours.
+static size_t encodeReply(const desktop::FrameHeader& header, std::array<uint8_t, desktop::SYNC_REPLY_FRAME_SIZE>& out)
+{
+    if (header.type == desktop::MsgType::SYNC_REQUEST)
+    {
+        return desktop::encodeSyncReply(header.seq, header.sendTimeUs, header.sendTimeUs, header.sendTimeUs,
+            out.data());
+    }
+    return desktop::encodeFrame(desktop::MsgType::ACK, header.seq, 0, nullptr, 0, out.data());
+}
+
+
+// Acks every command and answers clock probes until the socket closes, like the esp32 tcp client.
+static void runTcpDevice()
+{
+    asio::io_context ioc{};
+    tcp::socket sock{ioc};
+    auto ec = connectWithRetry(sock, "9003");
+    ASSERT_FALSE(ec);
+
+    std::array<uint8_t, 1024> buf{};
+    std::array<uint8_t, desktop::SYNC_REPLY_FRAME_SIZE> reply{};
+    desktop::FrameParser parser{};
+    while (true)
+    {
+        auto numBytes = sock.read_some(asio::buffer(buf), ec);
+        if (ec)
+        {
+            return;
+        }
+        parser.feed(buf.data(), numBytes, [&](const desktop::FrameHeader& header, const uint8_t*)
+            {
+                asio::write(sock, asio::buffer(reply.data(), encodeReply(header, reply)), ec);
+            });
+    }
+}
+
+
+static void runWsDevice()
+{
+    asio::io_context ioc{};
+    websocket::stream<tcp::socket> ws{ioc};
+    auto ec = connectWithRetry(ws.next_layer(), "9002");
+    ASSERT_FALSE(ec);
+    ws.handshake("127.0.0.1:9002", "/");
+    ws.binary(true);
+
+    beast::flat_buffer buf;
+    std::array<uint8_t, desktop::SYNC_REPLY_FRAME_SIZE> reply{};
+    while (true)
+    {
+        ws.read(buf, ec);
+        if (ec)
+        {
+            return;
+        }
+        auto header = desktop::decodeHeader(static_cast<const uint8_t*>(buf.data().data()));
+        buf.consume(buf.size());
+        ASSERT_TRUE(header.has_value());
+        ws.write(asio::buffer(reply.data(), encodeReply(*header, reply)), ec);
+    }
+}
+
+
+// Sends one command and runs ioc until its ack has been queued, clock probes go out in between.
+static bool roundTrip(asio::io_context& ioc, desktop::NetState& net)
+{
+    desktop::sendBlinkCommand(net);
+    desktop::IOEvent e{};
+    desktop::ConnectionEvent connEvent{};
+    while (true)
+    {
+        if (ioc.run_one_for(std::chrono::seconds(1)) == 0)
+        {
+            return false;
+        }
+        while (net.connEvents.tryPop(connEvent))
+        {
+            EXPECT_EQ(connEvent.type, desktop::ConnectionEventType::CLOCK_UPDATED);
+        }
+        if (net.ioEvents.tryPop(e))
+        {
+            return e.type == desktop::IOEventType::ACK_RECEIVED;
+        }
+    }
+}
+
+
+/**
+ * Counts heap allocations on the network thread over 10k round trips, after
+ * a warmup that lets buffers and asio's per-thread caches reach their size.
+ */
+static void expectRoundTripsDontAllocate(ConnectionType connType, void (*runDevice)())
+{
+    asio::io_context ioc{1};
+    auto workGuard = asio::make_work_guard(ioc);
+    desktop::NetState net{ioc, connType, false};
+    desktop::asyncWaitForConnection(net);
+    std::thread device{runDevice};
+
+    desktop::ConnectionEvent connEvent{};
+    while (!net.connEvents.tryPop(connEvent))
+    {
+        ASSERT_NE(ioc.run_one_for(std::chrono::seconds(5)), 0u);
+    }
+    ASSERT_EQ(connEvent.type, desktop::ConnectionEventType::CONNECTED);
+
+    for (int i = 0; i < 100; ++i)
+    {
+        ASSERT_TRUE(roundTrip(ioc, net));
+    }
+    size_t numAllocations = 0;
+    {
+        AllocationCounter counter{};
+        for (int i = 0; i < 10'000; ++i)
+        {
+            ASSERT_TRUE(roundTrip(ioc, net));
+        }
+        numAllocations = counter.count();
+    }
+    EXPECT_EQ(numAllocations, 0u);
+    EXPECT_EQ(net.handlerArena.numHeapFallbacks(), 0u);
+    EXPECT_TRUE(net.clock.has_value());
+
+    desktop::closeConnection(net);
+    ioc.restart();
+    ioc.poll();
+    device.join();
+}
+
+
+TEST(HandlerArenaTest, CustomTcpRoundTripsDontAllocate)
+{
+    expectRoundTripsDontAllocate(ConnectionType::CUSTOM_TCP, runTcpDevice);
+}
+
+
+TEST(HandlerArenaTest, WebsocketRoundTripsDontAllocate)
+{
+    expectRoundTripsDontAllocate(ConnectionType::WEB_SOCKET, runWsDevice);
+}
+
+
+}  // namespace tests
+}  // namespace teleop_led_benchmarks
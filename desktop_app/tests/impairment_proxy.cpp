@@ -0,0 +1,207 @@
+#include "impairment_proxy.hpp"
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <future>
+
+#include "device_emulator.hpp"
+#include "runner.hpp"
+
+namespace teleop_led_benchmarks
+{
+namespace tests
+{
+
+
+namespace desktop = teleop_led_benchmarks::desktop;
+using ConnectionType = desktop::ConnectionType;
+using std::chrono::microseconds;
+using time_point = desktop::ImpairedLink::time_point;
+
+
+TEST(ImpairedLinkTest, DelaysAndCapsBandwidth)
+{
+    desktop::LinkImpairment impairment{};
+    impairment.delay = microseconds(2'000);
+    impairment.bandwidthBps = 8'000.0;  // 1 ms per byte
+    desktop::LinkStats stats{};
+    desktop::ImpairedLink link{impairment, 1, stats};
+    time_point now{};
+    EXPECT_EQ(link.schedule(now, 10, false), now + microseconds(12'000));
+    // The second chunk has to wait for the first to finish serializing.
+    EXPECT_EQ(link.schedule(now, 10, false), now + microseconds(22'000));
+    EXPECT_EQ(stats.numChunks, 2u);
+    EXPECT_EQ(stats.numBytes, 20u);
+}
+
+
+TEST(ImpairedLinkTest, StreamsNeverLoseOrReorder)
+{
+    desktop::LinkImpairment impairment{};
+    impairment.jitter = microseconds(5'000);
+    impairment.jitterDistribution = desktop::DelayDistribution::PARETO;
+    impairment.goodLossProb = 0.1;
+    desktop::LinkStats stats{};
+    desktop::ImpairedLink link{impairment, 7, stats};
+    time_point now{};
+    time_point last{};
+    for (int i = 0; i < 1'000; ++i)
+    {
+        now += microseconds(100);
+        auto releaseAt = link.schedule(now, 100, true);
+        ASSERT_TRUE(releaseAt.has_value());
+        EXPECT_GE(*releaseAt, last);
+        last = *releaseAt;
+    }
+    EXPECT_EQ(stats.numLost, 0u);
+    EXPECT_GT(stats.numRetransmitted, 50u);
+}
+
+
+TEST(ImpairedLinkTest, GilbertElliottLossComesInBursts)
+{
+    desktop::LinkImpairment impairment{};
+    impairment.goodToBadProb = 0.05;
+    impairment.badToGoodProb = 0.25;
+    impairment.badLossProb = 1.0;
+    desktop::LinkStats stats{};
+    desktop::ImpairedLink link{impairment, 3, stats};
+    size_t numBursts = 0;
+    bool wasLost = false;
+    for (int i = 0; i < 100'000; ++i)
+    {
+        bool isLost = !link.schedule(time_point{}, 1, false).has_value();
+        numBursts += isLost && !wasLost;
+        wasLost = isLost;
+    }
+    // The bad state holds 0.05 / (0.05 + 0.25) of the time, for 1 / 0.25 chunks on average.
+    double lossRate = static_cast<double>(stats.numLost) / 100'000.0;
+    EXPECT_NEAR(lossRate, 1.0 / 6.0, 0.01);
+    EXPECT_NEAR(static_cast<double>(stats.numLost) / static_cast<double>(numBursts), 4.0, 0.3);
+}
+
+
+TEST(ImpairedLinkTest, SameSeedSameSchedule)
+{
+    desktop::LinkImpairment impairment{};
+    impairment.jitter = microseconds(1'000);
+    impairment.jitterDistribution = desktop::DelayDistribution::NORMAL;
+    impairment.goodLossProb = 0.2;
+    impairment.reorderProb = 0.2;
+    desktop::LinkStats statsA{};
+    desktop::LinkStats statsB{};
+    desktop::ImpairedLink a{impairment, 42, statsA};
+    desktop::ImpairedLink b{impairment, 42, statsB};
+    for (int i = 0; i < 1'000; ++i)
+    {
+        ASSERT_EQ(a.schedule(time_point{}, 64, false), b.schedule(time_point{}, 64, false));
+    }
+    EXPECT_GT(statsA.numReordered, 0u);
+}
+
+
+TEST(ImpairmentProxyTest, LoadsScript)
+{
+    std::string path = testing::TempDir() + "impairment_script.json";
+    {
+        std::ofstream out{path};
+        out << R"({"seed": 9, "phases": [
+            {"atMs": 5000, "both": {"delayUs": 100}},
+            {"atMs": 0, "both": {"delayUs": 3000, "jitterUs": 500, "jitterDistribution": "pareto"},
+             "downlink": {"goodToBadProb": 0.01, "badLossProb": 0.5}}]})";
+    }
+    desktop::ProxyConfig config{};
+    ASSERT_TRUE(desktop::loadImpairmentScript(path, config));
+    EXPECT_EQ(config.seed, 9u);
+    ASSERT_EQ(config.phases.size(), 2u);
+    EXPECT_EQ(config.phases[0].at.count(), 0);
+    EXPECT_EQ(config.phases[0].uplink.delay.count(), 3'000);
+    EXPECT_EQ(config.phases[0].uplink.jitterDistribution, desktop::DelayDistribution::PARETO);
+    EXPECT_EQ(config.phases[0].downlink.delay.count(), 0);
+    EXPECT_DOUBLE_EQ(config.phases[0].downlink.badLossProb, 0.5);
+    EXPECT_EQ(config.phases[1].uplink.delay.count(), 100);
+
+    {
+        std::ofstream out{path};
+        out << R"({"phases": [{"both": {"jitterDistribution": "gamma"}}]})";
+    }
+    EXPECT_FALSE(desktop::loadImpairmentScript(path, config));
+}
+
+
+TEST(ImpairmentProxyTest, DelaysCustomTcpRoundTrips)
+{
+    desktop::ProxyConfig proxyConfig{};
+    proxyConfig.connType = ConnectionType::CUSTOM_TCP;
+    proxyConfig.listenPort = 9103;
+    desktop::LinkImpairment impairment{};
+    impairment.delay = microseconds(2'000);
+    proxyConfig.phases.push_back(desktop::ImpairmentPhase{std::chrono::milliseconds{0}, impairment, impairment});
+    desktop::EmulatorConfig emulatorConfig{};
+    emulatorConfig.connType = ConnectionType::CUSTOM_TCP;
+    emulatorConfig.port = 9103;
+
+    std::atomic<bool> stopFlag{false};
+    desktop::ProxyReport proxyReport{};
+    desktop::EmulatorReport emulatorReport{};
+    auto futProxy = std::async(std::launch::async, [&]()
+        { return desktop::runImpairmentProxy(stopFlag, proxyConfig, proxyReport); });
+    auto futEmulator = std::async(std::launch::async, [&]()
+        { return desktop::runDeviceEmulator(stopFlag, emulatorConfig, emulatorReport); });
+    desktop::RunnerConfig config{};
+    config.connType = ConnectionType::CUSTOM_TCP;
+    config.numCommands = 50;
+    desktop::RunnerReport report{};
+    int exitCode = desktop::runBenchmark(stopFlag, config, report);
+    stopFlag.store(true);
+    ASSERT_EQ(futProxy.get(), 0);
+    ASSERT_EQ(futEmulator.get(), 0);
+
+    ASSERT_EQ(exitCode, 0);
+    EXPECT_GE(report.summary.minMs, 4.0);
+    EXPECT_GE(proxyReport.numSessions, 1u);
+    EXPECT_GE(proxyReport.uplink.numChunks, 50u);
+    EXPECT_GE(proxyReport.downlink.numChunks, 50u);
+}
+
+
+TEST(ImpairmentProxyTest, DropsUdpDatagrams)
+{
+    desktop::ProxyConfig proxyConfig{};
+    proxyConfig.connType = ConnectionType::UDP;
+    proxyConfig.listenPort = 9104;
+    desktop::LinkImpairment uplink{};
+    uplink.goodLossProb = 0.2;
+    proxyConfig.phases.push_back(desktop::ImpairmentPhase{std::chrono::milliseconds{0}, uplink, {}});
+    desktop::EmulatorConfig emulatorConfig{};
+    emulatorConfig.connType = ConnectionType::UDP;
+    emulatorConfig.port = 9104;
+
+    std::atomic<bool> stopFlag{false};
+    desktop::ProxyReport proxyReport{};
+    desktop::EmulatorReport emulatorReport{};
+    auto futProxy = std::async(std::launch::async, [&]()
+        { return desktop::runImpairmentProxy(stopFlag, proxyConfig, proxyReport); });
+    auto futEmulator = std::async(std::launch::async, [&]()
+        { return desktop::runDeviceEmulator(stopFlag, emulatorConfig, emulatorReport); });
+    desktop::RunnerConfig config{};
+    config.connType = ConnectionType::UDP;
+    config.numCommands = 200;
+    config.maxInFlight = 8;
+    config.ackTimeoutMs = 50;
+    desktop::RunnerReport report{};
+    desktop::runBenchmark(stopFlag, config, report);
+    stopFlag.store(true);
+    ASSERT_EQ(futProxy.get(), 0);
+    ASSERT_EQ(futEmulator.get(), 0);
+
+    EXPECT_GT(proxyReport.uplink.numLost, 0u);
+    EXPECT_EQ(proxyReport.downlink.numLost, 0u);
+    EXPECT_GT(report.numTimedOut, 0u);
+    EXPECT_EQ(report.summary.count + report.numTimedOut, 200u);
+}
+
+
+}  // namespace tests
+}  // namespace teleop_led_benchmarks
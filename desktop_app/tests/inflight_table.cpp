@@ -0,0 +1,73 @@
+#include "inflight_table.hpp"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace teleop_led_benchmarks
+{
+namespace tests
+{
+
+
+namespace desktop = teleop_led_benchmarks::desktop;
+using InFlightTable = desktop::InFlightTable;
+using steady_clock = std::chrono::steady_clock;
+
+
+TEST(InFlightTableTest, CompletesOutOfOrder)
+{
+    InFlightTable table{};
+    auto t0 = steady_clock::now();
+    for (uint32_t seq = 0; seq < 4; ++seq)
+    {
+        EXPECT_FALSE(table.insert(seq, t0 + std::chrono::milliseconds(seq)));
+    }
+    EXPECT_EQ(table.size(), 4u);
+
+    EXPECT_EQ(table.complete(2), t0 + std::chrono::milliseconds(2));
+    EXPECT_EQ(table.complete(0), t0);
+    EXPECT_EQ(table.complete(3), t0 + std::chrono::milliseconds(3));
+    EXPECT_EQ(table.complete(1), t0 + std::chrono::milliseconds(1));
+    EXPECT_EQ(table.size(), 0u);
+}
+
+
+TEST(InFlightTableTest, RejectsDuplicateAndUnknownAcks)
+{
+    InFlightTable table{};
+    table.insert(5, steady_clock::now());
+    EXPECT_TRUE(table.complete(5));
+    EXPECT_FALSE(table.complete(5));
+    EXPECT_FALSE(table.complete(6));
+    // Same slot, different seq.
+    table.insert(5 + InFlightTable::CAPACITY, steady_clock::now());
+    EXPECT_FALSE(table.complete(5));
+    EXPECT_EQ(table.size(), 1u);
+}
+
+
+TEST(InFlightTableTest, ExpiresAndEvicts)
+{
+    InFlightTable table{};
+    auto t0 = steady_clock::now();
+    table.insert(0, t0);
+    table.insert(1, t0 + std::chrono::seconds(1));
+    table.insert(2, t0 + std::chrono::seconds(2));
+
+    std::vector<uint32_t> expired;
+    auto numExpired = table.expireSentBefore(t0 + std::chrono::milliseconds(1500),
+        [&](uint32_t seq)
+        { expired.push_back(seq); });
+    EXPECT_EQ(numExpired, 2u);
+    EXPECT_EQ(expired, (std::vector<uint32_t>{0, 1}));
+    EXPECT_FALSE(table.complete(1));
+    EXPECT_EQ(table.size(), 1u);
+
+    EXPECT_EQ(table.insert(2 + InFlightTable::CAPACITY, t0), 2u);
+    EXPECT_EQ(table.size(), 1u);
+}
+
+
+}  // namespace tests
+}  // namespace teleop_led_benchmarks
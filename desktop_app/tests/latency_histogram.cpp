@@ -0,0 +1,134 @@
+#include "latency_histogram.hpp"
+
+#include <gtest/gtest.h>
+
+#include <random>
+
+namespace teleop_led_benchmarks
+{
+namespace tests
+{
+
+
+namespace desktop = teleop_led_benchmarks::desktop;
+using LatencyHistogram = desktop::LatencyHistogram;
+
+
+TEST(LatencyHistogramTest, BucketsCoverEveryValue)
+{
+    size_t prevIndex = 0;
+    for (uint64_t v = 0; v < 1'000'000; ++v)
+    {
+        auto idx = LatencyHistogram::bucketIndex(v);
+        ASSERT_LT(idx, LatencyHistogram::NUM_BUCKETS);
+        ASSERT_GE(idx, prevIndex);
+        ASSERT_LE(LatencyHistogram::bucketLowerBound(idx), v);
+        ASSERT_GE(LatencyHistogram::bucketUpperBound(idx), v);
+        prevIndex = idx;
+    }
+    EXPECT_EQ(LatencyHistogram::bucketIndex(LatencyHistogram::MAX_TRACKABLE_US),
+        LatencyHistogram::NUM_BUCKETS - 1);
+}
+
+
+TEST(LatencyHistogramTest, SmallValuesAreExact)
+{
+    LatencyHistogram hist;
+    for (uint64_t v = 1; v <= 100; ++v)
+    {
+        hist.record(v);
+    }
+    EXPECT_EQ(hist.count(), 100u);
+    EXPECT_EQ(hist.min(), 1u);
+    EXPECT_EQ(hist.max(), 100u);
+    EXPECT_DOUBLE_EQ(hist.mean(), 50.5);
+    EXPECT_EQ(hist.valueAtPercentile(50.0), 50u);
+    EXPECT_EQ(hist.valueAtPercentile(90.0), 90u);
+    EXPECT_EQ(hist.valueAtPercentile(99.0), 99u);
+    EXPECT_EQ(hist.valueAtPercentile(100.0), 100u);
+}
+
+
+TEST(LatencyHistogramTest, LargeValuesWithinRelativeError)
+{
+    std::mt19937_64 rng{42};
+    std::uniform_int_distribution<uint64_t> dist{1, 10'000'000};
+    for (int i = 0; i < 10'000; ++i)
+    {
+        uint64_t v = dist(rng);
+        auto reported = static_cast<double>(
+            LatencyHistogram::bucketUpperBound(LatencyHistogram::bucketIndex(v)));
+        ASSERT_LE(reported - static_cast<double>(v),
+            static_cast<double>(v) / LatencyHistogram::SUB_BUCKET_HALF);
+    }
+}
+
+
+TEST(LatencyHistogramTest, MergeMatchesSingleHistogram)
+{
+    LatencyHistogram a;
+    LatencyHistogram b;
+    LatencyHistogram all;
+    for (uint64_t v = 1; v <= 20'000; ++v)
+    {
+        (v % 3 == 0 ? a : b).record(v * 7);
+        all.record(v * 7);
+    }
+    a.merge(b);
+    EXPECT_EQ(a.count(), all.count());
+    EXPECT_EQ(a.min(), all.min());
+    EXPECT_EQ(a.max(), all.max());
+    EXPECT_DOUBLE_EQ(a.mean(), all.mean());
+    for (double p : {50.0, 90.0, 99.0, 99.9})
+    {
+        EXPECT_EQ(a.valueAtPercentile(p), all.valueAtPercentile(p));
+    }
+}
+
+
+TEST(LatencyHistogramTest, SummaryAndReset)
+{
+    LatencyHistogram hist;
+    hist.record(std::chrono::duration<double, std::milli>{1.5});
+    hist.record(std::chrono::duration<double, std::milli>{0.25});
+    auto summary = desktop::summarizeHistogram(hist);
+    EXPECT_EQ(summary.count, 2u);
+    EXPECT_DOUBLE_EQ(summary.minMs, 0.25);
+    EXPECT_DOUBLE_EQ(summary.maxMs, 1.5);
+
+    hist.reset();
+    EXPECT_EQ(hist.count(), 0u);
+    EXPECT_EQ(desktop::summarizeHistogram(hist).count, 0u);
+}
+
+
+TEST(LatencyHistogramTest, CompactHistogramWithinRelativeError)
+{
+    using CompactLatencyHistogram = desktop::CompactLatencyHistogram;
+    EXPECT_LE(sizeof(CompactLatencyHistogram), 1024u);
+    CompactLatencyHistogram hist;
+    LatencyHistogram exact;
+    std::mt19937_64 rng{7};
+    std::uniform_int_distribution<uint64_t> dist{1, 1'000'000};
+    for (int i = 0; i < 10'000; ++i)
+    {
+        uint64_t v = dist(rng);
+        hist.record(v);
+        exact.record(v);
+        auto reported = static_cast<double>(
+            CompactLatencyHistogram::bucketUpperBound(CompactLatencyHistogram::bucketIndex(v)));
+        ASSERT_LE(reported - static_cast<double>(v),
+            static_cast<double>(v) / CompactLatencyHistogram::SUB_BUCKET_HALF);
+    }
+    EXPECT_EQ(hist.count(), exact.count());
+    EXPECT_EQ(hist.min(), exact.min());
+    EXPECT_EQ(hist.max(), exact.max());
+    EXPECT_DOUBLE_EQ(hist.mean(), exact.mean());
+    auto p99 = static_cast<double>(exact.valueAtPercentile(99.0));
+    EXPECT_NEAR(static_cast<double>(hist.valueAtPercentile(99.0)), p99, p99 / 8.0);
+    EXPECT_EQ(desktop::summarizeHistogram(hist).count, 10'000u);
+}
+
+
+}  // namespace tests
+}  // namespace teleop_led_benchmarks
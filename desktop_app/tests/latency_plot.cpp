@@ -0,0 +1,96 @@
+#include "latency_plot.hpp"
+
+#include <gtest/gtest.h>
+
+#include <numeric>
+
+namespace teleop_led_benchmarks
+{
+namespace tests
+{
+
+
+namespace desktop = teleop_led_benchmarks::desktop;
+
+
+TEST(LatencyPlotTest, RecentLatenciesWrapAround)
+{
+    desktop::RecentLatencies recent{4};
+    for (int i = 0; i < 6; ++i)
+    {
+        recent.record(static_cast<float>(i));
+    }
+    ASSERT_EQ(recent.size(), 4u);
+    // Oldest first, the way PlotLines walks it from offset.
+    std::vector<float> ordered;
+    for (size_t i = 0; i < recent.size(); ++i)
+    {
+        ordered.push_back(recent.data()[(recent.offset() + i) % recent.size()]);
+    }
+    EXPECT_EQ(ordered, (std::vector<float>{2.0f, 3.0f, 4.0f, 5.0f}));
+    EXPECT_EQ(recent.max(), 5.0f);
+}
+
+
+TEST(LatencyPlotTest, DecimatedLatenciesStayBoundedAndKeepSpikes)
+{
+    desktop::DecimatedLatencies run{1000};
+    constexpr uint64_t numSamples = 3'000'000;
+    for (uint64_t i = 0; i < numSamples; ++i)
+    {
+        run.record(i == 1'234'567 ? 50.0f : 1.0f + static_cast<float>(i % 7) * 0.01f);
+    }
+    EXPECT_EQ(run.numSamples(), numSamples);
+    EXPECT_LE(run.size(), 1000u);
+    EXPECT_GE(run.size(), 500u);
+    EXPECT_EQ(run.samplesPerPoint(), 4096u);
+
+    // The spike survives every merge, and lands in the point covering its sample.
+    size_t spikePoint = 1'234'567 / run.samplesPerPoint();
+    EXPECT_EQ(run[spikePoint].maxMs, 50.0f);
+    EXPECT_FLOAT_EQ(run[spikePoint + 1].maxMs, 1.06f);
+    EXPECT_EQ(run[0].minMs, 1.0f);
+
+    std::vector<desktop::MinMaxPoint> columns;
+    run.decimate(300, columns);
+    ASSERT_EQ(columns.size(), 300u);
+    float maxMs = 0.0f;
+    for (const auto& c : columns)
+    {
+        EXPECT_LE(c.minMs, c.maxMs);
+        maxMs = std::max(maxMs, c.maxMs);
+    }
+    EXPECT_EQ(maxMs, 50.0f);
+
+    run.reset();
+    EXPECT_EQ(run.size(), 0u);
+    EXPECT_EQ(run.samplesPerPoint(), 1u);
+}
+
+
+TEST(LatencyPlotTest, BinsHistogramOnALogScale)
+{
+    desktop::LatencyHistogram hist;
+    for (int i = 0; i < 900; ++i)
+    {
+        hist.record(uint64_t{100});
+    }
+    for (int i = 0; i < 100; ++i)
+    {
+        hist.record(uint64_t{10'000});
+    }
+    desktop::LatencyBins bins;
+    desktop::binHistogram(hist, 20, bins);
+    ASSERT_EQ(bins.counts.size(), 20u);
+    EXPECT_FLOAT_EQ(std::accumulate(bins.counts.begin(), bins.counts.end(), 0.0f), 1000.0f);
+    EXPECT_FLOAT_EQ(bins.counts.front(), 900.0f);
+    EXPECT_FLOAT_EQ(bins.counts.back(), 100.0f);
+    EXPECT_DOUBLE_EQ(bins.lowMs, 0.1);
+
+    desktop::binHistogram(desktop::LatencyHistogram{}, 20, bins);
+    EXPECT_FLOAT_EQ(std::accumulate(bins.counts.begin(), bins.counts.end(), 0.0f), 0.0f);
+}
+
+
+}  // namespace tests
+}  // namespace teleop_led_benchmarks
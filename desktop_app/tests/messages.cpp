@@ -0,0 +1,171 @@
+#include "messages.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace teleop_led_benchmarks
+{
+namespace tests
+{
+
+
+namespace desktop = teleop_led_benchmarks::desktop;
+using FrameHeader = desktop::FrameHeader;
+using MsgType = desktop::MsgType;
+
+
+struct ParsedFrame
+{
+    FrameHeader header;
+    std::vector<uint8_t> payload;
+};
+
+
+static std::vector<uint8_t> makeFrame(MsgType type, uint32_t seq, size_t payloadSize)
+{
+    std::vector<uint8_t> payload(payloadSize);
+    for (size_t i = 0; i < payloadSize; ++i)
+    {
+        payload[i] = static_cast<uint8_t>(seq + i);
+    }
+    std::vector<uint8_t> frame(desktop::FRAME_HEADER_SIZE + payloadSize);
+    auto length = desktop::encodeFrame(type, seq, 1000 + seq, payload.data(), payload.size(),
+        frame.data());
+    EXPECT_EQ(length, frame.size());
+    return frame;
+}
+
+
+static auto collectInto(std::vector<ParsedFrame>& frames)
+{
+    return [&frames](const FrameHeader& header, const uint8_t* payload)
+    {
+        frames.push_back(ParsedFrame{header,
+            std::vector<uint8_t>(payload, payload + header.length - desktop::FRAME_HEADER_SIZE)});
+    };
+}
+
+
+TEST(MessagesTest, HeaderRoundTrip)
+{
+    auto frame = makeFrame(MsgType::ACK, 0xdeadbeef, 3);
+    // Little-endian on the wire regardless of host order.
+    EXPECT_EQ(frame[0], 19);
+    EXPECT_EQ(frame[1], 0);
+    EXPECT_EQ(frame[4], 0xef);
+    EXPECT_EQ(frame[7], 0xde);
+
+    auto header = desktop::decodeHeader(frame.data());
+    ASSERT_TRUE(header.has_value());
+    EXPECT_EQ(header->length, 19);
+    EXPECT_EQ(header->type, MsgType::ACK);
+    EXPECT_EQ(header->seq, 0xdeadbeefu);
+    EXPECT_EQ(header->sendTimeUs, 1000u + 0xdeadbeefu);
+}
+
+
+TEST(MessagesTest, RejectsInvalidHeaders)
+{
+    auto frame = makeFrame(MsgType::COMMAND, 1, 0);
+    frame[3] = desktop::FRAME_VERSION + 1;
+    EXPECT_FALSE(desktop::decodeHeader(frame.data()));
+
+    frame = makeFrame(MsgType::COMMAND, 1, 0);
+    frame[2] = 0x7f;
+    EXPECT_FALSE(desktop::decodeHeader(frame.data()));
+
+    frame = makeFrame(MsgType::COMMAND, 1, 0);
+    frame[0] = desktop::FRAME_HEADER_SIZE - 1;
+    EXPECT_FALSE(desktop::decodeHeader(frame.data()));
+
+    std::vector<uint8_t> payload(desktop::MAX_PAYLOAD_SIZE + 1);
+    std::vector<uint8_t> out(desktop::FRAME_HEADER_SIZE + payload.size());
+    EXPECT_EQ(desktop::encodeFrame(MsgType::COMMAND, 1, 0, payload.data(), payload.size(),
+                  out.data()),
+        0u);
+}
+
+
+TEST(MessagesTest, ParsesSeveralFramesInOneRead)
+{
+    std::vector<uint8_t> stream;
+    for (uint32_t seq = 0; seq < 5; ++seq)
+    {
+        auto frame = makeFrame(MsgType::ACK, seq, seq * 7);
+        stream.insert(stream.end(), frame.begin(), frame.end());
+    }
+
+    std::vector<ParsedFrame> frames;
+    desktop::FrameParser parser{};
+    ASSERT_TRUE(parser.feed(stream.data(), stream.size(), collectInto(frames)));
+    EXPECT_FALSE(parser.hasPartialFrame());
+    ASSERT_EQ(frames.size(), 5u);
+    for (uint32_t seq = 0; seq < 5; ++seq)
+    {
+        EXPECT_EQ(frames[seq].header.seq, seq);
+        ASSERT_EQ(frames[seq].payload.size(), seq * 7);
+        if (seq > 0)
+        {
+            EXPECT_EQ(frames[seq].payload.back(), static_cast<uint8_t>(seq + seq * 7 - 1));
+        }
+    }
+}
+
+
+TEST(MessagesTest, ReassemblesFramesAcrossReads)
+{
+    std::vector<uint8_t> stream;
+    for (uint32_t seq = 0; seq < 20; ++seq)
+    {
+        auto frame = makeFrame(MsgType::COMMAND, seq, seq % 3 == 0 ? 0 : 40);
+        stream.insert(stream.end(), frame.begin(), frame.end());
+    }
+
+    // Every chunk size from single bytes to bigger than a frame.
+    for (size_t chunk = 1; chunk < 80; ++chunk)
+    {
+        std::vector<ParsedFrame> frames;
+        desktop::FrameParser parser{};
+        for (size_t offset = 0; offset < stream.size(); offset += chunk)
+        {
+            size_t size = std::min(chunk, stream.size() - offset);
+            ASSERT_TRUE(parser.feed(stream.data() + offset, size, collectInto(frames)));
+        }
+        EXPECT_FALSE(parser.hasPartialFrame());
+        ASSERT_EQ(frames.size(), 20u) << "chunk " << chunk;
+        for (uint32_t seq = 0; seq < 20; ++seq)
+        {
+            EXPECT_EQ(frames[seq].header.seq, seq);
+            ASSERT_EQ(frames[seq].payload.size(), seq % 3 == 0 ? 0u : 40u);
+            if (!frames[seq].payload.empty())
+            {
+                EXPECT_EQ(frames[seq].payload[39], static_cast<uint8_t>(seq + 39));
+            }
+        }
+    }
+}
+
+
+TEST(MessagesTest, ParserRejectsCorruptStream)
+{
+    auto frame = makeFrame(MsgType::ACK, 3, 0);
+    frame[3] = 0;
+    std::vector<ParsedFrame> frames;
+    desktop::FrameParser parser{};
+    EXPECT_FALSE(parser.feed(frame.data(), frame.size(), collectInto(frames)));
+    EXPECT_FALSE(parser.hasPartialFrame());
+
+    // A split header is only checked once all of it has arrived.
+    auto good = makeFrame(MsgType::ACK, 4, 0);
+    EXPECT_TRUE(parser.feed(good.data(), 2, collectInto(frames)));
+    EXPECT_TRUE(parser.hasPartialFrame());
+    EXPECT_FALSE(parser.feed(frame.data() + 2, frame.size() - 2, collectInto(frames)));
+    EXPECT_FALSE(parser.hasPartialFrame());
+    EXPECT_TRUE(frames.empty());
+}
+
+
+}  // namespace tests
+}  // namespace teleop_led_benchmarks
@@ -0,0 +1,312 @@
+#include "net.hpp"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <future>
+#include <optional>
+
+#include "device_emulator.hpp"
+
+namespace teleop_led_benchmarks
+{
+namespace tests
+{
+
+
+namespace desktop = teleop_led_benchmarks::desktop;
+using ConnectionEvent = desktop::ConnectionEvent;
+using ConnectionEventType = desktop::ConnectionEventType;
+using IOEvent = desktop::IOEvent;
+using IOEventType = desktop::IOEventType;
+using steady_clock = std::chrono::steady_clock;
+
+
+TEST(NetTest, StaleDisconnectKeepsLinkUp)
+{
+    desktop::LinkState link{};
+    ConnectionEvent e{};
+    e.type = ConnectionEventType::CONNECTED;
+    e.connId = 1;
+    desktop::applyConnectionEvent(link, e);
+    e.connId = 2;
+    desktop::applyConnectionEvent(link, e);
+    ASSERT_TRUE(link.isConnected);
+    EXPECT_EQ(link.connId, 2u);
+
+    e.type = ConnectionEventType::DISCONNECTED;
+    e.connId = 1;
+    desktop::applyConnectionEvent(link, e);
+    EXPECT_TRUE(link.isConnected);
+    e.connId = 2;
+    desktop::applyConnectionEvent(link, e);
+    EXPECT_FALSE(link.isConnected);
+}
+
+
+TEST(NetTest, IOEventsUpdateLink)
+{
+    desktop::LinkState link{};
+    link.numInFlight = 3;
+    IOEvent e{};
+    e.type = IOEventType::ACK_RECEIVED;
+    e.seq = 0;
+    e.latency = std::chrono::duration<uint32_t, std::micro>(1500);
+    desktop::applyIOEvent(link, e);
+    EXPECT_EQ(link.numInFlight, 2u);
+    EXPECT_DOUBLE_EQ(link.lastBlinkLatency.count(), 1.5);
+    EXPECT_EQ(link.blinkLatencies.count(), 1u);
+
+    e.type = IOEventType::COMMAND_TIMED_OUT;
+    e.seq = 1;
+    desktop::applyIOEvent(link, e);
+    e.type = IOEventType::UNMATCHED_ACK;
+    desktop::applyIOEvent(link, e);
+    e.type = IOEventType::MALFORMED_MSG;
+    desktop::applyIOEvent(link, e);
+    EXPECT_EQ(link.numInFlight, 1u);
+    EXPECT_EQ(link.numTimedOut, 1u);
+    EXPECT_EQ(link.numUnmatchedAcks, 1u);
+    EXPECT_EQ(link.numMalformedMsgs, 1u);
+    EXPECT_EQ(link.blinkLatencies.count(), 1u);
+}
+
+
+TEST(NetTest, WakesConsumerOncePerDrain)
+{
+    desktop::EmulatorConfig emulatorConfig{};
+    std::atomic<bool> stopFlag{false};
+    desktop::EmulatorReport emulatorReport{};
+    auto futEmulator = std::async(std::launch::async, [&]()
+        { return desktop::runDeviceEmulator(stopFlag, emulatorConfig, emulatorReport); });
+    desktop::asio::io_context ioc{1};
+    desktop::NetState net{ioc, desktop::ConnectionType::CUSTOM_TCP, false};
+    size_t numWakes = 0;
+    net.wakeConsumer = [&numWakes]()
+    { ++numWakes; };
+    desktop::asyncWaitForConnection(net);
+
+    auto deadline = steady_clock::now() + std::chrono::seconds(10);
+    ConnectionEvent connEvent{};
+    while (!net.connEvents.tryPop(connEvent) && steady_clock::now() < deadline)
+    {
+        ioc.run_one_for(std::chrono::milliseconds(100));
+    }
+    ASSERT_EQ(connEvent.type, ConnectionEventType::CONNECTED);
+    EXPECT_EQ(numWakes, 1u);
+
+    for (int i = 0; i < 3; ++i)
+    {
+        desktop::sendBlinkCommand(net);
+    }
+    size_t numAcks = 0;
+    IOEvent e{};
+    while (numAcks < 3 && steady_clock::now() < deadline)
+    {
+        ioc.run_one_for(std::chrono::milliseconds(100));
+        while (net.ioEvents.tryPop(e))
+        {
+            ++numAcks;
+        }
+    }
+    ASSERT_EQ(numAcks, 3u);
+    // Not rearmed, so the acks didn't wake the consumer again.
+    EXPECT_EQ(numWakes, 1u);
+
+    desktop::rearmConsumerWake(net);
+    desktop::sendBlinkCommand(net);
+    while (numWakes < 2 && steady_clock::now() < deadline)
+    {
+        ioc.run_one_for(std::chrono::milliseconds(100));
+    }
+    EXPECT_EQ(numWakes, 2u);
+
+    desktop::closeConnection(net);
+    ioc.restart();
+    ioc.poll();
+    stopFlag.store(true);
+    ASSERT_EQ(futEmulator.get(), 0);
+}
+
+
+// Pops connection events until one of the given type, skipping clock updates.
+static bool waitForConnectionEvent(desktop::asio::io_context& ioc, desktop::NetState& net,
+    ConnectionEventType type, ConnectionEvent& e)
+{
+    auto deadline = steady_clock::now() + std::chrono::seconds(10);
+    while (steady_clock::now() < deadline)
+    {
+        while (net.connEvents.tryPop(e))
+        {
+            if (e.type == type)
+            {
+                return true;
+            }
+        }
+        ioc.run_one_for(std::chrono::milliseconds(100));
+    }
+    return false;
+}
+
+
+TEST(NetTest, InvalidTcpHeaderDropsTheConnection)
+{
+    desktop::asio::io_context ioc{1};
+    desktop::NetState net{ioc, desktop::ConnectionType::CUSTOM_TCP, false};
+    desktop::asyncWaitForConnection(net);
+
+    // Listening already, so the connect completes from the backlog.
+    desktop::asio::io_context deviceIoc{1};
+    desktop::tcp::socket device{deviceIoc};
+    device.connect({desktop::asio::ip::make_address("127.0.0.1"), desktop::CUSTOM_TCP_PORT});
+    ConnectionEvent connEvent{};
+    ASSERT_TRUE(waitForConnectionEvent(ioc, net, ConnectionEventType::CONNECTED, connEvent));
+
+    // A length no frame can have.
+    std::array<uint8_t, desktop::FRAME_HEADER_SIZE> garbage{};
+    garbage.fill(0xff);
+    desktop::asio::write(device, desktop::asio::buffer(garbage));
+    ASSERT_TRUE(waitForConnectionEvent(ioc, net, ConnectionEventType::DISCONNECTED, connEvent));
+    EXPECT_EQ(connEvent.connId, 1u);
+    EXPECT_EQ(net.numMalformedMsgs, 1u);
+
+    // Closed on our side too, so after the clock probe the device sees the end of the stream.
+    boost::system::error_code ec;
+    std::array<uint8_t, 256> readBuf{};
+    while (!ec)
+    {
+        device.read_some(desktop::asio::buffer(readBuf), ec);
+    }
+    EXPECT_EQ(ec, desktop::asio::error::eof);
+
+    desktop::closeConnection(net);
+    ioc.restart();
+    ioc.poll();
+}
+
+
+TEST(NetTest, InvalidHeaderOverUringDropsTheConnectionAfterTheBatch)
+{
+    desktop::asio::io_context ioc{1};
+    desktop::NetState net{ioc, desktop::ConnectionType::CUSTOM_TCP, false};
+    net.tcpIoBackend = desktop::TcpIoBackend::IO_URING;
+    desktop::asyncWaitForConnection(net);
+
+    desktop::asio::io_context deviceIoc{1};
+    desktop::tcp::socket device{deviceIoc};
+    device.connect({desktop::asio::ip::make_address("127.0.0.1"), desktop::CUSTOM_TCP_PORT});
+    ConnectionEvent connEvent{};
+    ASSERT_TRUE(waitForConnectionEvent(ioc, net, ConnectionEventType::CONNECTED, connEvent));
+    ASSERT_TRUE(net.uring);
+
+    // Waiting before the clock probe's write and the read behind it are submitted, so both
+    // usually complete in the same batch.
+    std::array<uint8_t, desktop::FRAME_HEADER_SIZE> garbage{};
+    garbage.fill(0xff);
+    desktop::asio::write(device, desktop::asio::buffer(garbage));
+    auto deadline = steady_clock::now() + std::chrono::seconds(10);
+    while (net.uring && steady_clock::now() < deadline)
+    {
+        desktop::pollUring(net, std::chrono::milliseconds(100));
+    }
+    ASSERT_FALSE(net.uring);
+    ASSERT_TRUE(waitForConnectionEvent(ioc, net, ConnectionEventType::DISCONNECTED, connEvent));
+    EXPECT_EQ(net.numMalformedMsgs, 1u);
+    // The probe's write was completed rather than dropped with the rest of the batch.
+    EXPECT_EQ(net.numWrites, 1u);
+    EXPECT_FALSE(net.isWriting);
+
+    boost::system::error_code ec;
+    std::array<uint8_t, 256> readBuf{};
+    while (!ec)
+    {
+        device.read_some(desktop::asio::buffer(readBuf), ec);
+    }
+    EXPECT_EQ(ec, desktop::asio::error::eof);
+
+    desktop::closeConnection(net);
+    ioc.restart();
+    ioc.poll();
+}
+
+
+// Runs ioc until sock receives a command, answering nothing, and returns its seq.
+static std::optional<uint32_t> receiveCommand(desktop::asio::io_context& ioc, desktop::udp::socket& sock)
+{
+    std::array<uint8_t, desktop::MAX_FRAME_SIZE> buf{};
+    auto deadline = steady_clock::now() + std::chrono::seconds(10);
+    while (steady_clock::now() < deadline)
+    {
+        ioc.run_one_for(std::chrono::milliseconds(10));
+        while (sock.available() > 0)
+        {
+            size_t numBytes = sock.receive(desktop::asio::buffer(buf));
+            auto header = numBytes >= desktop::FRAME_HEADER_SIZE ? desktop::decodeHeader(buf.data())
+                                                                 : std::nullopt;
+            if (header && header->type == desktop::MsgType::COMMAND)
+            {
+                return header->seq;
+            }
+        }
+    }
+    return std::nullopt;
+}
+
+
+TEST(NetTest, UdpHelloFromANewEndpointReplacesThePeer)
+{
+    desktop::asio::io_context ioc{1};
+    desktop::NetState net{ioc, desktop::ConnectionType::UDP, false};
+    desktop::asyncWaitForConnection(net);
+
+    desktop::asio::io_context deviceIoc{1};
+    desktop::udp::endpoint server{desktop::asio::ip::make_address("127.0.0.1"), desktop::UDP_PORT};
+    std::array<uint8_t, desktop::FRAME_HEADER_SIZE> hello{};
+    desktop::encodeFrame(desktop::MsgType::HELLO, 0, 0, nullptr, 0, hello.data());
+    desktop::udp::socket before{deviceIoc, desktop::udp::endpoint{desktop::udp::v4(), 0}};
+    before.send_to(desktop::asio::buffer(hello), server);
+    ConnectionEvent connEvent{};
+    ASSERT_TRUE(waitForConnectionEvent(ioc, net, ConnectionEventType::CONNECTED, connEvent));
+    EXPECT_EQ(connEvent.connId, 1u);
+    // Repeated hellos from the same endpoint are the same device.
+    before.send_to(desktop::asio::buffer(hello), server);
+    desktop::sendBlinkCommand(net);
+    EXPECT_EQ(receiveCommand(ioc, before), 0u);
+
+    // Rebooted, the device says hello from a new port and its last command is never acked.
+    desktop::udp::socket after{deviceIoc, desktop::udp::endpoint{desktop::udp::v4(), 0}};
+    after.send_to(desktop::asio::buffer(hello), server);
+    ASSERT_TRUE(waitForConnectionEvent(ioc, net, ConnectionEventType::DISCONNECTED, connEvent));
+    EXPECT_EQ(connEvent.connId, 1u);
+    ASSERT_TRUE(waitForConnectionEvent(ioc, net, ConnectionEventType::CONNECTED, connEvent));
+    EXPECT_EQ(connEvent.connId, 2u);
+    IOEvent e{};
+    ASSERT_TRUE(net.ioEvents.tryPop(e));
+    EXPECT_EQ(e.type, IOEventType::COMMAND_TIMED_OUT);
+    EXPECT_EQ(e.seq, 0u);
+    EXPECT_EQ(e.connId, 1u);
+    EXPECT_EQ(net.numTimedOut, 1u);
+
+    // Commands now go to, and acks are taken from, the new endpoint.
+    desktop::sendBlinkCommand(net);
+    EXPECT_EQ(receiveCommand(ioc, after), 1u);
+    std::array<uint8_t, desktop::MAX_FRAME_SIZE> ack{};
+    size_t ackSize = desktop::encodeAck(1, 0, 0, ack.data());
+    after.send_to(desktop::asio::buffer(ack.data(), ackSize), server);
+    auto deadline = steady_clock::now() + std::chrono::seconds(10);
+    while (!net.ioEvents.tryPop(e) && steady_clock::now() < deadline)
+    {
+        ioc.run_one_for(std::chrono::milliseconds(100));
+    }
+    EXPECT_EQ(e.type, IOEventType::ACK_RECEIVED);
+    EXPECT_EQ(e.seq, 1u);
+    EXPECT_EQ(e.connId, 2u);
+
+    desktop::closeConnection(net);
+    ioc.restart();
+    ioc.poll();
+}
+
+
+}  // namespace tests
+}  // namespace teleop_led_benchmarks
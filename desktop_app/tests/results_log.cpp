@@ -0,0 +1,157 @@
+#include "results_log.hpp"
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <future>
+#include <thread>
+
+#include "device_emulator.hpp"
+#include "net.hpp"
+#include "runner.hpp"
+
+namespace teleop_led_benchmarks
+{
+namespace tests
+{
+
+
+namespace desktop = teleop_led_benchmarks::desktop;
+using ConnectionType = desktop::ConnectionType;
+
+
+static desktop::ResultRecord makeRecord(uint32_t i)
+{
+    desktop::ResultRecord r{};
+    r.ackReadNs = 1'000'000 + uint64_t{i} * 1'000;
+    r.latencyUs = 500 + i % 100;
+    r.seq = i;
+    r.numBytes = 12;
+    r.connId = 1;
+    r.type = static_cast<uint8_t>(desktop::IOEventType::ACK_RECEIVED);
+    return r;
+}
+
+
+TEST(ResultsLogTest, RecordedRecordsReadBackInOrder)
+{
+    std::string path = testing::TempDir() + "results_round_trip.bin";
+    constexpr uint32_t numRecords = 200'000;  // a few times the queue, drained while recording
+    {
+        desktop::ResultsRecorder recorder{path, ConnectionType::WEB_SOCKET};
+        ASSERT_TRUE(recorder.isOpen());
+        for (uint32_t i = 0; i < numRecords; ++i)
+        {
+            recorder.record(makeRecord(i));
+            if (i % 10'000 == 0)
+            {
+                std::this_thread::sleep_for(desktop::RESULTS_FLUSH_INTERVAL);
+            }
+        }
+        ASSERT_TRUE(recorder.close());
+        EXPECT_EQ(recorder.numWritten() + recorder.numDropped(), numRecords);
+    }
+
+    desktop::ResultsLogReader reader{};
+    ASSERT_TRUE(reader.open(path));
+    EXPECT_EQ(reader.connType(), ConnectionType::WEB_SOCKET);
+    ASSERT_GT(reader.size(), 0u);
+    // Dropped records leave gaps, but never reorder.
+    uint32_t lastSeq = reader[0].seq;
+    for (const auto& r : reader)
+    {
+        ASSERT_EQ(r.latencyUs, makeRecord(r.seq).latencyUs);
+        ASSERT_GE(r.seq, lastSeq);
+        lastSeq = r.seq;
+    }
+    EXPECT_EQ(reader[reader.size() - 1].seq, numRecords - 1);
+}
+
+
+TEST(ResultsLogTest, IgnoresPartialLastRecord)
+{
+    std::string path = testing::TempDir() + "results_partial.bin";
+    {
+        desktop::ResultsRecorder recorder{path, ConnectionType::UDP};
+        for (uint32_t i = 0; i < 3; ++i)
+        {
+            recorder.record(makeRecord(i));
+        }
+    }
+    {
+        std::ofstream out{path, std::ios::binary | std::ios::app};
+        out << "partial";
+    }
+    desktop::ResultsLogReader reader{};
+    ASSERT_TRUE(reader.open(path));
+    ASSERT_EQ(reader.size(), 3u);
+    EXPECT_EQ(reader[2].seq, 2u);
+
+    auto summary = desktop::summarizeResultsLog(reader);
+    EXPECT_EQ(summary.connType, ConnectionType::UDP);
+    EXPECT_EQ(summary.summary.count, 3u);
+    EXPECT_NEAR(summary.elapsedS, 2e-6, 1e-9);
+}
+
+
+TEST(ResultsLogTest, RejectsOtherFiles)
+{
+    std::string path = testing::TempDir() + "results_not_a_log.bin";
+    {
+        std::ofstream out{path, std::ios::binary};
+        out << std::string(256, 'x');
+    }
+    desktop::ResultsLogReader reader{};
+    EXPECT_FALSE(reader.open(path));
+    EXPECT_EQ(reader.size(), 0u);
+    EXPECT_EQ(reader.begin(), reader.end());
+    EXPECT_FALSE(reader.open(testing::TempDir() + "results_missing.bin"));
+
+    // A valid header apart from the connection type.
+    desktop::ResultsLogHeader header{};
+    header.recordSize = sizeof(desktop::ResultRecord);
+    header.connType = static_cast<uint8_t>(desktop::CONNECTION_TYPE_STRINGS.size());
+    {
+        std::ofstream out{path, std::ios::binary | std::ios::trunc};
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+    EXPECT_FALSE(reader.open(path));
+    EXPECT_EQ(reader.size(), 0u);
+}
+
+
+TEST(ResultsLogTest, RunnerLogsEveryRoundTrip)
+{
+    desktop::EmulatorConfig emulatorConfig{};
+    emulatorConfig.connType = ConnectionType::CUSTOM_TCP;
+    std::atomic<bool> stopFlag{false};
+    desktop::EmulatorReport emulatorReport{};
+    auto futEmulator = std::async(std::launch::async, [&]()
+        { return desktop::runDeviceEmulator(stopFlag, emulatorConfig, emulatorReport); });
+    desktop::RunnerConfig config{};
+    config.connType = ConnectionType::CUSTOM_TCP;
+    config.numCommands = 300;
+    config.maxInFlight = 4;
+    config.logPath = testing::TempDir() + "results_runner.bin";
+    desktop::RunnerReport report{};
+    int exitCode = desktop::runBenchmark(stopFlag, config, report);
+    stopFlag.store(true);
+    ASSERT_EQ(futEmulator.get(), 0);
+    ASSERT_EQ(exitCode, 0);
+
+    desktop::ResultsLogReader reader{};
+    ASSERT_TRUE(reader.open(config.logPath));
+    auto summary = desktop::summarizeResultsLog(reader);
+    EXPECT_EQ(summary.connType, ConnectionType::CUSTOM_TCP);
+    EXPECT_EQ(summary.summary.count, 300u);
+    EXPECT_EQ(summary.summary.p50Ms, report.summary.p50Ms);
+    EXPECT_EQ(summary.uplinkSummary.count, report.uplinkSummary.count);
+    for (const auto& r : reader)
+    {
+        EXPECT_NE(r.connId, 0u);
+    }
+}
+
+
+}  // namespace tests
+}  // namespace teleop_led_benchmarks
@@ -0,0 +1,418 @@
+#include "runner.hpp"
+
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+
+#include <boost/asio/connect.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/ip/udp.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+#include <algorithm>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "messages.hpp"
+#include "trace.hpp"
+
+namespace teleop_led_benchmarks
+{
+namespace tests
+{
+
+
+namespace desktop = teleop_led_benchmarks::desktop;
+namespace beast = boost::beast;
+namespace websocket = beast::websocket;
+namespace asio = boost::asio;
+using tcp = boost::asio::ip::tcp;
+using udp = boost::asio::ip::udp;
+using ConnectionType = desktop::ConnectionType;
+
+
+// Retries until the runner's acceptor is listening.
+static void connectWithRetry(tcp::socket& sock, const std::string& port)
+{
+    tcp::resolver resolver{sock.get_executor()};
+    auto const results = resolver.resolve("127.0.0.1", port);
+    for (int attempt = 0;; ++attempt)
+    {
+        try
+        {
+            asio::connect(sock, results);
+            return;
+        }
+        catch (const boost::system::system_error& e)
+        {
+            if (attempt == 50)
+            {
+                throw;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+}
+
+
+// The fake devices' clock runs this far ahead of the desktop's.
+constexpr int64_t DEVICE_CLOCK_OFFSET_US = 3'600'000'000;
+
+
+static uint64_t deviceClockUs()
+{
+    return desktop::steadyClockNs(std::chrono::steady_clock::now()) / 1000 + DEVICE_CLOCK_OFFSET_US;
+}
+
+
+// Acks commands and answers clock probes like the esp32 firmware.
+static std::vector<uint8_t> makeReply(const desktop::FrameHeader& frame)
+{
+    std::vector<uint8_t> reply(desktop::SYNC_REPLY_FRAME_SIZE);
+    uint64_t receivedUs = deviceClockUs();
+    if (frame.type == desktop::MsgType::SYNC_REQUEST)
+    {
+        reply.resize(desktop::encodeSyncReply(frame.seq, frame.sendTimeUs, receivedUs, deviceClockUs(),
+            reply.data()));
+        return reply;
+    }
+    EXPECT_EQ(frame.type, desktop::MsgType::COMMAND);
+    reply.resize(desktop::encodeAck(frame.seq, receivedUs, deviceClockUs(), reply.data()));
+    return reply;
+}
+
+
+// Behaves like the esp32 tcp client: ack every command, echoing its sequence number.
+static void runTcpDevice()
+{
+    asio::io_context ioc{};
+    tcp::socket sock{ioc};
+    connectWithRetry(sock, "9003");
+    std::array<uint8_t, 1024> buf{};
+    std::vector<uint8_t> acks;
+    desktop::FrameParser parser{};
+    boost::system::error_code ec;
+    while (true)
+    {
+        auto numBytes = sock.read_some(asio::buffer(buf), ec);
+        if (ec)
+        {
+            return;
+        }
+        bool isValid = parser.feed(buf.data(), numBytes,
+            [&acks](const desktop::FrameHeader& header, const uint8_t*)
+            {
+                auto reply = makeReply(header);
+                acks.insert(acks.end(), reply.begin(), reply.end());
+            });
+        ASSERT_TRUE(isValid);
+        asio::write(sock, asio::buffer(acks), ec);
+        acks.clear();
+        if (ec)
+        {
+            return;
+        }
+    }
+}
+
+
+// Like the firmware, replies to each frame of a message, which may hold several, with a message of its own.
+static void runWsDevice()
+{
+    asio::io_context ioc{};
+    websocket::stream<tcp::socket> ws{ioc};
+    connectWithRetry(ws.next_layer(), "9002");
+    ws.handshake("127.0.0.1:9002", "/");
+    ws.binary(true);
+    beast::flat_buffer buf;
+    std::vector<std::vector<uint8_t>> replies;
+    desktop::FrameParser parser{};
+    boost::system::error_code ec;
+    while (true)
+    {
+        ws.read(buf, ec);
+        if (ec)
+        {
+            return;
+        }
+        bool isValid = parser.feed(static_cast<const uint8_t*>(buf.data().data()), buf.size(),
+            [&replies](const desktop::FrameHeader& header, const uint8_t*)
+            { replies.push_back(makeReply(header)); });
+        ASSERT_TRUE(isValid);
+        ASSERT_FALSE(parser.hasPartialFrame());
+        buf.consume(buf.size());
+        for (const auto& reply : replies)
+        {
+            ws.write(asio::buffer(reply), ec);
+            if (ec)
+            {
+                return;
+            }
+        }
+        replies.clear();
+    }
+}
+
+
+/**
+ * Behaves like the esp32 udp client, which repeats its hello until the first
+ * command arrives. Drops the acks for seqs in dropSeqs and sends the acks
+ * for seqs in dupSeqs twice, clock probes are always answered once.
+ */
+static void runUdpDevice(const std::atomic<bool>& stopFlag, const std::vector<uint32_t>& dropSeqs,
+    const std::vector<uint32_t>& dupSeqs)
+{
+    asio::io_context ioc{};
+    udp::socket sock{ioc, udp::endpoint{udp::v4(), 0}};
+    udp::endpoint server{asio::ip::make_address("127.0.0.1"), 9004};
+    timeval timeout{.tv_sec = 0, .tv_usec = 50'000};
+    setsockopt(sock.native_handle(), SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    std::array<uint8_t, desktop::MAX_FRAME_SIZE> buf{};
+    std::array<uint8_t, desktop::FRAME_HEADER_SIZE> hello{};
+    desktop::encodeFrame(desktop::MsgType::HELLO, 0, 0, nullptr, 0, hello.data());
+    bool isGreeted = false;
+    boost::system::error_code ec;
+    while (!stopFlag.load())
+    {
+        if (!isGreeted)
+        {
+            sock.send_to(asio::buffer(hello), server, 0, ec);
+        }
+        // asio's blocking receive retries on EAGAIN, so SO_RCVTIMEO only works with plain recv.
+        auto numBytes = ::recv(sock.native_handle(), buf.data(), buf.size(), 0);
+        if (numBytes < 0)
+        {
+            continue;
+        }
+        isGreeted = true;
+        ASSERT_GE(numBytes, static_cast<ssize_t>(desktop::FRAME_HEADER_SIZE));
+        auto header = desktop::decodeHeader(buf.data());
+        ASSERT_TRUE(header.has_value());
+        auto reply = makeReply(*header);
+        bool isCommand = header->type == desktop::MsgType::COMMAND;
+        if (isCommand && std::find(dropSeqs.begin(), dropSeqs.end(), header->seq) != dropSeqs.end())
+        {
+            continue;
+        }
+        sock.send_to(asio::buffer(reply), server, 0, ec);
+        if (isCommand && std::find(dupSeqs.begin(), dupSeqs.end(), header->seq) != dupSeqs.end())
+        {
+            sock.send_to(asio::buffer(reply), server, 0, ec);
+        }
+    }
+}
+
+
+TEST(RunnerTest, CustomTcpRoundTrips)
+{
+    std::atomic<bool> stopFlag{false};
+    desktop::RunnerConfig config{};
+    config.connType = ConnectionType::CUSTOM_TCP;
+    config.numCommands = 200;
+    config.numWarmup = 10;
+    desktop::RunnerReport report{};
+    auto futExitCode = std::async(std::launch::async, [&]()
+        { return desktop::runBenchmark(stopFlag, config, report); });
+    std::thread device{runTcpDevice};
+    auto exitCode = futExitCode.get();
+    device.join();
+
+    ASSERT_EQ(exitCode, 0);
+    EXPECT_EQ(report.histogram.count(), 200u);
+    EXPECT_EQ(report.summary.count, 200u);
+    EXPECT_LE(report.summary.minMs, report.summary.p50Ms);
+    EXPECT_LE(report.summary.p50Ms, report.summary.p99Ms);
+    EXPECT_LE(report.summary.p99Ms, report.summary.p999Ms);
+    EXPECT_LE(report.summary.p999Ms, report.summary.maxMs);
+}
+
+
+TEST(RunnerTest, WebsocketRoundTripsAtRate)
+{
+    std::atomic<bool> stopFlag{false};
+    desktop::RunnerConfig config{};
+    config.connType = ConnectionType::WEB_SOCKET;
+    config.numCommands = 50;
+    config.rateHz = 500.0;
+    desktop::RunnerReport report{};
+    auto futExitCode = std::async(std::launch::async, [&]()
+        { return desktop::runBenchmark(stopFlag, config, report); });
+    std::thread device{runWsDevice};
+    auto exitCode = futExitCode.get();
+    device.join();
+
+    ASSERT_EQ(exitCode, 0);
+    EXPECT_EQ(report.summary.count, 50u);
+    // 50 commands at 500 Hz can't finish faster than 49 periods
+    EXPECT_GE(report.elapsedS, 0.098 - 1e-3);
+}
+
+
+TEST(RunnerTest, WebsocketStreamsAtRate)
+{
+    std::atomic<bool> stopFlag{false};
+    desktop::RunnerConfig config{};
+    config.connType = ConnectionType::WEB_SOCKET;
+    config.numCommands = 200;
+    config.rateHz = 2000.0;
+    config.isStreaming = true;
+    config.payloadSize = 16;
+    desktop::RunnerReport report{};
+    auto futExitCode = std::async(std::launch::async, [&]()
+        { return desktop::runBenchmark(stopFlag, config, report); });
+    std::thread device{runWsDevice};
+    auto exitCode = futExitCode.get();
+    device.join();
+
+    ASSERT_EQ(exitCode, 0);
+    EXPECT_EQ(report.summary.count, 200u);
+    EXPECT_EQ(report.numTimedOut, 0u);
+    EXPECT_EQ(report.numMalformedMsgs, 0u);
+    // Paced, not limited by the default window of 1 or how fast the acks come back.
+    EXPECT_GE(report.elapsedS, 0.0995 - 1e-3);
+    EXPECT_LE(report.msgsPerS, 2000.0 * 1.01);
+    EXPECT_GT(report.msgsPerS, 1000.0);
+    EXPECT_NEAR(report.bytesPerS, report.msgsPerS * static_cast<double>(desktop::FRAME_HEADER_SIZE + 16), 1.0);
+}
+
+
+TEST(RunnerTest, CustomTcpPipelinedRoundTrips)
+{
+    std::atomic<bool> stopFlag{false};
+    desktop::RunnerConfig config{};
+    config.connType = ConnectionType::CUSTOM_TCP;
+    config.numCommands = 500;
+    config.numWarmup = 20;
+    config.maxInFlight = 16;
+    config.payloadSize = 100;
+    config.tracePath = testing::TempDir() + "pipelined_trace.json";
+    desktop::RunnerReport report{};
+    auto futExitCode = std::async(std::launch::async, [&]()
+        { return desktop::runBenchmark(stopFlag, config, report); });
+    std::thread device{runTcpDevice};
+    auto exitCode = futExitCode.get();
+    device.join();
+
+    ASSERT_EQ(exitCode, 0);
+    EXPECT_EQ(report.summary.count, 500u);
+    EXPECT_EQ(report.numTimedOut, 0u);
+    EXPECT_EQ(report.numUnmatchedAcks, 0u);
+    // The probe goes out ahead of the first command, so every ack splits into one-way delays.
+    ASSERT_TRUE(report.clock.has_value());
+    EXPECT_NEAR(report.clock->offsetUs, static_cast<double>(DEVICE_CLOCK_OFFSET_US),
+        report.clock->errorBoundUs + 1.0);
+    EXPECT_EQ(report.uplinkSummary.count, 500u);
+    EXPECT_EQ(report.downlinkSummary.count, 500u);
+    EXPECT_LE(report.uplinkSummary.p50Ms, report.summary.p50Ms);
+    // The first window queues up behind the probe and goes out in gathered writes.
+    EXPECT_GT(report.framesPerWrite, 1.0);
+    std::ifstream trace{config.tracePath};
+    std::string traceJson{std::istreambuf_iterator<char>(trace), std::istreambuf_iterator<char>()};
+    EXPECT_NE(traceJson.find("\"device ack sent\""), std::string::npos);
+}
+
+
+TEST(RunnerTest, CustomTcpIoUringPipelinedRoundTrips)
+{
+    std::atomic<bool> stopFlag{false};
+    desktop::RunnerConfig config{};
+    config.connType = ConnectionType::CUSTOM_TCP;
+    config.tcpIoBackend = desktop::TcpIoBackend::IO_URING;
+    config.numCommands = 500;
+    config.numWarmup = 20;
+    config.maxInFlight = 16;
+    config.payloadSize = 100;
+    desktop::RunnerReport report{};
+    auto futExitCode = std::async(std::launch::async, [&]()
+        { return desktop::runBenchmark(stopFlag, config, report); });
+    std::thread device{runTcpDevice};
+    auto exitCode = futExitCode.get();
+    device.join();
+
+    ASSERT_EQ(exitCode, 0);
+    EXPECT_EQ(report.summary.count, 500u);
+    EXPECT_EQ(report.numTimedOut, 0u);
+    EXPECT_EQ(report.numUnmatchedAcks, 0u);
+    EXPECT_EQ(report.numMalformedMsgs, 0u);
+    EXPECT_TRUE(report.clock.has_value());
+    EXPECT_GT(report.framesPerWrite, 1.0);
+}
+
+
+TEST(RunnerTest, CustomTcpRoundTripsBusyPolling)
+{
+    std::atomic<bool> stopFlag{false};
+    desktop::RunnerConfig config{};
+    config.connType = ConnectionType::CUSTOM_TCP;
+    config.numCommands = 200;
+    config.busyPoll.spinBudget = std::chrono::microseconds(200);
+    desktop::RunnerReport report{};
+    auto futExitCode = std::async(std::launch::async, [&]()
+        { return desktop::runBenchmark(stopFlag, config, report); });
+    std::thread device{runTcpDevice};
+    auto exitCode = futExitCode.get();
+    device.join();
+
+    ASSERT_EQ(exitCode, 0);
+    EXPECT_EQ(report.summary.count, 200u);
+    EXPECT_GT(report.ioThread.numHandlers, 200u);
+    EXPECT_GT(report.ioThread.cpuS, 0.0);
+    EXPECT_LE(report.ioThread.cpuS, report.ioThread.elapsedS + 0.01);
+}
+
+
+TEST(RunnerTest, RunsJitterTestBeforeConnecting)
+{
+    std::atomic<bool> stopFlag{false};
+    desktop::RunnerConfig config{};
+    config.connType = ConnectionType::CUSTOM_TCP;
+    config.numCommands = 50;
+    config.jitterTest.numWakeups = 20;
+    config.jitterTest.interval = std::chrono::microseconds(500);
+    desktop::RunnerReport report{};
+    auto futExitCode = std::async(std::launch::async, [&]()
+        { return desktop::runBenchmark(stopFlag, config, report); });
+    std::thread device{runTcpDevice};
+    auto exitCode = futExitCode.get();
+    device.join();
+
+    ASSERT_EQ(exitCode, 0);
+    EXPECT_EQ(report.summary.count, 50u);
+    EXPECT_EQ(report.osJitterSummary.count, 20u);
+    EXPECT_LE(report.osJitterSummary.p50Ms, report.osJitterSummary.maxMs);
+}
+
+
+TEST(RunnerTest, UdpCountsLossAndDuplicates)
+{
+    std::atomic<bool> stopFlag{false};
+    desktop::RunnerConfig config{};
+    config.connType = ConnectionType::UDP;
+    config.numCommands = 100;
+    config.ackTimeoutMs = 50;
+    desktop::RunnerReport report{};
+    auto futExitCode = std::async(std::launch::async, [&]()
+        { return desktop::runBenchmark(stopFlag, config, report); });
+    std::atomic<bool> deviceStopFlag{false};
+    std::thread device{runUdpDevice, std::cref(deviceStopFlag), std::vector<uint32_t>{7, 30},
+        std::vector<uint32_t>{13, 50}};
+    auto exitCode = futExitCode.get();
+    deviceStopFlag.store(true);
+    device.join();
+
+    EXPECT_EQ(exitCode, 1);  // the dropped round trips never completed
+    EXPECT_EQ(report.summary.count, 98u);
+    EXPECT_EQ(report.numTimedOut, 2u);
+    EXPECT_EQ(report.numDuplicateAcks, 2u);
+    EXPECT_EQ(report.numUnmatchedAcks, 2u);
+    EXPECT_EQ(report.numMalformedMsgs, 0u);
+}
+
+
+}  // namespace tests
+}  // namespace teleop_led_benchmarks
@@ -0,0 +1,64 @@
+#include "sequence_tracker.hpp"
+
+#include <gtest/gtest.h>
+
+namespace teleop_led_benchmarks
+{
+namespace tests
+{
+
+
+namespace desktop = teleop_led_benchmarks::desktop;
+using SequenceTracker = desktop::SequenceTracker;
+using SeqArrival = desktop::SeqArrival;
+
+
+TEST(SequenceTrackerTest, InOrder)
+{
+    SequenceTracker tracker{};
+    for (uint32_t seq = 0; seq < 5000; ++seq)
+    {
+        ASSERT_EQ(tracker.record(seq), SeqArrival::IN_ORDER);
+    }
+    EXPECT_EQ(tracker.numReceived(), 5000u);
+    EXPECT_EQ(tracker.numMissing(), 0u);
+    EXPECT_EQ(tracker.numDuplicates(), 0u);
+    EXPECT_EQ(tracker.numReordered(), 0u);
+}
+
+
+TEST(SequenceTrackerTest, GapsDuplicatesAndReordering)
+{
+    SequenceTracker tracker{};
+    EXPECT_EQ(tracker.record(0), SeqArrival::IN_ORDER);
+    EXPECT_EQ(tracker.record(3), SeqArrival::IN_ORDER);
+    EXPECT_EQ(tracker.numMissing(), 2u);
+    EXPECT_EQ(tracker.record(1), SeqArrival::REORDERED);
+    EXPECT_EQ(tracker.record(1), SeqArrival::DUPLICATE);
+    EXPECT_EQ(tracker.record(3), SeqArrival::DUPLICATE);
+    EXPECT_EQ(tracker.numMissing(), 1u);
+    EXPECT_EQ(tracker.numReceived(), 3u);
+    EXPECT_EQ(tracker.numDuplicates(), 2u);
+    EXPECT_EQ(tracker.numReordered(), 1u);
+}
+
+
+TEST(SequenceTrackerTest, WindowSlides)
+{
+    SequenceTracker tracker{};
+    tracker.record(0);
+    tracker.record(SequenceTracker::WINDOW + 5);
+    // The slot seq 5 shares with WINDOW + 5 must not read as a duplicate.
+    EXPECT_EQ(tracker.record(5), SeqArrival::TOO_OLD);
+    EXPECT_EQ(tracker.record(SequenceTracker::WINDOW + 4), SeqArrival::REORDERED);
+    EXPECT_EQ(tracker.record(SequenceTracker::WINDOW + 4), SeqArrival::DUPLICATE);
+
+    tracker.reset();
+    EXPECT_EQ(tracker.numReceived(), 0u);
+    EXPECT_EQ(tracker.record(7), SeqArrival::IN_ORDER);
+    EXPECT_EQ(tracker.numMissing(), 7u);
+}
+
+
+}  // namespace tests
+}  // namespace teleop_led_benchmarks
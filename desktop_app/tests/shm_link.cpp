@@ -0,0 +1,104 @@
+#include "shm_link.hpp"
+
+#include <gtest/gtest.h>
+
+#include <future>
+
+namespace teleop_led_benchmarks
+{
+namespace tests
+{
+
+
+namespace desktop = teleop_led_benchmarks::desktop;
+
+
+constexpr char TEST_SHM_NAME[] = "/teleop_led_benchmarks_test";
+
+
+TEST(ShmLinkTest, RingsCarryFramesBetweenMappings)
+{
+    desktop::ShmSegment desktopSide{};
+    desktop::ShmSegment deviceSide{};
+    ASSERT_TRUE(desktopSide.create(TEST_SHM_NAME));
+    ASSERT_TRUE(deviceSide.open(TEST_SHM_NAME));
+
+    // Pushed through one mapping, popped through the other.
+    auto& toDevice = desktopSide.layout().toDevice;
+    std::array<uint8_t, desktop::MAX_FRAME_SIZE> frame{};
+    for (size_t i = 0; i < desktop::SHM_RING_CAPACITY; ++i)
+    {
+        size_t length = desktop::encodeFrame(desktop::MsgType::COMMAND, static_cast<uint32_t>(i), 0,
+            nullptr, 0, frame.data());
+        ASSERT_TRUE(toDevice.tryPush(frame.data(), length));
+    }
+    EXPECT_FALSE(toDevice.tryPush(frame.data(), desktop::FRAME_HEADER_SIZE));
+    for (size_t i = 0; i < desktop::SHM_RING_CAPACITY; ++i)
+    {
+        ASSERT_EQ(deviceSide.layout().toDevice.tryPop(frame.data()), desktop::FRAME_HEADER_SIZE);
+        EXPECT_EQ(desktop::decodeHeader(frame.data())->seq, i);
+    }
+    EXPECT_EQ(deviceSide.layout().toDevice.tryPop(frame.data()), 0u);
+
+    // Closing tells the device to let go, and a new device can't attach to the old segment.
+    desktopSide.close();
+    EXPECT_TRUE(deviceSide.layout().isClosed.load());
+    desktop::ShmSegment lateDevice{};
+    EXPECT_FALSE(lateDevice.open(TEST_SHM_NAME));
+}
+
+
+TEST(ShmLinkTest, SleepingConsumerWakesOnPush)
+{
+    desktop::ShmSegment segment{};
+    ASSERT_TRUE(segment.create(TEST_SHM_NAME));
+    auto& ring = segment.layout().toDesktop;
+    std::atomic<bool> stopFlag{false};
+
+    EXPECT_FALSE(ring.waitForPush(0, desktop::ShmWaitMode::FUTEX, std::chrono::milliseconds(20), stopFlag));
+
+    auto futWoken = std::async(std::launch::async, [&]()
+        { return ring.waitForPush(0, desktop::ShmWaitMode::FUTEX, std::chrono::seconds(10), stopFlag); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    auto pushedAt = std::chrono::steady_clock::now();
+    std::array<uint8_t, desktop::FRAME_HEADER_SIZE> hello{};
+    desktop::encodeFrame(desktop::MsgType::HELLO, 0, 0, nullptr, 0, hello.data());
+    ASSERT_TRUE(ring.tryPush(hello.data(), hello.size()));
+    EXPECT_TRUE(futWoken.get());
+    EXPECT_LT(std::chrono::steady_clock::now() - pushedAt, std::chrono::seconds(1));
+}
+
+
+TEST(ShmLinkTest, WatcherCoalescesUntilRearmed)
+{
+    desktop::ShmSegment segment{};
+    ASSERT_TRUE(segment.create(TEST_SHM_NAME));
+    auto& ring = segment.layout().toDesktop;
+    std::atomic<int> numNotified{0};
+    desktop::ShmRingWatcher watcher{ring, desktop::ShmWaitMode::FUTEX, [&]() { ++numNotified; }};
+
+    std::array<uint8_t, desktop::FRAME_HEADER_SIZE> hello{};
+    desktop::encodeFrame(desktop::MsgType::HELLO, 0, 0, nullptr, 0, hello.data());
+    auto waitForNotified = [&](int expected)
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (numNotified.load() < expected && std::chrono::steady_clock::now() < deadline)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    };
+    ASSERT_TRUE(ring.tryPush(hello.data(), hello.size()));
+    waitForNotified(1);
+    ASSERT_TRUE(ring.tryPush(hello.data(), hello.size()));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(numNotified.load(), 1);
+
+    watcher.rearm();
+    ASSERT_TRUE(ring.tryPush(hello.data(), hello.size()));
+    waitForNotified(2);
+    EXPECT_EQ(numNotified.load(), 2);
+}
+
+
+}  // namespace tests
+}  // namespace teleop_led_benchmarks
@@ -0,0 +1,104 @@
+#include "socket_profile.hpp"
+
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <sstream>
+
+#include "profile_sweep.hpp"
+
+namespace teleop_led_benchmarks
+{
+namespace tests
+{
+
+
+namespace desktop = teleop_led_benchmarks::desktop;
+using ConnectionType = desktop::ConnectionType;
+
+
+static int getIntOption(int fd, int level, int option)
+{
+    int value = 0;
+    socklen_t size = sizeof(value);
+    getsockopt(fd, level, option, &value, &size);
+    return value;
+}
+
+
+TEST(SocketProfileTest, FindsProfilesByName)
+{
+    auto all = desktop::findSocketProfile("all");
+    ASSERT_TRUE(all.has_value());
+    EXPECT_TRUE(all->noDelay);
+    EXPECT_EQ(all->tos, desktop::TOS_DSCP_EF);
+    EXPECT_FALSE(desktop::findSocketProfile("fastest").has_value());
+
+    // Udp has no tcp only options, so nodelay is the default there.
+    auto none = desktop::findSocketProfile("default").value();
+    auto noDelay = desktop::findSocketProfile("nodelay").value();
+    EXPECT_FALSE(none.effective(true).hasSameOptions(noDelay.effective(true)));
+    EXPECT_TRUE(none.effective(false).hasSameOptions(noDelay.effective(false)));
+}
+
+
+TEST(SocketProfileTest, AppliesOptionsToTcpAndUdp)
+{
+    desktop::SocketProfile profile{};
+    profile.noDelay = true;
+    profile.rcvLowatBytes = static_cast<int>(desktop::FRAME_HEADER_SIZE);
+    profile.rcvBufBytes = 8 * 1024;
+    profile.tos = desktop::TOS_DSCP_EF;
+
+    int tcpFd = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_GE(tcpFd, 0);
+    EXPECT_TRUE(desktop::applySocketProfile(tcpFd, profile));
+    EXPECT_NE(getIntOption(tcpFd, IPPROTO_TCP, TCP_NODELAY), 0);
+    EXPECT_EQ(getIntOption(tcpFd, SOL_SOCKET, SO_RCVLOWAT), profile.rcvLowatBytes);
+    EXPECT_GE(getIntOption(tcpFd, SOL_SOCKET, SO_RCVBUF), profile.rcvBufBytes);
+    EXPECT_EQ(getIntOption(tcpFd, IPPROTO_IP, IP_TOS), desktop::TOS_DSCP_EF);
+    close(tcpFd);
+
+    // The tcp only options are skipped rather than failing.
+    int udpFd = socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_GE(udpFd, 0);
+    EXPECT_TRUE(desktop::applySocketProfile(udpFd, profile));
+    EXPECT_EQ(getIntOption(udpFd, SOL_SOCKET, SO_RCVLOWAT), 1);
+    EXPECT_EQ(getIntOption(udpFd, IPPROTO_IP, IP_TOS), desktop::TOS_DSCP_EF);
+    close(udpFd);
+}
+
+
+TEST(SocketProfileTest, SweepSkipsPairsWithTheSameOptions)
+{
+    std::atomic<bool> stopFlag{false};
+    desktop::ProfileSweepConfig config{};
+    config.connTypes = {ConnectionType::CUSTOM_TCP, ConnectionType::UDP};
+    config.profiles = {desktop::findSocketProfile("default").value(), desktop::findSocketProfile("nodelay").value()};
+    config.runner.numCommands = 50;
+    config.emulator.retryInterval = std::chrono::milliseconds(5);
+    desktop::ProfileSweepReport report{};
+
+    ASSERT_EQ(desktop::runProfileSweep(stopFlag, config, report), 0);
+    // Every pair on tcp, one on udp.
+    ASSERT_EQ(report.results.size(), 5u);
+    for (const auto& result : report.results)
+    {
+        EXPECT_TRUE(result.isComplete);
+        EXPECT_EQ(result.summary.count, 50u);
+    }
+    EXPECT_NE(desktop::bestProfilePair(report, ConnectionType::CUSTOM_TCP), nullptr);
+    EXPECT_EQ(desktop::bestProfilePair(report, ConnectionType::WEB_SOCKET), nullptr);
+
+    std::ostringstream os;
+    desktop::printProfileSweepReport(os, report);
+    EXPECT_NE(os.str().find("lowest tail: desktop"), std::string::npos);
+}
+
+
+}  // namespace tests
+}  // namespace teleop_led_benchmarks
@@ -0,0 +1,79 @@
+#include "spsc_queue.hpp"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <thread>
+
+namespace teleop_led_benchmarks
+{
+namespace tests
+{
+
+
+namespace desktop = teleop_led_benchmarks::desktop;
+
+
+TEST(SpscQueueTest, PushPopUntilFull)
+{
+    desktop::SpscQueue<int, 4> q;
+    int out = 0;
+    EXPECT_TRUE(q.empty());
+    EXPECT_FALSE(q.tryPop(out));
+    for (int i = 0; i < 4; ++i)
+    {
+        EXPECT_TRUE(q.tryPush(i));
+    }
+    EXPECT_FALSE(q.tryPush(4));
+    EXPECT_EQ(q.size(), 4u);
+    for (int i = 0; i < 4; ++i)
+    {
+        ASSERT_TRUE(q.tryPop(out));
+        EXPECT_EQ(out, i);
+    }
+    EXPECT_TRUE(q.empty());
+}
+
+
+TEST(SpscQueueTest, MoveOnlyElements)
+{
+    desktop::SpscQueue<std::unique_ptr<int>, 2> q;
+    EXPECT_TRUE(q.tryPush(std::make_unique<int>(7)));
+    std::unique_ptr<int> out;
+    ASSERT_TRUE(q.tryPop(out));
+    EXPECT_EQ(*out, 7);
+}
+
+
+TEST(SpscQueueTest, TwoThreadsPreserveOrder)
+{
+    constexpr size_t NUM_ITEMS = 200'000;
+    desktop::SpscQueue<size_t, 1024> q;
+    std::thread producer{[&q]()
+        {
+            for (size_t i = 0; i < NUM_ITEMS; ++i)
+            {
+                while (!q.tryPush(i))
+                {
+                    std::this_thread::yield();
+                }
+            }
+        }};
+
+    size_t expected = 0;
+    size_t out = 0;
+    while (expected < NUM_ITEMS)
+    {
+        if (q.tryPop(out))
+        {
+            ASSERT_EQ(out, expected);
+            ++expected;
+        }
+    }
+    producer.join();
+    EXPECT_TRUE(q.empty());
+}
+
+
+}  // namespace tests
+}  // namespace teleop_led_benchmarks
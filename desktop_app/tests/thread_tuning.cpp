@@ -0,0 +1,66 @@
+#include "thread_tuning.hpp"
+
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include <thread>
+
+namespace teleop_led_benchmarks
+{
+namespace tests
+{
+
+
+namespace desktop = teleop_led_benchmarks::desktop;
+
+
+TEST(ThreadTuningTest, ParsesCpuLists)
+{
+    EXPECT_EQ(desktop::parseCpuList("2"), (std::vector<int>{2}));
+    EXPECT_EQ(desktop::parseCpuList("2-3,6"), (std::vector<int>{2, 3, 6}));
+    EXPECT_FALSE(desktop::parseCpuList(""));
+    EXPECT_FALSE(desktop::parseCpuList("x"));
+    EXPECT_FALSE(desktop::parseCpuList("2,-1"));
+    EXPECT_FALSE(desktop::parseCpuList("99999"));
+}
+
+
+TEST(ThreadTuningTest, PinsEachThreadOfAPool)
+{
+    // Not the test runner's own thread, which would stay pinned for the remaining tests.
+    desktop::ThreadTuning tuning{};
+    tuning.cpus = {0};
+    tuning.stackPrefaultBytes = 256 * 1024;
+    bool isApplied = false;
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    std::thread thread{[&]()
+        {
+            isApplied = desktop::applyThreadTuning(tuning, 1);
+            pthread_getaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        }};
+    thread.join();
+
+    EXPECT_TRUE(isApplied);
+    EXPECT_EQ(CPU_COUNT(&cpus), 1);
+    EXPECT_TRUE(CPU_ISSET(0, &cpus));
+}
+
+
+TEST(ThreadTuningTest, JitterTestRecordsEveryWakeup)
+{
+    desktop::JitterTestConfig config{};
+    config.numWakeups = 20;
+    config.interval = std::chrono::microseconds(500);
+    desktop::LatencyHistogram wakeupLatencies{};
+    auto startedAt = std::chrono::steady_clock::now();
+
+    desktop::runJitterTest(config, wakeupLatencies);
+    EXPECT_GE(std::chrono::steady_clock::now() - startedAt, std::chrono::milliseconds(10));
+    EXPECT_EQ(wakeupLatencies.count(), 20u);
+}
+
+
+}  // namespace tests
+}  // namespace teleop_led_benchmarks
@@ -0,0 +1,113 @@
+#include "trace.hpp"
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+
+#include "messages.hpp"
+
+namespace teleop_led_benchmarks
+{
+namespace tests
+{
+
+
+namespace desktop = teleop_led_benchmarks::desktop;
+using TraceBuffer = desktop::TraceBuffer;
+using TraceStage = desktop::TraceStage;
+
+
+TEST(TraceTest, BufferKeepsNewestRecords)
+{
+    TraceBuffer buffer{5};
+    ASSERT_EQ(buffer.capacity(), 8u);
+    for (uint32_t seq = 0; seq < 10; ++seq)
+    {
+        buffer.record(TraceStage::NET_QUEUED, seq, uint64_t{seq} * 100);
+    }
+    EXPECT_EQ(buffer.size(), 8u);
+    EXPECT_EQ(buffer.numOverwritten(), 2u);
+    uint32_t expectedSeq = 2;
+    buffer.forEach([&expectedSeq](const desktop::TraceRecord& rec)
+        {
+            EXPECT_EQ(rec.seq, expectedSeq);
+            EXPECT_EQ(rec.timeNs, uint64_t{expectedSeq} * 100);
+            ++expectedSeq;
+        });
+    EXPECT_EQ(expectedSeq, 10u);
+}
+
+
+TEST(TraceTest, SpansJoinThreadsAndCenterDeviceStages)
+{
+    TraceBuffer ui{16};
+    TraceBuffer net{16};
+    ui.record(TraceStage::UI_INPUT_POLLED, 7, uint64_t{1'000});
+    ui.record(TraceStage::UI_QUEUED, 7, uint64_t{2'000});
+    ui.record(TraceStage::UI_DISPATCHED, 7, uint64_t{18'000});
+    net.record(TraceStage::NET_QUEUED, 7, uint64_t{19'000});
+    net.record(TraceStage::NET_WRITTEN, 7, uint64_t{20'000});
+    // Device clock is unrelated to ours and spends 2 us between receive and ack.
+    net.record(TraceStage::DEVICE_RECEIVED, 7, uint64_t{500'000'000});
+    net.record(TraceStage::DEVICE_ACK_SENT, 7, uint64_t{500'002'000});
+    net.record(TraceStage::NET_ACK_READ, 7, uint64_t{30'000});
+    ui.record(TraceStage::UI_APPLIED, 7, uint64_t{40'000});
+    ui.record(TraceStage::UI_PRESENTED, 7, uint64_t{50'000});
+
+    auto spans = desktop::buildTraceSpans({&ui, &net});
+    ASSERT_EQ(spans.size(), desktop::NUM_TRACE_STAGES - 1);
+    for (size_t i = 0; i < spans.size(); ++i)
+    {
+        EXPECT_EQ(spans[i].seq, 7u);
+        EXPECT_EQ(static_cast<size_t>(spans[i].to), i + 1);
+        if (i > 0)
+        {
+            EXPECT_EQ(spans[i].startNs, spans[i - 1].endNs);
+        }
+    }
+    const auto& uplink = spans[static_cast<size_t>(TraceStage::DEVICE_RECEIVED) - 1];
+    const auto& device = spans[static_cast<size_t>(TraceStage::DEVICE_ACK_SENT) - 1];
+    EXPECT_EQ(uplink.endNs - uplink.startNs, 4'000u);
+    EXPECT_EQ(device.endNs - device.startNs, 2'000u);
+
+    std::ostringstream os;
+    desktop::writeChromeTrace(os, spans);
+    EXPECT_NE(os.str().find("\"traceEvents\""), std::string::npos);
+    EXPECT_NE(os.str().find("\"device ack sent\""), std::string::npos);
+}
+
+
+TEST(TraceTest, DropsDeviceStagesThatDontFit)
+{
+    TraceBuffer net{16};
+    net.record(TraceStage::NET_WRITTEN, 1, uint64_t{1'000});
+    net.record(TraceStage::DEVICE_RECEIVED, 1, uint64_t{0});
+    net.record(TraceStage::DEVICE_ACK_SENT, 1, uint64_t{5'000});
+    net.record(TraceStage::NET_ACK_READ, 1, uint64_t{3'000});
+
+    auto spans = desktop::buildTraceSpans({&net});
+    ASSERT_EQ(spans.size(), 1u);
+    EXPECT_EQ(spans[0].from, TraceStage::NET_WRITTEN);
+    EXPECT_EQ(spans[0].to, TraceStage::NET_ACK_READ);
+}
+
+
+TEST(TraceTest, AckPayloadCarriesDeviceReceiveTime)
+{
+    std::array<uint8_t, desktop::ACK_FRAME_SIZE> frame{};
+    ASSERT_EQ(desktop::encodeAck(3, 1234, 5678, frame.data()), desktop::ACK_FRAME_SIZE);
+    auto header = desktop::decodeHeader(frame.data());
+    ASSERT_TRUE(header.has_value());
+    EXPECT_EQ(header->sendTimeUs, 5678u);
+    auto receivedUs = desktop::decodeAckReceivedUs(*header, frame.data() + desktop::FRAME_HEADER_SIZE);
+    ASSERT_TRUE(receivedUs.has_value());
+    EXPECT_EQ(*receivedUs, 1234u);
+
+    desktop::encodeFrame(desktop::MsgType::ACK, 3, 0, nullptr, 0, frame.data());
+    header = desktop::decodeHeader(frame.data());
+    EXPECT_FALSE(desktop::decodeAckReceivedUs(*header, nullptr).has_value());
+}
+
+
+}  // namespace tests
+}  // namespace teleop_led_benchmarks
@@ -0,0 +1,113 @@
+#include "uring_link.hpp"
+
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+
+namespace teleop_led_benchmarks
+{
+namespace tests
+{
+
+
+namespace desktop = teleop_led_benchmarks::desktop;
+
+
+constexpr std::chrono::microseconds WAIT_TIMEOUT{1'000'000};
+
+
+TEST(UringLinkTest, WritesAndReadsThroughRegisteredBuffers)
+{
+    std::array<int, 2> fds{};
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds.data()), 0);
+    std::array<uint8_t, 64> writeBuf{};
+    std::array<uint8_t, 64> readBuf{};
+    desktop::UringLink link{};
+    ASSERT_TRUE(link.open(fds[0], writeBuf.data(), writeBuf.size(), readBuf.data(), readBuf.size()));
+
+    // The peer echoes, so the read completes right after the write.
+    std::memcpy(writeBuf.data(), "ping", 4);
+    link.queueWrite(4, 7);
+    link.queueRead();
+    desktop::UringCompletions completions{};
+    size_t numCompleted = link.wait(std::chrono::microseconds::zero(), false, completions);
+    ASSERT_EQ(numCompleted, 1u);
+    EXPECT_EQ(completions[0].op, desktop::UringOp::WRITE);
+    EXPECT_EQ(completions[0].result, 4);
+    EXPECT_EQ(completions[0].tag, 7u);
+    // The write and the read linked behind it went in together.
+    EXPECT_EQ(link.numEnters(), 1u);
+
+    std::array<char, 4> echo{};
+    ASSERT_EQ(read(fds[1], echo.data(), echo.size()), 4);
+    ASSERT_EQ(write(fds[1], echo.data(), echo.size()), 4);
+    numCompleted = link.wait(WAIT_TIMEOUT, true, completions);
+    ASSERT_EQ(numCompleted, 1u);
+    EXPECT_EQ(completions[0].op, desktop::UringOp::READ);
+    ASSERT_EQ(completions[0].result, 4);
+    EXPECT_EQ(std::memcmp(readBuf.data(), "ping", 4), 0);
+
+    // A closed peer ends the stream.
+    link.queueRead();
+    close(fds[1]);
+    numCompleted = link.wait(WAIT_TIMEOUT, true, completions);
+    ASSERT_EQ(numCompleted, 1u);
+    EXPECT_EQ(completions[0].op, desktop::UringOp::READ);
+    EXPECT_EQ(completions[0].result, 0);
+
+    link.close();
+    close(fds[0]);
+}
+
+
+TEST(UringLinkTest, WriteWithoutProgressIsAnError)
+{
+    std::array<int, 2> fds{};
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds.data()), 0);
+    std::array<uint8_t, 64> writeBuf{};
+    std::array<uint8_t, 64> readBuf{};
+    desktop::UringLink link{};
+    ASSERT_TRUE(link.open(fds[0], writeBuf.data(), writeBuf.size(), readBuf.data(), readBuf.size()));
+
+    // An empty write completes with 0 bytes, which mustn't pass for a finished write.
+    link.queueWrite(0, 3);
+    desktop::UringCompletions completions{};
+    size_t numCompleted = link.wait(WAIT_TIMEOUT, true, completions);
+    ASSERT_EQ(numCompleted, 1u);
+    EXPECT_EQ(completions[0].op, desktop::UringOp::WRITE);
+    EXPECT_EQ(completions[0].result, -EPIPE);
+    EXPECT_EQ(completions[0].tag, 3u);
+
+    link.close();
+    close(fds[0]);
+    close(fds[1]);
+}
+
+
+TEST(UringLinkTest, WaitTimesOutWithoutCompletions)
+{
+    std::array<int, 2> fds{};
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds.data()), 0);
+    std::array<uint8_t, 64> writeBuf{};
+    std::array<uint8_t, 64> readBuf{};
+    desktop::UringLink link{};
+    ASSERT_TRUE(link.open(fds[0], writeBuf.data(), writeBuf.size(), readBuf.data(), readBuf.size()));
+
+    link.queueRead();
+    auto startedAt = std::chrono::steady_clock::now();
+    desktop::UringCompletions completions{};
+    EXPECT_EQ(link.wait(std::chrono::milliseconds(20), true, completions), 0u);
+    EXPECT_GE(std::chrono::steady_clock::now() - startedAt, std::chrono::milliseconds(20));
+
+    link.close();
+    close(fds[0]);
+    close(fds[1]);
+}
+
+
+}  // namespace tests
+}  // namespace teleop_led_benchmarks
@@ -12,9 +12,10 @@
    CONDITIONS OF ANY KIND, either express or implied.
 */
 
-#include <cJSON.h>
 #include <stdio.h>
 
+#include <algorithm>
+#include <array>
 #include <string>
 
 #include "driver/gpio.h"
@@ -22,15 +23,18 @@
 #include "esp_event.h"
 #include "esp_log.h"
 #include "esp_system.h"
+#include "esp_timer.h"
 #include "esp_websocket_client.h"
 #include "esp_wifi.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
 #include "freertos/semphr.h"
 #include "freertos/task.h"
+#include "messages.hpp"
 #include "nvs_flash.h"
 #include "protocol_examples_common.h"
 #include "tcp_client.hpp"
+#include "udp_client.hpp"
 
 
 #define NO_DATA_TIMEOUT_SEC 5
@@ -38,9 +42,14 @@
 
 
 static const char* TAG = "main";
-static const std::string RECEIVED_MSG = "received";
 static const uint16_t HOST_PORT = static_cast<uint16_t>(std::stoi(CONFIG_TCP_HOST_IP_PORT));
+static const uint16_t UDP_HOST_PORT = static_cast<uint16_t>(std::stoi(CONFIG_UDP_HOST_IP_PORT));
+static const int UDP_HELLO_INTERVAL_MS = 500;
+static const uint32_t UDP_STATS_LOG_INTERVAL = 1000;
+static const size_t TCP_READ_BUF_SIZE = 1024;
 static TimerHandle_t shutdownSignalTimer;
+// Reassembles frames split across data events, reset per connection so a cut off one doesn't carry over.
+static FrameParser wsParser;
 static SemaphoreHandle_t shutdownSema;
 
 
@@ -53,6 +62,43 @@ static void logErrorIfNonzero(const char* message, int errorCode)
 }
 
 
+// Large enough for an ack or a sync reply.
+using ReplyFrame = std::array<uint8_t, std::max(ACK_FRAME_SIZE, SYNC_REPLY_FRAME_SIZE)>;
+// Replies to everything a read can complete: its header-only frames, plus the one the previous read cut off.
+static const size_t TCP_REPLY_BUF_SIZE = (TCP_READ_BUF_SIZE / FRAME_HEADER_SIZE + 1) * sizeof(ReplyFrame);
+
+
+static uint64_t nowUs()
+{
+    return static_cast<uint64_t>(esp_timer_get_time());
+}
+
+
+/**
+ * Acks echo the command's sequence number and carry our clock at receive and
+ * at send, sync replies do the same for the desktop's clock probes. Returns
+ * the reply size, 0 for frames that don't get one.
+ */
+static size_t makeReply(const FrameHeader& frame, uint64_t receivedUs, ReplyFrame& reply)
+{
+    switch (frame.type)
+    {
+        case MsgType::COMMAND:
+        {
+            return encodeAck(frame.seq, receivedUs, nowUs(), reply.data());
+        }
+        case MsgType::SYNC_REQUEST:
+        {
+            return encodeSyncReply(frame.seq, frame.sendTimeUs, receivedUs, nowUs(), reply.data());
+        }
+        default:
+        {
+            return 0;
+        }
+    }
+}
+
+
 static void shutdownSignaler(TimerHandle_t xTimer)
 {
     ESP_LOGI(TAG, "No data received for %d seconds, signaling shutdown", NO_DATA_TIMEOUT_SEC);
@@ -74,11 +120,13 @@ static void websocketEventHandler(void* handlerArgs, esp_event_base_t base, int3
         case WEBSOCKET_EVENT_CONNECTED:
         {
             ESP_LOGI(TAG, "WEBSOCKET_EVENT_CONNECTED");
+            wsParser.reset();
             break;
         }
         case WEBSOCKET_EVENT_DISCONNECTED:
         {
             ESP_LOGI(TAG, "WEBSOCKET_EVENT_DISCONNECTED");
+            wsParser.reset();
             logErrorIfNonzero("HTTP status code", data->error_handle.esp_ws_handshake_status_code);
             if (data->error_handle.error_type == WEBSOCKET_ERROR_TYPE_TCP_TRANSPORT)
             {
@@ -94,7 +142,23 @@ static void websocketEventHandler(void* handlerArgs, esp_event_base_t base, int3
             // ESP_LOGI(TAG, "Received opcode=%d", data->op_code);
             if (data->op_code == 0x2)
             {  // Opcode 0x2 indicates binary data
-                ESP_LOG_BUFFER_HEX("Received binary data", data->data_ptr, data->data_len);
+                // Messages split across data events are reassembled by the parser, and may hold several frames.
+                uint64_t receivedUs = nowUs();
+                bool isValid = wsParser.feed(reinterpret_cast<const uint8_t*>(data->data_ptr),
+                    static_cast<size_t>(data->data_len),
+                    [client, receivedUs](const FrameHeader& header, const uint8_t*)
+                    {
+                        ReplyFrame reply{};
+                        size_t replySize = makeReply(header, receivedUs, reply);
+                        if (replySize > 0)
+                        {
+                            esp_websocket_client_send_bin(client, reinterpret_cast<const char*>(reply.data()), replySize, pdMS_TO_TICKS(50));
+                        }
+                    });
+                if (!isValid)
+                {
+                    ESP_LOG_BUFFER_HEX("Invalid frame", data->data_ptr, data->data_len);
+                }
             }
             else if (data->op_code == 0x08 && data->data_len == 2)
             {
@@ -102,27 +166,9 @@ static void websocketEventHandler(void* handlerArgs, esp_event_base_t base, int3
             }
             else
             {
-                // ESP_LOGW(TAG, "Received=%.*s\n\n", data->data_len, (char *)data->data_ptr);
-                esp_websocket_client_send_text(client, RECEIVED_MSG.data(), RECEIVED_MSG.size(), pdMS_TO_TICKS(50));
-                // ESP_LOGI(TAG, "Sent back ping");
-            }
-
-            // If received data contains json structure it succeed to parse
-            cJSON* root = cJSON_Parse(data->data_ptr);
-            if (root)
-            {
-                for (int i = 0; i < cJSON_GetArraySize(root); i++)
-                {
-                    cJSON* elem = cJSON_GetArrayItem(root, i);
-                    cJSON* id = cJSON_GetObjectItem(elem, "id");
-                    cJSON* name = cJSON_GetObjectItem(elem, "name");
-                    ESP_LOGW(TAG, "Json={'id': '%s', 'name': '%s'}", id->valuestring, name->valuestring);
-                }
-                cJSON_Delete(root);
+                ESP_LOGW(TAG, "Ignoring text message=%.*s", data->data_len, (char*) data->data_ptr);
             }
 
-            ESP_LOGW(TAG, "Total payload length=%d, data_len=%d, current payload offset=%d\r\n", data->payload_len, data->data_len, data->payload_offset);
-
             xTimerReset(shutdownSignalTimer, portMAX_DELAY);
             break;
         }
@@ -172,19 +218,43 @@ __attribute__((unused)) static void tcpAppStart()
 
     TcpClient client{CONFIG_TCP_HOST_IP_ADDR, HOST_PORT};
     client.connectToServer();
-    std::string expectedMsg = "button clicked\n";
-    std::string buffer(expectedMsg.size(), '\0');
+    std::array<uint8_t, TCP_READ_BUF_SIZE> buffer{};
+    std::array<uint8_t, TCP_REPLY_BUF_SIZE> acks{};
+    FrameParser parser;
     while (true)
     {
-        auto err = client.receiveData(buffer);
-        if (err)
+        int len = client.receiveData(buffer.data(), buffer.size());
+        uint64_t receivedUs = nowUs();
+        if (len < 0)
         {
             // error
             break;
         }
-        ESP_LOGI(TAG, "Received %s", buffer.c_str());
-        err = client.sendData(RECEIVED_MSG);
-        if (err)
+        // A read may end mid frame or hold several, reply to everything complete in one send.
+        size_t acksSize = 0;
+        bool isValid = parser.feed(buffer.data(), static_cast<size_t>(len),
+            [&acks, &acksSize, receivedUs](const FrameHeader& header, const uint8_t*)
+            {
+                ReplyFrame reply{};
+                size_t replySize = makeReply(header, receivedUs, reply);
+                if (replySize == 0)
+                {
+                    return;
+                }
+                if (acksSize + replySize > acks.size())
+                {
+                    ESP_LOGE(TAG, "Reply buffer full, dropped the reply to seq %" PRIu32, header.seq);
+                    return;
+                }
+                std::copy(reply.begin(), reply.begin() + replySize, acks.begin() + acksSize);
+                acksSize += replySize;
+            });
+        if (!isValid)
+        {
+            ESP_LOGE(TAG, "Invalid frame, stopping");
+            break;
+        }
+        if (acksSize > 0 && client.sendData(acks.data(), acksSize))
         {
             break;
         }
@@ -194,6 +264,76 @@ __attribute__((unused)) static void tcpAppStart()
 }
 
 
+/**
+ * The host learns our address from the hello, which is repeated until the
+ * first command arrives since either datagram may be lost. Commands are
+ * acked as they come, without waiting for any missing ones.
+ */
+__attribute__((unused)) static void udpAppStart()
+{
+    UdpClient client{CONFIG_TCP_HOST_IP_ADDR, UDP_HOST_PORT, UDP_HELLO_INTERVAL_MS};
+    client.connectToServer();
+    std::array<uint8_t, FRAME_HEADER_SIZE> hello{};
+    encodeFrame(MsgType::HELLO, 0, 0, nullptr, 0, hello.data());
+    std::array<uint8_t, MAX_FRAME_SIZE + 1> buffer{};  // one spare byte flags oversized datagrams
+    bool isGreeted = false;
+    uint32_t numReceived = 0;
+    uint32_t numGaps = 0;
+    uint32_t numLateOrDuplicate = 0;
+    uint32_t nextSeq = 0;
+    while (true)
+    {
+        if (!isGreeted && client.sendData(hello.data(), hello.size()))
+        {
+            break;
+        }
+        int len = client.receiveData(buffer.data(), buffer.size());
+        uint64_t receivedUs = nowUs();
+        if (len < 0)
+        {
+            break;
+        }
+        if (len == 0)
+        {
+            continue;  // timed out
+        }
+        isGreeted = true;
+        auto header = static_cast<size_t>(len) >= FRAME_HEADER_SIZE ? decodeHeader(buffer.data()) : std::nullopt;
+        ReplyFrame reply{};
+        size_t replySize = header && header->length == static_cast<size_t>(len) ? makeReply(*header, receivedUs, reply) : 0;
+        if (replySize == 0)
+        {
+            ESP_LOGW(TAG, "Ignoring unexpected datagram of %d bytes", len);
+            continue;
+        }
+        if (client.sendData(reply.data(), replySize))
+        {
+            break;
+        }
+        if (header->type != MsgType::COMMAND)
+        {
+            continue;  // clock probes aren't part of the command sequence
+        }
+
+        if (header->seq >= nextSeq)
+        {
+            numGaps += header->seq - nextSeq;
+            nextSeq = header->seq + 1;
+        }
+        else
+        {
+            ++numLateOrDuplicate;
+        }
+        if (++numReceived % UDP_STATS_LOG_INTERVAL == 0)
+        {
+            ESP_LOGI(TAG, "udp commands received %" PRIu32 " skipped %" PRIu32 " late or duplicate %" PRIu32,
+                numReceived, numGaps, numLateOrDuplicate);
+        }
+    }
+    ESP_LOGE(TAG, "Udp client stopped");
+}
+
+
 extern "C" void app_main(void)
 {
     ESP_LOGI(TAG, "[APP] Startup..");
@@ -221,4 +361,5 @@ extern "C" void app_main(void)
 
     websocketAppStart();
     // tcpAppStart();
+    // udpAppStart();
 }
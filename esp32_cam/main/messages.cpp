@@ -0,0 +1,111 @@
+#include "messages.hpp"
+
+
+template <typename T>
+static void writeLe(T value, uint8_t* out)
+{
+    for (size_t i = 0; i < sizeof(T); ++i)
+    {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+
+template <typename T>
+static T readLe(const uint8_t* data)
+{
+    T value = 0;
+    for (size_t i = 0; i < sizeof(T); ++i)
+    {
+        value |= static_cast<T>(data[i]) << (8 * i);
+    }
+    return value;
+}
+
+
+size_t encodeFrame(MsgType type, uint32_t seq, uint64_t sendTimeUs, const uint8_t* payload,
+    size_t payloadSize, uint8_t* out)
+{
+    if (payloadSize > MAX_PAYLOAD_SIZE)
+    {
+        return 0;
+    }
+    auto length = static_cast<uint16_t>(FRAME_HEADER_SIZE + payloadSize);
+    writeLe(length, out);
+    out[2] = static_cast<uint8_t>(type);
+    out[3] = FRAME_VERSION;
+    writeLe(seq, out + 4);
+    writeLe(sendTimeUs, out + 8);
+    if (payloadSize > 0)
+    {
+        memcpy(out + FRAME_HEADER_SIZE, payload, payloadSize);
+    }
+    return length;
+}
+
+
+std::optional<FrameHeader> decodeHeader(const uint8_t* data)
+{
+    FrameHeader header{};
+    header.length = readLe<uint16_t>(data);
+    if (header.length < FRAME_HEADER_SIZE || header.length > MAX_FRAME_SIZE ||
+        data[3] != FRAME_VERSION)
+    {
+        return std::nullopt;
+    }
+    switch (static_cast<MsgType>(data[2]))
+    {
+        case MsgType::COMMAND:
+        case MsgType::ACK:
+        case MsgType::HELLO:
+        case MsgType::SYNC_REQUEST:
+        case MsgType::SYNC_REPLY:
+        {
+            header.type = static_cast<MsgType>(data[2]);
+            break;
+        }
+        default:
+        {
+            return std::nullopt;
+        }
+    }
+    header.seq = readLe<uint32_t>(data + 4);
+    header.sendTimeUs = readLe<uint64_t>(data + 8);
+    return header;
+}
+
+
+size_t encodeAck(uint32_t seq, uint64_t receivedUs, uint64_t sentUs, uint8_t* out)
+{
+    std::array<uint8_t, ACK_PAYLOAD_SIZE> payload{};
+    writeLe(receivedUs, payload.data());
+    return encodeFrame(MsgType::ACK, seq, sentUs, payload.data(), payload.size(), out);
+}
+
+
+size_t encodeSyncReply(uint32_t seq, uint64_t desktopSentUs, uint64_t receivedUs, uint64_t sentUs,
+    uint8_t* out)
+{
+    std::array<uint8_t, SYNC_REPLY_PAYLOAD_SIZE> payload{};
+    writeLe(desktopSentUs, payload.data());
+    writeLe(receivedUs, payload.data() + 8);
+    return encodeFrame(MsgType::SYNC_REPLY, seq, sentUs, payload.data(), payload.size(), out);
+}
+
+
+FrameParser::FrameParser()
+    : pendingSize_{0}
+{
+}
+
+
+bool FrameParser::hasPartialFrame() const
+{
+    return pendingSize_ > 0;
+}
+
+
+void FrameParser::reset()
+{
+    pendingSize_ = 0;
+}
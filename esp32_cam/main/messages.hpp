@@ -0,0 +1,114 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <array>
+#include <optional>
+
+// Must match desktop_app/src/core/messages.hpp, see there for the frame layout.
+enum class MsgType : uint8_t
+{
+    COMMAND = 1,
+    ACK = 2,
+    HELLO = 3,
+    SYNC_REQUEST = 4,
+    SYNC_REPLY = 5,
+};
+
+
+constexpr uint8_t FRAME_VERSION = 1;
+constexpr size_t FRAME_HEADER_SIZE = 16;
+constexpr size_t MAX_FRAME_SIZE = 512;
+constexpr size_t MAX_PAYLOAD_SIZE = MAX_FRAME_SIZE - FRAME_HEADER_SIZE;
+
+
+struct FrameHeader
+{
+    uint16_t length = 0;
+    MsgType type = MsgType::COMMAND;
+    uint32_t seq = 0;
+    uint64_t sendTimeUs = 0;
+};
+
+
+size_t encodeFrame(MsgType type, uint32_t seq, uint64_t sendTimeUs, const uint8_t* payload,
+    size_t payloadSize, uint8_t* out);
+std::optional<FrameHeader> decodeHeader(const uint8_t* data);
+
+// Acks carry our clock at command arrival as payload, and at ack send in sendTimeUs.
+constexpr size_t ACK_PAYLOAD_SIZE = 8;
+constexpr size_t ACK_FRAME_SIZE = FRAME_HEADER_SIZE + ACK_PAYLOAD_SIZE;
+size_t encodeAck(uint32_t seq, uint64_t receivedUs, uint64_t sentUs, uint8_t* out);
+
+// Sync replies echo the request's seq and sendTimeUs, then our clock at request arrival and at reply send.
+constexpr size_t SYNC_REPLY_PAYLOAD_SIZE = 16;
+constexpr size_t SYNC_REPLY_FRAME_SIZE = FRAME_HEADER_SIZE + SYNC_REPLY_PAYLOAD_SIZE;
+size_t encodeSyncReply(uint32_t seq, uint64_t desktopSentUs, uint64_t receivedUs, uint64_t sentUs,
+    uint8_t* out);
+
+
+// Splits a byte stream into frames, copying only frames split across reads.
+class FrameParser
+{
+   public:
+    FrameParser();
+
+    // Calls onFrame(header, payload) per complete frame, false on an invalid header.
+    template <typename F>
+    bool feed(const uint8_t* data, size_t size, F&& onFrame)
+    {
+        while (size > 0)
+        {
+            if (pendingSize_ == 0 && size >= FRAME_HEADER_SIZE)
+            {
+                auto header = decodeHeader(data);
+                if (!header)
+                {
+                    reset();
+                    return false;
+                }
+                if (size >= header->length)
+                {
+                    onFrame(*header, data + FRAME_HEADER_SIZE);
+                    data += header->length;
+                    size -= header->length;
+                    continue;
+                }
+            }
+
+            bool hasHeader = pendingSize_ >= FRAME_HEADER_SIZE;
+            size_t wanted = hasHeader ? pendingHeader_.length : FRAME_HEADER_SIZE;
+            size_t numCopied = std::min(wanted - pendingSize_, size);
+            memcpy(pending_.data() + pendingSize_, data, numCopied);
+            pendingSize_ += numCopied;
+            data += numCopied;
+            size -= numCopied;
+            if (!hasHeader && pendingSize_ == FRAME_HEADER_SIZE)
+            {
+                auto header = decodeHeader(pending_.data());
+                if (!header)
+                {
+                    reset();
+                    return false;
+                }
+                pendingHeader_ = *header;
+            }
+            if (pendingSize_ >= FRAME_HEADER_SIZE && pendingSize_ == pendingHeader_.length)
+            {
+                onFrame(pendingHeader_, pending_.data() + FRAME_HEADER_SIZE);
+                pendingSize_ = 0;
+            }
+        }
+        return true;
+    }
+
+    bool hasPartialFrame() const;
+    void reset();
+
+   private:
+    std::array<uint8_t, MAX_FRAME_SIZE> pending_;
+    size_t pendingSize_;
+    FrameHeader pendingHeader_;
+};
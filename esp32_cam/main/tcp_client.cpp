@@ -64,7 +64,7 @@ int TcpClient::connectToServer()
 }
 
 
-int TcpClient::sendData(const std::string& data)
+int TcpClient::sendData(const uint8_t* data, size_t size)
 {
     if (sock_ < 0)
     {
@@ -72,17 +72,24 @@ int TcpClient::sendData(const std::string& data)
         return -1;
     }
 
-    if (send(sock_, data.c_str(), data.size(), 0) < 0)
+    // send may take only part of the buffer when the socket's send window is full.
+    while (size > 0)
     {
-        ESP_LOGE(TAG, "Failed to send data");
-        return -1;
+        int len = send(sock_, data, size, 0);
+        if (len < 0)
+        {
+            ESP_LOGE(TAG, "Failed to send data");
+            return -1;
+        }
+        data += len;
+        size -= static_cast<size_t>(len);
     }
     return 0;
 }
 
 
-// Caller must ensure string is sized correctly)
-int TcpClient::receiveData(std::string& data)
+// Returns the number of bytes read, which may hold partial or several frames, or -1.
+int TcpClient::receiveData(uint8_t* buf, size_t capacity)
 {
     if (sock_ < 0)
     {
@@ -90,14 +97,18 @@ int TcpClient::receiveData(std::string& data)
         return -1;
     }
 
-    int len = recv(sock_, data.data(), data.size() + 1, 0);
+    int len = recv(sock_, buf, capacity, 0);
     if (len < 0)
     {
         ESP_LOGE(TAG, "Failed to receive data");
         return -1;
     }
-
-    return 0;
+    if (len == 0)
+    {
+        ESP_LOGI(TAG, "Server closed the connection");
+        return -1;
+    }
+    return len;
 }
 
 
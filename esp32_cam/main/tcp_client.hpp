@@ -1,6 +1,9 @@
 #pragma once
 #include <unistd.h>
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include <string>
 
 
@@ -10,8 +13,8 @@ class TcpClient
     TcpClient(const std::string& host, uint16_t port);
     ~TcpClient();
     int connectToServer();
-    int sendData(const std::string& data);
-    int receiveData(std::string& data);
+    int sendData(const uint8_t* data, size_t size);
+    int receiveData(uint8_t* buf, size_t capacity);
     void disconnect();
 
    private:
@@ -0,0 +1,116 @@
+#include "udp_client.hpp"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "esp_log.h"
+
+static const char* TAG = "udpclient";
+
+UdpClient::UdpClient(
+    const std::string& host,
+    uint16_t port,
+    int recvTimeoutMs)
+    : hostIp_(host),
+      port_(port),
+      recvTimeoutMs_(recvTimeoutMs),
+      sock_(-1)
+{
+}
+
+
+UdpClient::~UdpClient()
+{
+    disconnect();
+}
+
+
+// Udp has no handshake, connect only fixes the peer so send and recv can skip the address.
+int UdpClient::connectToServer()
+{
+    struct sockaddr_in destAddr{};
+    inet_pton(AF_INET, hostIp_.c_str(), &destAddr.sin_addr);
+    destAddr.sin_family = AF_INET;
+    destAddr.sin_port = htons(port_);
+
+    sock_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    if (sock_ < 0)
+    {
+        ESP_LOGE(TAG, "failed to create socket");
+        return -1;
+    }
+
+    if (connect(sock_, reinterpret_cast<struct sockaddr*>(&destAddr), sizeof(destAddr)) != 0)
+    {
+        close(sock_);
+        sock_ = -1;
+        ESP_LOGE(TAG, "Failed to set server address");
+        return -1;
+    }
+
+    struct timeval timeout{};
+    timeout.tv_sec = recvTimeoutMs_ / 1000;
+    timeout.tv_usec = (recvTimeoutMs_ % 1000) * 1000;
+    if (setsockopt(sock_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0)
+    {
+        ESP_LOGE(TAG, "Failed to set receive timeout");
+    }
+
+    return 0;
+}
+
+
+int UdpClient::sendData(const uint8_t* data, size_t size)
+{
+    if (sock_ < 0)
+    {
+        ESP_LOGE(TAG, "Socket not connected");
+        return -1;
+    }
+
+    if (send(sock_, data, size, 0) < 0)
+    {
+        ESP_LOGE(TAG, "Failed to send data");
+        return -1;
+    }
+    return 0;
+}
+
+
+/**
+ * Receives one datagram into buf and returns its length, 0 when the receive
+ * timeout expired with nothing to read and -1 on errors. Datagrams longer
+ * than capacity are truncated, so size buf one byte over the largest one.
+ */
+int UdpClient::receiveData(uint8_t* buf, size_t capacity)
+{
+    if (sock_ < 0)
+    {
+        ESP_LOGE(TAG, "Socket not connected");
+        return -1;
+    }
+
+    int len = recv(sock_, buf, capacity, 0);
+    if (len < 0)
+    {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            return 0;
+        }
+        ESP_LOGE(TAG, "Failed to receive data");
+        return -1;
+    }
+    return len;
+}
+
+
+void UdpClient::disconnect()
+{
+    if (sock_ != -1)
+    {
+        close(sock_);
+        sock_ = -1;
+    }
+}
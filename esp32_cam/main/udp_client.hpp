@@ -0,0 +1,25 @@
+#pragma once
+#include <unistd.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+
+class UdpClient
+{
+   public:
+    UdpClient(const std::string& host, uint16_t port, int recvTimeoutMs);
+    ~UdpClient();
+    int connectToServer();
+    int sendData(const uint8_t* data, size_t size);
+    int receiveData(uint8_t* buf, size_t capacity);
+    void disconnect();
+
+   private:
+    std::string hostIp_;
+    uint16_t port_;
+    int recvTimeoutMs_;
+    int sock_;
+};